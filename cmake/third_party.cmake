@@ -41,6 +41,9 @@ if(NOT WIN32)
   set(BLA_STATIC ON)
   set(BLA_VENDOR "Intel10_64lp_seq")
   find_package(BLAS)
+  if(BLAS_FOUND)
+    add_definitions(-DOF_BLAS_SEQUENTIAL)
+  endif()
   if(NOT BLAS_FOUND)
     set(BLA_VENDOR "All")
     find_package(BLAS)
@@ -51,6 +54,7 @@ else()
   )
   set(BLAS_LIBRARIES ${MKL_LIB_PATH}/mkl_core_dll.lib ${MKL_LIB_PATH}/mkl_sequential_dll.lib
                      ${MKL_LIB_PATH}/mkl_intel_lp64_dll.lib)
+  add_definitions(-DOF_BLAS_SEQUENTIAL)
 endif()
 message(STATUS "Found Blas Lib: " ${BLAS_LIBRARIES})
 
@@ -20,5 +20,6 @@ limitations under the License.
 #include "env.h"
 #include "framework.h"
 #include "nn.h"
+#include "profiler.h"
 
 #endif  // !ONEFLOW_API_CPP_API_H_
@@ -14,6 +14,9 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include "oneflow/api/common/ofblob.h"
 #include "oneflow/api/common/variable_tensor_mgr.h"
 #include "oneflow/api/cpp/env_impl.h"
@@ -32,12 +35,19 @@ limitations under the License.
 #include "oneflow/core/common/shape.h"
 #include "oneflow/core/common/symbol.h"
 #include "oneflow/core/common/util.h"
+#include "oneflow/core/eager/eager_blob_object.h"
+#include "oneflow/core/eager/local_dep_object.h"
+#include "oneflow/core/framework/checkpoint_engine.h"
 #include "oneflow/core/framework/device.h"
 #include "oneflow/core/framework/dtype.h"
 #include "oneflow/core/framework/multi_client_session_context.h"
 #include "oneflow/core/framework/nn_graph.h"
 #include "oneflow/core/framework/scope_util.h"
+#include "oneflow/core/framework/stream.h"
 #include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/framework/tensor_impl.h"
+#include "oneflow/core/framework/tensor_meta.h"
+#include "oneflow/core/framework/tensor_storage.h"
 #include "oneflow/core/framework/tensor_tuple.h"
 #include "oneflow/core/framework/tensor_util.h"
 #include "oneflow/core/functional/functional_api.yaml.h"
@@ -57,6 +67,13 @@ limitations under the License.
 #include "oneflow/core/register/logical_blob_id.pb.h"
 #include "oneflow/core/vm/vm_util.h"
 
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // __linux__
+
 namespace oneflow_api {
 
 namespace of = oneflow;
@@ -108,6 +125,101 @@ Shape OfShapeToOfApiShape(const of::Shape& of_shape) {
   return Shape(dims);
 }
 
+of::Shape OfApiShapeToOfShape(const Shape& shape) {
+  of::DimVector dims(shape.NumAxes());
+  for (int64_t i = 0; i < shape.NumAxes(); ++i) { dims[i] = shape.At(i); }
+  return of::Shape(dims);
+}
+
+// A read-only view of a variable file. On linux the file is mapped with MAP_PRIVATE, so the pages
+// live in the page cache and are shared by every process serving the same model; a private copy
+// of a page is only made if it is ever written.
+class VariableFile final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(VariableFile);
+  VariableFile() : data_(nullptr), size_(0) {}
+  ~VariableFile() {
+#ifdef __linux__
+    if (data_ != nullptr) { PCHECK(munmap(data_, size_) == 0); }
+#endif  // __linux__
+  }
+
+  static of::Maybe<VariableFile> Open(const std::string& filename) {
+    auto file = std::make_shared<VariableFile>();
+#ifdef __linux__
+    int fd = open(filename.c_str(), O_RDONLY);
+    CHECK_NE_OR_RETURN(fd, -1) << "open " << filename << " failed: " << strerror(errno);
+    struct stat s {};
+    const int stat_ret = fstat(fd, &s);
+    if (stat_ret == -1) { close(fd); }
+    CHECK_NE_OR_RETURN(stat_ret, -1) << "stat " << filename << " failed: " << strerror(errno);
+    if (s.st_size > 0) {
+      void* ptr = mmap(nullptr, s.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      close(fd);
+      CHECK_OR_RETURN(ptr != MAP_FAILED) << "mmap " << filename << " failed: " << strerror(errno);
+      file->data_ = static_cast<char*>(ptr);
+      file->size_ = s.st_size;
+    } else {
+      close(fd);
+    }
+#else
+    std::ifstream variable_file(filename, std::ios::binary);
+    CHECK_OR_RETURN(variable_file.is_open()) << "open " << filename << " failed";
+    std::stringstream ss;
+    ss << variable_file.rdbuf();
+    file->buffer_ = ss.str();
+    file->data_ = const_cast<char*>(file->buffer_.data());
+    file->size_ = file->buffer_.size();
+#endif  // __linux__
+    return file;
+  }
+
+  char* mut_data() { return data_; }
+  size_t size() const { return size_; }
+
+  // Start reading the whole file in background so that the kernel readahead of all variables
+  // overlaps with the copies of the ones already resident. Only worth it when every page is
+  // about to be read, files bound in place are faulted in on first use instead.
+  void Prefetch() const {
+#ifdef __linux__
+    if (data_ != nullptr) { madvise(data_, size_, MADV_WILLNEED); }
+#endif  // __linux__
+  }
+
+ private:
+  char* data_;
+  size_t size_;
+#ifndef __linux__
+  std::string buffer_;
+#endif  // __linux__
+};
+
+// Builds a cpu tensor whose storage is the variable file itself, the file is unmapped when the
+// tensor storage is released.
+of::Maybe<of::one::Tensor> NewTensorFromVariableFile(const std::shared_ptr<VariableFile>& file,
+                                                     const of::Shape& shape, of::DataType dtype,
+                                                     of::Symbol<of::Device> device) {
+  const size_t byte_size = shape.elem_cnt() * of::GetSizeOfDataType(dtype);
+  CHECK_GE_OR_RETURN(file->size(), byte_size)
+      << "variable file is smaller than the variable, expected " << byte_size << " bytes but got "
+      << file->size();
+  const auto tensor_meta = std::make_shared<of::one::LocalTensorMeta>(
+      std::make_shared<of::Shape>(shape), dtype, device);
+  const auto& Free = [file](char* dptr) {};
+  auto tensor_data = std::make_shared<of::vm::TensorStorage>();
+  tensor_data->set_blob_dptr(
+      std::unique_ptr<char, std::function<void(char*)>>(file->mut_data(), Free), file->size());
+  auto tensor_storage = std::make_shared<of::one::TensorStorage>(tensor_data);
+  auto tensor_impl = std::make_shared<of::one::EagerLocalTensorImpl>(
+      tensor_meta, tensor_storage, /*requires_grad=*/false, /*is_leaf=*/true);
+  JUST(tensor_impl->InitEagerBlobObject(of::NewLocalDepObject()));
+  const auto& stream = JUST(of::GetDefaultStreamByDevice(device));
+  const auto& eager_blob_object = JUST(tensor_impl->eager_blob_object());
+  JUST(eager_blob_object->init_producer_stream(stream));
+  eager_blob_object->set_last_used_stream(stream);
+  return std::shared_ptr<of::one::Tensor>(new of::one::LocalTensor(tensor_impl));
+}
+
 }  // namespace
 
 class Graph::GraphImpl final {
@@ -126,32 +238,84 @@ class Graph::GraphImpl final {
   InputOutputInfos GetOutputInfos();
   std::vector<Tensor> Forward(const std::vector<Tensor>& inputs);
   void set_batch_size(int batch_size) { batch_size_ = batch_size; }
+  of::Maybe<void> set_num_execution_contexts(int num_execution_contexts);
+  of::Maybe<void> AddInputShapeBucket(const std::vector<Shape>& input_shapes);
+  of::Maybe<void> set_trimmed_output_axes(
+      const std::vector<std::vector<int64_t>>& trimmed_output_axes);
 
   of::Maybe<void> RegisterJobPass(
       const std::function<std::string(const std::string& job)>& pass_fn);
 
  private:
+  // An execution context is one compiled NNGraph with its own runtime, i.e. its own register
+  // buffers and activations. All the execution contexts of a graph share the variable tensors.
+  struct ExecutionContext {
+    std::shared_ptr<of::NNGraph> graph;
+    std::vector<std::string> output_op_names;
+    std::shared_ptr<of::one::TensorTuple> output_tensor_tuple;
+  };
+
+  // Hands out the execution contexts in round-robin order, blocks when all of them are in use.
+  class ExecutionContextPool final {
+   public:
+    OF_DISALLOW_COPY_AND_MOVE(ExecutionContextPool);
+    ExecutionContextPool() = default;
+    ~ExecutionContextPool() = default;
+
+    void Add(std::unique_ptr<ExecutionContext>&& context);
+    ExecutionContext* Acquire();
+    void Release(ExecutionContext* context);
+
+   private:
+    std::vector<std::unique_ptr<ExecutionContext>> contexts_;
+    std::deque<ExecutionContext*> idle_contexts_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+  };
+
+  // A set of input shapes the graph is compiled for, together with its execution contexts.
+  struct ShapeBucket {
+    // one shape per input in input order, empty if the graph is compiled for its first inputs
+    std::vector<of::Shape> input_shapes;
+    // trimmed_output_axes[i][axis] is true if the axis of the i-th output is declared to follow
+    // the same axis of the first input, such an axis is trimmed back to the unpadded size after run
+    std::vector<std::vector<bool>> trimmed_output_axes;
+    std::unique_ptr<ExecutionContextPool> context_pool;
+  };
+
   of::Maybe<void> CollectInputOutputInfos();
   of::Maybe<void> Compile(const std::vector<Tensor>& inputs);
-  of::Maybe<std::vector<Tensor>> Run(const std::vector<Tensor>& inputs) const;
-  of::Maybe<void> AddOp(of::OperatorConf op_conf);
-  of::Maybe<void> BuildGraph();
+  of::Maybe<void> InitTrimmedOutputAxes(ShapeBucket* bucket, const ExecutionContext& context);
+  of::Maybe<ShapeBucket*> FindShapeBucket(const std::vector<Tensor>& inputs);
+  of::Maybe<std::vector<Tensor>> Run(const ShapeBucket& bucket, const ExecutionContext& context,
+                                     const std::vector<Tensor>& inputs) const;
+  of::Maybe<void> AddOp(of::OperatorConf op_conf, const std::vector<of::Shape>& input_shapes);
+  of::Maybe<void> BuildGraph(const of::JobConfigProto& job_conf,
+                             const std::vector<of::Shape>& input_shapes, ExecutionContext* context);
   of::Maybe<void> LoadCheckpoint();
-  of::Maybe<void> RegisterTensors(const std::vector<Tensor>& inputs);
+  // On cpu the variable tensors are bound to the mapped variable files, other devices copy from
+  // the mapped files into the pre-allocated variable tensors. A sharded checkpoint is always
+  // copied, its shards are read in parallel.
+  bool LoadVariablesInPlace() const;
+  std::string VariableFilename(const std::string& variable_op_name) const;
+  of::Maybe<of::one::Tensor> NewVariableTensor(const of::OperatorConf& op_conf);
+  of::Maybe<void> RegisterTensors(const std::vector<Tensor>& inputs, ExecutionContext* context);
   of::Maybe<of::Job> ApplyJobPasses(const of::Job& job);
 
-  std::shared_ptr<of::NNGraph> graph_ = nullptr;
+  std::vector<ShapeBucket> shape_buckets_;
+  std::vector<std::vector<int64_t>> trimmed_output_axes_;
   std::string model_path_;
+  bool is_sharded_checkpoint_ = false;
   bool is_compiled_ = false;
+  std::unique_ptr<std::mutex> compile_mutex_ = std::make_unique<std::mutex>();
   int batch_size_ = 0;
+  int num_execution_contexts_ = 1;
   Device device_;
   of::Job job_;
 
   InputOutputInfos input_infos_;
   InputOutputInfos output_infos_;
-  of::HashMap<std::string, std::shared_ptr<of::one::Tensor>> output_name_to_tensor_;
   of::HashMap<std::string, std::shared_ptr<of::one::Tensor>> variable_op_name_to_tensor_;
-  std::shared_ptr<of::one::TensorTuple> output_tensor_tuple_;
   std::shared_ptr<of::one::TensorTuple> parameter_tensor_tuple_;
   std::vector<std::function<std::string(const std::string&)>> registered_job_passes_;
 };
@@ -201,13 +365,48 @@ IValue Graph::Forward(const IValue& inputs) {
 
 void Graph::set_batch_size(int batch_size) { graph_->set_batch_size(batch_size); }
 
+void Graph::set_num_execution_contexts(int num_execution_contexts) {
+  CHECK_JUST(graph_->set_num_execution_contexts(num_execution_contexts));
+}
+
+void Graph::AddInputShapeBucket(const std::vector<Shape>& input_shapes) {
+  CHECK_JUST(graph_->AddInputShapeBucket(input_shapes));
+}
+
+void Graph::set_trimmed_output_axes(const std::vector<std::vector<int64_t>>& trimmed_output_axes) {
+  CHECK_JUST(graph_->set_trimmed_output_axes(trimmed_output_axes));
+}
+
 Graph Graph::Load(const std::string& model_path, const Device& device) {
   Graph graph(model_path, device);
   return graph;
 }
 
+void Graph::GraphImpl::ExecutionContextPool::Add(std::unique_ptr<ExecutionContext>&& context) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_contexts_.emplace_back(context.get());
+  contexts_.emplace_back(std::move(context));
+  cond_.notify_one();
+}
+
+Graph::GraphImpl::ExecutionContext* Graph::GraphImpl::ExecutionContextPool::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this]() { return !idle_contexts_.empty(); });
+  ExecutionContext* context = idle_contexts_.front();
+  idle_contexts_.pop_front();
+  return context;
+}
+
+void Graph::GraphImpl::ExecutionContextPool::Release(ExecutionContext* context) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_contexts_.emplace_back(context);
+  cond_.notify_one();
+}
+
 Graph::GraphImpl::GraphImpl(const std::string& model_path, const Device& device)
-    : model_path_(model_path), device_(device) {
+    : model_path_(model_path),
+      is_sharded_checkpoint_(of::CheckpointEngine::IsCheckpoint(model_path)),
+      device_(device) {
   CHECK_JUST(of::LoadJobFromIR(&job_, model_path + "/model.mlir"));
   CollectInputOutputInfos();
   if (of::ParseBooleanFromEnv("ONEFLOW_SERVING_DEBUG", false)) { LOG(ERROR) << job_.DebugString(); }
@@ -252,6 +451,49 @@ of::Maybe<void> Graph::GraphImpl::RegisterJobPass(
   return of::Maybe<void>::Ok();
 }
 
+of::Maybe<void> Graph::GraphImpl::set_num_execution_contexts(int num_execution_contexts) {
+  if (is_compiled_) {
+    return of::Error::RuntimeError()
+           << "the number of execution contexts should be set before compile and forward";
+  }
+  CHECK_GT_OR_RETURN(num_execution_contexts, 0);
+  num_execution_contexts_ = num_execution_contexts;
+  return of::Maybe<void>::Ok();
+}
+
+of::Maybe<void> Graph::GraphImpl::AddInputShapeBucket(const std::vector<Shape>& input_shapes) {
+  if (is_compiled_) {
+    return of::Error::RuntimeError() << "shape bucket should be added before compile and forward";
+  }
+  CHECK_EQ_OR_RETURN(input_shapes.size(), input_infos_.size())
+      << "a shape bucket should have one shape per input";
+  ShapeBucket bucket;
+  for (const auto& input_info : input_infos_) {
+    const Shape& shape = input_shapes.at(input_info.second.input_output_index_);
+    const Shape& declared_shape = input_info.second.input_output_shape_;
+    CHECK_EQ_OR_RETURN(shape.NumAxes(), declared_shape.NumAxes())
+        << "the shape bucket of input " << input_info.first << " should have "
+        << declared_shape.NumAxes() << " axes";
+  }
+  for (const auto& shape : input_shapes) {
+    bucket.input_shapes.emplace_back(OfApiShapeToOfShape(shape));
+  }
+  shape_buckets_.emplace_back(std::move(bucket));
+  return of::Maybe<void>::Ok();
+}
+
+of::Maybe<void> Graph::GraphImpl::set_trimmed_output_axes(
+    const std::vector<std::vector<int64_t>>& trimmed_output_axes) {
+  if (is_compiled_) {
+    return of::Error::RuntimeError()
+           << "trimmed output axes should be set before compile and forward";
+  }
+  CHECK_LE_OR_RETURN(trimmed_output_axes.size(), output_infos_.size())
+      << "trimmed output axes are declared for more outputs than the graph has";
+  trimmed_output_axes_ = trimmed_output_axes;
+  return of::Maybe<void>::Ok();
+}
+
 of::Maybe<of::Job> Graph::GraphImpl::ApplyJobPasses(const of::Job& job) {
   auto current_job = std::make_shared<of::Job>(job);
   for (const auto& pass_fn : registered_job_passes_) {
@@ -266,42 +508,173 @@ of::Maybe<of::Job> Graph::GraphImpl::ApplyJobPasses(const of::Job& job) {
 }
 
 std::vector<Tensor> Graph::GraphImpl::Forward(const std::vector<Tensor>& inputs) {
-  if (!is_compiled_) {
-    static std::mutex mtx;
-    std::lock_guard<std::mutex> lock(mtx);
-    Compile(inputs).GetOrThrow();
-    is_compiled_ = true;
+  {
+    std::lock_guard<std::mutex> lock(*compile_mutex_);
+    if (!is_compiled_) {
+      Compile(inputs).GetOrThrow();
+      is_compiled_ = true;
+    }
   }
-  return Run(inputs).GetOrThrow();
+  ShapeBucket* bucket = FindShapeBucket(inputs).GetOrThrow();
+  ExecutionContext* context = bucket->context_pool->Acquire();
+  std::shared_ptr<void> release_guard(nullptr,
+                                      [&](void*) { bucket->context_pool->Release(context); });
+  return Run(*bucket, *context, inputs).GetOrThrow();
 }
 
 of::Maybe<void> Graph::GraphImpl::Compile(const std::vector<Tensor>& inputs) {
-  JUST(BuildGraph());
-  JUST(RegisterTensors(inputs));
-  JUST(graph_->CompileAndInitRuntime());
+  if (shape_buckets_.empty()) { shape_buckets_.emplace_back(); }
+  int context_id = 0;
+  for (auto& bucket : shape_buckets_) {
+    bucket.context_pool = std::make_unique<ExecutionContextPool>();
+    // the inputs are only used for their metas when registered, so bucketed graphs are
+    // registered with empty tensors of the bucket shapes
+    std::vector<Tensor> bucket_inputs = inputs;
+    for (int i = 0; i < bucket.input_shapes.size(); ++i) {
+      const auto& input = inputs.at(i).tensor_;
+      bucket_inputs[i] = Tensor(JUST(of::one::functional::Empty(
+          bucket.input_shapes.at(i), input->dtype(), JUST(input->device()), /*pin_memory=*/false)));
+    }
+    for (int i = 0; i < num_execution_contexts_; ++i, ++context_id) {
+      of::JobConfigProto job_conf = job_.job_conf();
+      if (context_id > 0) {
+        job_conf.set_job_name(job_conf.job_name() + "_context" + std::to_string(context_id));
+      }
+      auto context = std::make_unique<ExecutionContext>();
+      JUST(BuildGraph(job_conf, bucket.input_shapes, context.get()));
+      JUST(RegisterTensors(bucket_inputs, context.get()));
+      JUST(context->graph->CompileAndInitRuntime());
+      if (i == 0) { JUST(InitTrimmedOutputAxes(&bucket, *context)); }
+      bucket.context_pool->Add(std::move(context));
+    }
+  }
+  return of::Maybe<void>::Ok();
+}
+
+of::Maybe<void> Graph::GraphImpl::InitTrimmedOutputAxes(ShapeBucket* bucket,
+                                                        const ExecutionContext& context) {
+  for (const auto& output : *context.output_tensor_tuple) {
+    bucket->trimmed_output_axes.emplace_back(output->shape()->NumAxes(), false);
+  }
+  if (bucket->input_shapes.empty()) { return of::Maybe<void>::Ok(); }
+  const of::Shape& first_input_shape = bucket->input_shapes.front();
+  for (int i = 0; i < trimmed_output_axes_.size(); ++i) {
+    const of::Shape& output_shape = *context.output_tensor_tuple->at(i)->shape();
+    for (int64_t axis : trimmed_output_axes_.at(i)) {
+      CHECK_OR_RETURN(axis >= 0 && axis < output_shape.NumAxes()
+                      && axis < first_input_shape.NumAxes())
+          << "trimmed axis " << axis << " of output " << i << " is out of range";
+      CHECK_EQ_OR_RETURN(output_shape.At(axis), first_input_shape.At(axis))
+          << "axis " << axis << " of output " << i << " is declared to follow the first input, "
+          << "but its size " << output_shape.At(axis) << " differs from the input size "
+          << first_input_shape.At(axis) << " in shape bucket " << first_input_shape.ToString();
+      bucket->trimmed_output_axes.at(i).at(axis) = true;
+    }
+  }
   return of::Maybe<void>::Ok();
 }
 
-of::Maybe<std::vector<Tensor>> Graph::GraphImpl::Run(const std::vector<Tensor>& inputs) const {
+of::Maybe<Graph::GraphImpl::ShapeBucket*> Graph::GraphImpl::FindShapeBucket(
+    const std::vector<Tensor>& inputs) {
+  if (shape_buckets_.front().input_shapes.empty()) { return &shape_buckets_.front(); }
+  ShapeBucket* best_bucket = nullptr;
+  int64_t best_elem_cnt = 0;
+  for (auto& bucket : shape_buckets_) {
+    CHECK_EQ_OR_RETURN(inputs.size(), bucket.input_shapes.size());
+    bool fits = true;
+    int64_t elem_cnt = 0;
+    for (int i = 0; i < inputs.size() && fits; ++i) {
+      const of::Shape& input_shape = *inputs.at(i).tensor_->shape();
+      const of::Shape& bucket_shape = bucket.input_shapes.at(i);
+      if (input_shape.NumAxes() != bucket_shape.NumAxes()) { fits = false; }
+      for (int64_t axis = 0; axis < input_shape.NumAxes() && fits; ++axis) {
+        if (input_shape.At(axis) > bucket_shape.At(axis)) { fits = false; }
+      }
+      elem_cnt += bucket_shape.elem_cnt();
+    }
+    if (fits && (best_bucket == nullptr || elem_cnt < best_elem_cnt)) {
+      best_bucket = &bucket;
+      best_elem_cnt = elem_cnt;
+    }
+  }
+  CHECK_NOTNULL_OR_RETURN(best_bucket) << "none of the shape buckets fits the input shapes";
+  return best_bucket;
+}
+
+of::Maybe<std::vector<Tensor>> Graph::GraphImpl::Run(const ShapeBucket& bucket,
+                                                     const ExecutionContext& context,
+                                                     const std::vector<Tensor>& inputs) const {
   const auto input_tensor_tuple = std::make_shared<of::one::TensorTuple>();
-  for (const auto& tensor : inputs) { input_tensor_tuple->emplace_back(tensor.tensor_); }
+  for (int i = 0; i < inputs.size(); ++i) {
+    const auto& tensor = inputs.at(i).tensor_;
+    if (bucket.input_shapes.empty() || *tensor->shape() == bucket.input_shapes.at(i)) {
+      input_tensor_tuple->emplace_back(tensor);
+      continue;
+    }
+    // pad with zeros at the end of every axis, the pad list starts from the last axis
+    const of::Shape& bucket_shape = bucket.input_shapes.at(i);
+    std::vector<int64_t> pad;
+    for (int64_t axis = bucket_shape.NumAxes() - 1; axis >= 0; --axis) {
+      pad.emplace_back(0);
+      pad.emplace_back(bucket_shape.At(axis) - tensor->shape()->At(axis));
+    }
+    input_tensor_tuple->emplace_back(
+        JUST(of::one::functional::Pad(tensor, pad, "constant", of::Scalar(0))));
+  }
+
+  // Every run writes to new output tensors, so that outputs returned to one caller are never
+  // overwritten by a later run on the same execution context.
+  const auto output_tensor_tuple = std::make_shared<of::one::TensorTuple>();
+  for (const auto& tensor : *context.output_tensor_tuple) {
+    output_tensor_tuple->emplace_back(JUST(of::one::functional::Empty(
+        *tensor->shape(), tensor->dtype(), JUST(tensor->device()), /*pin_memory=*/false)));
+  }
 
-  JUST(of::RunLazyNNGraph(*input_tensor_tuple, *output_tensor_tuple_, *parameter_tensor_tuple_,
-                          graph_));
-  JUST(of::SoftSyncNNGraphBuffers(*output_tensor_tuple_, graph_));
+  JUST(of::RunLazyNNGraph(*input_tensor_tuple, *output_tensor_tuple, *parameter_tensor_tuple_,
+                          context.graph));
+  JUST(of::SoftSyncNNGraphBuffers(*output_tensor_tuple, context.graph));
 
   std::vector<Tensor> outputs;
-  for (const auto& tensor : *output_tensor_tuple_) { outputs.emplace_back(Tensor(tensor)); }
+  for (int i = 0; i < output_tensor_tuple->size(); ++i) {
+    const auto& tensor = output_tensor_tuple->at(i);
+    if (bucket.input_shapes.empty()) {
+      outputs.emplace_back(Tensor(tensor));
+      continue;
+    }
+    const of::Shape& first_input_shape = *inputs.front().tensor_->shape();
+    const int64_t num_axes = tensor->shape()->NumAxes();
+    std::vector<int64_t> start(num_axes, 0);
+    std::vector<int64_t> stop(tensor->shape()->dim_vec().begin(), tensor->shape()->dim_vec().end());
+    std::vector<int64_t> step(num_axes, 1);
+    bool trimmed = false;
+    for (int64_t axis = 0; axis < num_axes; ++axis) {
+      if (bucket.trimmed_output_axes.at(i).at(axis) && stop[axis] != first_input_shape.At(axis)) {
+        stop[axis] = first_input_shape.At(axis);
+        trimmed = true;
+      }
+    }
+    if (trimmed) {
+      outputs.emplace_back(Tensor(JUST(
+          of::one::functional::Slice(tensor, start, stop, step, /*enable_view_slice=*/false))));
+    } else {
+      outputs.emplace_back(Tensor(tensor));
+    }
+  }
   return outputs;
 }
 
-of::Maybe<void> Graph::GraphImpl::AddOp(of::OperatorConf op_conf) {
+of::Maybe<void> Graph::GraphImpl::AddOp(of::OperatorConf op_conf,
+                                         const std::vector<of::Shape>& input_shapes) {
   {
     const std::shared_ptr<of::Scope> scope = JUST(of::GetCurrentScope());
     op_conf.set_scope_symbol_id(scope->symbol_id().value_or(0));
   }
   op_conf.set_device_tag(GetDeviceTag(device_));
-  if (batch_size_ > 0 && op_conf.has_input_conf()) {
+  if (!input_shapes.empty() && op_conf.has_input_conf()) {
+    const size_t index = input_infos_.at(op_conf.name()).input_output_index_;
+    auto* shape = op_conf.mutable_input_conf()->mutable_blob_conf()->mutable_shape();
+    input_shapes.at(index).ToProto(shape);
+  } else if (batch_size_ > 0 && op_conf.has_input_conf()) {
     op_conf.mutable_input_conf()->mutable_blob_conf()->mutable_shape()->mutable_dim()->Set(
         0, batch_size_);
   }
@@ -310,25 +683,25 @@ of::Maybe<void> Graph::GraphImpl::AddOp(of::OperatorConf op_conf) {
   return of::Maybe<void>::Ok();
 }
 
-of::Maybe<void> Graph::GraphImpl::BuildGraph() {
-  CompileScope build_graph_scope(job_.job_conf(), *device_.device_->shared_from_symbol());
+of::Maybe<void> Graph::GraphImpl::BuildGraph(const of::JobConfigProto& job_conf,
+                                              const std::vector<of::Shape>& input_shapes,
+                                              ExecutionContext* context) {
+  // variables are created and loaded by the first execution context and shared by the others
+  const bool load_variables = variable_op_name_to_tensor_.empty();
+  CompileScope build_graph_scope(job_conf, *device_.device_->shared_from_symbol());
   {
     const of::OpGraph op_graph(job_);
     op_graph.TopoForEachNode([&](const of::OpNode* node) -> of::Maybe<void> {
       const of::OperatorConf& op_conf = node->op().op_conf();
-      JUST(AddOp(op_conf));
-      if (op_conf.has_variable_conf()) {
+      JUST(AddOp(op_conf, input_shapes));
+      if (load_variables && op_conf.has_variable_conf()) {
         const of::LazyMode::Guard lazy_mode_disabled_guard{false};
-        const of::VariableOpConf& variable_conf = op_conf.variable_conf();
-        variable_op_name_to_tensor_[op_conf.name()] = JUST(of::one::functional::Empty(
-            of::Shape(variable_conf.shape()),
-            JUST(of::DType::Get(static_cast<of::DataType>(variable_conf.data_type()))),
-            *device_.device_, /*pin_memory=*/false));
+        variable_op_name_to_tensor_[op_conf.name()] = JUST(NewVariableTensor(op_conf));
       }
       return of::Maybe<void>::Ok();
     });
   }
-  JUST(LoadCheckpoint());
+  if (load_variables) { JUST(LoadCheckpoint()); }
   JUST(of::CurJobBuildAndInferCtx_Complete());
   std::shared_ptr<of::Job> complete_job = JUST(of::GetCurrentJob());
   int64_t job_id = JUST(of::JobBuildAndInferCtx_GetCurrentJobId());
@@ -336,8 +709,10 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
 
   // apply custom job passes
   complete_job = JUST(ApplyJobPasses(*complete_job));
-  graph_ = std::make_shared<of::NNGraph>(job_.job_conf().job_name(), *complete_job, job_id,
-                                         of::Singleton<OneFlowEnv>::Get()->GetSessionCtx());
+  const auto& session_ctx = of::Singleton<OneFlowEnv>::Get()->GetSessionCtx();
+  context->graph =
+      std::make_shared<of::NNGraph>(job_conf.job_name(), *complete_job, job_id, session_ctx);
+  of::HashMap<std::string, std::shared_ptr<of::one::Tensor>> output_name_to_tensor;
   {
     const of::OpGraph complete_graph(*complete_job);
     complete_graph.TopoForEachNode([&](const of::OpNode* node) -> of::Maybe<void> {
@@ -345,13 +720,16 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
       const of::OperatorConf& op_conf = node->op().op_conf();
       if (op_conf.has_output_conf()) {
         of::InterfaceBlobConf blob_conf = op_conf.output_conf().blob_conf();
-        if (batch_size_ > 0) {
+        if (!input_shapes.empty()) {
+          const of::LogicalBlobId input_lbi = of::GenLogicalBlobId(op_conf.output_conf().in());
+          node->LogicalBlobDesc4Lbi(input_lbi).shape().ToProto(blob_conf.mutable_shape());
+        } else if (batch_size_ > 0) {
           const std::string input_lbi_str = op_conf.output_conf().in();
           const of::LogicalBlobId input_lbi = of::GenLogicalBlobId(input_lbi_str);
           int64_t batch_size = node->LogicalBlobDesc4Lbi(input_lbi).shape().At(0);
           blob_conf.mutable_shape()->set_dim(0, batch_size);
         }
-        output_name_to_tensor_[op_conf.name()] = JUST(of::one::functional::Empty(
+        output_name_to_tensor[op_conf.name()] = JUST(of::one::functional::Empty(
             of::Shape(blob_conf.shape()),
             JUST(of::DType::Get(static_cast<of::DataType>(blob_conf.data_type()))),
             *device_.device_, /*pin_memory=*/false));
@@ -359,35 +737,71 @@ of::Maybe<void> Graph::GraphImpl::BuildGraph() {
       return of::Maybe<void>::Ok();
     });
   }
+  {
+    const auto& pair = Unzip(output_name_to_tensor);
+    context->output_op_names = pair.first;
+    context->output_tensor_tuple = ConvertToTensorTuple(pair.second);
+  }
   return of::Maybe<void>::Ok();
 }
 
+std::string Graph::GraphImpl::VariableFilename(const std::string& variable_op_name) const {
+  return model_path_ + "/" + variable_op_name + "/out";
+}
+
+bool Graph::GraphImpl::LoadVariablesInPlace() const {
+  return device_.type() == "cpu" && !is_sharded_checkpoint_;
+}
+
+of::Maybe<of::one::Tensor> Graph::GraphImpl::NewVariableTensor(const of::OperatorConf& op_conf) {
+  const of::VariableOpConf& variable_conf = op_conf.variable_conf();
+  const of::Shape shape(variable_conf.shape());
+  const auto data_type = static_cast<of::DataType>(variable_conf.data_type());
+  if (LoadVariablesInPlace()) {
+    const auto file = JUST(VariableFile::Open(VariableFilename(op_conf.name())));
+    return NewTensorFromVariableFile(file, shape, data_type, *device_.device_);
+  }
+  return of::one::functional::Empty(shape, JUST(of::DType::Get(data_type)), *device_.device_,
+                                    /*pin_memory=*/false);
+}
+
 of::Maybe<void> Graph::GraphImpl::LoadCheckpoint() {
-  for (const auto& variable_op_name_and_tensor : variable_op_name_to_tensor_) {
-    const auto& variable_op_name = variable_op_name_and_tensor.first;
-    const auto& variable_tensor = variable_op_name_and_tensor.second;
-    const std::string variable_filename = model_path_ + "/" + variable_op_name + "/out";
-    const std::string buffer = [&]() {
-      std::ifstream variable_file(variable_filename, std::ios::binary);
-      CHECK(variable_file.is_open());
-      std::stringstream ss;
-      ss << variable_file.rdbuf();
-      return ss.str();
-    }();
-    const auto& callback = [&](uint64_t of_blob_ptr) {
-      CHECK_JUST(of::BlobBufferCopyUtil<void>::From(
-          of_blob_ptr, buffer.data(),
-          variable_tensor->shape()->elem_cnt()
-              * of::GetSizeOfDataType(variable_tensor->dtype()->data_type())));
-    };
-    JUST(of::one::SyncAccessTensorWithTimeOut(variable_tensor, callback, "mut"));
+  if (is_sharded_checkpoint_) {
+    const auto& pair = Unzip(variable_op_name_to_tensor_);
+    JUST(of::Singleton<of::CheckpointEngine>::Get()->Load(model_path_, pair.first, pair.second));
+  } else if (!LoadVariablesInPlace()) {
+    std::vector<std::pair<std::shared_ptr<VariableFile>, std::shared_ptr<of::one::Tensor>>>
+        files_and_tensors;
+    files_and_tensors.reserve(variable_op_name_to_tensor_.size());
+    for (const auto& variable_op_name_and_tensor : variable_op_name_to_tensor_) {
+      const auto file =
+          JUST(VariableFile::Open(VariableFilename(variable_op_name_and_tensor.first)));
+      file->Prefetch();
+      files_and_tensors.emplace_back(file, variable_op_name_and_tensor.second);
+    }
+    for (auto& file_and_tensor : files_and_tensors) {
+      VariableFile* file = file_and_tensor.first.get();
+      const auto& variable_tensor = file_and_tensor.second;
+      const size_t byte_size = variable_tensor->shape()->elem_cnt()
+                               * of::GetSizeOfDataType(variable_tensor->dtype()->data_type());
+      CHECK_GE_OR_RETURN(file->size(), byte_size)
+          << "variable file is smaller than the variable, expected " << byte_size
+          << " bytes but got " << file->size();
+      const auto& callback = [&](uint64_t of_blob_ptr) {
+        CHECK_JUST(of::BlobBufferCopyUtil<void>::From(of_blob_ptr, file->mut_data(), byte_size));
+      };
+      JUST(of::one::SyncAccessTensorWithTimeOut(variable_tensor, callback, "mut"));
+      // unmap as soon as the variable has been copied to the device to bound host memory
+      file_and_tensor.first.reset();
+    }
   }
   const auto& pair = Unzip(variable_op_name_to_tensor_);
   JUST(of::FillVariableTensorMgr(pair.first, pair.second));
   return of::Maybe<void>::Ok();
 }
 
-of::Maybe<void> Graph::GraphImpl::RegisterTensors(const std::vector<Tensor>& inputs) {
+of::Maybe<void> Graph::GraphImpl::RegisterTensors(const std::vector<Tensor>& inputs,
+                                                   ExecutionContext* context) {
   {
     std::vector<std::string> input_op_names(inputs.size());
     std::vector<std::shared_ptr<of::one::Tensor>> input_tensors(inputs.size());
@@ -396,20 +810,18 @@ of::Maybe<void> Graph::GraphImpl::RegisterTensors(const std::vector<Tensor>& inp
       input_op_names[index] = input_info.first;
       input_tensors[index] = inputs.at(index).tensor_;
     }
-    JUST(graph_->RegisterInputOpNamesAndTensors(input_op_names, input_tensors));
+    JUST(context->graph->RegisterInputOpNamesAndTensors(input_op_names, input_tensors));
   }
   {
-    const auto& pair = Unzip(output_name_to_tensor_);
-    const std::vector<std::string>& output_op_names = pair.first;
-    const std::vector<std::shared_ptr<of::one::Tensor>>& output_tensors = pair.second;
-    JUST(graph_->RegisterOutputOpNamesAndTensors(output_op_names, output_tensors));
-    output_tensor_tuple_ = ConvertToTensorTuple(output_tensors);
+    const std::vector<std::shared_ptr<of::one::Tensor>> output_tensors(
+        context->output_tensor_tuple->begin(), context->output_tensor_tuple->end());
+    JUST(context->graph->RegisterOutputOpNamesAndTensors(context->output_op_names, output_tensors));
   }
   {
     const auto& t = of::DumpVariableTensorMgr();
     const std::vector<std::string>& variable_op_names = std::get<0>(t);
     const std::vector<std::shared_ptr<of::one::Tensor>>& variable_tensors = std::get<1>(t);
-    JUST(graph_->RegisterVariableOpNamesAndTensors(variable_op_names, variable_tensors));
+    JUST(context->graph->RegisterVariableOpNamesAndTensors(variable_op_names, variable_tensors));
     parameter_tensor_tuple_ = ConvertToTensorTuple(variable_tensors);
   }
   return of::Maybe<void>::Ok();
@@ -64,6 +64,21 @@ class Graph {
   InputOutputInfos GetOutputInfos();
   IValue Forward(const IValue& inputs);
   void set_batch_size(int batch_size);
+  // Compiles the graph into `num_execution_contexts` runtimes which share the loaded variables,
+  // so that Forward can be called from that many threads concurrently. The runs of the contexts
+  // overlap as long as the graph does not update its variables and runs in a single process.
+  // Must be set before the first Forward.
+  void set_num_execution_contexts(int num_execution_contexts);
+  // Adds a set of input shapes, one per input in input order, the graph is compiled for. With
+  // shape buckets added, Forward runs on the smallest bucket all the inputs fit in: inputs are
+  // padded with zeros up to the bucket shapes, and the output axes declared with
+  // set_trimmed_output_axes are trimmed back. Must be called before the first Forward.
+  void AddInputShapeBucket(const std::vector<Shape>& input_shapes);
+  // Declares, for every output in output order, the axes that follow the same axes of the first
+  // input, e.g. {{0, 1}} for a [batch, seq, hidden] output of a [batch, seq] input. After a
+  // bucketed Forward these axes are trimmed back to the unpadded sizes of the first input, the
+  // other axes keep the sizes computed for the bucket. Must be called before the first Forward.
+  void set_trimmed_output_axes(const std::vector<std::vector<int64_t>>& trimmed_output_axes);
 
   void RegisterJobPass(const std::function<std::string(const std::string& job)>& pass_fn);
 
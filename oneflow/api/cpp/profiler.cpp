@@ -0,0 +1,33 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/api/cpp/profiler.h"
+#include "oneflow/core/profiler/op_trace.h"
+
+namespace oneflow_api {
+namespace profiler {
+
+namespace of = oneflow;
+
+void EnableOpTrace(bool enabled) { of::profiler::EnableOpTrace(enabled); }
+
+std::string DumpOpTraceStatsJson() { return of::profiler::DumpOpTraceStatsJson(); }
+
+std::string DumpOpTraceChromeTrace() { return of::profiler::DumpOpTraceChromeTrace(); }
+
+void ResetOpTrace() { of::profiler::ResetOpTrace(); }
+
+}  // namespace profiler
+}  // namespace oneflow_api
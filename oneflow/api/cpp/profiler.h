@@ -0,0 +1,39 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_API_CPP_PROFILER_H_
+#define ONEFLOW_API_CPP_PROFILER_H_
+
+#include <string>
+
+namespace oneflow_api {
+namespace profiler {
+
+// Always-on op tracing, also enabled by ONEFLOW_PROFILER_ENABLE_OP_TRACE=1.
+void EnableOpTrace(bool enabled);
+
+// Returns a json array with the count, total, max, p50, p90 and p99 latency in nanoseconds of
+// every traced op type and vm instruction type.
+std::string DumpOpTraceStatsJson();
+
+// Returns the most recent traced launches of every thread in the chrome trace event format.
+std::string DumpOpTraceChromeTrace();
+
+void ResetOpTrace();
+
+}  // namespace profiler
+}  // namespace oneflow_api
+
+#endif  // ONEFLOW_API_CPP_PROFILER_H_
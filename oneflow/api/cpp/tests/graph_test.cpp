@@ -159,6 +159,53 @@ TEST(Api, graph_thread_test) {
   for (auto& thread : threads) { thread.join(); }
 }
 
+TEST(Api, graph_cpu_shape_bucket_test) {
+  EnvScope scope;
+  Device device("cpu");
+  Graph graph = LoadGraph(device);
+  graph.AddInputShapeBucket({Shape({2, 3})});
+  graph.AddInputShapeBucket({Shape({4, 3})});
+  graph.set_trimmed_output_axes({{0}});
+  Forward(graph, device, 3);
+  Forward(graph, device, 2);
+  Forward(graph, device, 1);
+  Forward(graph, device, 4);
+}
+
+TEST(Api, graph_cpu_concurrent_forward_test) {
+  EnvScope scope;
+
+  constexpr int kNumExecutionContexts = 4;
+  constexpr int kNumForwardPerThread = 50;
+  constexpr int kNumRepeats = 3;
+  Device device("cpu");
+  Graph graph = LoadGraph(device);
+  graph.set_num_execution_contexts(kNumExecutionContexts);
+  Forward(graph, device, 1);
+
+  // the best of several repeats, so that a slow repeat on a busy machine does not count
+  const auto& Throughput = [&](int num_threads) {
+    double best = 0;
+    for (int repeat = 0; repeat < kNumRepeats; ++repeat) {
+      const auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([&]() {
+          for (int j = 0; j < kNumForwardPerThread; ++j) { Forward(graph, device, 1); }
+        });
+      }
+      for (auto& thread : threads) { thread.join(); }
+      const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      best = std::max(best, num_threads * kNumForwardPerThread / elapsed.count());
+    }
+    return best;
+  };
+  const double serial_throughput = Throughput(1);
+  const double concurrent_throughput = Throughput(kNumExecutionContexts);
+  // the runs of different execution contexts overlap, so more threads finish more forwards
+  ASSERT_GT(concurrent_throughput, serial_throughput);
+}
+
 TEST(Api, graph_input_order_test) {
   EnvScope scope;
 
@@ -79,14 +79,24 @@ Maybe<one::TensorTuple> CheckAndInitOutGrads(const one::TensorTuple& outputs,
   return gradients;
 }
 
+// Workers of the parallel backward acquire the GIL themselves to run python hooks and custom
+// autograd functions, so the calling thread must not hold it while the graph runs.
+std::unique_ptr<py::gil_scoped_release> ReleaseGILIfParallelBackward() {
+  if (one::AutogradThreadNum() > 1) { return std::make_unique<py::gil_scoped_release>(); }
+  return nullptr;
+}
+
 }  // namespace
 
 Maybe<one::TensorTuple> Backward(const one::TensorTuple& outputs, const one::TensorTuple& out_grads,
                                  bool retain_graph, bool create_graph) {
   if (create_graph) { retain_graph = true; }
   std::shared_ptr<one::TensorTuple> gradients = JUST(CheckAndInitOutGrads(outputs, out_grads));
-  JUST(one::GetThreadLocalAutogradEngine()->RunBackwardAndSaveGrads4LeafTensorIf(
-      outputs, *gradients, retain_graph, create_graph));
+  {
+    const auto& gil_release = ReleaseGILIfParallelBackward();
+    JUST(one::GetThreadLocalAutogradEngine()->RunBackwardAndSaveGrads4LeafTensorIf(
+        outputs, *gradients, retain_graph, create_graph));
+  }
   return std::make_shared<one::TensorTuple>(0);
 }
 
@@ -100,6 +110,7 @@ Maybe<one::TensorTuple> Grad(const one::TensorTuple& outputs, const one::TensorT
       [](const std::shared_ptr<one::Tensor>& tensor) { return tensor->requires_grad(); }))
       << "All input tensors `.requires_grad` should be true";
   std::shared_ptr<one::TensorTuple> gradients = JUST(CheckAndInitOutGrads(outputs, out_grads));
+  const auto& gil_release = ReleaseGILIfParallelBackward();
   return one::GetThreadLocalAutogradEngine()->RunBackwardAndReturnInputsTensorGradIf(
       outputs, inputs, *gradients, retain_graph, create_graph);
 }
@@ -65,11 +65,18 @@ py::object PackTensorTuple(const one::TensorTuple& tp) {
 }
 
 // wrap PyFunction, unpack the inputs from TensorTuple and pack outputs to TensorTuple
+// The backward function may be called and released on a worker of the parallel autograd engine,
+// so the GIL is acquired explicitly.
 one::AutogradFunctionBase::FType PackPyFunctionToFType(const py::function& func) {
-  return [func](const std::shared_ptr<one::FunctionAutoGradCaptureState>& ctx,
-                const one::TensorTuple& inputs) {
+  std::shared_ptr<py::function> func_ptr(new py::function(func), [](py::function* ptr) {
+    py::gil_scoped_acquire acquire;
+    delete ptr;
+  });
+  return [func_ptr](const std::shared_ptr<one::FunctionAutoGradCaptureState>& ctx,
+                    const one::TensorTuple& inputs) {
+    py::gil_scoped_acquire acquire;
     const py::tuple& a = py::cast(inputs);
-    py::object res = func(ctx, *a);
+    py::object res = (*func_ptr)(ctx, *a);
     return UnpackTensorTuple(res).GetPtrOrThrow();
   };
 }
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include "oneflow/api/python/env/env.h"
 #include "oneflow/api/python/of_api_registry.h"
 #include "oneflow/core/job/env_global_objects_scope.h"
@@ -60,6 +61,9 @@ ONEFLOW_API_PYBIND11_MODULE("", m) {
   m.def("RDMAIsInitialized", &RDMAIsInitialized);
   m.def("CudaGetDeviceCount", &CudaGetDeviceCount);
   m.def("EmptyCache", &EmptyCache);
+  m.def("GetAllocatorStats", &GetAllocatorStats);
+  m.def("CtrlBarrier", &CtrlBarrier, py::call_guard<py::gil_scoped_release>());
+  m.def("CtrlBroadcastKV", &CtrlBroadcastKV, py::call_guard<py::gil_scoped_release>());
 #ifdef WITH_CUDA
   m.def("GetCudaDeviceIndex", &GetCudaDeviceIndex);
   m.def("SetCudaDeviceIndex", &SetCudaDeviceIndex);
@@ -29,6 +29,7 @@ limitations under the License.
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/rpc/include/base.h"
 #include "oneflow/core/ep/include/device_manager_registry.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
 #include "oneflow/core/vm/vm_util.h"
 #include "oneflow/core/vm/virtual_machine.h"
 
@@ -80,6 +81,53 @@ inline Maybe<void> EmptyCache() {
   return Maybe<void>::Ok();
 }
 
+inline Maybe<HashMap<std::string, HashMap<std::string, double>>> GetAllocatorStats() {
+  auto* vm = JUST(SingletonMaybe<VirtualMachine>());
+  const auto& stream_name2stats = JUST(vm->GetAllocatorStats());
+  HashMap<std::string, HashMap<std::string, double>> ret;
+  for (const auto& pair : *stream_name2stats) {
+    const vm::CachingAllocatorStats& stats = pair.second;
+    ret[pair.first] = {
+        {"reserved_bytes", static_cast<double>(stats.reserved_bytes)},
+        {"allocated_bytes", static_cast<double>(stats.allocated_bytes)},
+        {"peak_allocated_bytes", static_cast<double>(stats.peak_allocated_bytes)},
+        {"thread_cached_bytes", static_cast<double>(stats.thread_cached_bytes)},
+        {"free_bytes", static_cast<double>(stats.free_bytes)},
+        {"largest_free_bytes", static_cast<double>(stats.largest_free_bytes)},
+        {"fragmentation", stats.fragmentation()},
+        {"thread_cache_hit_rate", stats.thread_cache_hit_rate()},
+    };
+  }
+  // Backing memory of the cpu device, shared by the eager streams and the lazy memory chunks
+  auto cpu_device = std::dynamic_pointer_cast<ep::CpuDevice>(
+      Singleton<ep::DeviceManagerRegistry>::Get()->GetDevice(DeviceType::kCPU, 0));
+  if (cpu_device) {
+    const ep::CpuAllocationStats stats = cpu_device->GetAllocationStats();
+    ret["cpu/device"] = {
+        {"mapped_bytes", static_cast<double>(stats.mapped_bytes)},
+        {"transparent_huge_page_bytes", static_cast<double>(stats.transparent_huge_page_bytes)},
+        {"huge_tlb_bytes", static_cast<double>(stats.huge_tlb_bytes)},
+        {"numa_bound_bytes", static_cast<double>(stats.numa_bound_bytes)},
+        {"huge_tlb_fallback_cnt", static_cast<double>(stats.huge_tlb_fallback_cnt)},
+        {"numa_bind_failure_cnt", static_cast<double>(stats.numa_bind_failure_cnt)},
+    };
+  }
+  return ret;
+}
+
+// Ctrl plane barrier of all ranks, without synchronizing the virtual machine like eager.Sync
+inline Maybe<void> CtrlBarrier(const std::string& barrier_name) {
+  JUST(SingletonMaybe<CtrlClient>())->Barrier(barrier_name);
+  return Maybe<void>::Ok();
+}
+
+// Value of rank 0 for key on every rank, sent over the ctrl plane like the nn.Graph plan
+inline Maybe<std::string> CtrlBroadcastKV(const std::string& key, const std::string& value) {
+  std::string broadcast_value = value;
+  JUST(SingletonMaybe<CtrlClient>())->BroadcastKV(key, &broadcast_value);
+  return broadcast_value;
+}
+
 inline Maybe<void> SetGraphLRVerbose(bool verbose) {
   SetGraphVerboseStepLr(verbose);
   return Maybe<void>::Ok();
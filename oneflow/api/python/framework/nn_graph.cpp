@@ -19,6 +19,8 @@ limitations under the License.
 #include <string>
 #include "oneflow/api/python/job_build/job_build_and_infer.h"
 #include "oneflow/api/python/of_api_registry.h"
+#include "oneflow/core/common/singleton.h"
+#include "oneflow/core/framework/checkpoint_engine.h"
 #include "oneflow/core/framework/multi_client_session_context.h"
 #include "oneflow/core/framework/tensor.h"
 #include "oneflow/core/framework/nn_graph.h"
@@ -81,11 +83,15 @@ ONEFLOW_API_PYBIND11_MODULE("nn.graph.", m) {
       .def_property_readonly("additional_var_names", &APINNGraphAdditionalVarNames)
       .def_property_readonly("additional_var_tensors", &APINNGraphAdditionalVarTensors)
       .def("complie_and_init_runtime", &NNGraph::CompileAndInitRuntime)
-      .def("get_current_job_str", &APINNGraphGetCurrentSerializedJob);
+      .def("get_current_job_str", &APINNGraphGetCurrentSerializedJob)
+      .def("async_save_variables", &NNGraph::AsyncSaveVariables)
+      .def("load_variables", &NNGraph::LoadVariables);
 
   m.def("RunLazyNNGraph", &RunLazyNNGraph);
   m.def("SoftSyncNNGraphBuffers", &SoftSyncNNGraphBuffers);
   m.def("AddTensorAsGraphLoss", &AddTensorAsGraphLoss);
+  m.def("WaitUntilCheckpointSaved",
+        []() -> Maybe<void> { return Singleton<CheckpointEngine>::Get()->WaitUntilSaved(); });
   m.def("ConvertJobToTosaIR", [](const std::string& serialized_job) -> Maybe<std::string> {
     Job job;
     CHECK_OR_RETURN(TxtString2PbMessage(serialized_job, &job))
@@ -0,0 +1,183 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <cmath>
+#include "oneflow/core/auto_parallel/sbp_graph.h"
+
+namespace oneflow {
+
+namespace {
+
+// Changes smaller than this ratio of the cost are treated as noise, so that ties keep the
+// current choices.
+constexpr double kRelativeTolerance = 1e-9;
+
+bool IsImproved(double new_cost, double old_cost) {
+  return new_cost < old_cost - kRelativeTolerance * std::abs(old_cost);
+}
+
+}  // namespace
+
+int32_t SbpGraph::AddNode(std::vector<double> node_cost) {
+  CHECK(!node_cost.empty());
+  nodes_.emplace_back();
+  nodes_.back().cost = std::move(node_cost);
+  return nodes_.size() - 1;
+}
+
+void SbpGraph::AddEdge(int32_t producer, int32_t consumer,
+                       const std::vector<std::vector<double>>& cost) {
+  CHECK_LT(producer, consumer);
+  CHECK_LT(consumer, nodes_.size());
+  CHECK_EQ(cost.size(), CandidateNum(producer));
+  for (const auto& row : cost) { CHECK_EQ(row.size(), CandidateNum(consumer)); }
+  for (int32_t edge_id : nodes_[producer].out_edges) {
+    SbpEdge* edge = &edges_[edge_id];
+    if (edge->consumer != consumer) { continue; }
+    for (int32_t i = 0; i < cost.size(); ++i) {
+      for (int32_t j = 0; j < cost[i].size(); ++j) { edge->cost[i][j] += cost[i][j]; }
+    }
+    return;
+  }
+  edges_.emplace_back(SbpEdge{producer, consumer, cost});
+  nodes_[producer].out_edges.emplace_back(edges_.size() - 1);
+  nodes_[consumer].in_edges.emplace_back(edges_.size() - 1);
+}
+
+void SbpGraph::SetChoice(int32_t node_id, int32_t choice) {
+  CHECK_GE(choice, 0);
+  CHECK_LT(choice, CandidateNum(node_id));
+  nodes_.at(node_id).choice = choice;
+}
+
+double SbpGraph::ComputeCost() const {
+  double total_cost = ComputeEdgeCost();
+  for (const auto& node : nodes_) { total_cost += node.cost[node.choice]; }
+  return total_cost;
+}
+
+double SbpGraph::ComputeEdgeCost() const {
+  double total_cost = 0.0;
+  for (const auto& edge : edges_) { total_cost += EdgeCost(edge); }
+  return total_cost;
+}
+
+void SbpGraph::ComputeUnaryCost(int32_t node_id, int32_t skip_in_edge, int32_t skip_out_edge,
+                                std::vector<double>* unary_cost) const {
+  const SbpNode& node = nodes_[node_id];
+  *unary_cost = node.cost;
+  for (int32_t edge_id : node.in_edges) {
+    if (edge_id == skip_in_edge) { continue; }
+    const SbpEdge& edge = edges_[edge_id];
+    const auto& row = edge.cost[nodes_[edge.producer].choice];
+    for (int32_t i = 0; i < unary_cost->size(); ++i) { (*unary_cost)[i] += row[i]; }
+  }
+  for (int32_t edge_id : node.out_edges) {
+    if (edge_id == skip_out_edge) { continue; }
+    const SbpEdge& edge = edges_[edge_id];
+    const int32_t consumer_choice = nodes_[edge.consumer].choice;
+    for (int32_t i = 0; i < unary_cost->size(); ++i) {
+      (*unary_cost)[i] += edge.cost[i][consumer_choice];
+    }
+  }
+}
+
+void SbpGraph::CollectChains(std::vector<std::vector<int32_t>>* chains) const {
+  // next[u] = v if the only edge out of u is the only edge into v
+  std::vector<int32_t> next(nodes_.size(), -1);
+  std::vector<bool> has_prev(nodes_.size(), false);
+  for (int32_t node_id = 0; node_id < nodes_.size(); ++node_id) {
+    if (nodes_[node_id].out_edges.size() != 1) { continue; }
+    const int32_t consumer = edges_[nodes_[node_id].out_edges.front()].consumer;
+    if (nodes_[consumer].in_edges.size() != 1) { continue; }
+    next[node_id] = consumer;
+    has_prev[consumer] = true;
+  }
+  // Since producer < consumer, every chain starts at the node with the smallest id and chains come
+  // out in topological order of their heads.
+  chains->clear();
+  for (int32_t node_id = 0; node_id < nodes_.size(); ++node_id) {
+    if (has_prev[node_id]) { continue; }
+    chains->emplace_back();
+    for (int32_t id = node_id; id != -1; id = next[id]) { chains->back().emplace_back(id); }
+  }
+}
+
+bool SbpGraph::SearchChain(const std::vector<int32_t>& chain) {
+  const int32_t length = chain.size();
+  // link_edges[k] connects chain[k] and chain[k + 1]
+  std::vector<int32_t> link_edges(length - 1);
+  for (int32_t k = 0; k + 1 < length; ++k) { link_edges[k] = nodes_[chain[k]].out_edges.front(); }
+  std::vector<std::vector<double>> unary_costs(length);
+  for (int32_t k = 0; k < length; ++k) {
+    ComputeUnaryCost(chain[k], k > 0 ? link_edges[k - 1] : -1,
+                     k + 1 < length ? link_edges[k] : -1, &unary_costs[k]);
+  }
+  // The cost of the current choices on the chain, with the rest of the graph fixed
+  double current_cost = unary_costs[0][nodes_[chain[0]].choice];
+  for (int32_t k = 1; k < length; ++k) {
+    current_cost += unary_costs[k][nodes_[chain[k]].choice] + EdgeCost(edges_[link_edges[k - 1]]);
+  }
+  // min_costs[k][j] is the minimum cost of chain[0..k] with chain[k] choosing j
+  std::vector<std::vector<double>> min_costs(length);
+  std::vector<std::vector<int32_t>> prev_choices(length);
+  min_costs[0] = unary_costs[0];
+  for (int32_t k = 1; k < length; ++k) {
+    const auto& link_cost = edges_[link_edges[k - 1]].cost;
+    const int32_t prev_num = min_costs[k - 1].size();
+    const int32_t curr_num = unary_costs[k].size();
+    min_costs[k].resize(curr_num);
+    prev_choices[k].resize(curr_num);
+    for (int32_t j = 0; j < curr_num; ++j) {
+      int32_t best_i = 0;
+      double best_cost = min_costs[k - 1][0] + link_cost[0][j];
+      for (int32_t i = 1; i < prev_num; ++i) {
+        const double cost = min_costs[k - 1][i] + link_cost[i][j];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_i = i;
+        }
+      }
+      min_costs[k][j] = best_cost + unary_costs[k][j];
+      prev_choices[k][j] = best_i;
+    }
+  }
+  const auto& last_costs = min_costs[length - 1];
+  int32_t best_j = std::min_element(last_costs.begin(), last_costs.end()) - last_costs.begin();
+  if (!IsImproved(last_costs[best_j], current_cost)) { return false; }
+  for (int32_t k = length - 1; k >= 0; --k) {
+    nodes_[chain[k]].choice = best_j;
+    if (k > 0) { best_j = prev_choices[k][best_j]; }
+  }
+  return true;
+}
+
+double SbpGraph::Search(int32_t max_sweeps) {
+  std::vector<std::vector<int32_t>> chains;
+  CollectChains(&chains);
+  for (int32_t sweep = 0; sweep < max_sweeps; ++sweep) {
+    bool improved = false;
+    // Alternate the direction so that choices propagate both downstream and upstream
+    if (sweep % 2 == 0) {
+      for (const auto& chain : chains) { improved |= SearchChain(chain); }
+    } else {
+      for (auto it = chains.rbegin(); it != chains.rend(); ++it) { improved |= SearchChain(*it); }
+    }
+    if (!improved) { break; }
+  }
+  return ComputeCost();
+}
+
+}  // namespace oneflow
@@ -0,0 +1,86 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_AUTO_PARALLEL_SBP_GRAPH_H_
+#define ONEFLOW_CORE_AUTO_PARALLEL_SBP_GRAPH_H_
+
+#include <vector>
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// A pairwise cost model over sbp choices. Every node picks one of its candidate sbp signatures.
+// The cost of a choice is the node cost (computation and memory) plus the transfer cost of each
+// edge, which depends on the choices of both ends.
+class SbpGraph final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(SbpGraph);
+  SbpGraph() = default;
+  ~SbpGraph() = default;
+
+  // Add a node with node_cost[i] for the i-th candidate and return its id. The first candidate is
+  // chosen by default.
+  int32_t AddNode(std::vector<double> node_cost);
+  // cost[i][j] is the cost of the producer choosing i and the consumer choosing j. Nodes must be
+  // added in topological order, so producer < consumer. Edges between the same pair of nodes are
+  // merged.
+  void AddEdge(int32_t producer, int32_t consumer, const std::vector<std::vector<double>>& cost);
+
+  int32_t NodeNum() const { return nodes_.size(); }
+  int32_t CandidateNum(int32_t node_id) const { return nodes_.at(node_id).cost.size(); }
+  int32_t Choice(int32_t node_id) const { return nodes_.at(node_id).choice; }
+  void SetChoice(int32_t node_id, int32_t choice);
+
+  // Total cost of the current choices
+  double ComputeCost() const;
+  // Transfer part of the total cost
+  double ComputeEdgeCost() const;
+
+  // Improve the current choices and return the final cost, which never exceeds the starting one.
+  // The graph is cut into chains, nodes linked by the only edge between them. Each chain is solved
+  // exactly by dynamic programming with the rest of the graph fixed, and the chains are swept
+  // back and forth until no chain improves or max_sweeps is reached.
+  double Search(int32_t max_sweeps);
+
+ private:
+  struct SbpNode {
+    std::vector<double> cost;
+    int32_t choice = 0;
+    std::vector<int32_t> in_edges;
+    std::vector<int32_t> out_edges;
+  };
+  struct SbpEdge {
+    int32_t producer;
+    int32_t consumer;
+    std::vector<std::vector<double>> cost;
+  };
+
+  double EdgeCost(const SbpEdge& edge) const {
+    return edge.cost[nodes_[edge.producer].choice][nodes_[edge.consumer].choice];
+  }
+  // The node cost of each candidate of node_id plus the cost of its edges, skipping the given ones
+  void ComputeUnaryCost(int32_t node_id, int32_t skip_in_edge, int32_t skip_out_edge,
+                        std::vector<double>* unary_cost) const;
+  void CollectChains(std::vector<std::vector<int32_t>>* chains) const;
+  // Return true if the choices on the chain are improved
+  bool SearchChain(const std::vector<int32_t>& chain);
+
+  std::vector<SbpNode> nodes_;
+  std::vector<SbpEdge> edges_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_AUTO_PARALLEL_SBP_GRAPH_H_
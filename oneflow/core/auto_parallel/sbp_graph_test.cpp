@@ -0,0 +1,114 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <random>
+#include "gtest/gtest.h"
+#include "oneflow/core/auto_parallel/sbp_graph.h"
+
+namespace oneflow {
+
+namespace {
+
+std::vector<double> RandomNodeCost(std::mt19937* gen, int32_t candidate_num) {
+  std::uniform_real_distribution<double> dis(0.0, 10.0);
+  std::vector<double> cost(candidate_num);
+  for (auto& c : cost) { c = dis(*gen); }
+  return cost;
+}
+
+std::vector<std::vector<double>> RandomEdgeCost(std::mt19937* gen, int32_t producer_num,
+                                                int32_t consumer_num) {
+  std::uniform_real_distribution<double> dis(0.0, 100.0);
+  std::vector<std::vector<double>> cost(producer_num, std::vector<double>(consumer_num));
+  for (auto& row : cost) {
+    for (auto& c : row) { c = dis(*gen); }
+  }
+  return cost;
+}
+
+// Enumerate all the choices and return the minimum cost
+double BruteForceMinCost(SbpGraph* graph) {
+  const int32_t node_num = graph->NodeNum();
+  for (int32_t i = 0; i < node_num; ++i) { graph->SetChoice(i, 0); }
+  double min_cost = graph->ComputeCost();
+  while (true) {
+    int32_t i = 0;
+    while (i < node_num && graph->Choice(i) + 1 == graph->CandidateNum(i)) {
+      graph->SetChoice(i, 0);
+      ++i;
+    }
+    if (i == node_num) { break; }
+    graph->SetChoice(i, graph->Choice(i) + 1);
+    min_cost = std::min(min_cost, graph->ComputeCost());
+  }
+  return min_cost;
+}
+
+}  // namespace
+
+TEST(SbpGraph, chain_is_optimal) {
+  std::mt19937 gen(0);
+  for (int32_t test = 0; test < 20; ++test) {
+    SbpGraph graph;
+    std::vector<int32_t> candidate_nums{3, 1, 4, 2, 3, 4};
+    for (int32_t num : candidate_nums) { graph.AddNode(RandomNodeCost(&gen, num)); }
+    for (int32_t i = 0; i + 1 < candidate_nums.size(); ++i) {
+      graph.AddEdge(i, i + 1, RandomEdgeCost(&gen, candidate_nums[i], candidate_nums[i + 1]));
+    }
+    const double searched_cost = graph.Search(/*max_sweeps=*/1);
+    ASSERT_NEAR(searched_cost, BruteForceMinCost(&graph), 1e-6);
+  }
+}
+
+TEST(SbpGraph, dag_never_gets_worse) {
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int32_t> candidate_dis(1, 3);
+  std::bernoulli_distribution edge_dis(0.3);
+  for (int32_t test = 0; test < 20; ++test) {
+    SbpGraph graph;
+    const int32_t node_num = 9;
+    for (int32_t i = 0; i < node_num; ++i) {
+      graph.AddNode(RandomNodeCost(&gen, candidate_dis(gen)));
+    }
+    for (int32_t consumer = 1; consumer < node_num; ++consumer) {
+      for (int32_t producer = 0; producer < consumer; ++producer) {
+        if (producer + 1 != consumer && !edge_dis(gen)) { continue; }
+        graph.AddEdge(producer, consumer,
+                      RandomEdgeCost(&gen, graph.CandidateNum(producer),
+                                     graph.CandidateNum(consumer)));
+      }
+    }
+    const double start_cost = graph.ComputeCost();
+    const double searched_cost = graph.Search(/*max_sweeps=*/16);
+    ASSERT_LE(searched_cost, start_cost);
+    ASSERT_DOUBLE_EQ(searched_cost, graph.ComputeCost());
+    ASSERT_GE(searched_cost, BruteForceMinCost(&graph) - 1e-6);
+  }
+}
+
+TEST(SbpGraph, merged_edges) {
+  SbpGraph graph;
+  graph.AddNode({0.0, 0.0});
+  graph.AddNode({0.0, 0.0});
+  graph.AddEdge(0, 1, {{0.0, 5.0}, {5.0, 1.0}});
+  graph.AddEdge(0, 1, {{4.0, 0.0}, {0.0, 1.0}});
+  // Summed edge cost is {{4, 5}, {5, 2}}
+  ASSERT_DOUBLE_EQ(graph.ComputeCost(), 4.0);
+  ASSERT_DOUBLE_EQ(graph.Search(/*max_sweeps=*/1), 2.0);
+  ASSERT_EQ(graph.Choice(0), 1);
+  ASSERT_EQ(graph.Choice(1), 1);
+}
+
+}  // namespace oneflow
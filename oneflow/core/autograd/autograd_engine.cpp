@@ -17,6 +17,8 @@ limitations under the License.
 #include <memory>
 #include <stack>
 #include <queue>
+#include <mutex>
+#include <condition_variable>
 #include "oneflow/core/autograd/autograd_engine.h"
 #include "oneflow/core/autograd/autograd_meta.h"
 #include "oneflow/core/framework/tensor.h"
@@ -28,6 +30,8 @@ limitations under the License.
 #include "oneflow/core/framework/nd_sbp.h"
 #include "oneflow/core/framework/global_param_grad_sync_mode.h"
 #include "oneflow/core/common/container_util.h"
+#include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/thread/thread_pool.h"
 
 namespace oneflow {
 namespace one {
@@ -106,6 +110,41 @@ Maybe<void> RawTorchGlobalTensor(const std::shared_ptr<one::Tensor>& tensor) {
 
 static constexpr auto* TorchGlobalTensor = DECORATE(&RawTorchGlobalTensor, CheckGlobalTensorMeta);
 
+Maybe<bool> RunFunctionNode(FunctionNode* node, bool save_grad_for_leaf, bool retain_graph,
+                            bool create_graph) {
+  if (/*bool not_ready_to_apply=*/!(JUST(node->Apply(create_graph)))) { return false; }
+  if (save_grad_for_leaf) { JUST(node->AccGrad4LeafTensor(create_graph)); }
+  JUST(node->AccGrad4RetainGradTensor());
+  node->ReleaseOutTensorArgs();
+  if (!retain_graph) { node->ReleaseData(); }
+  return true;
+}
+
+// Pops the node created last in the forward pass first. Parameters used late in the forward pass
+// fill the first DDP buckets, so their grads are produced before the others.
+struct SequenceNrLess {
+  bool operator()(const FunctionNode* lhs, const FunctionNode* rhs) const {
+    return lhs->sequence_nr() < rhs->sequence_nr();
+  }
+};
+
+using ReadyQueue =
+    std::priority_queue<FunctionNode*, std::vector<FunctionNode*>, SequenceNrLess>;
+
+// Set on the threads running a parallel backward graph, so that a backward called from a hook
+// or a custom function falls back to the calling thread instead of waiting for the busy workers.
+bool* MutThreadLocalInParallelBackward() {
+  thread_local static bool in_parallel_backward = false;
+  return &in_parallel_backward;
+}
+
+// Must be called with the parallel backward run mutex held
+ThreadPool* AutogradWorkerPool(int64_t worker_num) {
+  static std::unique_ptr<ThreadPool> pool;
+  if (!pool || pool->thread_num() != worker_num) { pool.reset(new ThreadPool(worker_num)); }
+  return pool.get();
+}
+
 Maybe<void> CheckGlobalTensorsMeta(const TensorTuple& tensor_tuple) {
   for (const auto& tensor : tensor_tuple) {
     if (tensor->is_global()) { JUST(TorchGlobalTensor(tensor)); }
@@ -165,6 +204,20 @@ Maybe<void> FunctionNode::AccGrad4LeafTensor(bool create_graph) {
   return Maybe<void>::Ok();
 }
 
+/*static*/ std::atomic<int64_t> FunctionNode::next_sequence_nr_(0);
+
+bool FunctionNode::has_leaf_output() const {
+  return std::any_of(output_meta_data_.begin(), output_meta_data_.end(),
+                     [](const std::shared_ptr<AutogradMeta>& meta_data) {
+                       return meta_data->is_leaf() && meta_data->requires_grad();
+                     });
+}
+
+bool FunctionNode::has_global_output() const {
+  return std::any_of(output_tensor_infos_.begin(), output_tensor_infos_.end(),
+                     [](const TensorInfo& info) { return info.placement().has_value(); });
+}
+
 void FunctionNode::ReleaseOutTensorArgs() {
   for (const std::shared_ptr<AutogradMeta>& meta_data : output_meta_data_) {
     meta_data->current_grad()->Release();
@@ -323,7 +376,25 @@ Maybe<void> GraphTask::ComputeDependenciesAndPruneNode(const TensorTuple& inputs
   return Maybe<void>::Ok();
 }
 
+Maybe<bool> GraphTask::ApplyNode(FunctionNode* node, bool save_grad_for_leaf) {
+  if (!need_execute_.empty() && need_execute_.find(node) == need_execute_.end()) {
+    node->ReleaseOutTensorArgs();
+    return false;
+  }
+  return RunFunctionNode(node, save_grad_for_leaf, retain_graph_, create_graph_);
+}
+
 Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
+  const int64_t thread_num = AutogradThreadNum();
+  if (thread_num > 1 && !*MutThreadLocalInParallelBackward()) {
+    bool has_global_node = std::any_of(
+        dependencies_.begin(), dependencies_.end(),
+        [](const std::pair<FunctionNode* const, int>& pair) {
+          return pair.first->has_global_output();
+        });
+    // Global backward ops launch collectives which must be issued in the same order on all ranks
+    if (!has_global_node) { return ParallelApply(save_grad_for_leaf, thread_num); }
+  }
   std::queue<FunctionNode*> queue;
   for (FunctionNode* node : roots_) {
     if (dependencies_[node] == 0) { queue.push(node); }
@@ -332,15 +403,7 @@ Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
   while (!queue.empty()) {
     FunctionNode* node = queue.front();
     queue.pop();
-    if (!need_execute_.empty() && need_execute_.find(node) == need_execute_.end()) {
-      node->ReleaseOutTensorArgs();
-      continue;
-    }
-    if (/*bool not_ready_to_apply=*/!(JUST(node->Apply(create_graph_)))) { continue; }
-    if (save_grad_for_leaf) { JUST(node->AccGrad4LeafTensor(create_graph_)); }
-    JUST(node->AccGrad4RetainGradTensor());
-    node->ReleaseOutTensorArgs();
-    if (!retain_graph_) { node->ReleaseData(); }
+    if (!JUST(ApplyNode(node, save_grad_for_leaf))) { continue; }
 
     for (const auto& next_grad_fn : node->next_functions()) {
       FunctionNode* next_node = next_grad_fn.get();
@@ -351,6 +414,174 @@ Maybe<void> GraphTask::Apply(bool save_grad_for_leaf) {
   return Maybe<void>::Ok();
 }
 
+// Runs independent FunctionNodes on the calling thread and `thread_num - 1` workers.
+// Ready nodes are popped in descending sequence number. The ops they launch are still ordered per
+// device stream by the virtual machine. The leaf grad accumulations, which run the
+// post-accumulation hooks that trigger gradient communication, only run on the calling thread so
+// they happen one at a time in priority order.
+Maybe<void> GraphTask::ParallelApply(bool save_grad_for_leaf, int64_t thread_num) {
+  // Serializes concurrent parallel backward runs, since each of them occupies all the workers
+  static std::mutex run_mutex;
+  std::unique_lock<std::mutex> run_lock(run_mutex);
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  ReadyQueue compute_queue;
+  ReadyQueue accumulate_queue;
+  int64_t pending_num = 0;
+  std::shared_ptr<ErrorProto> error;
+
+  const auto Push = [&](FunctionNode* node) {
+    ++pending_num;
+    if (node->has_leaf_output()) {
+      accumulate_queue.push(node);
+    } else {
+      compute_queue.push(node);
+    }
+  };
+  for (FunctionNode* node : roots_) {
+    if (dependencies_[node] == 0) { Push(node); }
+  }
+
+  const bool grad_mode = autograd::GradMode::is_enabled();
+  const auto Work = [&](bool is_calling_thread) {
+    autograd::AutoGradMode mode(grad_mode);
+    DisableCheckGlobalTensorMetaScope disable_meta_check;
+    bool* in_parallel_backward = MutThreadLocalInParallelBackward();
+    *in_parallel_backward = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cond.wait(lock, [&]() {
+        return error || pending_num == 0 || !compute_queue.empty()
+               || (is_calling_thread && !accumulate_queue.empty());
+      });
+      if (error || pending_num == 0) { break; }
+      ReadyQueue* queue = &compute_queue;
+      if (is_calling_thread && !accumulate_queue.empty()) { queue = &accumulate_queue; }
+      FunctionNode* node = queue->top();
+      queue->pop();
+      lock.unlock();
+      const auto& maybe_visit_next = ApplyNode(node, save_grad_for_leaf);
+      lock.lock();
+      if (!maybe_visit_next.IsOk()) {
+        if (!error) { error = maybe_visit_next.error(); }
+      } else if (maybe_visit_next.GetOrThrow()) {
+        for (const auto& next_grad_fn : node->next_functions()) {
+          FunctionNode* next_node = next_grad_fn.get();
+          if (--dependencies_[next_node] == 0) { Push(next_node); }
+        }
+      }
+      --pending_num;
+      cond.notify_all();
+    }
+    *in_parallel_backward = false;
+  };
+
+  const int64_t worker_num = thread_num - 1;
+  ThreadPool* pool = AutogradWorkerPool(worker_num);
+  BlockingCounter bc(worker_num);
+  for (int64_t i = 0; i < worker_num; ++i) {
+    pool->AddWork([&]() {
+      Work(/*is_calling_thread=*/false);
+      bc.Decrease();
+    });
+  }
+  Work(/*is_calling_thread=*/true);
+  bc.WaitForeverUntilCntEqualZero();
+  if (error) { return Maybe<void>(error); }
+  return Maybe<void>::Ok();
+}
+
+void GraphTopologyCache::NumberNodes(const TensorTuple& outputs) {
+  static std::atomic<int64_t> epoch_counter(0);
+  const int64_t epoch = epoch_counter.fetch_add(1, std::memory_order_relaxed);
+  const auto Visit = [&](FunctionNode* node) -> int32_t {
+    if (node->visit_epoch_ != epoch) {
+      node->visit_epoch_ = epoch;
+      node->visit_index_ = nodes_.size();
+      nodes_.emplace_back(node);
+    }
+    return node->visit_index_;
+  };
+  nodes_.clear();
+  current_.next_offsets.clear();
+  current_.next_indices.clear();
+  for (const auto& out_tensor : outputs) { Visit(out_tensor->mut_grad_fn_node().get()); }
+  current_.next_offsets.emplace_back(0);
+  size_t fingerprint = nodes_.size();
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    FunctionNode* node = nodes_[i];
+    for (const auto& next_grad_fn : node->next_functions()) {
+      const int32_t next_index = Visit(next_grad_fn.get());
+      current_.next_indices.emplace_back(next_index);
+      HashCombine(&fingerprint, next_index);
+    }
+    current_.next_offsets.emplace_back(current_.next_indices.size());
+    HashCombine(&fingerprint, current_.next_indices.size());
+  }
+  current_.fingerprint = fingerprint;
+}
+
+const GraphTopology& GraphTopologyCache::LookupOrInsert() {
+  for (const GraphTopology& topology : cached_) {
+    if (topology.fingerprint == current_.fingerprint
+        && topology.next_offsets == current_.next_offsets
+        && topology.next_indices == current_.next_indices) {
+      return topology;
+    }
+  }
+  current_.dependencies.assign(nodes_.size(), 0);
+  for (int32_t next_index : current_.next_indices) { current_.dependencies[next_index] += 1; }
+  // Same order as the queue of GraphTask::Apply when every node is ready to run
+  remaining_dependencies_.assign(current_.dependencies.begin(), current_.dependencies.end());
+  current_.order.clear();
+  for (int32_t i = 0; i < nodes_.size(); ++i) {
+    if (remaining_dependencies_[i] == 0) { current_.order.emplace_back(i); }
+  }
+  for (size_t head = 0; head < current_.order.size(); ++head) {
+    const int32_t i = current_.order[head];
+    for (int32_t j = current_.next_offsets[i]; j < current_.next_offsets[i + 1]; ++j) {
+      const int32_t next_index = current_.next_indices[j];
+      if (--remaining_dependencies_[next_index] == 0) { current_.order.emplace_back(next_index); }
+    }
+  }
+  static constexpr size_t kMaxCachedGraphTopologies = 8;
+  if (cached_.size() < kMaxCachedGraphTopologies) {
+    cached_.emplace_back(current_);
+    return cached_.back();
+  }
+  GraphTopology& victim = cached_[next_victim_];
+  next_victim_ = (next_victim_ + 1) % kMaxCachedGraphTopologies;
+  victim = current_;
+  return victim;
+}
+
+Maybe<void> GraphTopologyCache::Apply(const TensorTuple& outputs, bool retain_graph,
+                                      bool create_graph) {
+  CHECK_OR_RETURN(!busy_) << "GraphTopologyCache is already running a backward graph";
+  busy_ = true;
+  const auto& maybe_ok = [&]() -> Maybe<void> {
+    NumberNodes(outputs);
+    const GraphTopology& topology = LookupOrInsert();
+    remaining_dependencies_.assign(topology.dependencies.begin(), topology.dependencies.end());
+    for (int32_t i : topology.order) {
+      // Skips the nodes behind a node which was not ready to run
+      if (remaining_dependencies_[i] != 0) { continue; }
+      if (!JUST(RunFunctionNode(nodes_[i], /*save_grad_for_leaf=*/true, retain_graph,
+                                create_graph))) {
+        continue;
+      }
+      for (int32_t j = topology.next_offsets[i]; j < topology.next_offsets[i + 1]; ++j) {
+        remaining_dependencies_[topology.next_indices[j]] -= 1;
+      }
+    }
+    return Maybe<void>::Ok();
+  }();
+  nodes_.clear();
+  busy_ = false;
+  return maybe_ok;
+}
+
 Maybe<void> GraphAutogradEngine::RunBackwardAndSaveGrads4LeafTensor(const TensorTuple& outputs,
                                                                     const TensorTuple& out_grads,
                                                                     bool retain_graph,
@@ -358,6 +589,10 @@ Maybe<void> GraphAutogradEngine::RunBackwardAndSaveGrads4LeafTensor(const Tensor
   for (int i = 0; i < outputs.size(); ++i) {
     JUST(JUST(outputs.at(i)->current_grad())->PushPartialTensor(out_grads.at(i)));
   }
+  if (AutogradGraphTopologyCacheEnabled() && AutogradThreadNum() == 1
+      && !topology_cache_.busy()) {
+    return topology_cache_.Apply(outputs, retain_graph, create_graph);
+  }
   GraphTask graph_task(outputs, retain_graph, create_graph);
   JUST(graph_task.ComputeDependencies());
   JUST(graph_task.Apply(/*save_grad_for_leaf=*/true));
@@ -410,6 +645,14 @@ Maybe<FunctionNode> GraphAutogradEngine::AddNode(
   return func_node;
 }
 
+bool AutogradGraphTopologyCacheEnabled() {
+  return ParseBooleanFromEnv("ONEFLOW_AUTOGRAD_CACHE_GRAPH_TOPOLOGY", false);
+}
+
+int64_t AutogradThreadNum() {
+  return std::max<int64_t>(ParseIntegerFromEnv("ONEFLOW_AUTOGRAD_NUM_THREADS", 1), 1);
+}
+
 AutogradEngine* GetThreadLocalAutogradEngine() {
   thread_local static GraphAutogradEngine autograd_engine;
   return &autograd_engine;
@@ -20,6 +20,7 @@ limitations under the License.
 #include <list>
 #include <vector>
 #include <memory>
+#include <atomic>
 #include <functional>
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/autograd/autograd_meta.h"
@@ -55,13 +56,20 @@ class FunctionNode {
     return next_functions_;
   }
   const std::string& name() const { return name_; }
+  // Nodes created later in the forward pass have larger sequence numbers
+  int64_t sequence_nr() const { return sequence_nr_; }
+  bool has_leaf_output() const;
+  bool has_global_output() const;
 
  protected:
   explicit FunctionNode(const std::string& name,
                         const std::shared_ptr<BackwardFunction>& backward_fn)
-      : name_(name), backward_fn_(backward_fn) {}
+      : name_(name),
+        sequence_nr_(next_sequence_nr_.fetch_add(1, std::memory_order_relaxed)),
+        backward_fn_(backward_fn) {}
 
   const std::string name_;
+  const int64_t sequence_nr_;
   std::vector<std::shared_ptr<FunctionNode>> next_functions_;
 
   std::vector<std::shared_ptr<AutogradMeta>> input_meta_data_;
@@ -70,6 +78,14 @@ class FunctionNode {
 
   // Actual backward function builds in `AutogradInterpreter` to calculate one backward op
   std::shared_ptr<BackwardFunction> backward_fn_;
+
+ private:
+  friend class GraphTopologyCache;
+  static std::atomic<int64_t> next_sequence_nr_;
+
+  // Scratch slots used by GraphTopologyCache to number the nodes of a graph without hashing
+  int64_t visit_epoch_ = -1;
+  int32_t visit_index_ = -1;
 };
 
 class AutogradEngine {
@@ -132,6 +148,10 @@ class GraphTask final {
   Maybe<void> Apply(bool save_grad_for_leaf);
 
  private:
+  // Runs one FunctionNode and returns whether its next functions should be visited
+  Maybe<bool> ApplyNode(FunctionNode* node, bool save_grad_for_leaf);
+  Maybe<void> ParallelApply(bool save_grad_for_leaf, int64_t thread_num);
+
   bool retain_graph_;
   bool create_graph_;
   std::vector<FunctionNode*> roots_;
@@ -139,6 +159,41 @@ class GraphTask final {
   HashSet<FunctionNode*> need_execute_;
 };
 
+// Structure of a backward graph. Nodes are numbered in BFS order from the roots and their next
+// functions are stored in CSR form, so the structure doesn't depend on FunctionNode addresses.
+struct GraphTopology {
+  size_t fingerprint = 0;
+  std::vector<int32_t> next_offsets;
+  std::vector<int32_t> next_indices;
+  std::vector<int32_t> dependencies;
+  // Execution order of the nodes if all of them are ready to run
+  std::vector<int32_t> order;
+};
+
+// Caches the dependency counts and execution order of the recent backward graphs. Training loops
+// build a graph with the same topology every step, so after the first step a backward only
+// numbers its nodes and compares the structure with the cached one.
+class GraphTopologyCache final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(GraphTopologyCache);
+  GraphTopologyCache() : busy_(false), next_victim_(0) {}
+  ~GraphTopologyCache() = default;
+
+  bool busy() const { return busy_; }
+  Maybe<void> Apply(const TensorTuple& outputs, bool retain_graph, bool create_graph);
+
+ private:
+  void NumberNodes(const TensorTuple& outputs);
+  const GraphTopology& LookupOrInsert();
+
+  bool busy_;
+  std::vector<FunctionNode*> nodes_;
+  GraphTopology current_;
+  std::vector<int32_t> remaining_dependencies_;
+  std::vector<GraphTopology> cached_;
+  size_t next_victim_;
+};
+
 class GraphAutogradEngine final : public AutogradEngine {
  public:
   OF_DISALLOW_COPY_AND_MOVE(GraphAutogradEngine);
@@ -159,10 +214,20 @@ class GraphAutogradEngine final : public AutogradEngine {
                                                           const TensorTuple& out_grads,
                                                           bool retain_graph,
                                                           bool create_graph) override;
+
+  GraphTopologyCache topology_cache_;
 };
 
 AutogradEngine* GetThreadLocalAutogradEngine();
 
+// Whether to reuse the topology of previous backward graphs, read from
+// `ONEFLOW_AUTOGRAD_CACHE_GRAPH_TOPOLOGY` at every backward
+bool AutogradGraphTopologyCacheEnabled();
+
+// Number of threads used to run local backward graphs, read from `ONEFLOW_AUTOGRAD_NUM_THREADS`
+// at every backward. The default 1 runs the graph on the calling thread.
+int64_t AutogradThreadNum();
+
 Maybe<void> AddAccumulateFunctionNode(const std::shared_ptr<Tensor>& tensor);
 
 }  // namespace one
@@ -0,0 +1,155 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/autograd/ddp_reducer.h"
+#include "oneflow/core/autograd/autograd_engine.h"
+#include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/functional/functional.h"
+#include "oneflow/core/job/rank_group_scope.h"
+
+namespace oneflow {
+
+namespace one {
+
+namespace {
+
+// Gradients in a bucket start at addresses aligned for device kernels
+constexpr int64_t kGradAlignBytes = 512;
+
+}  // namespace
+
+/* static */ Maybe<DDPReducer> DDPReducer::New(const std::vector<std::shared_ptr<Tensor>>& params,
+                                               int64_t bucket_bytes) {
+  std::shared_ptr<DDPReducer> reducer(new DDPReducer());
+  JUST(reducer->Init(params, bucket_bytes));
+  return reducer;
+}
+
+Maybe<void> DDPReducer::Init(const std::vector<std::shared_ptr<Tensor>>& params,
+                             int64_t bucket_bytes) {
+  CHECK_GT_OR_RETURN(bucket_bytes, 0) << "bucket size must be positive";
+  grad_scale_ = 1.0 / JUST(RankGroupScope::CurrentRankGroup())->size();
+
+  // step 1. group consecutive parameters of the same dtype and device into buckets
+  std::vector<int64_t> offset4param(params.size());
+  std::vector<int64_t> bucket_elem_cnts;
+  Symbol<DType> bucket_dtype;
+  Symbol<Device> bucket_device;
+  int64_t bucket_elem_cnt = 0;
+  for (int64_t i = 0; i < params.size(); ++i) {
+    const auto& param = params.at(i);
+    CHECK_OR_RETURN(param->is_local()) << "DDP only supports local parameters";
+    CHECK_OR_RETURN(param->is_leaf() && param->requires_grad())
+        << "DDP parameters must be leaf tensors which require grad";
+    const Symbol<DType> dtype = param->dtype();
+    const Symbol<Device> device = JUST(param->device());
+    const int64_t elem_size = GetSizeOfDataType(dtype->data_type());
+    const int64_t align = std::max<int64_t>(kGradAlignBytes / elem_size, 1);
+    const int64_t elem_cnt = RoundUp(param->shape()->elem_cnt(), align);
+    if (bucket_elem_cnts.empty() || dtype != bucket_dtype || device != bucket_device
+        || (bucket_elem_cnt > 0 && (bucket_elem_cnt + elem_cnt) * elem_size > bucket_bytes)) {
+      if (!bucket_elem_cnts.empty()) { bucket_elem_cnts.back() = bucket_elem_cnt; }
+      bucket_elem_cnts.emplace_back(0);
+      buckets_.emplace_back(Bucket{nullptr, 0, 0});
+      bucket_dtype = dtype;
+      bucket_device = device;
+      bucket_elem_cnt = 0;
+    }
+    offset4param.at(i) = bucket_elem_cnt;
+    bucket_elem_cnt += elem_cnt;
+    bucket_index4param_.emplace_back(buckets_.size() - 1);
+    buckets_.back().param_num += 1;
+  }
+  if (!bucket_elem_cnts.empty()) { bucket_elem_cnts.back() = bucket_elem_cnt; }
+
+  // step 2. allocate the flat buckets and make a gradient view for each parameter
+  for (int64_t i = 0; i < params.size(); ++i) {
+    const auto& param = params.at(i);
+    const int64_t bucket_index = bucket_index4param_.at(i);
+    Bucket* bucket = &buckets_.at(bucket_index);
+    if (!bucket->flat_grad) {
+      bucket->flat_grad = JUST(functional::Constant(Shape({bucket_elem_cnts.at(bucket_index)}),
+                                                    Scalar(0), param->dtype(),
+                                                    JUST(param->device())));
+    }
+    const int64_t begin = offset4param.at(i);
+    const auto& flat_view = JUST(functional::SliceView1dContiguous(
+        bucket->flat_grad, begin, begin + param->shape()->elem_cnt()));
+    grad_views_.emplace_back(JUST(functional::View(flat_view, *param->shape())));
+  }
+  param_ready_.resize(params.size());
+  PrepareForBackward();
+
+  // step 3. let the parameters report their accumulated gradients, the hooks do not keep the
+  // reducer alive
+  std::weak_ptr<DDPReducer> weak_reducer = shared_from_this();
+  for (int64_t i = 0; i < params.size(); ++i) {
+    const auto& param = params.at(i);
+    if (!param->grad_fn_node()) { JUST(AddAccumulateFunctionNode(param)); }
+    // Once the gradient is the bucket view, later passes must accumulate into it instead of
+    // replacing it with a new tensor
+    param->mut_autograd_meta()->set_is_grad_acc_inplace(true);
+    param->mut_autograd_meta()->add_post_grad_accumulation_hook(
+        [weak_reducer, i](const std::shared_ptr<const Tensor>& grad) -> std::shared_ptr<Tensor> {
+          const auto reducer = weak_reducer.lock();
+          if (!reducer) { return nullptr; }
+          std::shared_ptr<Tensor> new_grad;
+          CHECK_JUST(reducer->OnGradAccumulated(i, grad, &new_grad));
+          return new_grad;
+        });
+  }
+  return Maybe<void>::Ok();
+}
+
+void DDPReducer::PrepareForBackward() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ResetReadiness();
+}
+
+void DDPReducer::ResetReadiness() {
+  for (auto& bucket : buckets_) { bucket.pending_param_num = bucket.param_num; }
+  std::fill(param_ready_.begin(), param_ready_.end(), false);
+  next_bucket_ = 0;
+}
+
+Maybe<void> DDPReducer::OnGradAccumulated(int64_t param_index,
+                                          const std::shared_ptr<const Tensor>& grad,
+                                          std::shared_ptr<Tensor>* new_grad) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto& grad_view = grad_views_.at(param_index);
+  if (grad.get() != grad_view.get()) {
+    // The first backward pass, or the gradient was set to None since. Later passes accumulate
+    // in place into the view.
+    JUST(functional::Fill(grad_view, Scalar(0)));
+    JUST(functional::Add(grad_view, std::const_pointer_cast<Tensor>(grad), /*alpha=*/1,
+                         /*inplace=*/true));
+    *new_grad = grad_view;
+  }
+  if (param_ready_.at(param_index)) { return Maybe<void>::Ok(); }
+  param_ready_.at(param_index) = true;
+  buckets_.at(bucket_index4param_.at(param_index)).pending_param_num -= 1;
+  while (next_bucket_ < buckets_.size() && buckets_.at(next_bucket_).pending_param_num == 0) {
+    const auto& flat_grad = buckets_.at(next_bucket_).flat_grad;
+    JUST(functional::Mul(flat_grad, Scalar(grad_scale_), /*inplace=*/true));
+    JUST(functional::LocalAllReduce(flat_grad, /*inplace=*/true));
+    next_bucket_ += 1;
+  }
+  if (next_bucket_ == buckets_.size()) { ResetReadiness(); }
+  return Maybe<void>::Ok();
+}
+
+}  // namespace one
+
+}  // namespace oneflow
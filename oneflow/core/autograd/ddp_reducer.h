@@ -0,0 +1,79 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_AUTOGRAD_DDP_REDUCER_H_
+#define ONEFLOW_CORE_AUTOGRAD_DDP_REDUCER_H_
+
+#include <mutex>
+#include <vector>
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/common/maybe.h"
+
+namespace oneflow {
+
+namespace one {
+
+class Tensor;
+
+// Averages the gradients of data parallel parameters over all ranks. The gradients accumulate
+// into flat buckets of at most bucket_bytes, each holding parameters of one dtype and device.
+// A bucket is allreduced asynchronously as soon as all its gradients are accumulated, and the
+// buckets are launched in the same order on all ranks.
+class DDPReducer final : public std::enable_shared_from_this<DDPReducer> {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(DDPReducer);
+  ~DDPReducer() = default;
+
+  // The parameters are in the order their gradients are expected, usually the reverse order of
+  // the forward pass.
+  static Maybe<DDPReducer> New(const std::vector<std::shared_ptr<Tensor>>& params,
+                               int64_t bucket_bytes);
+
+  // Forgets the gradients accumulated by an unfinished backward pass
+  void PrepareForBackward();
+
+  int64_t bucket_num() const { return buckets_.size(); }
+  const std::vector<int64_t>& bucket_index4param() const { return bucket_index4param_; }
+
+ private:
+  struct Bucket {
+    std::shared_ptr<Tensor> flat_grad;
+    int64_t param_num;
+    int64_t pending_param_num;
+  };
+
+  DDPReducer() : next_bucket_(0) {}
+
+  Maybe<void> Init(const std::vector<std::shared_ptr<Tensor>>& params, int64_t bucket_bytes);
+  // Called after the gradient of the param_index-th parameter is accumulated, sets new_grad to
+  // the gradient view in the bucket if the accumulated gradient is somewhere else.
+  Maybe<void> OnGradAccumulated(int64_t param_index, const std::shared_ptr<const Tensor>& grad,
+                                std::shared_ptr<Tensor>* new_grad);
+  void ResetReadiness();
+
+  std::mutex mutex_;
+  std::vector<Bucket> buckets_;
+  std::vector<int64_t> bucket_index4param_;
+  std::vector<std::shared_ptr<Tensor>> grad_views_;
+  std::vector<bool> param_ready_;
+  int64_t next_bucket_;
+  double grad_scale_;
+};
+
+}  // namespace one
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_AUTOGRAD_DDP_REDUCER_H_
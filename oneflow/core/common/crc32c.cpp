@@ -0,0 +1,104 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/common/crc32c.h"
+#include <array>
+#include <cstring>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define OF_CRC32C_WITH_SSE42
+#endif
+
+namespace oneflow {
+
+namespace {
+
+constexpr uint32_t kCrc32cPoly = 0x82f63b78;
+
+// tables[k][b] is the crc of byte b followed by k zero bytes, for slicing by 8 bytes
+using Crc32cTables = std::array<std::array<uint32_t, 256>, 8>;
+
+Crc32cTables MakeCrc32cTables() {
+  Crc32cTables tables;
+  for (uint32_t b = 0; b < 256; ++b) {
+    uint32_t crc = b;
+    for (int i = 0; i < 8; ++i) { crc = (crc >> 1) ^ ((crc & 1) ? kCrc32cPoly : 0); }
+    tables[0][b] = crc;
+  }
+  for (uint32_t b = 0; b < 256; ++b) {
+    for (int k = 1; k < 8; ++k) {
+      tables[k][b] = (tables[k - 1][b] >> 8) ^ tables[0][tables[k - 1][b] & 0xff];
+    }
+  }
+  return tables;
+}
+
+uint32_t Crc32cSoftware(uint32_t crc, const uint8_t* p, size_t size) {
+  static const Crc32cTables tables = MakeCrc32cTables();
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, 8);
+    word ^= crc;
+    crc = tables[7][word & 0xff] ^ tables[6][(word >> 8) & 0xff] ^ tables[5][(word >> 16) & 0xff]
+          ^ tables[4][(word >> 24) & 0xff] ^ tables[3][(word >> 32) & 0xff]
+          ^ tables[2][(word >> 40) & 0xff] ^ tables[1][(word >> 48) & 0xff]
+          ^ tables[0][word >> 56];
+    p += 8;
+    size -= 8;
+  }
+  while (size > 0) {
+    crc = (crc >> 8) ^ tables[0][(crc ^ *p) & 0xff];
+    ++p;
+    --size;
+  }
+  return crc;
+}
+
+#ifdef OF_CRC32C_WITH_SSE42
+
+__attribute__((target("sse4.2"))) uint32_t Crc32cSse42(uint32_t crc, const uint8_t* p,
+                                                        size_t size) {
+  uint64_t crc64 = crc;
+  while (size >= 8) {
+    uint64_t word;
+    std::memcpy(&word, p, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+    p += 8;
+    size -= 8;
+  }
+  crc = static_cast<uint32_t>(crc64);
+  while (size > 0) {
+    crc = _mm_crc32_u8(crc, *p);
+    ++p;
+    --size;
+  }
+  return crc;
+}
+
+#endif  // OF_CRC32C_WITH_SSE42
+
+}  // namespace
+
+uint32_t Crc32cExtend(uint32_t crc, const char* buf, size_t size) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(buf);
+  crc = ~crc;
+#ifdef OF_CRC32C_WITH_SSE42
+  static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+  if (has_sse42) { return ~Crc32cSse42(crc, p, size); }
+#endif  // OF_CRC32C_WITH_SSE42
+  return ~Crc32cSoftware(crc, p, size);
+}
+
+}  // namespace oneflow
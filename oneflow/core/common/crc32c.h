@@ -0,0 +1,32 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_COMMON_CRC32C_H_
+#define ONEFLOW_CORE_COMMON_CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace oneflow {
+
+// CRC32C (Castagnoli), computed with the sse4.2 crc32 instruction when the cpu supports it.
+// Extends `crc`, the crc of some preceding data, with `size` bytes of `buf`.
+uint32_t Crc32cExtend(uint32_t crc, const char* buf, size_t size);
+
+inline uint32_t Crc32c(const char* buf, size_t size) { return Crc32cExtend(0, buf, size); }
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_COMMON_CRC32C_H_
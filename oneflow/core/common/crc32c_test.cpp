@@ -0,0 +1,41 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <string>
+#include "oneflow/core/common/crc32c.h"
+
+namespace oneflow {
+namespace test {
+
+TEST(Crc32c, known_values) {
+  EXPECT_EQ(Crc32c("", 0), 0);
+  EXPECT_EQ(Crc32c("123456789", 9), 0xe3069283);
+  const std::string zeros(32, '\0');
+  EXPECT_EQ(Crc32c(zeros.data(), zeros.size()), 0x8a9136aa);
+}
+
+TEST(Crc32c, extend) {
+  std::string data;
+  for (int i = 0; i < 1027; ++i) { data.push_back(static_cast<char>(i * 7 + 3)); }
+  const uint32_t crc = Crc32c(data.data(), data.size());
+  for (size_t split : {0, 1, 8, 13, 1026, 1027}) {
+    EXPECT_EQ(Crc32cExtend(Crc32c(data.data(), split), data.data() + split, data.size() - split),
+              crc);
+  }
+}
+
+}  // namespace test
+}  // namespace oneflow
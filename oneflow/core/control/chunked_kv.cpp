@@ -0,0 +1,193 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/control/chunked_kv.h"
+#include <lz4.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/control/global_process_ctx.h"
+
+namespace oneflow {
+
+namespace {
+
+struct ChunkHeader {
+  int64_t raw_size;
+  int32_t is_compressed;
+  int32_t is_last;
+};
+
+size_t CtrlKVChunkSize() {
+  static const size_t chunk_size = ParseIntegerFromEnv("ONEFLOW_CTRL_KV_CHUNK_SIZE_MB", 8) << 20;
+  return chunk_size;
+}
+
+int64_t CtrlKVChunkWindow() {
+  static const int64_t window = ParseIntegerFromEnv("ONEFLOW_CTRL_KV_CHUNK_WINDOW", 4);
+  CHECK_GT(window, 0);
+  return window;
+}
+
+void EncodeChunk(const std::string& raw, bool is_last, std::string* chunk) {
+  CHECK_LE(raw.size(), LZ4_MAX_INPUT_SIZE);
+  ChunkHeader header{};
+  header.raw_size = raw.size();
+  header.is_last = is_last;
+  const int bound = LZ4_compressBound(raw.size());
+  chunk->resize(sizeof(ChunkHeader) + bound);
+  const int compressed_size =
+      raw.empty() ? 0
+                  : LZ4_compress_default(raw.data(), &chunk->at(sizeof(ChunkHeader)),
+                                         raw.size(), bound);
+  if (compressed_size > 0 && compressed_size < raw.size()) {
+    header.is_compressed = 1;
+    chunk->resize(sizeof(ChunkHeader) + compressed_size);
+  } else {
+    header.is_compressed = 0;
+    chunk->resize(sizeof(ChunkHeader));
+    chunk->append(raw);
+  }
+  std::memcpy(&chunk->at(0), &header, sizeof(ChunkHeader));
+}
+
+void DecodeChunk(const std::string& chunk, std::string* raw, bool* is_last) {
+  CHECK_GE(chunk.size(), sizeof(ChunkHeader));
+  ChunkHeader header{};
+  std::memcpy(&header, chunk.data(), sizeof(ChunkHeader));
+  const char* payload = chunk.data() + sizeof(ChunkHeader);
+  const size_t payload_size = chunk.size() - sizeof(ChunkHeader);
+  if (header.is_compressed) {
+    raw->resize(header.raw_size);
+    const int raw_size =
+        LZ4_decompress_safe(payload, &raw->at(0), payload_size, header.raw_size);
+    CHECK_EQ(raw_size, header.raw_size) << "corrupted lz4 chunk";
+  } else {
+    CHECK_EQ(payload_size, header.raw_size);
+    raw->assign(payload, payload_size);
+  }
+  *is_last = header.is_last;
+}
+
+class ChunkOutputStream final : public google::protobuf::io::CopyingOutputStream {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ChunkOutputStream);
+  ChunkOutputStream(size_t chunk_size, const std::function<void(std::string*)>& Handler)
+      : chunk_size_(chunk_size), Handler_(Handler) {
+    raw_.reserve(chunk_size_);
+  }
+  ~ChunkOutputStream() override = default;
+
+  bool Write(const void* buffer, int size) override {
+    const char* data = static_cast<const char*>(buffer);
+    while (size > 0) {
+      const size_t n = std::min<size_t>(size, chunk_size_ - raw_.size());
+      raw_.append(data, n);
+      data += n;
+      size -= n;
+      if (raw_.size() == chunk_size_) { Flush(false); }
+    }
+    return true;
+  }
+
+  void Close() { Flush(true); }
+
+ private:
+  void Flush(bool is_last) {
+    std::string chunk;
+    EncodeChunk(raw_, is_last, &chunk);
+    raw_.clear();
+    Handler_(&chunk);
+  }
+
+  size_t chunk_size_;
+  std::function<void(std::string*)> Handler_;
+  std::string raw_;
+};
+
+class ChunkInputStream final : public google::protobuf::io::CopyingInputStream {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ChunkInputStream);
+  explicit ChunkInputStream(const std::function<void(std::string*)>& NextChunk)
+      : NextChunk_(NextChunk), offset_(0), is_last_(false) {}
+  ~ChunkInputStream() override = default;
+
+  int Read(void* buffer, int size) override {
+    while (offset_ == raw_.size()) {
+      if (is_last_) { return 0; }
+      std::string chunk;
+      NextChunk_(&chunk);
+      DecodeChunk(chunk, &raw_, &is_last_);
+      offset_ = 0;
+    }
+    const size_t n = std::min<size_t>(size, raw_.size() - offset_);
+    std::memcpy(buffer, raw_.data() + offset_, n);
+    offset_ += n;
+    return n;
+  }
+
+  bool is_last() const { return is_last_; }
+
+ private:
+  std::function<void(std::string*)> NextChunk_;
+  std::string raw_;
+  size_t offset_;
+  bool is_last_;
+};
+
+}  // namespace
+
+void SerializeToChunks(const PbMessage& msg, size_t chunk_size,
+                       const std::function<void(std::string* chunk)>& Handler) {
+  CHECK_GT(chunk_size, 0);
+  ChunkOutputStream chunk_stream(chunk_size, Handler);
+  {
+    google::protobuf::io::CopyingOutputStreamAdaptor output(&chunk_stream);
+    CHECK(msg.SerializeToZeroCopyStream(&output));
+    CHECK(output.Flush());
+  }
+  chunk_stream.Close();
+}
+
+bool ParseFromChunks(const std::function<void(std::string* chunk)>& NextChunk, PbMessage* msg) {
+  ChunkInputStream chunk_stream(NextChunk);
+  google::protobuf::io::CopyingInputStreamAdaptor input(&chunk_stream);
+  // NOTE: the parser reads until the stream ends, which is after the last chunk.
+  return msg->ParseFromZeroCopyStream(&input) && chunk_stream.is_last();
+}
+
+void BroadcastChunkedKV(const std::string& k, PbMessage* msg) {
+  if (GlobalProcessCtx::WorldSize() == 1) { return; }
+  CtrlClient* ctrl_client = Singleton<CtrlClient>::Get();
+  const int64_t window = CtrlKVChunkWindow();
+  int64_t chunk_id = 0;
+  auto BroadcastChunk = [&](std::string* chunk) {
+    const std::string chunk_key = k + "/" + std::to_string(chunk_id);
+    ctrl_client->BroadcastKV(chunk_key, chunk);
+    chunk_id += 1;
+    // NOTE: a parent pushes each chunk into the ctrl servers of its children without waiting for
+    //   them to pull it, so the ranks acknowledge every window chunks. This keeps at most window
+    //   chunks queued on a rank. Both sides run this after the same chunks, including the last.
+    if (chunk_id % window == 0) {
+      ctrl_client->Barrier(chunk_key + "/ack", GlobalProcessCtx::WorldSize());
+    }
+  };
+  if (GlobalProcessCtx::IsThisProcessMaster()) {
+    SerializeToChunks(*msg, CtrlKVChunkSize(), BroadcastChunk);
+  } else {
+    CHECK(ParseFromChunks(BroadcastChunk, msg)) << "failed to parse " << k;
+  }
+}
+
+}  // namespace oneflow
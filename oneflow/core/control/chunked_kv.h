@@ -0,0 +1,40 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_CONTROL_CHUNKED_KV_H_
+#define ONEFLOW_CORE_CONTROL_CHUNKED_KV_H_
+
+#include "oneflow/core/common/protobuf.h"
+
+namespace oneflow {
+
+// Serializes msg as a sequence of chunks of at most chunk_size bytes before compression. Each
+// chunk is lz4 compressed when that makes it smaller and passed to Handler in order, so the whole
+// serialized message is never held in memory.
+void SerializeToChunks(const PbMessage& msg, size_t chunk_size,
+                       const std::function<void(std::string* chunk)>& Handler);
+
+// Parses msg from the chunks produced by SerializeToChunks. NextChunk is called once per chunk,
+// in order, until the last one.
+bool ParseFromChunks(const std::function<void(std::string* chunk)>& NextChunk, PbMessage* msg);
+
+// Broadcasts the master's msg to all ranks like CtrlClient::BroadcastKV, but as a stream of
+// compressed chunks named "<k>/<i>". Chunk size is set by ONEFLOW_CTRL_KV_CHUNK_SIZE_MB. All ranks
+// acknowledge every ONEFLOW_CTRL_KV_CHUNK_WINDOW chunks, which bounds the chunks queued on a rank.
+void BroadcastChunkedKV(const std::string& k, PbMessage* msg);
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_CONTROL_CHUNKED_KV_H_
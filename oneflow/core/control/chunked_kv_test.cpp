@@ -0,0 +1,56 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "gtest/gtest.h"
+#include "oneflow/core/control/chunked_kv.h"
+#include "oneflow/core/common/shape.pb.h"
+
+namespace oneflow {
+
+namespace {
+
+void TestRoundTrip(const ShapeProto& shape, size_t chunk_size) {
+  std::vector<std::string> chunks;
+  SerializeToChunks(shape, chunk_size, [&](std::string* chunk) { chunks.emplace_back(*chunk); });
+  ASSERT_GE(chunks.size(), 1);
+  size_t chunk_id = 0;
+  ShapeProto parsed;
+  auto NextChunk = [&](std::string* chunk) { *chunk = chunks.at(chunk_id++); };
+  ASSERT_TRUE(ParseFromChunks(NextChunk, &parsed));
+  ASSERT_EQ(chunk_id, chunks.size());
+  ASSERT_EQ(parsed.SerializeAsString(), shape.SerializeAsString());
+}
+
+}  // namespace
+
+TEST(ChunkedKV, round_trip) {
+  ShapeProto shape;
+  FOR_RANGE(int64_t, i, 0, 100000) { shape.add_dim(i % 128); }
+  TestRoundTrip(shape, 1);
+  TestRoundTrip(shape, 4096);
+  TestRoundTrip(shape, 1 << 30);
+}
+
+TEST(ChunkedKV, empty_message) { TestRoundTrip(ShapeProto(), 4096); }
+
+TEST(ChunkedKV, repeated_content_is_compressed) {
+  ShapeProto shape;
+  FOR_RANGE(int64_t, i, 0, 100000) { shape.add_dim(i % 128); }
+  size_t total_size = 0;
+  SerializeToChunks(shape, 1 << 20, [&](std::string* chunk) { total_size += chunk->size(); });
+  ASSERT_LT(total_size, shape.ByteSizeLong() / 4);
+}
+
+}  // namespace oneflow
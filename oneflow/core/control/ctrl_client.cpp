@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/job/env_desc.h"
 
 namespace oneflow {
 
@@ -21,6 +22,13 @@ namespace {
 
 #define GRPC_CHECK(x) CHECK_EQ(x.error_code(), grpc::StatusCode::OK)
 
+// Fan-out of the tree collectives of the ctrl plane. 0 keeps barriers on the master's ctrl server
+// and makes the master send broadcast values to every rank directly.
+int64_t CtrlTreeFanOut() {
+  static const int64_t fan_out = ParseIntegerFromEnv("ONEFLOW_CTRL_TREE_FAN_OUT", 8);
+  return fan_out;
+}
+
 }  // namespace
 
 GrpcCtrlClient::~GrpcCtrlClient() { StopHeartbeat(); }
@@ -58,10 +66,19 @@ GrpcCtrlClient::GrpcCtrlClient(const ProcessCtx& process_ctx) : process_ctx_(pro
   });
 }
 
-void GrpcCtrlClient::Barrier(const std::string& barrier_name) { rpc_client_.Barrier(barrier_name); }
+void GrpcCtrlClient::Barrier(const std::string& barrier_name) {
+  Barrier(barrier_name, Singleton<EnvDesc>::Get()->TotalMachineNum());
+}
 
 void GrpcCtrlClient::Barrier(const std::string& barrier_name, int32_t barrier_num) {
-  rpc_client_.Barrier(barrier_name, barrier_num);
+  const int64_t fan_out = CtrlTreeFanOut();
+  // NOTE: the tree takes two rounds per level, it only pays off when the master would otherwise
+  //   serve more than fan_out + 1 ranks.
+  if (fan_out > 0 && barrier_num == process_ctx().ctrl_addr_size() && barrier_num > fan_out + 1) {
+    rpc_client_.TreeBarrier(barrier_name, fan_out);
+  } else {
+    rpc_client_.Barrier(barrier_name, barrier_num);
+  }
 }
 
 TryLockResult GrpcCtrlClient::TryLock(const std::string& name) { return rpc_client_.TryLock(name); }
@@ -102,6 +119,19 @@ void GrpcCtrlClient::PullMasterKV(const std::string& k, PbMessage* msg) {
   rpc_client_.PullMasterKV(k, msg);
 }
 
+void GrpcCtrlClient::BroadcastKV(const std::string& k, std::string* v) {
+  const int64_t world_size = process_ctx().ctrl_addr_size();
+  const int64_t fan_out = CtrlTreeFanOut() > 0 ? CtrlTreeFanOut() : world_size - 1;
+  if (world_size > 1) { rpc_client_.TreeBroadcastKV(k, fan_out, v); }
+}
+
+void GrpcCtrlClient::BroadcastKV(const std::string& k, PbMessage* msg) {
+  std::string v;
+  if (process_ctx().rank() == 0) { msg->SerializeToString(&v); }
+  BroadcastKV(k, &v);
+  if (process_ctx().rank() != 0) { CHECK(msg->ParseFromString(v)); }
+}
+
 void GrpcCtrlClient::Clear() { rpc_client_.Clear(); }
 
 int32_t GrpcCtrlClient::IncreaseCount(const std::string& k, int32_t v) {
@@ -45,6 +45,11 @@ class ClientCall final {
   CtrlResponse<ctrl_method> response_;
 };
 
+int64_t TreeChildNum(int64_t rank, int64_t world_size, int64_t fan_out) {
+  const int64_t first_child = rank * fan_out + 1;
+  return std::max<int64_t>(std::min<int64_t>(world_size - first_child, fan_out), 0);
+}
+
 }  // namespace
 
 void RpcClient::Barrier(const std::string& barrier_name) {
@@ -150,6 +155,52 @@ void RpcClient::PullMasterKV(const std::string& k, PbMessage* msg) {
   PullMasterKV(k, [&](const std::string& i) { msg->ParseFromString(i); });
 }
 
+void RpcClient::TreeBarrier(const std::string& barrier_name, int64_t fan_out) {
+  CHECK_GT(fan_out, 0);
+  const int64_t world_size = stubs_.size();
+  const int64_t rank = GlobalProcessCtx::Rank();
+  const std::string up_name = barrier_name + "/tree_up";
+  const std::string down_name = barrier_name + "/tree_down";
+  auto BarrierAt = [&](int64_t host_rank, const std::string& name) {
+    ClientCall<CtrlMethod::kBarrier> call;
+    call.mut_request()->set_name(name);
+    call.mut_request()->set_num(TreeChildNum(host_rank, world_size, fan_out) + 1);
+    call(GetStubAt(host_rank));
+  };
+  const bool has_child = TreeChildNum(rank, world_size, fan_out) > 0;
+  // NOTE: a rank meets its children on its own ctrl server, first when the whole subtree has
+  //   arrived and then again to let them go once its parent has let it go.
+  if (has_child) { BarrierAt(rank, up_name); }
+  if (rank != 0) {
+    const int64_t parent = (rank - 1) / fan_out;
+    BarrierAt(parent, up_name);
+    BarrierAt(parent, down_name);
+  }
+  if (has_child) { BarrierAt(rank, down_name); }
+}
+
+void RpcClient::TreeBroadcastKV(const std::string& k, int64_t fan_out, std::string* v) {
+  CHECK_GT(fan_out, 0);
+  const int64_t world_size = stubs_.size();
+  const int64_t rank = GlobalProcessCtx::Rank();
+  if (rank != 0) {
+    ClientCall<CtrlMethod::kPullKV> pull_call;
+    pull_call.mut_request()->set_key(k);
+    pull_call(GetThisStub());
+    *v = pull_call.response().val();
+    ClientCall<CtrlMethod::kClearKV> clear_call;
+    clear_call.mut_request()->set_key(k);
+    clear_call(GetThisStub());
+  }
+  const int64_t child_num = TreeChildNum(rank, world_size, fan_out);
+  FOR_RANGE(int64_t, i, 0, child_num) {
+    ClientCall<CtrlMethod::kPushKV> push_call;
+    push_call.mut_request()->set_key(k);
+    *push_call.mut_request()->mutable_val() = *v;
+    push_call(GetStubAt(rank * fan_out + 1 + i));
+  }
+}
+
 void RpcClient::Clear() {
   ClientCall<CtrlMethod::kClear> call;
   call(GetThisStub());
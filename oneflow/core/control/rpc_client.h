@@ -59,6 +59,15 @@ class RpcClient {
     *v = oneflow_cast<T>(v_str);
   }
 
+  // Tree-structured collectives over the ctrl servers of all ranks. Rank r relays for ranks
+  // r * fan_out + 1 to r * fan_out + fan_out, so no ctrl server is hit by more than fan_out + 1
+  // ranks at once. They must be called by all ranks.
+  void TreeBarrier(const std::string& barrier_name, int64_t fan_out);
+  // The master's *v is pushed to the ctrl server of each of its children, which pull it from
+  // their own server and pass it on. Every rank clears its own copy, but the key can only be
+  // broadcast again once all ranks have returned.
+  void TreeBroadcastKV(const std::string& k, int64_t fan_out, std::string* v);
+
   void Clear();
 
   int32_t IncreaseCount(const std::string& k, int32_t v);
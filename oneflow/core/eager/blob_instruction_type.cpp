@@ -26,6 +26,7 @@ limitations under the License.
 #include "oneflow/core/vm/access_blob_arg_cb_phy_instr_operand.h"
 #include "oneflow/core/register/ofblob.h"
 #include "oneflow/core/eager/eager_blob_object.h"
+#include "oneflow/core/framework/variable_write_epoch.h"
 
 namespace oneflow {
 namespace vm {
@@ -39,6 +40,10 @@ void AccessBlobByCallbackInstructionType::Compute(vm::Instruction* instruction)
   DeviceCtx* device_ctx = instruction->stream().device_ctx().get();
   OfBlob ofblob(device_ctx->stream(), ptr->eager_blob_object()->blob());
   ptr->callback()(reinterpret_cast<uint64_t>(&ofblob));
+  if (ptr->modifier() != "const"
+      && ptr->eager_blob_object()->tensor_storage()->is_bound_to_lazy_job()) {
+    VariableWriteEpoch::Increase();
+  }
 }
 
 }  // namespace vm
@@ -75,6 +75,13 @@ class TensorStorage {
     storage_delete_hooks_.emplace_back(hook);
   }
 
+  // Whether the memory backs a variable of a lazy job, see RegstMgr::AddPlan. Eager writes to such
+  // storages increase the VariableWriteEpoch.
+  bool is_bound_to_lazy_job() const { return is_bound_to_lazy_job_; }
+  void set_is_bound_to_lazy_job(bool is_bound_to_lazy_job) {
+    is_bound_to_lazy_job_ = is_bound_to_lazy_job;
+  }
+
  private:
   size_t blob_bytes_;
   std::unique_ptr<char, std::function<void(char*)>> blob_dptr_;
@@ -82,6 +89,7 @@ class TensorStorage {
   Optional<Symbol<::oneflow::Stream>> producer_stream_;
   Optional<Symbol<::oneflow::Stream>> last_used_stream_;
   std::vector<std::function<void()>> storage_delete_hooks_;
+  bool is_bound_to_lazy_job_ = false;
 };
 
 class EagerBlobObject final : public user_op::Tensor,
@@ -19,6 +19,7 @@ limitations under the License.
 #include "oneflow/core/vm/lazy_job_device_context.h"
 #include "oneflow/core/eager/lazy_job_phy_instr_operand.h"
 #include "oneflow/core/framework/nn_graph_if.h"
+#include "oneflow/core/framework/variable_write_epoch.h"
 #include "oneflow/core/common/container_util.h"
 #include "oneflow/core/common/of_unused.h"
 #include "oneflow/core/vm/instruction.h"
@@ -79,8 +80,8 @@ class LaunchLazyJobInstructionType final : public InstructionType {  // NOLINT
 
     static thread_local int64_t run_id = 0;
     {
-      OF_PROFILER_RANGE_GUARD("WaitUntilQueueEmptyIfFrontNNGraphNotEquals");
-      device_ctx->WaitUntilQueueEmptyIfFrontNNGraphNotEquals(cur_nn_graph);
+      OF_PROFILER_RANGE_GUARD("WaitUntilNNGraphCanLaunch");
+      device_ctx->WaitUntilNNGraphCanLaunch(cur_nn_graph);
     }
     {
       OF_PROFILER_RANGE_GUARD("Send all buffers to BufferMgr");
@@ -90,6 +91,9 @@ class LaunchLazyJobInstructionType final : public InstructionType {  // NOLINT
       buffer_mgr->Get(GetCallbackNotifierBufferName(job_name))->Push(job_instance);
       buffer_mgr->Get(GetSourceTickBufferName(job_name))->Push(job_instance);
     }
+    // A graph writing variables never overlaps with jobs of other graphs, so the epoch is increased
+    // before any other job reads the variables this one updates.
+    if (cur_nn_graph->writes_variables()) { VariableWriteEpoch::Increase(); }
     OF_UNUSED(run_id);  // disable compiler warning.
     OF_PROFILER_RANGE_GUARD("EnqueueNNGraph");
     device_ctx->EnqueueNNGraph(cur_nn_graph);
@@ -117,7 +121,7 @@ class LaunchLazyJobInstructionType final : public InstructionType {  // NOLINT
     const auto& nn_graph = phy_instr_operand->nn_graph();
     const auto& FinishCb = [this, instruction]() {
       auto* device_ctx = GetLazyJobDeviceCtx(instruction);
-      device_ctx->DequeueNNGraph();
+      device_ctx->DequeueNNGraph(GetCurNNGraph(instruction).get());
       auto* status_buffer = instruction->mut_status_buffer();
       NaiveInstrStatusQuerier::MutCast(status_buffer->mut_buffer())->set_done();
     };
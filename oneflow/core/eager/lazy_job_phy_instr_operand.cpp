@@ -23,8 +23,22 @@ limitations under the License.
 namespace oneflow {
 namespace vm {
 
+// The variables of a graph which may run concurrently are only read, so they are const
+// dependences and launches of such graphs do not wait for each other.
+void LaunchLazyJobPhyInstrOperand::ForEachConstDependence(
+    const std::function<void(vm::Dependence* compute)>& DoEach) const {
+  if (!nn_graph_->may_run_concurrently()) { return; }
+  ForEachDependence(DoEach);
+}
+
 void LaunchLazyJobPhyInstrOperand::ForEachMutDependence(
     const std::function<void(vm::Dependence* compute)>& DoEach) const {
+  if (nn_graph_->may_run_concurrently()) { return; }
+  ForEachDependence(DoEach);
+}
+
+void LaunchLazyJobPhyInstrOperand::ForEachDependence(
+    const std::function<void(vm::Dependence* compute)>& DoEach) const {
   for (const auto& eager_blob_object : *param_blob_objects_) {
     DoEach(CHECK_JUST(eager_blob_object->compute_local_dep_object()));
   }
@@ -57,7 +57,7 @@ class LaunchLazyJobPhyInstrOperand final : public PhyInstrOperand {
   const DependenceVector& input_dependences() const override { return input_dependences_; }
   const DependenceVector& output_dependences() const override { return output_dependences_; }
 
-  void ForEachConstDependence(const std::function<void(vm::Dependence* compute)>&) const {}
+  void ForEachConstDependence(const std::function<void(vm::Dependence* compute)>&) const;
 
   void ForEachMutDependence(const std::function<void(vm::Dependence* compute)>&) const;
 
@@ -68,6 +68,8 @@ class LaunchLazyJobPhyInstrOperand final : public PhyInstrOperand {
   }
 
  private:
+  void ForEachDependence(const std::function<void(vm::Dependence* compute)>&) const;
+
   std::shared_ptr<NNGraphIf> nn_graph_;
   one::EagerBlobObjectListPtr param_blob_objects_;
   DependenceVector input_dependences_;
@@ -29,6 +29,7 @@ limitations under the License.
 #include "oneflow/core/vm/instruction.h"
 #include "oneflow/core/vm/instruction_type.h"
 #include "oneflow/core/framework/user_op_registry_manager.h"
+#include "oneflow/core/framework/variable_write_epoch.h"
 #include "oneflow/core/job/foreign_callback.h"
 #include "oneflow/core/register/ofblob.h"
 #include "oneflow/core/vm/symbol_storage.h"
@@ -66,6 +67,7 @@ struct OpCallInstructionUtil final {
       TryInitOpKernelStateAndCache(operand, device_ctx, &state, &cache);
     }
     OpKernelCompute(operand, device_ctx, state, cache);
+    if (unlikely(operand->writes_lazy_job_variables())) { VariableWriteEpoch::Increase(); }
   }
 
   static inline OpCallPhyInstrOperand* GetCallPhyInstrOperand(const vm::Instruction& instruction) {
@@ -36,12 +36,35 @@ OpCallPhyInstrOperand::OpCallPhyInstrOperand(
       infer_tmp_size_fn_(nullptr),
       need_temp_storage_(false),
       dev_vm_dep_object_consume_mode_(dev_vm_dep_object_consume_mode),
+      writes_lazy_job_variables_(false),
       input_dependences_(),
       output_dependences_() {
   ForEachConstDependence(SetInserter(&input_dependences_));
   ForEachMutDependence(SetInserter(&output_dependences_));
   ForEachMut2Dependence(SetInserter(&output_dependences_));
   InitStreamSequentialDependence();
+  InitWritesLazyJobVariables();
+}
+
+void OpCallPhyInstrOperand::InitWritesLazyJobVariables() {
+  // Outputs which are not inplace get new storages, so only the storages of mutable inputs and
+  // inplace outputs can be bound to a lazy job.
+  const auto& IsBoundToLazyJob = [](const std::shared_ptr<EagerBlobObject>& eager_blob_object) {
+    return eager_blob_object->tensor_storage()->is_bound_to_lazy_job();
+  };
+  const auto& input_list = inputs();
+  for (int64_t index : opkernel().input_tuple_indexes4mut_ibns()) {
+    if (IsBoundToLazyJob(input_list->at(index))) {
+      writes_lazy_job_variables_ = true;
+      return;
+    }
+  }
+  for (const auto& output : *outputs()) {
+    if (IsBoundToLazyJob(output)) {
+      writes_lazy_job_variables_ = true;
+      return;
+    }
+  }
 }
 
 Maybe<void> OpCallPhyInstrOperand::Init() {
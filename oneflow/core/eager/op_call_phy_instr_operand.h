@@ -75,6 +75,8 @@ class OpCallPhyInstrOperand final : public vm::PhyInstrOperand {
   void ForEachMut2Dependence(const std::function<void(vm::Dependence* compute)>&) const;
 
   bool need_temp_storage() const { return need_temp_storage_; }
+  // Whether the op writes a variable of a lazy job, decided when the instruction is built.
+  bool writes_lazy_job_variables() const { return writes_lazy_job_variables_; }
   const user_op::OpKernel* user_opkernel() const { return user_opkernel_; }
   const user_op::InferTmpSizeFn& infer_tmp_size_fn() const { return *infer_tmp_size_fn_; }
 
@@ -99,6 +101,7 @@ class OpCallPhyInstrOperand final : public vm::PhyInstrOperand {
 
   Maybe<void> Init();
   void InitStreamSequentialDependence();
+  void InitWritesLazyJobVariables();
 
   vm::Stream* vm_stream_;
   eager::CallContext call_ctx_;
@@ -107,6 +110,7 @@ class OpCallPhyInstrOperand final : public vm::PhyInstrOperand {
   const user_op::InferTmpSizeFn* infer_tmp_size_fn_;
   bool need_temp_storage_;
   const one::DevVmDepObjectConsumeMode dev_vm_dep_object_consume_mode_;
+  bool writes_lazy_job_variables_;
   DependenceVector input_dependences_;
   DependenceVector output_dependences_;
 };
@@ -17,11 +17,123 @@ limitations under the License.
 #include "oneflow/core/ep/cpu/cpu_event.h"
 #include "oneflow/core/ep/cpu/cpu_stream.h"
 #include "oneflow/core/ep/include/device_manager_registry.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
 
 namespace oneflow {
 
 namespace ep {
 
+namespace {
+
+constexpr size_t kTransparentHugePageSize = 2 * 1024 * 1024;
+
+bool UseMappedAllocation(const CpuAllocationConfig& config, size_t size) {
+#ifdef __linux__
+  return (config.huge_page_mode != CpuHugePageMode::kNone || config.numa_bind)
+         && size >= config.large_allocation_threshold;
+#else
+  return false;
+#endif  // __linux__
+}
+
+#ifdef __linux__
+
+// Value of MPOL_PREFERRED in <linux/mempolicy.h>, libnuma is not a dependency
+constexpr int kMpolPreferred = 1;
+constexpr int64_t kMaxNumaNodes = 1024;
+
+void* MapHugeTlb(size_t size, size_t page_size) {
+#ifdef MAP_HUGETLB
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+  flags |= __builtin_ctzll(page_size) << MAP_HUGE_SHIFT;
+#endif  // MAP_HUGE_SHIFT
+  void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  return ptr == MAP_FAILED ? nullptr : ptr;
+#else
+  return nullptr;
+#endif  // MAP_HUGETLB
+}
+
+// Over-maps by the alignment and unmaps the unaligned head and tail
+void* MapAligned(size_t size, size_t alignment) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t padding = alignment > page_size ? alignment : 0;
+  void* ptr = mmap(nullptr, size + padding, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1, 0);
+  if (ptr == MAP_FAILED) { return nullptr; }
+  if (padding == 0) { return ptr; }
+  const uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+  const uintptr_t aligned_begin = RoundUp(begin, alignment);
+  const uintptr_t end = begin + size + padding;
+  const uintptr_t aligned_end = aligned_begin + size;
+  if (aligned_begin > begin) { munmap(ptr, aligned_begin - begin); }
+  if (end > aligned_end) { munmap(reinterpret_cast<void*>(aligned_end), end - aligned_end); }
+  return reinterpret_cast<void*>(aligned_begin);
+}
+
+bool AdviseHugePage(void* ptr, size_t size) {
+#ifdef MADV_HUGEPAGE
+  return madvise(ptr, size, MADV_HUGEPAGE) == 0;
+#else
+  return false;
+#endif  // MADV_HUGEPAGE
+}
+
+int64_t GetCurrentNumaNode() {
+#ifdef SYS_getcpu
+  unsigned int cpu = 0;
+  unsigned int node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) { return node; }
+#endif  // SYS_getcpu
+  return -1;
+}
+
+// Must run before the pages are first touched, the policy only affects future faults
+bool BindToNumaNode(void* ptr, size_t size, int64_t node) {
+#ifdef SYS_mbind
+  if (node < 0 || node >= kMaxNumaNodes) { return false; }
+  constexpr int64_t kBitsPerWord = sizeof(unsigned long) * 8;  // NOLINT
+  std::vector<unsigned long> node_mask(kMaxNumaNodes / kBitsPerWord, 0);  // NOLINT
+  node_mask[node / kBitsPerWord] |= 1UL << (node % kBitsPerWord);
+  return syscall(SYS_mbind, ptr, size, kMpolPreferred, node_mask.data(), kMaxNumaNodes + 1, 0)
+         == 0;
+#else
+  return false;
+#endif  // SYS_mbind
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+CpuAllocationConfig GetCpuAllocationConfigFromEnv() {
+  CpuAllocationConfig config;
+  const std::string huge_page_mode = GetStringFromEnv("ONEFLOW_EP_CPU_HUGE_PAGE", "none");
+  if (huge_page_mode == "thp") {
+    config.huge_page_mode = CpuHugePageMode::kTransparent;
+  } else if (huge_page_mode == "hugetlb") {
+    config.huge_page_mode = CpuHugePageMode::kHugeTlb;
+  } else {
+    CHECK_EQ(huge_page_mode, "none")
+        << "ONEFLOW_EP_CPU_HUGE_PAGE should be one of none, thp and hugetlb";
+  }
+  const int64_t huge_tlb_page_size_mb =
+      ParseIntegerFromEnv("ONEFLOW_EP_CPU_HUGE_TLB_PAGE_SIZE_MB", 2);
+  CHECK(huge_tlb_page_size_mb == 2 || huge_tlb_page_size_mb == 1024)
+      << "ONEFLOW_EP_CPU_HUGE_TLB_PAGE_SIZE_MB should be 2 or 1024";
+  config.huge_tlb_page_size = huge_tlb_page_size_mb * 1024 * 1024;
+  config.large_allocation_threshold =
+      ParseIntegerFromEnv("ONEFLOW_EP_CPU_LARGE_ALLOCATION_THRESHOLD_MB", 2) * 1024 * 1024;
+  config.numa_bind = ParseBooleanFromEnv("ONEFLOW_EP_CPU_NUMA_BIND", false);
+  config.numa_node = ParseIntegerFromEnv("ONEFLOW_EP_CPU_NUMA_NODE", -1);
+  return config;
+}
+
 void CpuDevice::SetAsActiveDevice() {}
 
 Stream* CpuDevice::CreateStream() { return new CpuStream(this); }
@@ -43,13 +155,16 @@ Maybe<void> CpuDevice::Alloc(const AllocationOptions& options, void** ptr, size_
                                                       options.GetPinnedDeviceIndex());  // NOLINT
     CHECK_OR_RETURN(device);
     return device->AllocPinned(options, ptr, size);
+  }
+  if (size >= mapped_allocation_threshold_.load(std::memory_order_relaxed)) {
+    const CpuAllocationConfig config = GetAllocationConfig();
+    if (UseMappedAllocation(config, size)) { return AllocMapped(config, ptr, size); }
+  }
+  *ptr = aligned_alloc(kMaxAlignmentRequirement, RoundUp(size, kMaxAlignmentRequirement));
+  if (*ptr == nullptr) {
+    return Error::RuntimeError() << "allocate failed";
   } else {
-    *ptr = aligned_alloc(kMaxAlignmentRequirement, RoundUp(size, kMaxAlignmentRequirement));
-    if (*ptr == nullptr) {
-      return Error::RuntimeError() << "allocate failed";
-    } else {
-      return Maybe<void>::Ok();
-    }
+    return Maybe<void>::Ok();
   }
 }
 
@@ -60,9 +175,108 @@ void CpuDevice::Free(const AllocationOptions& options, void* ptr) {
                                                       options.GetPinnedDeviceIndex());  // NOLINT
     CHECK(device);
     return device->FreePinned(options, ptr);
+  }
+  if (mapped_region_num_.load() > 0) {
+    std::unique_lock<std::mutex> lock(allocation_mutex_);
+    auto it = ptr2mapped_region_.find(ptr);
+    if (it != ptr2mapped_region_.end()) {
+      const MappedRegion region = it->second;
+      ptr2mapped_region_.erase(it);
+      mapped_region_num_ -= 1;
+      lock.unlock();
+      FreeMapped(ptr, region);
+      return;
+    }
+  }
+  free(ptr);  // NOLINT
+}
+
+void CpuDevice::SetAllocationConfig(const CpuAllocationConfig& config) {
+  std::lock_guard<std::mutex> lock(allocation_mutex_);
+  allocation_config_ = config;
+  if (UseMappedAllocation(config, std::numeric_limits<size_t>::max())) {
+    mapped_allocation_threshold_ = config.large_allocation_threshold;
   } else {
-    free(ptr);  // NOLINT
+    mapped_allocation_threshold_ = kNoMappedAllocation;
+  }
+}
+
+CpuAllocationConfig CpuDevice::GetAllocationConfig() {
+  std::lock_guard<std::mutex> lock(allocation_mutex_);
+  return allocation_config_;
+}
+
+CpuAllocationStats CpuDevice::GetAllocationStats() {
+  std::lock_guard<std::mutex> lock(allocation_mutex_);
+  return allocation_stats_;
+}
+
+Maybe<void> CpuDevice::AllocMapped(const CpuAllocationConfig& config, void** ptr, size_t size) {
+#ifdef __linux__
+  MappedRegion region{};
+  region.huge_page_mode = CpuHugePageMode::kNone;
+  bool huge_tlb_fallback = false;
+  *ptr = nullptr;
+  if (config.huge_page_mode == CpuHugePageMode::kHugeTlb) {
+    region.size = RoundUp(size, config.huge_tlb_page_size);
+    *ptr = MapHugeTlb(region.size, config.huge_tlb_page_size);
+    if (*ptr != nullptr) {
+      region.huge_page_mode = CpuHugePageMode::kHugeTlb;
+    } else {
+      huge_tlb_fallback = true;
+      LOG_FIRST_N(WARNING, 1) << "hugetlb pool of page size " << config.huge_tlb_page_size
+                              << " is exhausted or not configured, fall back to transparent huge "
+                              << "pages";
+    }
+  }
+  if (*ptr == nullptr) {
+    const bool use_huge_page = config.huge_page_mode != CpuHugePageMode::kNone;
+    const size_t alignment = use_huge_page ? kTransparentHugePageSize : kMaxAlignmentRequirement;
+    const size_t page_size =
+        use_huge_page ? kTransparentHugePageSize : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    region.size = RoundUp(size, page_size);
+    *ptr = MapAligned(region.size, alignment);
+    if (*ptr == nullptr) { return Error::RuntimeError() << "allocate failed"; }
+    if (use_huge_page && AdviseHugePage(*ptr, region.size)) {
+      region.huge_page_mode = CpuHugePageMode::kTransparent;
+    }
+  }
+  if (config.numa_bind) {
+    const int64_t node = config.numa_node >= 0 ? config.numa_node : GetCurrentNumaNode();
+    region.numa_bound = BindToNumaNode(*ptr, region.size, node);
+  }
+  std::lock_guard<std::mutex> lock(allocation_mutex_);
+  CHECK(ptr2mapped_region_.emplace(*ptr, region).second);
+  mapped_region_num_ += 1;
+  allocation_stats_.mapped_bytes += region.size;
+  if (region.huge_page_mode == CpuHugePageMode::kTransparent) {
+    allocation_stats_.transparent_huge_page_bytes += region.size;
+  } else if (region.huge_page_mode == CpuHugePageMode::kHugeTlb) {
+    allocation_stats_.huge_tlb_bytes += region.size;
+  }
+  if (region.numa_bound) { allocation_stats_.numa_bound_bytes += region.size; }
+  if (huge_tlb_fallback) { allocation_stats_.huge_tlb_fallback_cnt += 1; }
+  if (config.numa_bind && !region.numa_bound) { allocation_stats_.numa_bind_failure_cnt += 1; }
+  return Maybe<void>::Ok();
+#else
+  UNIMPLEMENTED_THEN_RETURN();
+#endif  // __linux__
+}
+
+void CpuDevice::FreeMapped(void* ptr, const MappedRegion& region) {
+#ifdef __linux__
+  PCHECK(munmap(ptr, region.size) == 0);
+  std::lock_guard<std::mutex> lock(allocation_mutex_);
+  allocation_stats_.mapped_bytes -= region.size;
+  if (region.huge_page_mode == CpuHugePageMode::kTransparent) {
+    allocation_stats_.transparent_huge_page_bytes -= region.size;
+  } else if (region.huge_page_mode == CpuHugePageMode::kHugeTlb) {
+    allocation_stats_.huge_tlb_bytes -= region.size;
   }
+  if (region.numa_bound) { allocation_stats_.numa_bound_bytes -= region.size; }
+#else
+  UNIMPLEMENTED();
+#endif  // __linux__
 }
 
 Maybe<void> CpuDevice::AllocPinned(const AllocationOptions& options, void** ptr, size_t size) {
@@ -16,22 +16,64 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_EP_CPU_CPU_DEVICE_H_
 #define ONEFLOW_CORE_EP_CPU_CPU_DEVICE_H_
 
+#include <atomic>
+#include <limits>
 #include "oneflow/core/ep/include/device.h"
+#include "oneflow/core/common/util.h"
 
 namespace oneflow {
 
 namespace ep {
 
+enum class CpuHugePageMode {
+  kNone,
+  // Anonymous mappings aligned to 2MB and advised with MADV_HUGEPAGE
+  kTransparent,
+  // Explicit huge pages from the hugetlbfs pool, falling back to kTransparent when exhausted
+  kHugeTlb,
+};
+
+struct CpuAllocationConfig {
+  CpuHugePageMode huge_page_mode = CpuHugePageMode::kNone;
+  // Page size for kHugeTlb, 2MB or 1GB
+  size_t huge_tlb_page_size = 2 * 1024 * 1024;
+  // Allocations smaller than this stay on the heap
+  size_t large_allocation_threshold = 2 * 1024 * 1024;
+  bool numa_bind = false;
+  // Node to bind large allocations to, -1 means the node of the allocating thread
+  int64_t numa_node = -1;
+};
+
+struct CpuAllocationStats {
+  size_t mapped_bytes = 0;
+  size_t transparent_huge_page_bytes = 0;
+  size_t huge_tlb_bytes = 0;
+  size_t numa_bound_bytes = 0;
+  size_t huge_tlb_fallback_cnt = 0;
+  size_t numa_bind_failure_cnt = 0;
+};
+
+// Reads ONEFLOW_EP_CPU_HUGE_PAGE (none, thp or hugetlb), ONEFLOW_EP_CPU_HUGE_TLB_PAGE_SIZE_MB,
+// ONEFLOW_EP_CPU_LARGE_ALLOCATION_THRESHOLD_MB, ONEFLOW_EP_CPU_NUMA_BIND and
+// ONEFLOW_EP_CPU_NUMA_NODE
+CpuAllocationConfig GetCpuAllocationConfigFromEnv();
+
 class CpuDevice : public Device {
  public:
   OF_DISALLOW_COPY_AND_MOVE(CpuDevice);
   explicit CpuDevice(DeviceManager* device_manager)
-      : device_manager_(device_manager), num_threads_(1) {}
+      : device_manager_(device_manager),
+        num_threads_(1),
+        mapped_allocation_threshold_(kNoMappedAllocation),
+        mapped_region_num_(0) {}
   ~CpuDevice() override = default;
 
   void SetAsActiveDevice() override;
   void SetNumThreads(size_t num_threads) { num_threads_ = num_threads; }
   size_t GetNumThreads() { return num_threads_; }
+  void SetAllocationConfig(const CpuAllocationConfig& config);
+  CpuAllocationConfig GetAllocationConfig();
+  CpuAllocationStats GetAllocationStats();
 
   DeviceType device_type() const override { return DeviceType::kCPU; }
   size_t device_index() const override { return 0; }
@@ -49,8 +91,27 @@ class CpuDevice : public Device {
   void FreePinned(const AllocationOptions& options, void* ptr) override;
 
  private:
+  struct MappedRegion {
+    size_t size;
+    CpuHugePageMode huge_page_mode;
+    bool numa_bound;
+  };
+
+  Maybe<void> AllocMapped(const CpuAllocationConfig& config, void** ptr, size_t size);
+  void FreeMapped(void* ptr, const MappedRegion& region);
+
+  static constexpr size_t kNoMappedAllocation = std::numeric_limits<size_t>::max();
+
   DeviceManager* device_manager_;
   size_t num_threads_;
+  // Allocations below the threshold and frees with no mapped region alive skip
+  // allocation_mutex_, so the default configuration costs no more than aligned_alloc and free
+  std::atomic<size_t> mapped_allocation_threshold_;
+  std::atomic<size_t> mapped_region_num_;
+  std::mutex allocation_mutex_;
+  CpuAllocationConfig allocation_config_;
+  CpuAllocationStats allocation_stats_;
+  HashMap<void*, MappedRegion> ptr2mapped_region_;
 };
 
 }  // namespace ep
@@ -21,7 +21,9 @@ namespace oneflow {
 namespace ep {
 
 CpuDeviceManager::CpuDeviceManager(DeviceManagerRegistry* registry)
-    : device_num_threads_(1), registry_(registry) {}
+    : device_num_threads_(1),
+      device_allocation_config_(GetCpuAllocationConfigFromEnv()),
+      registry_(registry) {}
 
 CpuDeviceManager::~CpuDeviceManager() = default;
 
@@ -29,7 +31,10 @@ DeviceManagerRegistry* CpuDeviceManager::registry() const { return registry_; }
 
 std::shared_ptr<Device> CpuDeviceManager::GetDevice(size_t device_index) {
   std::lock_guard<std::mutex> lock(device_mutex_);
-  if (!device_) { device_.reset(new CpuDevice(this)); }
+  if (!device_) {
+    device_.reset(new CpuDevice(this));
+    device_->SetAllocationConfig(device_allocation_config_);
+  }
   device_->SetNumThreads(device_num_threads_);
   return device_;
 }
@@ -46,6 +51,12 @@ void CpuDeviceManager::SetDeviceNumThreads(size_t num_threads) {
   device_num_threads_ = num_threads;
 }
 
+void CpuDeviceManager::SetDeviceAllocationConfig(const CpuAllocationConfig& config) {
+  std::lock_guard<std::mutex> lock(device_mutex_);
+  device_allocation_config_ = config;
+  if (device_) { device_->SetAllocationConfig(config); }
+}
+
 }  // namespace ep
 
 }  // namespace oneflow
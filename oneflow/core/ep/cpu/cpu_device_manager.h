@@ -17,13 +17,12 @@ limitations under the License.
 #define ONEFLOW_CORE_EP_CPU_CPU_DEVICE_MANAGER_H_
 
 #include "oneflow/core/ep/include/device_manager.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
 
 namespace oneflow {
 
 namespace ep {
 
-class CpuDevice;
-
 class CpuDeviceManager : public DeviceManager {
  public:
   OF_DISALLOW_COPY_AND_MOVE(CpuDeviceManager);
@@ -37,9 +36,11 @@ class CpuDeviceManager : public DeviceManager {
   size_t GetActiveDeviceIndex() override;
   void SetActiveDeviceByIndex(size_t device_index) override;
   void SetDeviceNumThreads(size_t num_threads);
+  void SetDeviceAllocationConfig(const CpuAllocationConfig& config);
 
  private:
   size_t device_num_threads_;
+  CpuAllocationConfig device_allocation_config_;
   std::mutex device_mutex_;
   std::shared_ptr<CpuDevice> device_;
   DeviceManagerRegistry* registry_;
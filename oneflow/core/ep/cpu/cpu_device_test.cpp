@@ -0,0 +1,112 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <cstring>
+#include "gtest/gtest.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+
+namespace oneflow {
+namespace ep {
+
+namespace {
+
+constexpr size_t kMB = 1024 * 1024;
+
+void* AllocAndTouch(CpuDevice* device, size_t size) {
+  void* ptr = nullptr;
+  CHECK_JUST(device->Alloc(AllocationOptions{}, &ptr, size));
+  EXPECT_NE(ptr, nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % kMaxAlignmentRequirement, 0);
+  std::memset(ptr, 0x5a, size);
+  EXPECT_EQ(static_cast<unsigned char*>(ptr)[size - 1], 0x5a);
+  return ptr;
+}
+
+}  // namespace
+
+TEST(CpuDevice, heap_allocation) {
+  CpuDevice device(nullptr);
+  void* ptr = AllocAndTouch(&device, 8 * kMB);
+  EXPECT_EQ(device.GetAllocationStats().mapped_bytes, 0);
+  device.Free(AllocationOptions{}, ptr);
+}
+
+#ifdef __linux__
+
+TEST(CpuDevice, transparent_huge_page) {
+  CpuDevice device(nullptr);
+  CpuAllocationConfig config;
+  config.huge_page_mode = CpuHugePageMode::kTransparent;
+  config.large_allocation_threshold = 4 * kMB;
+  device.SetAllocationConfig(config);
+  void* small_ptr = AllocAndTouch(&device, 1 * kMB);
+  void* large_ptr = AllocAndTouch(&device, 5 * kMB);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(large_ptr) % (2 * kMB), 0);
+  CpuAllocationStats stats = device.GetAllocationStats();
+  EXPECT_EQ(stats.mapped_bytes, 6 * kMB);
+  EXPECT_LE(stats.transparent_huge_page_bytes, stats.mapped_bytes);
+  device.Free(AllocationOptions{}, small_ptr);
+  device.Free(AllocationOptions{}, large_ptr);
+  stats = device.GetAllocationStats();
+  EXPECT_EQ(stats.mapped_bytes, 0);
+  EXPECT_EQ(stats.transparent_huge_page_bytes, 0);
+}
+
+TEST(CpuDevice, free_mapped_after_config_change) {
+  CpuDevice device(nullptr);
+  CpuAllocationConfig config;
+  config.huge_page_mode = CpuHugePageMode::kTransparent;
+  device.SetAllocationConfig(config);
+  void* ptr = AllocAndTouch(&device, 4 * kMB);
+  EXPECT_EQ(device.GetAllocationStats().mapped_bytes, 4 * kMB);
+  // The region is still unmapped after mapped allocations are turned off
+  device.SetAllocationConfig(CpuAllocationConfig{});
+  device.Free(AllocationOptions{}, ptr);
+  EXPECT_EQ(device.GetAllocationStats().mapped_bytes, 0);
+}
+
+TEST(CpuDevice, huge_tlb_with_fallback) {
+  CpuDevice device(nullptr);
+  CpuAllocationConfig config;
+  config.huge_page_mode = CpuHugePageMode::kHugeTlb;
+  device.SetAllocationConfig(config);
+  // Succeeds whether or not the machine has reserved hugetlb pages
+  void* ptr = AllocAndTouch(&device, 3 * kMB);
+  CpuAllocationStats stats = device.GetAllocationStats();
+  EXPECT_EQ(stats.mapped_bytes, 4 * kMB);
+  EXPECT_TRUE(stats.huge_tlb_bytes == 4 * kMB || stats.huge_tlb_fallback_cnt == 1);
+  device.Free(AllocationOptions{}, ptr);
+  stats = device.GetAllocationStats();
+  EXPECT_EQ(stats.mapped_bytes, 0);
+  EXPECT_EQ(stats.huge_tlb_bytes, 0);
+}
+
+TEST(CpuDevice, numa_bind) {
+  CpuDevice device(nullptr);
+  CpuAllocationConfig config;
+  config.numa_bind = true;
+  device.SetAllocationConfig(config);
+  void* ptr = AllocAndTouch(&device, 4 * kMB + 1);
+  CpuAllocationStats stats = device.GetAllocationStats();
+  EXPECT_GE(stats.mapped_bytes, 4 * kMB + 1);
+  EXPECT_TRUE(stats.numa_bound_bytes == stats.mapped_bytes || stats.numa_bind_failure_cnt == 1);
+  device.Free(AllocationOptions{}, ptr);
+  EXPECT_EQ(device.GetAllocationStats().numa_bound_bytes, 0);
+}
+
+#endif  // __linux__
+
+}  // namespace ep
+}  // namespace oneflow
@@ -27,6 +27,11 @@ Maybe<void> CpuStream::Sync() { return Maybe<void>::Ok(); }
 
 void CpuStream::RecordEvent(Event* /*event*/) {}
 
+void* CpuStream::GetWorkspace(size_t size) {
+  if (workspace_.size() < size) { workspace_.resize(size); }
+  return workspace_.data();
+}
+
 #ifdef WITH_ONEDNN
 
 const std::unique_ptr<ep::OneDnnExecutor>& CpuStream::onednn_executor() const {
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_EP_CPU_CPU_STREAM_H_
 #define ONEFLOW_CORE_EP_CPU_CPU_STREAM_H_
 
+#include <vector>
 #include "oneflow/core/ep/include/stream.h"
 #include "oneflow/core/ep/cpu/cpu_device.h"
 
@@ -148,8 +149,14 @@ class CpuStream : public Stream {
   const std::unique_ptr<ep::OneDnnExecutor>& onednn_executor() const;
 #endif
 
+  // Host memory for the temporaries of primitives, e.g. the fp32 copies of the operands of a half
+  // matmul. It only grows, so launches of the same size after the first one do not allocate. The
+  // returned memory is valid until the next call.
+  void* GetWorkspace(size_t size);
+
  private:
   CpuDevice* device_;
+  std::vector<char> workspace_;
   static constexpr size_t kParallelForDefaultGrain = 32768;
 #ifdef WITH_ONEDNN
   std::unique_ptr<ep::OneDnnExecutor> onednn_executor_;
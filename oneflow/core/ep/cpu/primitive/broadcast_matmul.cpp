@@ -17,6 +17,8 @@ limitations under the License.
 #include "oneflow/core/ep/include/primitive/broadcast_matmul.h"
 #include "oneflow/core/ep/common/primitive/broadcast_matmul.h"
 #include "oneflow/core/common/blas.h"
+#include "oneflow/core/ep/include/primitive/cast.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
@@ -66,7 +68,7 @@ void CblasMatmul(CBLAS_TRANSPOSE trans_a, CBLAS_TRANSPOSE trans_b, int m, int n,
 }
 
 template<typename T>
-void LaunchCblasBroadcastMatmul(Stream* /*stream*/, DataType data_type,
+void LaunchCblasBroadcastMatmul(Stream* stream, DataType data_type,
                                 BlasTransposeType transpose_a, BlasTransposeType transpose_b,
                                 int64_t num_batch_dims, const int64_t* broadcast_batch_dims,
                                 const int64_t* a_batch_dims, const int64_t* b_batch_dims,
@@ -81,10 +83,79 @@ void LaunchCblasBroadcastMatmul(Stream* /*stream*/, DataType data_type,
                    static_cast<const T*>(batch_a), static_cast<const T*>(batch_b), beta_value,
                    static_cast<T*>(batch_c));
   };
+#ifdef OF_BLAS_SEQUENTIAL
+  // A sequential blas runs each gemm on the calling thread, so the gemms of a batch are distributed
+  // over the threads of the stream. With a multithreaded blas they stay serial, running them
+  // concurrently would oversubscribe the cores.
+  bool c_is_broadcast = false;
+  int64_t batch_count = 1;
+  for (int64_t i = 0; i < num_batch_dims; ++i) {
+    if (c_batch_dims[i] != broadcast_batch_dims[i]) { c_is_broadcast = true; }
+    batch_count *= broadcast_batch_dims[i];
+  }
+  // batches accumulating into the same c are left serial
+  if (batch_count > 1 && !c_is_broadcast) {
+    struct BatchArgs {
+      const void* a;
+      const void* b;
+      void* c;
+    };
+    std::vector<BatchArgs> batches;
+    batches.reserve(batch_count);
+    ForEachMatmul<kMaxNumDims>(
+        data_type, m, n, k, beta, num_batch_dims, broadcast_batch_dims, a_batch_dims, b_batch_dims,
+        c_batch_dims, a, b, c,
+        [&](const void* batch_a, const void* batch_b, void* batch_c, Scalar /*batch_beta*/) {
+          batches.push_back(BatchArgs{batch_a, batch_b, batch_c});
+        });
+    stream->As<CpuStream>()->ParallelFor(
+        0, batches.size(),
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            func(batches[i].a, batches[i].b, batches[i].c, beta);
+          }
+        },
+        1);
+    return;
+  }
+#endif  // OF_BLAS_SEQUENTIAL
   ForEachMatmul<kMaxNumDims>(data_type, m, n, k, beta, num_batch_dims, broadcast_batch_dims,
                              a_batch_dims, b_batch_dims, c_batch_dims, a, b, c, func);
 }
 
+// float16 and bfloat16 are converted to fp32 and accumulated in fp32
+void LaunchHalfBroadcastMatmul(Stream* stream, DataType data_type, BlasTransposeType transpose_a,
+                               BlasTransposeType transpose_b, int64_t num_batch_dims,
+                               const int64_t* broadcast_batch_dims, const int64_t* a_batch_dims,
+                               const int64_t* b_batch_dims, const int64_t* c_batch_dims, int64_t m,
+                               int64_t n, int64_t k, Scalar alpha, const void* a, const void* b,
+                               Scalar beta, void* c) {
+  int64_t a_count = m * k;
+  int64_t b_count = k * n;
+  int64_t c_count = m * n;
+  for (int64_t i = 0; i < num_batch_dims; ++i) {
+    a_count *= a_batch_dims[i];
+    b_count *= b_batch_dims[i];
+    c_count *= c_batch_dims[i];
+  }
+  auto to_float = NewPrimitive<CastFactory>(DeviceType::kCPU, data_type, DataType::kFloat);
+  auto from_float = NewPrimitive<CastFactory>(DeviceType::kCPU, DataType::kFloat, data_type);
+  CHECK(to_float);
+  CHECK(from_float);
+  float* a_float = static_cast<float*>(
+      stream->As<CpuStream>()->GetWorkspace((a_count + b_count + c_count) * sizeof(float)));
+  float* b_float = a_float + a_count;
+  float* c_float = b_float + b_count;
+  to_float->Launch(stream, a, a_float, a_count);
+  to_float->Launch(stream, b, b_float, b_count);
+  if (beta.Value<double>() != 0) { to_float->Launch(stream, c, c_float, c_count); }
+  LaunchCblasBroadcastMatmul<float>(stream, DataType::kFloat, transpose_a, transpose_b,
+                                    num_batch_dims, broadcast_batch_dims, a_batch_dims,
+                                    b_batch_dims, c_batch_dims, m, n, k, alpha, a_float, b_float,
+                                    beta, c_float);
+  from_float->Launch(stream, c_float, c, c_count);
+}
+
 void LaunchBroadcastMatmul(Stream* stream, DataType data_type, BlasTransposeType transpose_a,
                            BlasTransposeType transpose_b, int64_t num_batch_dims,
                            const int64_t* broadcast_batch_dims, const int64_t* a_batch_dims,
@@ -99,6 +170,10 @@ void LaunchBroadcastMatmul(Stream* stream, DataType data_type, BlasTransposeType
     LaunchCblasBroadcastMatmul<double>(stream, data_type, transpose_a, transpose_b, num_batch_dims,
                                        broadcast_batch_dims, a_batch_dims, b_batch_dims,
                                        c_batch_dims, m, n, k, alpha, a, b, beta, c);
+  } else if (data_type == DataType::kFloat16 || data_type == DataType::kBFloat16) {
+    LaunchHalfBroadcastMatmul(stream, data_type, transpose_a, transpose_b, num_batch_dims,
+                              broadcast_batch_dims, a_batch_dims, b_batch_dims, c_batch_dims, m, n,
+                              k, alpha, a, b, beta, c);
   } else {
     UNIMPLEMENTED();
   }
@@ -114,7 +189,8 @@ class BroadcastMatmulFactoryImpl : public BroadcastMatmulFactory {
                                        BlasTransposeType transpose_b,
                                        size_t max_num_dims) override {
     if (max_num_dims > kMaxNumDims) { return nullptr; }
-    if (data_type == DataType::kFloat || data_type == DataType::kDouble) {
+    if (data_type == DataType::kFloat || data_type == DataType::kDouble
+        || data_type == DataType::kFloat16 || data_type == DataType::kBFloat16) {
       return std::make_unique<BroadcastMatmulImpl<kMaxNumDims>>(data_type, transpose_a,
                                                                 transpose_b);
     } else {
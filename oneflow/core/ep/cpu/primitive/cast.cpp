@@ -13,6 +13,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <cstring>
 #include "oneflow/core/ep/include/primitive/cast.h"
 #include "oneflow/core/ep/cpu/primitive/type_seq.h"
 
@@ -40,6 +41,44 @@ class CastImpl : public Cast {
   }
 };
 
+// There is no bfloat16 type on cpu, a bfloat16 is stored as the upper 16 bits of a float.
+class CastBFloat16ToFloat : public Cast {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CastBFloat16ToFloat);
+  CastBFloat16ToFloat() = default;
+  ~CastBFloat16ToFloat() override = default;
+
+  void Launch(Stream* stream, const void* from, void* to, size_t count) override {
+    const uint16_t* x = reinterpret_cast<const uint16_t*>(from);
+    float* y = reinterpret_cast<float*>(to);
+    for (size_t i = 0; i < count; ++i) {
+      const uint32_t bits = static_cast<uint32_t>(x[i]) << 16;
+      std::memcpy(y + i, &bits, sizeof(float));
+    }
+  }
+};
+
+class CastFloatToBFloat16 : public Cast {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CastFloatToBFloat16);
+  CastFloatToBFloat16() = default;
+  ~CastFloatToBFloat16() override = default;
+
+  void Launch(Stream* stream, const void* from, void* to, size_t count) override {
+    const float* x = reinterpret_cast<const float*>(from);
+    uint16_t* y = reinterpret_cast<uint16_t*>(to);
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t bits = 0;
+      std::memcpy(&bits, x + i, sizeof(float));
+      if ((bits & 0x7fffffffU) > 0x7f800000U) {
+        y[i] = 0x7fc0;  // nan
+      } else {
+        y[i] = static_cast<uint16_t>((bits + 0x7fffU + ((bits >> 16) & 1U)) >> 16);
+      }
+    }
+  }
+};
+
 template<typename From, typename To>
 std::unique_ptr<Cast> NewCast() {
   return std::unique_ptr<Cast>(new CastImpl<From, To>());
@@ -75,6 +114,12 @@ class CastFactoryImpl : public CastFactory {
 
 #undef MAKE_NEW_CAST_ENTRY
 
+    if (from == DataType::kBFloat16 && to == DataType::kFloat) {
+      return std::unique_ptr<Cast>(new CastBFloat16ToFloat());
+    }
+    if (from == DataType::kFloat && to == DataType::kBFloat16) {
+      return std::unique_ptr<Cast>(new CastFloatToBFloat16());
+    }
     const auto it = new_cast_handle.find(std::make_pair(from, to));
     if (it != new_cast_handle.end()) {
       return it->second();
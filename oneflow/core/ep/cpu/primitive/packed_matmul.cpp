@@ -0,0 +1,127 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/ep/include/primitive/packed_matmul.h"
+#include "oneflow/core/ep/include/primitive/cast.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/core/common/blas.h"
+
+namespace oneflow {
+
+namespace ep {
+namespace primitive {
+
+namespace {
+
+// b is packed to fp32 stored as (k, n) row major. The linked blas has neither a packed gemm api
+// nor a half gemm, so packing converts and transposes b once instead of on every launch. A fp32 b
+// which is not transposed is already in that layout, so there is no primitive for it.
+class PackedMatmulImpl : public PackedMatmul {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(PackedMatmulImpl);
+  PackedMatmulImpl(DataType data_type, BlasTransposeType transpose_a,
+                   BlasTransposeType transpose_b)
+      : transpose_a_(transpose_a), transpose_b_(transpose_b) {
+    if (data_type != DataType::kFloat) {
+      to_float_ = NewPrimitive<CastFactory>(DeviceType::kCPU, data_type, DataType::kFloat);
+      from_float_ = NewPrimitive<CastFactory>(DeviceType::kCPU, DataType::kFloat, data_type);
+      CHECK(to_float_);
+      CHECK(from_float_);
+    }
+  }
+  ~PackedMatmulImpl() override = default;
+
+  size_t GetPackedBSize(size_t k, size_t n) override { return k * n * sizeof(float); }
+
+  void PackB(Stream* stream, size_t k, size_t n, const void* b, void* packed_b) override {
+    auto* cpu_stream = stream->As<CpuStream>();
+    float* packed = static_cast<float*>(packed_b);
+    if (transpose_b_ == BlasTransposeType::N) {
+      to_float_->Launch(stream, b, packed, k * n);
+      return;
+    }
+    // b is (n, k)
+    const float* b_float = static_cast<const float*>(b);
+    if (to_float_) {
+      float* converted = static_cast<float*>(cpu_stream->GetWorkspace(k * n * sizeof(float)));
+      to_float_->Launch(stream, b, converted, k * n);
+      b_float = converted;
+    }
+    const int64_t rows = k;
+    const int64_t cols = n;
+    cpu_stream->ParallelFor(0, rows, [=](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        for (int64_t j = 0; j < cols; ++j) { packed[i * cols + j] = b_float[j * rows + i]; }
+      }
+    });
+  }
+
+  void Launch(Stream* stream, size_t m, size_t n, size_t k, Scalar alpha, const void* a,
+              const void* packed_b, Scalar beta, void* c) override {
+    const CBLAS_TRANSPOSE trans_a =
+        transpose_a_ == BlasTransposeType::N ? CblasNoTrans : CblasTrans;
+    const int lda = transpose_a_ == BlasTransposeType::N ? k : m;
+    const float alpha_value = alpha.Value<float>();
+    const float beta_value = beta.Value<float>();
+    const float* b = static_cast<const float*>(packed_b);
+    if (!to_float_) {
+      cblas_gemm<float>(CblasRowMajor, trans_a, CblasNoTrans, m, n, k, alpha_value,
+                        static_cast<const float*>(a), lda, b, n, beta_value,
+                        static_cast<float*>(c), n);
+      return;
+    }
+    float* a_float = static_cast<float*>(
+        stream->As<CpuStream>()->GetWorkspace((m * k + m * n) * sizeof(float)));
+    float* c_float = a_float + m * k;
+    to_float_->Launch(stream, a, a_float, m * k);
+    if (beta_value != 0) { to_float_->Launch(stream, c, c_float, m * n); }
+    cblas_gemm<float>(CblasRowMajor, trans_a, CblasNoTrans, m, n, k, alpha_value, a_float, lda, b,
+                      n, beta_value, c_float, n);
+    from_float_->Launch(stream, c_float, c, m * n);
+  }
+
+ private:
+  BlasTransposeType transpose_a_;
+  BlasTransposeType transpose_b_;
+  std::unique_ptr<Cast> to_float_;
+  std::unique_ptr<Cast> from_float_;
+};
+
+class PackedMatmulFactoryImpl : public PackedMatmulFactory {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(PackedMatmulFactoryImpl);
+  PackedMatmulFactoryImpl() = default;
+  ~PackedMatmulFactoryImpl() override = default;
+
+  std::unique_ptr<PackedMatmul> New(DataType data_type, BlasTransposeType transpose_a,
+                                    BlasTransposeType transpose_b) override {
+    if (data_type == DataType::kFloat && transpose_b == BlasTransposeType::N) { return nullptr; }
+    if (data_type == DataType::kFloat || data_type == DataType::kFloat16
+        || data_type == DataType::kBFloat16) {
+      return std::make_unique<PackedMatmulImpl>(data_type, transpose_a, transpose_b);
+    } else {
+      return nullptr;
+    }
+  }
+};
+
+REGISTER_PRIMITIVE_FACTORY(DeviceType::kCPU, PackedMatmulFactory, PackedMatmulFactoryImpl);
+
+}  // namespace
+
+}  // namespace primitive
+}  // namespace ep
+
+}  // namespace oneflow
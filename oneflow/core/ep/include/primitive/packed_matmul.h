@@ -0,0 +1,58 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_PRIMITIVE_PACKED_MATMUL_H_
+#define ONEFLOW_CORE_EP_PRIMITIVE_PACKED_MATMUL_H_
+
+#include "oneflow/core/ep/include/primitive/primitive.h"
+#include "oneflow/core/ep/include/primitive/blas.h"
+#include "oneflow/core/common/scalar.h"
+
+namespace oneflow {
+
+namespace ep {
+namespace primitive {
+
+// A matmul whose b stays constant over many launches, e.g. a weight in inference. b is packed
+// once into a layout of the device's choice and every launch reads the packed b.
+class PackedMatmul : public Primitive {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(PackedMatmul);
+  PackedMatmul() = default;
+  ~PackedMatmul() override = default;
+
+  // Size in bytes of the packed op(b), which is (k, n).
+  virtual size_t GetPackedBSize(size_t k, size_t n) = 0;
+  virtual void PackB(Stream* stream, size_t k, size_t n, const void* b, void* packed_b) = 0;
+  virtual void Launch(Stream* stream, size_t m, size_t n, size_t k, Scalar alpha, const void* a,
+                      const void* packed_b, Scalar beta, void* c) = 0;
+};
+
+class PackedMatmulFactory : public Factory<PackedMatmul> {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(PackedMatmulFactory);
+  PackedMatmulFactory() = default;
+  ~PackedMatmulFactory() override = default;
+
+  virtual std::unique_ptr<PackedMatmul> New(DataType data_type, BlasTransposeType transpose_a,
+                                            BlasTransposeType transpose_b) = 0;
+};
+
+}  // namespace primitive
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_PRIMITIVE_PACKED_MATMUL_H_
@@ -0,0 +1,125 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_EP_TEST_BENCHMARK_UTIL_
+#define ONEFLOW_CORE_EP_TEST_BENCHMARK_UTIL_
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/ep/cpu/cpu_device.h"
+#include "oneflow/core/ep/test/test_util.h"
+
+namespace oneflow {
+
+namespace ep {
+
+namespace test {
+
+// Benchmarks are gtest cases derived from BenchmarkCase. They are skipped unless
+// ONEFLOW_EP_BENCHMARK is set, and every result is recorded as a test property, so running
+//   ONEFLOW_EP_BENCHMARK=1 oneflow_testexe --gtest_filter='*Benchmark*' \
+//       --gtest_output=json:benchmark.json
+// gives json results that can be compared across commits.
+//
+// ONEFLOW_EP_BENCHMARK_MIN_TIME_MS: minimal measured time of each case, default 200
+// ONEFLOW_EP_BENCHMARK_NUM_THREADS: comma separated cpu thread counts, default 1
+class BenchmarkCase : public TestCase {
+ protected:
+  void SetUp() override {
+    if (!ParseBooleanFromEnv("ONEFLOW_EP_BENCHMARK", false)) {
+      GTEST_SKIP() << "set ONEFLOW_EP_BENCHMARK=1 to run benchmarks";
+    }
+    TestCase::SetUp();
+    min_time_ms_ = ParseIntegerFromEnv("ONEFLOW_EP_BENCHMARK_MIN_TIME_MS", 200);
+    Split(GetStringFromEnv("ONEFLOW_EP_BENCHMARK_NUM_THREADS", "1"), ",",
+          [&](std::string&& num_threads) { num_threads_list_.push_back(std::stoul(num_threads)); });
+  }
+
+  // Calls `fn(device, num_threads)` for every available device, on cpu once for every configured
+  // thread count.
+  template<typename F>
+  void ForEachDeviceAndNumThreads(const F& fn) {
+    for (const auto& device_type : available_device_types_) {
+      auto device = device_manager_registry_.GetDevice(device_type, 0);
+      if (device_type == DeviceType::kCPU) {
+        auto* cpu_device = static_cast<CpuDevice*>(device.get());
+        const size_t saved_num_threads = cpu_device->GetNumThreads();
+        for (size_t num_threads : num_threads_list_) {
+          cpu_device->SetNumThreads(num_threads);
+          fn(device.get(), num_threads);
+        }
+        cpu_device->SetNumThreads(saved_num_threads);
+      } else {
+        fn(device.get(), 1);
+      }
+    }
+  }
+
+  // Returns the mean time in microseconds of one `launch()` on `stream`. The launches are
+  // repeated in growing batches until they take at least the minimal benchmark time.
+  template<typename F>
+  double MeasureLaunchTimeUs(Stream* stream, const F& launch) {
+    launch();
+    CHECK_JUST(stream->Sync());
+    int64_t num_iters = 1;
+    while (true) {
+      const auto start = std::chrono::steady_clock::now();
+      for (int64_t i = 0; i < num_iters; ++i) { launch(); }
+      CHECK_JUST(stream->Sync());
+      const std::chrono::duration<double, std::micro> elapsed =
+          std::chrono::steady_clock::now() - start;
+      if (elapsed.count() >= min_time_ms_ * 1000 || num_iters >= (1LL << 30)) {
+        return elapsed.count() / num_iters;
+      }
+      num_iters *= 2;
+    }
+  }
+
+  // Records the time of one case, `bytes` and `flops` are the memory traffic and floating point
+  // operations of one launch and may be zero if not meaningful.
+  void Report(const std::string& name, DeviceType device_type, size_t num_threads, double time_us,
+              double bytes, double flops) {
+    std::ostringstream key;
+    key << name << "/" << DeviceType_Name(device_type) << "/threads:" << num_threads;
+    RecordProperty(key.str() + "/time_us", std::to_string(time_us));
+    std::cout << std::left << std::setw(72) << key.str() << std::right << std::setw(12)
+              << std::fixed << std::setprecision(2) << time_us << " us";
+    if (bytes > 0) {
+      RecordProperty(key.str() + "/gb_per_s", std::to_string(bytes / time_us / 1e3));
+      std::cout << std::setw(10) << bytes / time_us / 1e3 << " GB/s";
+    }
+    if (flops > 0) {
+      RecordProperty(key.str() + "/gflop_per_s", std::to_string(flops / time_us / 1e3));
+      std::cout << std::setw(10) << flops / time_us / 1e3 << " GFLOP/s";
+    }
+    std::cout << std::endl;
+  }
+
+ private:
+  int64_t min_time_ms_ = 0;
+  std::vector<size_t> num_threads_list_;
+};
+
+}  // namespace test
+
+}  // namespace ep
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_EP_TEST_BENCHMARK_UTIL_
@@ -0,0 +1,122 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <numeric>
+#include "oneflow/core/ep/test/benchmark_util.h"
+#include "oneflow/core/ep/include/primitive/broadcast_matmul.h"
+#include "oneflow/core/ep/include/primitive/memset.h"
+#include "oneflow/core/ep/include/primitive/packed_matmul.h"
+
+namespace oneflow {
+
+namespace ep {
+
+namespace primitive {
+
+namespace test {
+
+namespace {
+
+class GemmBenchmark : public ep::test::BenchmarkCase {};
+
+// Fill has no bfloat16 kernel on every device, the gemm benchmark fills bytes instead.
+void MemsetDeviceMemory(Device* device, Stream* stream, void* ptr, size_t size) {
+  std::unique_ptr<Memset> memset = NewPrimitive<MemsetFactory>(device->device_type());
+  ASSERT_TRUE(memset.operator bool());
+  memset->Launch(stream, ptr, 0x3c, size);
+  CHECK_JUST(stream->Sync());
+}
+
+
+}  // namespace
+
+TEST_F(GemmBenchmark, BroadcastAndPackedMatmul) {
+  struct Case {
+    std::string name;
+    std::vector<int64_t> a_dims;
+    std::vector<int64_t> b_dims;
+    std::vector<int64_t> c_dims;
+  };
+  // Attention of a 12 head 768 hidden encoder, and the projections of a 4096 hidden decoder at
+  // decoding (m = 1, 32) and prefill (m = 512).
+  const std::vector<Case> cases = {
+      {"attention_scores", {384, 128, 64}, {384, 64, 128}, {384, 128, 128}},
+      {"attention_context", {384, 128, 128}, {384, 128, 64}, {384, 128, 64}},
+      {"decode_attention_scores", {32, 1, 128}, {32, 128, 2048}, {32, 1, 2048}},
+      {"llm_proj_m1", {1, 4096}, {4096, 4096}, {1, 4096}},
+      {"llm_proj_m32", {32, 4096}, {4096, 4096}, {32, 4096}},
+      {"llm_proj_m512", {512, 4096}, {4096, 4096}, {512, 4096}},
+      {"llm_mlp_up_m32", {32, 4096}, {4096, 11008}, {32, 11008}},
+      {"llm_mlp_down_m32", {32, 11008}, {11008, 4096}, {32, 4096}},
+  };
+  for (DataType data_type : {DataType::kFloat, DataType::kFloat16, DataType::kBFloat16}) {
+    for (const auto& c : cases) {
+      const size_t num_dims = c.c_dims.size();
+      const size_t a_count = std::accumulate(c.a_dims.cbegin(), c.a_dims.cend(), int64_t(1),
+                                             std::multiplies<int64_t>());
+      const size_t b_count = std::accumulate(c.b_dims.cbegin(), c.b_dims.cend(), int64_t(1),
+                                             std::multiplies<int64_t>());
+      const size_t c_count = std::accumulate(c.c_dims.cbegin(), c.c_dims.cend(), int64_t(1),
+                                             std::multiplies<int64_t>());
+      const size_t k = c.a_dims.back();
+      ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+        std::unique_ptr<BroadcastMatmul> matmul = NewPrimitive<BroadcastMatmulFactory>(
+            device->device_type(), data_type, BlasTransposeType::N, BlasTransposeType::N,
+            num_dims);
+        if (!matmul) { return; }
+        const size_t size_of_data_type = GetSizeOfDataType(data_type);
+        ep::test::DeviceMemoryGuard a(device, a_count * size_of_data_type);
+        ep::test::DeviceMemoryGuard b(device, b_count * size_of_data_type);
+        ep::test::DeviceMemoryGuard out(device, c_count * size_of_data_type);
+        ep::test::StreamGuard stream(device);
+        MemsetDeviceMemory(device, stream.stream(), a.ptr(), a_count * size_of_data_type);
+        MemsetDeviceMemory(device, stream.stream(), b.ptr(), b_count * size_of_data_type);
+        const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+          matmul->Launch(stream.stream(), 1.0, c.a_dims.size(), c.a_dims.data(), a.ptr(),
+                         c.b_dims.size(), c.b_dims.data(), b.ptr(), 0.0, num_dims,
+                         c.c_dims.data(), out.ptr());
+        });
+        const size_t bytes = (a_count + b_count + c_count) * size_of_data_type;
+        const double flops = 2.0 * c_count * k;
+        Report("gemm/" + DataType_Name(data_type) + "/" + c.name, device->device_type(),
+               num_threads, time_us, bytes, flops);
+        // Weights of 2d cases are constant in inference, compare with b packed ahead of time.
+        if (c.b_dims.size() != 2) { return; }
+        std::unique_ptr<PackedMatmul> packed_matmul = NewPrimitive<PackedMatmulFactory>(
+            device->device_type(), data_type, BlasTransposeType::N, BlasTransposeType::N);
+        if (!packed_matmul) { return; }
+        const int64_t m = c.a_dims.front();
+        const int64_t n = c.b_dims.back();
+        ep::test::DeviceMemoryGuard packed_b(device, packed_matmul->GetPackedBSize(k, n));
+        packed_matmul->PackB(stream.stream(), k, n, b.ptr(), packed_b.ptr());
+        const double packed_time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+          packed_matmul->Launch(stream.stream(), m, n, k, 1.0, a.ptr(), packed_b.ptr(), 0.0,
+                                out.ptr());
+        });
+        Report("gemm_packed/" + DataType_Name(data_type) + "/" + c.name, device->device_type(),
+               num_threads, packed_time_us, bytes, flops);
+      });
+    }
+  }
+}
+
+}  // namespace test
+
+}  // namespace primitive
+
+}  // namespace ep
+
+}  // namespace oneflow
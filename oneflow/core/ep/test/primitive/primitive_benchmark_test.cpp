@@ -0,0 +1,304 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <array>
+#include "oneflow/core/ep/test/benchmark_util.h"
+#include "oneflow/core/ep/include/primitive/batch_matmul.h"
+#include "oneflow/core/ep/include/primitive/broadcast_elementwise_binary.h"
+#include "oneflow/core/ep/include/primitive/cast.h"
+#include "oneflow/core/ep/include/primitive/elementwise_unary.h"
+#include "oneflow/core/ep/include/primitive/fill.h"
+#include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/core/ep/include/primitive/permute.h"
+#include "oneflow/core/ep/include/primitive/softmax.h"
+
+namespace oneflow {
+
+namespace ep {
+
+namespace primitive {
+
+namespace test {
+
+namespace {
+
+// The shapes below are taken from the layers that dominate typical models: resnet50 classifier,
+// bert-base encoder (batch 32, sequence 128, hidden 768, 12 heads) and wide&deep style mlps.
+
+class PrimitiveBenchmark : public ep::test::BenchmarkCase {};
+
+void FillDeviceMemory(Device* device, Stream* stream, void* ptr, DataType data_type,
+                      size_t count, Scalar value) {
+  std::unique_ptr<Fill> fill = NewPrimitive<FillFactory>(device->device_type(), data_type);
+  ASSERT_TRUE(fill.operator bool());
+  fill->Launch(stream, ptr, value, count);
+  CHECK_JUST(stream->Sync());
+}
+
+}  // namespace
+
+TEST_F(PrimitiveBenchmark, MatmulBenchmark) {
+  // m, n, k
+  const std::vector<std::array<size_t, 3>> shapes = {
+      {32, 1000, 2048},    // resnet50 fc
+      {4096, 3072, 768},   // bert ffn up projection
+      {4096, 768, 3072},   // bert ffn down projection
+      {4096, 768, 768},    // bert attention projection
+      {2048, 1024, 1024},  // wide&deep mlp
+      {2048, 256, 512},    // wide&deep mlp
+  };
+  for (DataType data_type : {DataType::kFloat, DataType::kDouble}) {
+    for (const auto& shape : shapes) {
+      const size_t m = shape[0], n = shape[1], k = shape[2];
+      ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+        std::unique_ptr<Matmul> matmul = NewPrimitive<MatmulFactory>(
+            device->device_type(), data_type, BlasTransposeType::N, BlasTransposeType::N);
+        if (!matmul) { return; }
+        const size_t size_of_data_type = GetSizeOfDataType(data_type);
+        ep::test::DeviceMemoryGuard a(device, m * k * size_of_data_type);
+        ep::test::DeviceMemoryGuard b(device, k * n * size_of_data_type);
+        ep::test::DeviceMemoryGuard c(device, m * n * size_of_data_type);
+        ep::test::StreamGuard stream(device);
+        FillDeviceMemory(device, stream.stream(), a.ptr(), data_type, m * k, Scalar(0.5));
+        FillDeviceMemory(device, stream.stream(), b.ptr(), data_type, k * n, Scalar(0.5));
+        const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+          matmul->Launch(stream.stream(), m, n, k, 1.0, a.ptr(), b.ptr(), 0.0, c.ptr());
+        });
+        Report("matmul/" + DataType_Name(data_type) + "/m:" + std::to_string(m) + "/n:"
+                   + std::to_string(n) + "/k:" + std::to_string(k),
+               device->device_type(), num_threads, time_us,
+               (m * k + k * n + m * n) * size_of_data_type, 2.0 * m * n * k);
+      });
+    }
+  }
+}
+
+TEST_F(PrimitiveBenchmark, BatchMatmulBenchmark) {
+  // batch, m, n, k
+  const std::vector<std::array<size_t, 4>> shapes = {
+      {384, 128, 128, 64},  // bert attention scores
+      {384, 128, 64, 128},  // bert attention context
+      {256, 1, 64, 64},     // decoding step with small m
+  };
+  for (DataType data_type : {DataType::kFloat, DataType::kDouble}) {
+    for (const auto& shape : shapes) {
+      const size_t batch_size = shape[0], m = shape[1], n = shape[2], k = shape[3];
+      ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+        std::unique_ptr<BatchMatmul> batch_matmul = NewPrimitive<BatchMatmulFactory>(
+            device->device_type(), data_type, BlasTransposeType::N, BlasTransposeType::N);
+        if (!batch_matmul) { return; }
+        const size_t size_of_data_type = GetSizeOfDataType(data_type);
+        ep::test::DeviceMemoryGuard a(device, batch_size * m * k * size_of_data_type);
+        ep::test::DeviceMemoryGuard b(device, batch_size * k * n * size_of_data_type);
+        ep::test::DeviceMemoryGuard c(device, batch_size * m * n * size_of_data_type);
+        ep::test::StreamGuard stream(device);
+        FillDeviceMemory(device, stream.stream(), a.ptr(), data_type, batch_size * m * k,
+                         Scalar(0.5));
+        FillDeviceMemory(device, stream.stream(), b.ptr(), data_type, batch_size * k * n,
+                         Scalar(0.5));
+        const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+          batch_matmul->Launch(stream.stream(), batch_size, m, n, k, 1.0, a.ptr(), b.ptr(), 0.0,
+                               c.ptr());
+        });
+        Report("batch_matmul/" + DataType_Name(data_type) + "/batch:" + std::to_string(batch_size)
+                   + "/m:" + std::to_string(m) + "/n:" + std::to_string(n)
+                   + "/k:" + std::to_string(k),
+               device->device_type(), num_threads, time_us,
+               batch_size * (m * k + k * n + m * n) * size_of_data_type,
+               2.0 * batch_size * m * n * k);
+      });
+    }
+  }
+}
+
+TEST_F(PrimitiveBenchmark, BroadcastElementwiseBinaryBenchmark) {
+  struct Case {
+    std::string name;
+    BinaryOp op;
+    std::vector<int64_t> src0_dims;
+    std::vector<int64_t> src1_dims;
+  };
+  const std::vector<Case> cases = {
+      {"bias_add", BinaryOp::kAdd, {4096, 768}, {1, 768}},
+      {"residual_add", BinaryOp::kAdd, {4096, 768}, {4096, 768}},
+      {"mask_mul", BinaryOp::kMul, {32, 12, 128, 128}, {32, 1, 1, 128}},
+      {"channel_mul", BinaryOp::kMul, {32, 256, 56, 56}, {1, 256, 1, 1}},
+      {"feature_mul", BinaryOp::kMul, {2048, 1024}, {2048, 1024}},
+  };
+  for (DataType data_type : {DataType::kFloat, DataType::kDouble}) {
+    for (const auto& c : cases) {
+      ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+        const size_t num_dims = c.src0_dims.size();
+        std::unique_ptr<BroadcastElementwiseBinary> binary =
+            NewPrimitive<BroadcastElementwiseBinaryFactory>(device->device_type(), c.op, data_type,
+                                                            data_type, num_dims);
+        if (!binary) { return; }
+        size_t src0_count = 1;
+        size_t src1_count = 1;
+        for (size_t i = 0; i < num_dims; ++i) {
+          src0_count *= c.src0_dims.at(i);
+          src1_count *= c.src1_dims.at(i);
+        }
+        const size_t size_of_data_type = GetSizeOfDataType(data_type);
+        ep::test::DeviceMemoryGuard src0(device, src0_count * size_of_data_type);
+        ep::test::DeviceMemoryGuard src1(device, src1_count * size_of_data_type);
+        ep::test::DeviceMemoryGuard dst(device, src0_count * size_of_data_type);
+        ep::test::StreamGuard stream(device);
+        FillDeviceMemory(device, stream.stream(), src0.ptr(), data_type, src0_count, Scalar(0.5));
+        FillDeviceMemory(device, stream.stream(), src1.ptr(), data_type, src1_count, Scalar(0.5));
+        const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+          binary->Launch(stream.stream(), num_dims, c.src0_dims.data(), src0.ptr(), num_dims,
+                         c.src1_dims.data(), src1.ptr(), dst.ptr());
+        });
+        Report("broadcast_elementwise_binary/" + c.name + "/" + DataType_Name(data_type),
+               device->device_type(), num_threads, time_us,
+               (2 * src0_count + src1_count) * size_of_data_type, src0_count);
+      });
+    }
+  }
+}
+
+TEST_F(PrimitiveBenchmark, ElementwiseUnaryBenchmark) {
+  const std::vector<std::pair<std::string, UnaryOp>> ops = {
+      {"relu", UnaryOp::kRelu}, {"gelu", UnaryOp::kGelu}, {"tanh", UnaryOp::kTanh},
+      {"silu", UnaryOp::kSilu}};
+  const size_t count = 4096 * 3072;
+  for (DataType data_type : {DataType::kFloat, DataType::kDouble}) {
+    for (const auto& op : ops) {
+      ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+        std::unique_ptr<ElementwiseUnary> unary = NewPrimitive<ElementwiseUnaryFactory>(
+            device->device_type(), op.second, data_type, data_type);
+        if (!unary) { return; }
+        const size_t size_of_data_type = GetSizeOfDataType(data_type);
+        ep::test::DeviceMemoryGuard src(device, count * size_of_data_type);
+        ep::test::DeviceMemoryGuard dst(device, count * size_of_data_type);
+        ep::test::StreamGuard stream(device);
+        FillDeviceMemory(device, stream.stream(), src.ptr(), data_type, count, Scalar(0.5));
+        const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+          unary->Launch(stream.stream(), src.ptr(), dst.ptr(), count);
+        });
+        Report("elementwise_unary/" + op.first + "/" + DataType_Name(data_type),
+               device->device_type(), num_threads, time_us, 2 * count * size_of_data_type, 0);
+      });
+    }
+  }
+}
+
+TEST_F(PrimitiveBenchmark, SoftmaxBenchmark) {
+  // rows, cols
+  const std::vector<std::pair<size_t, size_t>> shapes = {
+      {32 * 12 * 128, 128},  // bert attention probabilities
+      {32, 1000},            // resnet50 classifier
+      {4096, 30522},         // bert vocabulary
+  };
+  for (DataType data_type : {DataType::kFloat, DataType::kDouble}) {
+    for (const auto& shape : shapes) {
+      ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+        std::unique_ptr<Softmax> softmax =
+            NewPrimitive<SoftmaxFactory>(device->device_type(), data_type);
+        if (!softmax) { return; }
+        const size_t count = shape.first * shape.second;
+        const size_t size_of_data_type = GetSizeOfDataType(data_type);
+        ep::test::DeviceMemoryGuard x(device, count * size_of_data_type);
+        ep::test::DeviceMemoryGuard y(device, count * size_of_data_type);
+        ep::test::StreamGuard stream(device);
+        FillDeviceMemory(device, stream.stream(), x.ptr(), data_type, count, Scalar(0.5));
+        const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+          softmax->Launch(stream.stream(), shape.first, shape.second, x.ptr(), y.ptr());
+        });
+        Report("softmax/" + DataType_Name(data_type) + "/rows:" + std::to_string(shape.first)
+                   + "/cols:" + std::to_string(shape.second),
+               device->device_type(), num_threads, time_us, 2 * count * size_of_data_type, 0);
+      });
+    }
+  }
+}
+
+TEST_F(PrimitiveBenchmark, PermuteBenchmark) {
+  // split heads of bert attention, [batch, seq, heads, head_size] -> [batch, heads, seq, head_size]
+  const std::vector<int64_t> src_dims = {32, 128, 12, 64};
+  const std::vector<int> permutation = {0, 2, 1, 3};
+  const size_t count = 32 * 128 * 12 * 64;
+  for (DataType data_type : {DataType::kFloat, DataType::kDouble}) {
+    ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+      std::unique_ptr<Permute> permute =
+          NewPrimitive<PermuteFactory>(device->device_type(), src_dims.size());
+      if (!permute) { return; }
+      const size_t size_of_data_type = GetSizeOfDataType(data_type);
+      ep::test::DeviceMemoryGuard src(device, count * size_of_data_type);
+      ep::test::DeviceMemoryGuard dst(device, count * size_of_data_type);
+      ep::test::StreamGuard stream(device);
+      FillDeviceMemory(device, stream.stream(), src.ptr(), data_type, count, Scalar(0.5));
+      const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+        permute->Launch(stream.stream(), data_type, src_dims.size(), src_dims.data(), src.ptr(),
+                        permutation.data(), dst.ptr());
+      });
+      Report("permute/" + DataType_Name(data_type) + "/0213", device->device_type(), num_threads,
+             time_us, 2 * count * size_of_data_type, 0);
+    });
+  }
+}
+
+TEST_F(PrimitiveBenchmark, CastBenchmark) {
+  const size_t count = 4096 * 3072;
+  const std::vector<std::pair<DataType, DataType>> casts = {
+      {DataType::kFloat, DataType::kDouble},
+      {DataType::kDouble, DataType::kFloat},
+      {DataType::kInt64, DataType::kFloat},
+  };
+  for (const auto& cast_types : casts) {
+    ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+      std::unique_ptr<Cast> cast =
+          NewPrimitive<CastFactory>(device->device_type(), cast_types.first, cast_types.second);
+      if (!cast) { return; }
+      const size_t from_size = GetSizeOfDataType(cast_types.first);
+      const size_t to_size = GetSizeOfDataType(cast_types.second);
+      ep::test::DeviceMemoryGuard from(device, count * from_size);
+      ep::test::DeviceMemoryGuard to(device, count * to_size);
+      ep::test::StreamGuard stream(device);
+      FillDeviceMemory(device, stream.stream(), from.ptr(), cast_types.first, count, Scalar(1));
+      const double time_us = MeasureLaunchTimeUs(
+          stream.stream(), [&]() { cast->Launch(stream.stream(), from.ptr(), to.ptr(), count); });
+      Report("cast/" + DataType_Name(cast_types.first) + "_to_" + DataType_Name(cast_types.second),
+             device->device_type(), num_threads, time_us, count * (from_size + to_size), 0);
+    });
+  }
+}
+
+TEST_F(PrimitiveBenchmark, FillBenchmark) {
+  const size_t count = 64 * 1024 * 1024;
+  for (DataType data_type : {DataType::kFloat, DataType::kDouble}) {
+    ForEachDeviceAndNumThreads([&](Device* device, size_t num_threads) {
+      std::unique_ptr<Fill> fill = NewPrimitive<FillFactory>(device->device_type(), data_type);
+      if (!fill) { return; }
+      const size_t size_of_data_type = GetSizeOfDataType(data_type);
+      ep::test::DeviceMemoryGuard dst(device, count * size_of_data_type);
+      ep::test::StreamGuard stream(device);
+      const double time_us = MeasureLaunchTimeUs(
+          stream.stream(), [&]() { fill->Launch(stream.stream(), dst.ptr(), Scalar(0), count); });
+      Report("fill/" + DataType_Name(data_type), device->device_type(), num_threads, time_us,
+             count * size_of_data_type, 0);
+    });
+  }
+}
+
+}  // namespace test
+
+}  // namespace primitive
+
+}  // namespace ep
+
+}  // namespace oneflow
@@ -0,0 +1,464 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/checkpoint_engine.h"
+#include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/common/protobuf.h"
+#include "oneflow/core/common/singleton.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/control/ctrl_client.h"
+#include "oneflow/core/control/global_process_ctx.h"
+#include "oneflow/core/framework/tensor.h"
+#include "oneflow/core/framework/tensor_util.h"
+#include "oneflow/core/framework/variable_meta_info.pb.h"
+#include "oneflow/core/job/nd_sbp_util.h"
+#include "oneflow/core/job/parallel_desc.h"
+#include "oneflow/core/persistence/file_system.h"
+#include "oneflow/core/persistence/persistent_out_stream.h"
+#include "oneflow/core/register/ofblob.h"
+
+namespace oneflow {
+
+namespace {
+
+const char kManifestFilename[] = "manifest";
+
+int64_t CheckpointIoThreadNum() {
+  static const int64_t thread_num = ParseIntegerFromEnv("ONEFLOW_CHECKPOINT_IO_THREAD_NUM", 8);
+  return std::max<int64_t>(thread_num, 1);
+}
+
+bool CheckpointDirectIo() {
+  static const bool direct_io = ParseBooleanFromEnv("ONEFLOW_CHECKPOINT_DIRECT_IO", false);
+  return direct_io;
+}
+
+// Checking the checksums reads every shard a rank loads from once more.
+bool CheckpointVerifyChecksum() {
+  static const bool verify = ParseBooleanFromEnv("ONEFLOW_CHECKPOINT_VERIFY_CHECKSUM", true);
+  return verify;
+}
+
+// The slices of a variable indexed by parallel id, and the parallel id of this rank which is -1 if
+// this rank holds no slice. A local variable has a single slice owned by rank 0 when saving.
+struct VariableSlices {
+  std::vector<TensorSliceView> views;
+  int64_t parallel_id;
+};
+
+Maybe<void> GetVariableSlices(const std::shared_ptr<one::Tensor>& tensor, bool is_saving,
+                              VariableSlices* slices) {
+  const Shape& shape = *tensor->shape();
+  if (!tensor->is_global()) {
+    slices->views = {TensorSliceView(shape)};
+    slices->parallel_id = (!is_saving || GlobalProcessCtx::IsThisProcessMaster()) ? 0 : -1;
+    return Maybe<void>::Ok();
+  }
+  const auto& placement = JUST(tensor->parallel_desc());
+  const auto& nd_sbp = JUST(tensor->nd_sbp());
+  CHECK_OR_RETURN(!NdSbpHasPartialParallel(*nd_sbp))
+      << Error::RuntimeError() << "a variable with partial sbp can not be checkpointed";
+  slices->views = GetTensorSliceView(*placement->hierarchy(), *nd_sbp, shape);
+  slices->parallel_id = JUST(GetParallelId4CurrentProcessCtx(placement))->value_or(-1);
+  return Maybe<void>::Ok();
+}
+
+// Only the first parallel id of each distinct slice writes it, the others hold replicas.
+bool IsFirstOfSlice(const std::vector<TensorSliceView>& views, int64_t parallel_id) {
+  FOR_RANGE(int64_t, i, 0, parallel_id) {
+    if (views.at(i) == views.at(parallel_id)) { return false; }
+  }
+  return true;
+}
+
+// TensorSliceView treats a view without axes as empty, while it is the whole of a 0-dim variable.
+bool Overlaps(const TensorSliceView& lhs, const TensorSliceView& rhs, TensorSliceView* overlap) {
+  if (lhs.NumAxes() == 0 && rhs.NumAxes() == 0) {
+    *overlap = lhs;
+    return true;
+  }
+  *overlap = lhs.Intersect(rhs);
+  return !overlap->IsEmpty() && overlap->shape().elem_cnt() > 0;
+}
+
+int64_t FlatOffset(const TensorSliceView& view, const std::vector<int64_t>& index) {
+  int64_t offset = 0;
+  FOR_RANGE(int64_t, axis, 0, view.NumAxes()) {
+    offset = offset * view.At(axis).size() + index.at(axis) - view.At(axis).begin();
+  }
+  return offset;
+}
+
+// Copies `copy_view` from `src`, which holds `src_view` starting at its `src_offset`-th element,
+// into `dst` which holds the whole `dst_view`. Rows along the last axis are contiguous in both.
+void CopySlice(const TensorSliceView& dst_view, char* dst, const TensorSliceView& src_view,
+               const char* src, int64_t src_offset, const TensorSliceView& copy_view,
+               size_t elem_size) {
+  const int64_t num_axes = copy_view.NumAxes();
+  if (num_axes == 0) {
+    std::memcpy(dst, src, elem_size);
+    return;
+  }
+  const int64_t row_size = copy_view.At(num_axes - 1).size();
+  const int64_t row_num = copy_view.shape().elem_cnt() / row_size;
+  std::vector<int64_t> index(num_axes);
+  FOR_RANGE(int64_t, row, 0, row_num) {
+    int64_t remainder = row;
+    for (int64_t axis = num_axes - 2; axis >= 0; --axis) {
+      index.at(axis) = copy_view.At(axis).begin() + remainder % copy_view.At(axis).size();
+      remainder /= copy_view.At(axis).size();
+    }
+    index.at(num_axes - 1) = copy_view.At(num_axes - 1).begin();
+    std::memcpy(dst + FlatOffset(dst_view, index) * elem_size,
+                src + (FlatOffset(src_view, index) - src_offset) * elem_size, row_size * elem_size);
+  }
+}
+
+// The version keeps the shards of a new save apart from those of the checkpoint it replaces,
+// which stays loadable until the new manifest is published.
+std::string ShardFilename(const std::string& variable_name, int64_t parallel_id,
+                          const std::string& version) {
+  return JoinPath(variable_name, "shard_" + std::to_string(parallel_id) + "." + version);
+}
+
+// The file appears under its name only once it is complete, with a checksum of every block.
+Maybe<void> WriteFile(fs::FileSystem* fs, const std::string& filename, const char* data,
+                      size_t size) {
+  PersistentOutStreamConf conf;
+  conf.atomic = true;
+  conf.direct_io = CheckpointDirectIo();
+  PersistentOutStream out_stream(fs, filename, conf);
+  out_stream.Write(data, size);
+  JUST(out_stream.Close());
+  return Maybe<void>::Ok();
+}
+
+void ReadFile(fs::FileSystem* fs, const std::string& filename, uint64_t offset, size_t size,
+              char* data) {
+  if (size == 0) { return; }
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(filename, &file);
+  file->Read(offset, size, data);
+}
+
+Maybe<void> ReadManifest(fs::FileSystem* fs, const std::string& path,
+                         CheckpointManifest* manifest) {
+  const std::string filename = JoinPath(path, kManifestFilename);
+  CHECK_OR_RETURN(fs->FileExists(filename))
+      << Error::RuntimeError() << path << " is not a checkpoint or it has not been published";
+  CHECK_OR_RETURN(!CheckpointVerifyChecksum() || VerifyPersistentFile(fs, filename))
+      << Error::RuntimeError() << filename << " does not match its checksums";
+  std::string manifest_str(fs->GetFileSize(filename), '\0');
+  ReadFile(fs, filename, 0, manifest_str.size(), &manifest_str.at(0));
+  CHECK_OR_RETURN(TxtString2PbMessage(manifest_str, manifest))
+      << Error::RuntimeError() << "failed to parse " << filename;
+  return Maybe<void>::Ok();
+}
+
+// A slice of a variable copied to host memory, waiting to be written.
+struct StagedShard {
+  std::string filename;
+  size_t size;
+  std::unique_ptr<char[]> data;
+  // the failure to write the shard, set on the io threads
+  std::shared_ptr<ErrorProto> error;
+};
+
+// Returns the number of ranks which failed. All the ranks call it at the same step of a save, so
+// that they agree on whether to go on.
+int32_t CountFailedRanks(const std::string& key, bool failed) {
+  if (GlobalProcessCtx::WorldSize() == 1) { return failed ? 1 : 0; }
+  CtrlClient* ctrl_client = Singleton<CtrlClient>::Get();
+  ctrl_client->IncreaseCount(key, failed ? 1 : 0);
+  ctrl_client->Barrier(key);
+  const int32_t failed_num = ctrl_client->IncreaseCount(key, 0);
+  ctrl_client->Barrier(key + "/read");
+  if (GlobalProcessCtx::IsThisProcessMaster()) { ctrl_client->EraseCount(key); }
+  return failed_num;
+}
+
+Maybe<void> PublishManifest(fs::FileSystem* fs, const std::string& path,
+                            const CheckpointManifest& manifest,
+                            const CheckpointManifest& replaced_manifest) {
+  const std::string manifest_str = PbMessage2TxtString(manifest);
+  JUST(WriteFile(fs, JoinPath(path, kManifestFilename), manifest_str.data(), manifest_str.size()));
+  HashSet<std::string> shard_files;
+  for (const auto& variable : manifest.variable()) {
+    for (const auto& shard : variable.shard()) { shard_files.insert(shard.file()); }
+  }
+  for (const auto& variable : replaced_manifest.variable()) {
+    for (const auto& shard : variable.shard()) {
+      if (shard_files.count(shard.file()) == 0) {
+        DeletePersistentFile(fs, JoinPath(path, shard.file()));
+      }
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
+// Writes the shards of this rank, then the master publishes the manifest if all the ranks have
+// written theirs. Every rank goes through all the steps whatever fails, so that none of them waits
+// for the others forever, and they all return an error if the checkpoint is not published.
+Maybe<void> WriteShardsAndPublish(fs::FileSystem* fs, ThreadPool* io_thread_pool,
+                                  const std::string& path, const std::string& barrier_name,
+                                  const CheckpointManifest& manifest,
+                                  const CheckpointManifest& replaced_manifest,
+                                  std::vector<StagedShard>* shards) {
+  BlockingCounter counter(shards->size());
+  for (auto& shard : *shards) {
+    StagedShard* staged = &shard;
+    io_thread_pool->AddWork([fs, staged, &counter]() {
+      staged->error = WriteFile(fs, staged->filename, staged->data.get(), staged->size)
+                          .GetDataAndErrorProto();
+      staged->data.reset();
+      counter.Decrease();
+    });
+  }
+  counter.WaitForeverUntilCntEqualZero();
+  std::shared_ptr<ErrorProto> error;
+  for (const auto& shard : *shards) {
+    if (shard.error) {
+      error = shard.error;
+      break;
+    }
+  }
+  const int32_t failed_num = CountFailedRanks(barrier_name + "/end", error != nullptr);
+  if (failed_num > 0) {
+    // the shards written are not referenced by any manifest
+    for (const auto& shard : *shards) {
+      if (!shard.error) { DeletePersistentFile(fs, shard.filename); }
+    }
+  } else if (GlobalProcessCtx::IsThisProcessMaster()) {
+    error = PublishManifest(fs, path, manifest, replaced_manifest).GetDataAndErrorProto();
+  }
+  // the save of every rank ends once the manifest is published
+  const int32_t unpublished_num =
+      CountFailedRanks(barrier_name + "/published", failed_num == 0 && error != nullptr);
+  if (error) { return Maybe<void>(error); }
+  CHECK_EQ_OR_RETURN(failed_num, 0)
+      << Error::RuntimeError() << "Failed to write the shards of " << failed_num
+      << " rank(s), checkpoint " << path << " is not saved";
+  CHECK_EQ_OR_RETURN(unpublished_num, 0)
+      << Error::RuntimeError() << "Failed to publish the manifest of checkpoint " << path;
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+CheckpointEngine::CheckpointEngine()
+    : io_thread_pool_(std::make_unique<ThreadPool>(CheckpointIoThreadNum())), save_cnt_(0) {}
+
+CheckpointEngine::~CheckpointEngine() {
+  const auto& saved = WaitUntilSaved();
+  if (!saved.IsOk()) { LOG(ERROR) << saved.GetSerializedError(); }
+}
+
+bool CheckpointEngine::IsCheckpoint(const std::string& path) {
+  return SnapshotFS()->FileExists(JoinPath(path, kManifestFilename));
+}
+
+Maybe<void> CheckpointEngine::AsyncSave(
+    const std::string& path, const std::vector<std::string>& variable_names,
+    const std::vector<std::shared_ptr<one::Tensor>>& variable_tensors) {
+  CHECK_EQ_OR_RETURN(variable_names.size(), variable_tensors.size());
+  // NOTE: only one save is in flight, so the staging memory is bounded by one copy of the
+  //   variables held by this rank.
+  JUST(WaitUntilSaved());
+  fs::FileSystem* fs = SnapshotFS();
+  const bool is_master = GlobalProcessCtx::IsThisProcessMaster();
+  const bool is_multi_process = GlobalProcessCtx::WorldSize() > 1;
+  const std::string barrier_name = "checkpoint:" + path + ":" + std::to_string(save_cnt_++);
+  // The master creates the directories for all the ranks and picks the version of the new shards.
+  // A previous checkpoint at the same path keeps its manifest and shards until the new manifest
+  // replaces it, then the master deletes the shards only the previous one uses.
+  std::string version;
+  auto replaced_manifest = std::make_shared<CheckpointManifest>();
+  if (is_master) {
+    fs->RecursivelyCreateDirIfNotExist(path);
+    if (IsCheckpoint(path)) { JUST(ReadManifest(fs, path, replaced_manifest.get())); }
+    for (const auto& name : variable_names) { fs->CreateDirIfNotExist(JoinPath(path, name)); }
+    version = std::to_string(static_cast<int64_t>(GetCurTime()));
+  }
+  if (is_multi_process) {
+    Singleton<CtrlClient>::Get()->BroadcastKV(barrier_name + "/version", &version);
+    Singleton<CtrlClient>::Get()->Barrier(barrier_name + "/begin");
+  }
+
+  auto manifest = std::make_shared<CheckpointManifest>();
+  auto shards = std::make_shared<std::vector<StagedShard>>();
+  FOR_RANGE(int64_t, i, 0, variable_names.size()) {
+    const std::string& name = variable_names.at(i);
+    const auto& tensor = variable_tensors.at(i);
+    VariableSlices slices;
+    JUST(GetVariableSlices(tensor, /*is_saving=*/true, &slices));
+    const DataType data_type = tensor->dtype()->data_type();
+    auto* variable = manifest->add_variable();
+    variable->set_name(name);
+    tensor->shape()->ToProto(variable->mutable_meta_info()->mutable_shape());
+    variable->mutable_meta_info()->set_data_type(data_type);
+    FOR_RANGE(int64_t, parallel_id, 0, slices.views.size()) {
+      if (!IsFirstOfSlice(slices.views, parallel_id)) { continue; }
+      const TensorSliceView& view = slices.views.at(parallel_id);
+      auto* shard = variable->add_shard();
+      shard->set_file(ShardFilename(name, parallel_id, version));
+      view.ToProto(shard->mutable_slice());
+      if (parallel_id != slices.parallel_id) { continue; }
+      StagedShard staged;
+      staged.filename = JoinPath(path, shard->file());
+      staged.size = view.shape().elem_cnt() * GetSizeOfDataType(data_type);
+      staged.data.reset(new char[staged.size]);
+      const std::shared_ptr<one::Tensor> local_tensor =
+          tensor->is_global() ? JUST(tensor->cur_rank_phy_tensor()) : tensor;
+      char* data = staged.data.get();
+      const size_t size = staged.size;
+      const auto& Callback = [data, size](uint64_t of_blob_ptr) {
+        reinterpret_cast<OfBlob*>(of_blob_ptr)->AutoMemCopyTo<void>(data, size);
+      };
+      JUST(one::SyncAccessTensorWithTimeOut(local_tensor, Callback, "const"));
+      shards->emplace_back(std::move(staged));
+    }
+  }
+
+  publish_thread_ = std::thread([this, fs, path, manifest, replaced_manifest, shards,
+                                 barrier_name]() {
+    save_error_ = WriteShardsAndPublish(fs, io_thread_pool_.get(), path, barrier_name, *manifest,
+                                        *replaced_manifest, shards.get())
+                      .GetDataAndErrorProto();
+    if (!save_error_) { VLOG(1) << "checkpoint " << path << " is saved"; }
+  });
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> CheckpointEngine::WaitUntilSaved() {
+  if (publish_thread_.joinable()) { publish_thread_.join(); }
+  // the failure of a save is returned once
+  std::shared_ptr<ErrorProto> error = std::move(save_error_);
+  save_error_.reset();
+  if (error) { return Maybe<void>(error); }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> CheckpointEngine::Load(
+    const std::string& path, const std::vector<std::string>& variable_names,
+    const std::vector<std::shared_ptr<one::Tensor>>& variable_tensors) {
+  CHECK_EQ_OR_RETURN(variable_names.size(), variable_tensors.size());
+  // a save in flight may be writing the checkpoint to be loaded
+  JUST(WaitUntilSaved());
+  fs::FileSystem* fs = SnapshotFS();
+  auto manifest = std::make_shared<CheckpointManifest>();
+  JUST(ReadManifest(fs, path, manifest.get()));
+  HashMap<std::string, const ShardedVariableInfo*> name2variable;
+  for (const auto& variable : manifest->variable()) {
+    name2variable.emplace(variable.name(), &variable);
+  }
+
+  struct LoadingVariable {
+    const ShardedVariableInfo* variable;
+    std::shared_ptr<one::Tensor> local_tensor;
+    TensorSliceView view;
+    size_t elem_size;
+    std::unique_ptr<char[]> data;
+    std::unique_ptr<BlockingCounter> counter;
+    // the shard which does not match its checksums, set on the io threads
+    std::string corrupted_file;
+  };
+  auto loading_variables = std::make_shared<std::vector<LoadingVariable>>(variable_names.size());
+  FOR_RANGE(int64_t, i, 0, variable_names.size()) {
+    const std::string& name = variable_names.at(i);
+    const auto& tensor = variable_tensors.at(i);
+    auto it = name2variable.find(name);
+    CHECK_OR_RETURN(it != name2variable.end())
+        << Error::RuntimeError() << "variable " << name << " is not found in checkpoint " << path;
+    const Shape saved_shape(it->second->meta_info().shape());
+    CHECK_OR_RETURN(saved_shape == *tensor->shape())
+        << Error::RuntimeError() << "variable " << name << " has shape "
+        << tensor->shape()->ToString() << " but it is saved with shape " << saved_shape.ToString();
+    const DataType data_type = tensor->dtype()->data_type();
+    CHECK_EQ_OR_RETURN(it->second->meta_info().data_type(), data_type)
+        << Error::RuntimeError() << "variable " << name << " is saved with another data type";
+    VariableSlices slices;
+    JUST(GetVariableSlices(tensor, /*is_saving=*/false, &slices));
+    LoadingVariable* loading = &loading_variables->at(i);
+    loading->variable = it->second;
+    loading->elem_size = GetSizeOfDataType(data_type);
+    loading->counter = std::make_unique<BlockingCounter>(1);
+    if (slices.parallel_id < 0) { continue; }
+    loading->local_tensor = tensor->is_global() ? JUST(tensor->cur_rank_phy_tensor()) : tensor;
+    loading->view = slices.views.at(slices.parallel_id);
+  }
+
+  // The shards are read on the io threads, meanwhile the variables already read are copied to
+  // the devices in order on this thread.
+  // NOTE: the tasks share the ownership of the manifest and the loading variables, so that an
+  //   error returned halfway leaves no dangling pointers behind.
+  for (LoadingVariable& loading_variable : *loading_variables) {
+    LoadingVariable* loading = &loading_variable;
+    if (!loading->local_tensor) {
+      loading->counter->Decrease();
+      continue;
+    }
+    loading->data.reset(new char[loading->view.shape().elem_cnt() * loading->elem_size]);
+    io_thread_pool_->AddWork([fs, path, manifest, loading_variables, loading]() {
+      const size_t elem_size = loading->elem_size;
+      for (const auto& shard : loading->variable->shard()) {
+        const TensorSliceView shard_view(shard.slice());
+        TensorSliceView overlap;
+        if (!Overlaps(loading->view, shard_view, &overlap)) { continue; }
+        const std::string filename = JoinPath(path, shard.file());
+        if (CheckpointVerifyChecksum() && !VerifyPersistentFile(fs, filename)) {
+          loading->corrupted_file = filename;
+          break;
+        }
+        if (overlap == shard_view && overlap == loading->view) {
+          ReadFile(fs, filename, 0, overlap.shape().elem_cnt() * elem_size, loading->data.get());
+          continue;
+        }
+        // only the range of the shard file between the first and the last element of the
+        // overlap is read, which is no more than the overlap for slices split along axis 0
+        std::vector<int64_t> first_index(overlap.NumAxes());
+        std::vector<int64_t> last_index(overlap.NumAxes());
+        FOR_RANGE(int64_t, axis, 0, overlap.NumAxes()) {
+          first_index.at(axis) = overlap.At(axis).begin();
+          last_index.at(axis) = overlap.At(axis).end() - 1;
+        }
+        const int64_t begin = FlatOffset(shard_view, first_index);
+        const int64_t end = FlatOffset(shard_view, last_index) + 1;
+        std::unique_ptr<char[]> buffer(new char[(end - begin) * elem_size]);
+        ReadFile(fs, filename, begin * elem_size, (end - begin) * elem_size, buffer.get());
+        CopySlice(loading->view, loading->data.get(), shard_view, buffer.get(), begin, overlap,
+                  elem_size);
+      }
+      loading->counter->Decrease();
+    });
+  }
+  for (LoadingVariable& loading : *loading_variables) {
+    loading.counter->WaitForeverUntilCntEqualZero();
+    if (!loading.local_tensor) { continue; }
+    CHECK_OR_RETURN(loading.corrupted_file.empty())
+        << Error::RuntimeError() << "shard " << loading.corrupted_file << " of variable "
+        << loading.variable->name() << " does not match its checksums";
+    const char* data = loading.data.get();
+    const size_t size = loading.view.shape().elem_cnt() * loading.elem_size;
+    const auto& Callback = [data, size](uint64_t of_blob_ptr) {
+      reinterpret_cast<OfBlob*>(of_blob_ptr)->AutoMemCopyFrom<void>(data, size);
+    };
+    JUST(one::SyncAccessTensorWithTimeOut(loading.local_tensor, Callback, "mut"));
+    // free the host copy as soon as the variable is on its device to bound host memory
+    loading.data.reset();
+  }
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
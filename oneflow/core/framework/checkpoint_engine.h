@@ -0,0 +1,72 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_FRAMEWORK_CHECKPOINT_ENGINE_H_
+#define ONEFLOW_CORE_FRAMEWORK_CHECKPOINT_ENGINE_H_
+
+#include <thread>
+#include "oneflow/core/common/maybe.h"
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/thread/thread_pool.h"
+
+namespace oneflow {
+
+template<typename T, typename Kind>
+class Singleton;
+
+namespace one {
+
+class Tensor;
+
+}
+
+// Saves and loads variables as sharded checkpoints. A checkpoint directory holds a directory per
+// variable with one file for each distinct slice of the variable, and a `manifest` which lists
+// the slices. Rank 0 publishes the manifest only after all ranks have written their shards, so a
+// directory without a manifest is never loaded. Saving over a checkpoint writes shards under new
+// names, so the old checkpoint stays loadable until the new manifest replaces its own.
+class CheckpointEngine final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CheckpointEngine);
+  ~CheckpointEngine();
+
+  // Copies the variables into host staging buffers and returns, the shards are written and the
+  // manifest is published in background. Must be called by all ranks with the same variables.
+  Maybe<void> AsyncSave(const std::string& path, const std::vector<std::string>& variable_names,
+                        const std::vector<std::shared_ptr<one::Tensor>>& variable_tensors);
+  // Blocks until the last save has been published. Returns the failure to write or publish it,
+  // which the next AsyncSave or Load returns otherwise. All the ranks fail if any of them fails.
+  Maybe<void> WaitUntilSaved();
+  // Loads variables saved with any number of ranks and any sbp, each rank only reads the parts of
+  // the shards which overlap its own slices of the variables.
+  Maybe<void> Load(const std::string& path, const std::vector<std::string>& variable_names,
+                   const std::vector<std::shared_ptr<one::Tensor>>& variable_tensors);
+
+  static bool IsCheckpoint(const std::string& path);
+
+ private:
+  friend class Singleton<CheckpointEngine>;
+  CheckpointEngine();
+
+  std::unique_ptr<ThreadPool> io_thread_pool_;
+  std::thread publish_thread_;
+  // the failure of the last save, set by the publish thread
+  std::shared_ptr<ErrorProto> save_error_;
+  int64_t save_cnt_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_FRAMEWORK_CHECKPOINT_ENGINE_H_
@@ -38,6 +38,7 @@ limitations under the License.
 #include "oneflow/core/job/collective_boxing/scheduler.h"
 #include "oneflow/core/graph/task_stream_index_manager.h"
 #include "oneflow/core/framework/variable_tensor_mgr.h"
+#include "oneflow/core/framework/checkpoint_engine.h"
 #ifdef WITH_CUDA
 #include <cuda.h>
 #endif  // WITH_CUDA
@@ -110,6 +111,7 @@ Maybe<void> MultiClientSessionContext::TryInit(const ConfigProto& config_proto)
       Singleton<summary::EventsWriter>::New();
       Singleton<boxing::collective::Scheduler>::New();
       Singleton<VariableTensorMgr>::New();
+      Singleton<CheckpointEngine>::New();
     }
 
     is_inited_ = true;
@@ -144,6 +146,8 @@ Maybe<void> MultiClientSessionContext::TryClose() {
     VLOG(1) << "Try to delete multi client session context." << std::endl;
     {
       // NOTE(chengcheng): delete runtime global objects
+      // the checkpoint engine waits for the save in flight, which may still read the variables
+      Singleton<CheckpointEngine>::Delete();
       Singleton<boxing::collective::Scheduler>::Delete();
       Singleton<summary::EventsWriter>::Delete();
       Singleton<RuntimeJobDescs>::Delete();
@@ -19,9 +19,11 @@ limitations under the License.
 #include "oneflow/core/common/scalar.h"
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/common/container_util.h"
+#include "oneflow/core/control/chunked_kv.h"
 #include "oneflow/core/control/ctrl_client.h"
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/eager/eager_blob_object.h"
+#include "oneflow/core/framework/checkpoint_engine.h"
 #include "oneflow/core/framework/instructions_builder.h"
 #include "oneflow/core/framework/nd_sbp.h"
 #include "oneflow/core/framework/tensor_name_scope.h"
@@ -69,6 +71,43 @@ Maybe<std::string> GetTensorMetaString(const std::shared_ptr<one::Tensor>& tenso
   return ret;
 }
 
+// NOTE: all ranks must agree on this. Task and register ids come from per-session counters, so
+//   turning it on after graphs were compiled on the master only makes the ranks disagree, which
+//   CheckPlanFingerprintBetweenRanks reports.
+bool IsDistributedPlanCompileEnabled() {
+  return GlobalProcessCtx::WorldSize() > 1
+         && ParseBooleanFromEnv("ONEFLOW_LAZY_DISTRIBUTED_PLAN_COMPILE", false);
+}
+
+// Ranks that compile their part of the plan on their own only exchange a fingerprint of the task
+// and register ids they use to talk to each other, instead of the master pushing the whole plan.
+// The ranks count the mismatches together, so they all fail instead of the matching ones waiting
+// for the failed ones in the runtime.
+Maybe<void> CheckPlanFingerprintBetweenRanks(const std::string& plan_name,
+                                             size_t cross_rank_fingerprint) {
+  CtrlClient* ctrl_client = Singleton<CtrlClient>::Get();
+  const std::string fingerprint_key = plan_name + "_fingerprint";
+  const std::string fingerprint = std::to_string(cross_rank_fingerprint);
+  std::string master_fingerprint = fingerprint;
+  ctrl_client->BroadcastKV(fingerprint_key, &master_fingerprint);
+  const bool matched = fingerprint == master_fingerprint;
+  const std::string mismatch_key = fingerprint_key + "_mismatch";
+  ctrl_client->IncreaseCount(mismatch_key, matched ? 0 : 1);
+  ctrl_client->Barrier(mismatch_key, GlobalProcessCtx::WorldSize());
+  const int32_t mismatch_num = ctrl_client->IncreaseCount(mismatch_key, 0);
+  ctrl_client->Barrier(mismatch_key + "_read", GlobalProcessCtx::WorldSize());
+  if (GlobalProcessCtx::IsThisProcessMaster()) { ctrl_client->EraseCount(mismatch_key); }
+  CHECK_OR_RETURN(matched)
+      << Error::RuntimeError() << "The plan compiled on rank " << GlobalProcessCtx::Rank()
+      << " differs from the one compiled on the master rank. Unset "
+         "ONEFLOW_LAZY_DISTRIBUTED_PLAN_COMPILE to compile the plan on the master rank only.";
+  CHECK_EQ_OR_RETURN(mismatch_num, 0)
+      << Error::RuntimeError() << "The plans compiled on " << mismatch_num
+      << " rank(s) differ from the one compiled on the master rank. Unset "
+         "ONEFLOW_LAZY_DISTRIBUTED_PLAN_COMPILE to compile the plan on the master rank only.";
+  return Maybe<void>::Ok();
+}
+
 }  // namespace
 
 NNGraph::~NNGraph() {
@@ -98,6 +137,10 @@ const std::vector<bool>& NNGraph::inputs_valid() const { return input_tensors_va
 
 const std::vector<bool>& NNGraph::outputs_valid() const { return output_tensors_valid_; }
 
+bool NNGraph::may_run_concurrently() const {
+  return !writes_variables() && GlobalProcessCtx::WorldSize() == 1;
+}
+
 const std::vector<std::string>& NNGraph::inputs_tensor_meta_str() const {
   return inputs_tensor_meta_str_;
 }
@@ -209,6 +252,38 @@ Maybe<std::vector<std::shared_ptr<one::Tensor>>> NNGraph::GetAdditionalVarOpTens
   return tensors;
 }
 
+Maybe<void> NNGraph::GetSortedVariableOpNamesAndTensors(
+    std::vector<std::string>* variable_op_names,
+    std::vector<std::shared_ptr<one::Tensor>>* variable_tensors) const {
+  CHECK_OR_RETURN(runtime_inited_)
+      << Error::RuntimeError() << "nn.Graph " << name_
+      << " must be compiled before its variables are saved or loaded";
+  std::map<std::string, std::shared_ptr<one::Tensor>> sorted_name2tensor;
+  for (const auto& pair : variable_op_name2tensor_) {
+    CHECK_NOTNULL_OR_RETURN(pair.second) << pair.first << " not found.";
+    sorted_name2tensor.emplace(pair.first, pair.second);
+  }
+  for (const auto& pair : sorted_name2tensor) {
+    variable_op_names->emplace_back(pair.first);
+    variable_tensors->emplace_back(pair.second);
+  }
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> NNGraph::AsyncSaveVariables(const std::string& path) const {
+  std::vector<std::string> variable_op_names;
+  std::vector<std::shared_ptr<one::Tensor>> variable_tensors;
+  JUST(GetSortedVariableOpNamesAndTensors(&variable_op_names, &variable_tensors));
+  return Singleton<CheckpointEngine>::Get()->AsyncSave(path, variable_op_names, variable_tensors);
+}
+
+Maybe<void> NNGraph::LoadVariables(const std::string& path) const {
+  std::vector<std::string> variable_op_names;
+  std::vector<std::shared_ptr<one::Tensor>> variable_tensors;
+  JUST(GetSortedVariableOpNamesAndTensors(&variable_op_names, &variable_tensors));
+  return Singleton<CheckpointEngine>::Get()->Load(path, variable_op_names, variable_tensors);
+}
+
 Maybe<void> NNGraph::RegisterNewVariableOpInJobPass() {
   OpGraph op_graph(job_);
   JUST(op_graph.MaybeForEachNode([&](OpNode* op_node) -> Maybe<void> {
@@ -277,45 +352,61 @@ Maybe<void> NNGraph::CompileAndInitRuntime() {
   auto scope = std::make_unique<GlobalJobDescScope>(job_.job_conf(), job_id_);
 
   // NOTE(chengcheng): do job compeleter for each rank.
+  CompileStageTimer timer("Graph " + name_);
   JUST(JobCompleter().Complete(&job_));
+  timer.Tick("job completer");
 
-  if (GlobalProcessCtx::IsThisProcessMaster()) {
-    double start = GetCurTime();
+  // NOTE: with distributed plan compile, every rank compiles only its own tasks and memory, so
+  //   the plan is not sent over the control plane.
+  const bool distributed_plan_compile = IsDistributedPlanCompileEnabled();
+  size_t cross_rank_fingerprint = 0;
+  if (GlobalProcessCtx::IsThisProcessMaster() || distributed_plan_compile) {
     // TODO(chengcheng): new memory reused by chunk
-    Compiler().Compile(&job_, &plan_);
+    if (distributed_plan_compile) {
+      cross_rank_fingerprint = Compiler().CompileForRank(&job_, &plan_, GlobalProcessCtx::Rank());
+    } else {
+      Compiler().Compile(&job_, &plan_);
+    }
+    timer.Tick("compile");
     PlanUtil::GenMemBlockAndChunkWithVariableOpNames4Plan(&plan_, variable_op_names_);
-
-    VLOG(1) << "Graph name: " << name_ << " compile time: " << (GetCurTime() - start) / 1000000000.0
-            << " seconds.";
-    if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
-      TeePersistentLogStream::Create("job_" + name_ + "_plan")->Write(plan_);
+    timer.Tick("mem block and chunk");
+
+    const bool dump_plan = Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()
+                           && GlobalProcessCtx::IsThisProcessMaster();
+    if (dump_plan) {
+      // a large plan is written on the thread of the stream, and appears only once complete
+      PersistentOutStreamConf conf;
+      conf.atomic = true;
+      TeePersistentLogStream::Create("job_" + name_ + "_plan", conf)->Write(plan_);
       PlanUtil::ToDotFile(plan_, "job_" + name_ + "_plan.dot");
     }
     PlanUtil::GenRegisterHint(&plan_);
+    timer.Tick("register hint");
     // TODO(chengcheng): test collective boxing for multi-job.
     PlanUtil::GenCollectiveBoxingPlan(&job_, &plan_);
+    timer.Tick("collective boxing plan");
     // PlanUtil::SetForceInplaceMemBlock(&plan_); NOTE(chengcheng): only for ssp.
     PlanUtil::DumpCtrlRegstInfoToPlan(&plan_);
-    PlanUtil::PlanMemoryLog(&plan_, name_);
-    if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()) {
-      PlanUtil::GenLightPlan(&plan_, name_);
+    // NOTE: drops the tasks of other ranks that the register hints and ctrl regst info needed.
+    if (distributed_plan_compile) {
+      PlanUtil::FilterPlanForRank(&plan_, GlobalProcessCtx::Rank());
     }
+    PlanUtil::PlanMemoryLog(&plan_, name_);
+    if (dump_plan) { PlanUtil::GenLightPlan(&plan_, name_); }
+    timer.Tick("plan post process");
   }
-  if (GlobalProcessCtx::WorldSize() > 1) {
-    std::string plan_name = "plan:" + job_name();
-    if (GlobalProcessCtx::IsThisProcessMaster()) {
-      // TODO(chengcheng): split plan for each rank.
-      Singleton<CtrlClient>::Get()->PushKV(plan_name, plan_);
-    } else {
-      Singleton<CtrlClient>::Get()->PullKV(plan_name, &plan_);
-    }
-    OF_SESSION_BARRIER();
-    // NOTE(zwx): After barrier plan is synchronized between all ranks,
-    //     then it can be cleared for saving mem.
-    if (GlobalProcessCtx::IsThisProcessMaster()) {
-      Singleton<CtrlClient>::Get()->ClearKV(plan_name);
-    }
+  if (distributed_plan_compile) {
+    JUST(CheckPlanFingerprintBetweenRanks("plan:" + job_name(), cross_rank_fingerprint));
+    timer.Tick("plan sync");
+  } else if (GlobalProcessCtx::WorldSize() > 1) {
+    // TODO(chengcheng): split plan for each rank.
+    // NOTE: the plan is relayed down a tree of ranks as lz4 compressed chunks and each rank clears
+    //   its own copy, so no rank holds the whole serialized plan and the master neither serves
+    //   every rank nor needs a barrier before clearing it.
+    BroadcastChunkedKV("plan:" + job_name(), &plan_);
+    timer.Tick("plan sync");
   }
+  LOG(INFO) << timer.ToString();
   // NOTE(chengcheng): recovery op_attr
   PlanUtil::PopulateOpAttribute(&plan_, plan_.job_id2op_attribute_ref_table());
 
@@ -50,6 +50,8 @@ class NNGraph final : public NNGraphIf {
   const std::vector<std::string>& outputs_op_names() const override;
   const std::vector<bool>& inputs_valid() const override;
   const std::vector<bool>& outputs_valid() const override;
+  bool writes_variables() const override { return job_.job_conf().has_train_conf(); }
+  bool may_run_concurrently() const override;
   const std::vector<std::string>& inputs_tensor_meta_str() const;
   const std::vector<std::string>& outputs_tensor_meta_str() const;
   int64_t variable_op_size() const;
@@ -73,12 +75,20 @@ class NNGraph final : public NNGraphIf {
   Maybe<std::vector<std::shared_ptr<one::Tensor>>> GetAdditionalVarOpTensors() const;
   Maybe<void> CompileAndInitRuntime();
   Maybe<void> Close();
+  // Saves the variables to a sharded checkpoint in background and loads them back, the graph must
+  // have been compiled. See CheckpointEngine.
+  Maybe<void> AsyncSaveVariables(const std::string& path) const;
+  Maybe<void> LoadVariables(const std::string& path) const;
 
  private:
   Maybe<void> RegisterFreeEagerTensorsToVariableOpNames();
   Maybe<void> RegisterNewVariableOpInJobPass();
   Maybe<void> DeleteOutdatedVariableInVariableTensorMgr();
   Maybe<void> GetVariableRealBlobAfterSyncPlan();
+  // in the order of names, so that all ranks agree on the variables of a checkpoint
+  Maybe<void> GetSortedVariableOpNamesAndTensors(
+      std::vector<std::string>* variable_op_names,
+      std::vector<std::shared_ptr<one::Tensor>>* variable_tensors) const;
 
   void NewRuntimeBuffers();
   void CloseRuntimeBuffers();
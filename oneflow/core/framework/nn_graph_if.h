@@ -34,6 +34,11 @@ class NNGraphIf {
   virtual const std::vector<std::string>& outputs_op_names() const = 0;
   virtual const std::vector<bool>& inputs_valid() const = 0;
   virtual const std::vector<bool>& outputs_valid() const = 0;
+  // Whether a run of the job may update its variables, e.g. by an optimizer.
+  virtual bool writes_variables() const = 0;
+  // Whether runs of the job may overlap with runs of other jobs. Such a job only reads its
+  // variables and does no communication between ranks, whose order must agree on every rank.
+  virtual bool may_run_concurrently() const = 0;
 
  protected:
   NNGraphIf() = default;
@@ -26,6 +26,7 @@ bool TensorArg::Empty() const { return !acc_tensor_; }
 void TensorArg::Release() { acc_tensor_.reset(); }
 
 Maybe<void> TensorArg::PushPartialTensor(const std::shared_ptr<Tensor>& partial_tensor) {
+  std::unique_lock<std::mutex> lock(mutex_);
   if (!acc_tensor_) {
     acc_tensor_ = partial_tensor;
   } else {
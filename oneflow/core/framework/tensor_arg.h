@@ -18,6 +18,7 @@ limitations under the License.
 #define ONEFLOW_CORE_FRAMEWORK_TENSOR_ARG_H_
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/autograd/autograd_meta.h"
@@ -42,6 +43,8 @@ class TensorArg final {
 
  private:
   std::shared_ptr<Tensor> acc_tensor_;
+  // Guards partial grads pushed by FunctionNodes running on different threads
+  std::mutex mutex_;
 };
 
 }  // namespace one
@@ -86,6 +86,11 @@ OpRegistry& OpRegistry::NoGrad() {
   return *this;
 }
 
+OpRegistry& OpRegistry::Random() {
+  result_.random = true;
+  return *this;
+}
+
 OpRegistry& OpRegistry::SetOutputBufferNum(int32_t num) {
   result_.same_output_regst_num = num;
   return *this;
@@ -64,6 +64,7 @@ struct OpRegistryResult {
       : cpu_only_supported(false),
         no_grad(false),
         non_contiguous_supported(false),
+        random(false),
         same_output_regst_num(-1) {}
   ~OpRegistryResult() = default;
 
@@ -71,6 +72,7 @@ struct OpRegistryResult {
   bool cpu_only_supported;
   bool no_grad;
   bool non_contiguous_supported;
+  bool random;
   int32_t same_output_regst_num;
   UserOpDef op_def;
   CheckAttrFn check_fn;
@@ -109,6 +111,7 @@ class OpRegistry final {
   OpRegistry& SupportCpuOnly();
   OpRegistry& SupportNonContiguous();
   OpRegistry& NoGrad();
+  OpRegistry& Random();
   OpRegistry& SetOutputBufferNum(int32_t num);
 
   __attribute__((deprecated)) OpRegistry& Attr(const std::string& name, AttrType type);
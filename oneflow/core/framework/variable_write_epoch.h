@@ -0,0 +1,34 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_FRAMEWORK_VARIABLE_WRITE_EPOCH_H_
+#define ONEFLOW_CORE_FRAMEWORK_VARIABLE_WRITE_EPOCH_H_
+
+#include <cstdint>
+
+namespace oneflow {
+
+// Variables of a lazy job share memory with eager tensors and can be overwritten from outside the
+// job, by eager ops like load_state_dict or by a training job sharing them. Each such write
+// increases the epoch, so kernels caching data derived from a variable, e.g. a packed weight,
+// rebuild it once the epoch differs from the one they built it at.
+struct VariableWriteEpoch {
+  static uint64_t Get();
+  static void Increase();
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_FRAMEWORK_VARIABLE_WRITE_EPOCH_H_
@@ -40,7 +40,7 @@ void BoxingZerosTaskNode::ConsumeAllRegsts() {
 void BoxingZerosTaskNode::BuildExecGphAndRegst() {
   ExecNode* node = mut_exec_gph().NewNode();
   OperatorConf op_conf;
-  op_conf.set_name("System-Boxing-Zeros-" + NewUniqueId());
+  op_conf.set_name("System-Boxing-Zeros-" + std::to_string(task_id()));
   op_conf.set_device_tag(*CHECK_JUST(DeviceTag4DeviceType(this->device_type())));
   *op_conf.mutable_boxing_zeros_conf()->mutable_lbi() = lbi();
   shape_.ToProto(op_conf.mutable_boxing_zeros_conf()->mutable_shape());
@@ -45,7 +45,7 @@ void CollectiveBoxingPackTaskNode::ConsumeAllRegsts() {
 void CollectiveBoxingPackTaskNode::BuildExecGphAndRegst() {
   ExecNode* node = mut_exec_gph().NewNode();
   OperatorConf op_conf;
-  op_conf.set_name("System-Collective-Boxing-Pack-" + NewUniqueId());
+  op_conf.set_name("System-Collective-Boxing-Pack-" + std::to_string(task_id()));
   op_conf.set_device_tag(*CHECK_JUST(DeviceTag4DeviceType(this->device_type())));
   auto* collective_boxing_pack_conf = op_conf.mutable_collective_boxing_pack_conf();
   *collective_boxing_pack_conf->mutable_lbi() = lbi();
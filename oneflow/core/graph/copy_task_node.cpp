@@ -66,7 +66,7 @@ void CopyHdTaskNode::InitProducedRegstMemCase(MemoryCase* mem_case) {
 
 OperatorConf CopyHdTaskNode::NewCopyOpConf() {
   OperatorConf conf;
-  conf.set_name("copy_hd_" + NewUniqueId());
+  conf.set_name("copy_hd_" + std::to_string(task_id()));
   conf.set_device_tag(*CHECK_JUST(DeviceTag4DeviceType(device_type())));
   conf.mutable_copy_hd_conf()->set_type(copy_type_);
   auto in_regst = GetSoleConsumedRegst("copy_in");
@@ -87,7 +87,7 @@ void CopyCommNetTaskNode::Init(int64_t machine_id, const LogicalBlobId& lbi) {
 
 OperatorConf CopyCommNetTaskNode::NewCopyOpConf() {
   OperatorConf conf;
-  conf.set_name("copy_comm_net_" + NewUniqueId());
+  conf.set_name("copy_comm_net_" + std::to_string(task_id()));
   conf.set_device_tag(*CHECK_JUST(DeviceTag4DeviceType(this->device_type())));
   *(conf.mutable_copy_comm_net_conf()->mutable_lbi()) = lbi();
   return conf;
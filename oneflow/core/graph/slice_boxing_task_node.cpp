@@ -95,11 +95,11 @@ OperatorConf SliceBoxingTaskNode::GetBoxingOpConf() {
     in_data_edge2slice_.at(edge).ToProto(boxing_conf.mutable_in_slice()->Add());
   }
   if (mode_ == kSliceBoxingTaskModeCopy) {
-    op_conf.set_name("System-Boxing-BoxingCopy-" + NewUniqueId());
+    op_conf.set_name("System-Boxing-BoxingCopy-" + std::to_string(task_id()));
     SliceBoxingCopyOpConf* conf = op_conf.mutable_slice_boxing_copy_conf();
     *conf->mutable_slice_boxing_conf() = boxing_conf;
   } else if (mode_ == kSliceBoxingTaskModeAdd) {
-    op_conf.set_name("System-Boxing-BoxingAdd-" + NewUniqueId());
+    op_conf.set_name("System-Boxing-BoxingAdd-" + std::to_string(task_id()));
     SliceBoxingAddOpConf* conf = op_conf.mutable_slice_boxing_add_conf();
     *conf->mutable_slice_boxing_conf() = boxing_conf;
   } else {
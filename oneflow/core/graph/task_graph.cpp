@@ -31,6 +31,8 @@ limitations under the License.
 #include "oneflow/core/graph/task_stream_index_manager.h"
 #include "oneflow/core/ep/include/primitive/memcpy.h"
 #include "oneflow/core/graph/straighten_nodes.h"
+#include "oneflow/core/thread/thread_pool.h"
+#include "oneflow/core/common/blocking_counter.h"
 
 namespace oneflow {
 
@@ -462,6 +464,41 @@ TaskGraph::TaskGraph(bool enable_straighten_algorithm) {
 
 TaskGraph::~TaskGraph() = default;
 
+void TaskGraph::ParallelTopoForEachNode(ThreadPool* thread_pool,
+                                        const std::function<void(TaskNode*)>& Handler) const {
+  if (thread_pool == nullptr || node_num() <= 1) {
+    TopoForEachNode(Handler);
+    return;
+  }
+  std::vector<TaskNode*> nodes;
+  HashMap<const TaskNode*, int64_t> node2index;
+  ForEachNode([&](TaskNode* node) {
+    CHECK(node2index.emplace(node, nodes.size()).second);
+    nodes.emplace_back(node);
+  });
+  std::vector<std::atomic<int64_t>> in_edge_cnts(nodes.size());
+  FOR_RANGE(int64_t, i, 0, nodes.size()) {
+    in_edge_cnts.at(i).store(nodes.at(i)->in_edges().size(), std::memory_order_relaxed);
+  }
+  BlockingCounter counter(nodes.size());
+  std::function<void(TaskNode*)> Schedule;
+  Schedule = [&](TaskNode* node) {
+    thread_pool->AddWork([&, node]() {
+      Handler(node);
+      for (TaskEdge* edge : node->out_edges()) {
+        // NOTE: acq_rel so that the last in-node to finish publishes all in-node writes.
+        std::atomic<int64_t>* cnt = &in_edge_cnts.at(node2index.at(edge->dst_node()));
+        if (cnt->fetch_sub(1, std::memory_order_acq_rel) == 1) { Schedule(edge->dst_node()); }
+      }
+      counter.Decrease();
+    });
+  };
+  for (TaskNode* node : nodes) {
+    if (node->in_edges().empty()) { Schedule(node); }
+  }
+  counter.WaitForeverUntilCntEqualZero();
+}
+
 TaskEdge* TaskGraph::NewTaskEdgeWithLbi(const LogicalBlobId& lbi) {
   TaskEdge* edge = NewEdge();
   edge->AddLbi(lbi);
@@ -28,6 +28,8 @@ limitations under the License.
 
 namespace oneflow {
 
+class ThreadPool;
+
 class SubTskGphBuilderCtx;
 class HierarchicalSubTskGphBuilder;
 
@@ -46,6 +48,11 @@ class TaskGraph final : public Graph<TaskNode, TaskEdge> {
   explicit TaskGraph(bool enable_straighten_algorithm);
 
   const char* TypeName() const override { return "TaskGraph"; }
+  // Visits nodes in the same order constraint as TopoForEachNode but runs Handler on the threads
+  // of thread_pool, or serially when it is nullptr. Handler may only modify the visited node and
+  // read its in-nodes.
+  void ParallelTopoForEachNode(ThreadPool* thread_pool,
+                               const std::function<void(TaskNode*)>& Handler) const;
   void RemoveEmptyRegsts();
   void MergeChainAndAddOrderingCtrlEdgeInSameChain();
 
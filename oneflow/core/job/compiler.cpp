@@ -22,6 +22,7 @@ limitations under the License.
 #include "oneflow/core/job_rewriter/job_completer.h"
 #include "oneflow/core/thread/thread_pool.h"
 #include "oneflow/core/common/blocking_counter.h"
+#include "oneflow/core/common/balanced_splitter.h"
 
 namespace oneflow {
 
@@ -45,8 +46,135 @@ void CreateOpAttributeRef(Plan* plan, int64_t job_id, TaskProto* task_proto) {
   kernel_conf->set_allocated_op_attribute(nullptr);
 }
 
-void Compiler::Compile(Job* job, Plan* plan) const {
+int64_t LazyCompileThreadNum() {
+  static const int64_t thread_num = ParseIntegerFromEnv(
+      "ONEFLOW_LAZY_COMPILE_THREAD_NUM", static_cast<int64_t>(std::thread::hardware_concurrency()));
+  return std::max<int64_t>(thread_num, 1);
+}
+
+ThreadPool* LazyCompileThreadPool() {
+  static const std::unique_ptr<ThreadPool> thread_pool(
+      LazyCompileThreadNum() > 1 ? new ThreadPool(LazyCompileThreadNum()) : nullptr);
+  return thread_pool.get();
+}
+
+void LazyCompileParallelFor(int64_t num, const std::function<void(int64_t i)>& Handler) {
+  ThreadPool* thread_pool = LazyCompileThreadPool();
+  const int64_t range_num =
+      thread_pool == nullptr ? 1 : std::min<int64_t>(num, thread_pool->thread_num());
+  if (range_num <= 1) {
+    FOR_RANGE(int64_t, i, 0, num) { Handler(i); }
+    return;
+  }
+  BalancedSplitter bs(num, range_num);
+  BlockingCounter counter(range_num);
+  FOR_RANGE(int64_t, range_id, 0, range_num) {
+    thread_pool->AddWork([&, range_id]() {
+      const Range range = bs.At(range_id);
+      FOR_RANGE(int64_t, i, range.begin(), range.end()) { Handler(i); }
+      counter.Decrease();
+    });
+  }
+  counter.WaitForeverUntilCntEqualZero();
+}
+
+CompileStageTimer::CompileStageTimer(const std::string& name)
+    : name_(name), start_time_(GetCurTime()), last_tick_time_(start_time_) {}
+
+void CompileStageTimer::Tick(const std::string& stage) {
+  const double now = GetCurTime();
+  stage_seconds_.emplace_back(stage, (now - last_tick_time_) / 1e9);
+  last_tick_time_ = now;
+}
+
+std::string CompileStageTimer::ToString() const {
+  std::ostringstream ss;
+  ss << name_ << " compile time breakdown:";
+  for (const auto& pair : stage_seconds_) {
+    ss << " [" << pair.first << ": " << pair.second << "s]";
+  }
+  ss << " total: " << (last_tick_time_ - start_time_) / 1e9 << " seconds.";
+  return ss.str();
+}
+
+namespace {
+
+// Hash of all task ids and of the registers on the edges between ranks. Only these have to agree
+// between ranks that compile their own part of the plan, the other ids stay within a rank.
+size_t GenCrossRankFingerprint(const TaskGraph& task_gph) {
+  std::vector<std::pair<int64_t, size_t>> task_id7hashes;
+  task_gph.ForEachNode([&](TaskNode* node) {
+    size_t hash = Hash(node->task_id(), node->machine_id(), node->thrd_id(),
+                       static_cast<int64_t>(node->GetTaskType()));
+    for (TaskEdge* edge : node->out_edges()) {
+      if (edge->dst_node()->machine_id() == node->machine_id()) { continue; }
+      AddHash(&hash, edge->dst_node()->task_id());
+      std::vector<int64_t> regst_desc_ids;
+      for (const auto& regst : edge->GetRegsts()) {
+        regst_desc_ids.emplace_back(regst->regst_desc_id());
+      }
+      std::sort(regst_desc_ids.begin(), regst_desc_ids.end());
+      for (int64_t regst_desc_id : regst_desc_ids) { AddHash(&hash, regst_desc_id); }
+    }
+    task_id7hashes.emplace_back(node->task_id(), hash);
+  });
+  std::sort(task_id7hashes.begin(), task_id7hashes.end());
+  size_t hash = std::hash<size_t>()(task_id7hashes.size());
+  for (const auto& pair : task_id7hashes) { HashCombine(&hash, pair.second); }
+  return hash;
+}
+
+// The tasks of rank and all tasks they transitively consume from.
+HashSet<const TaskNode*> GetTaskNodesToBuild(const TaskGraph& task_gph, int64_t rank) {
+  HashSet<const TaskNode*> nodes;
+  std::vector<const TaskNode*> stack;
+  task_gph.ForEachNode([&](TaskNode* node) {
+    if (node->machine_id() == rank && nodes.insert(node).second) { stack.emplace_back(node); }
+  });
+  while (!stack.empty()) {
+    const TaskNode* node = stack.back();
+    stack.pop_back();
+    for (const TaskEdge* edge : node->in_edges()) {
+      if (nodes.insert(edge->src_node()).second) { stack.emplace_back(edge->src_node()); }
+    }
+  }
+  return nodes;
+}
+
+// Drops the registers of a task of another rank that no task of rank consumes, so that they are
+// neither planned nor reused in the memory of rank.
+void KeepRegstsConsumedOnRank(const TaskNode& node, int64_t rank, TaskProto* task_proto) {
+  for (const auto& pair : node.produced_regsts()) {
+    const auto& consumers = pair.second->consumers();
+    const bool consumed_on_rank =
+        std::any_of(consumers.cbegin(), consumers.cend(),
+                    [rank](const TaskNode* consumer) { return consumer->machine_id() == rank; });
+    if (!consumed_on_rank) { task_proto->mutable_produced_regst_desc()->erase(pair.first); }
+  }
+}
+
+bool HasCollectiveBoxingTask(const TaskGraph& task_gph) {
+  bool has_collective_boxing_task = false;
+  task_gph.ForEachNode([&](TaskNode* node) {
+    if (node->GetTaskType() == TaskType::kCollectiveBoxingGeneric) {
+      has_collective_boxing_task = true;
+    }
+  });
+  return has_collective_boxing_task;
+}
+
+}  // namespace
+
+void Compiler::Compile(Job* job, Plan* plan) const { DoCompile(job, plan, kAllRanks); }
+
+size_t Compiler::CompileForRank(Job* job, Plan* plan, int64_t rank) const {
+  CHECK_GE(rank, 0);
+  return DoCompile(job, plan, rank);
+}
+
+size_t Compiler::DoCompile(Job* job, Plan* plan, int64_t rank) const {
   // Step1: new Singleton<OpGraph> and set log configs.
+  CompileStageTimer timer("Job " + job->job_conf().job_name());
   Singleton<OpGraph>::New(*job);
   const JobDesc& job_desc = GlobalJobDesc();
   if (Singleton<ResourceDesc, ForSession>::Get()->enable_debug_mode()
@@ -55,50 +183,94 @@ void Compiler::Compile(Job* job, Plan* plan) const {
     Singleton<OpGraph>::Get()->ToDotWithFilePath(
         "optimized_dlnet_" + std::to_string(job_desc.job_id()) + "_op_graph.dot");
   }
+  timer.Tick("op graph");
 
   // Step2: build task_gph.
+  // NOTE: task nodes and sub task graphs are created serially since the task, regst and mem
+  //   block ids depend on creation order, and all ranks must get the same ids. The passes that
+  //   only fill in existing nodes run on LazyCompileThreadNum() threads.
   // TODO(levi): we can rewrite this part of code in visitor pattern.
+  ThreadPool* thread_pool = LazyCompileThreadPool();
   auto task_gph =
       std::make_unique<TaskGraph>(job->job_conf().enable_straighten_algorithm_in_task_graph());
+  timer.Tick("task graph");
   using std::placeholders::_1;
   task_gph->ForEachNode(std::bind(&TaskNode::ProduceAllRegstsAndBindEdges, _1));
   task_gph->ForEachNode(std::bind(&TaskNode::ConsumeAllRegsts, _1));
   task_gph->ForEachNode(std::bind(&TaskNode::PinConsumedRegst, _1));
-  task_gph->TopoForEachNode(&TaskNode::Build);
+  timer.Tick("produce and consume regsts");
+  // NOTE: the nodes and registers of all ranks are created above, so that the ids used between
+  //   ranks are the same on every rank. Only the tasks of rank and the ones they consume from are
+  //   built from here on. The collective boxing plan orders the requests of all ranks together,
+  //   so jobs with collective boxing tasks are compiled for all ranks.
+  const size_t cross_rank_fingerprint = GenCrossRankFingerprint(*task_gph);
+  if (rank != kAllRanks && HasCollectiveBoxingTask(*task_gph)) {
+    LOG(INFO) << "Job " << job->job_conf().job_name()
+              << " has collective boxing tasks, compiling the tasks of all ranks.";
+    rank = kAllRanks;
+  }
+  HashSet<const TaskNode*> nodes_to_build;
+  if (rank != kAllRanks) { nodes_to_build = GetTaskNodesToBuild(*task_gph, rank); }
+  auto IsNodeToBuild = [&](const TaskNode* node) {
+    return rank == kAllRanks || nodes_to_build.count(node) > 0;
+  };
+  task_gph->ParallelTopoForEachNode(thread_pool, [&](TaskNode* node) {
+    if (IsNodeToBuild(node)) { node->Build(); }
+  });
+  timer.Tick("build exec graph");
   task_gph->RemoveEmptyRegsts();
   task_gph->MergeChainAndAddOrderingCtrlEdgeInSameChain();
+  timer.Tick("merge chain");
   auto IsReachable = Singleton<OpGraph>::Get()->MakePredicatorIsOpNameDataOrCtrlReachable();
   if (job_desc.enable_inplace()) { task_gph->EnableInplaceMemSharing(IsReachable); }
-  task_gph->TopoForEachNode(&TaskNode::InferTimeShapeIfMeaningful);
-  task_gph->ForEachEdge([&](TaskEdge* task_edge) { task_edge->CheckRegstLbiValid(); });
+  timer.Tick("inplace");
+  task_gph->ParallelTopoForEachNode(thread_pool, [&](TaskNode* node) {
+    if (IsNodeToBuild(node)) { node->InferTimeShapeIfMeaningful(); }
+  });
+  std::vector<TaskEdge*> task_edges;
+  task_gph->ForEachEdge([&](TaskEdge* task_edge) {
+    if (IsNodeToBuild(task_edge->src_node())) { task_edges.emplace_back(task_edge); }
+  });
+  LazyCompileParallelFor(task_edges.size(),
+                         [&](int64_t i) { task_edges.at(i)->CheckRegstLbiValid(); });
+  timer.Tick("infer time shape");
 
   // Step3: put infomation from task_gph into plan.
-  const int64_t node_num = task_gph->node_num();
-  const int64_t cpu_num = std::thread::hardware_concurrency();
-  const int64_t thread_pool_size = std::min(node_num, cpu_num);
-  BlockingCounter counter(node_num);
-  std::mutex mtx;
-  ThreadPool thread_pool(thread_pool_size);
+  // NOTE: tasks are appended in node order rather than in completion order, so the same job
+  //   always yields the same plan. A rank also keeps the tasks of other ranks it consumes from
+  //   directly, since the register hints and the ctrl regst info need their registers.
+  auto IsNodeInPlan = [&](const TaskNode* node) {
+    if (rank == kAllRanks || node->machine_id() == rank) { return true; }
+    for (const TaskEdge* edge : node->out_edges()) {
+      if (edge->dst_node()->machine_id() == rank) { return true; }
+    }
+    return false;
+  };
+  std::vector<TaskNode*> task_nodes;
   task_gph->ForEachNode([&](TaskNode* task_node) {
-    thread_pool.AddWork([task_node, plan, &job_desc, &counter, &mtx]() {
-      if (!task_node->IsMeaningLess()) {
-        TaskProto task_proto;
-        task_node->ToProto(&task_proto);
-        {
-          std::unique_lock<std::mutex> guard(mtx);
-          if (task_node->GetTaskType() == kNormalForward || task_node->GetTaskType() == kRepeat
-              || task_node->GetTaskType() == kAcc) {
-            CreateOpAttributeRef(plan, job_desc.job_id(), &task_proto);
-          }
-          plan->mutable_task()->Add(std::move(task_proto));
-        }  // guard(mtx)
-      }
-      counter.Decrease();
-    } /* thread_pool.AddWork */);
-  } /* task_gph->ForEachNode */);
-  counter.WaitForeverUntilCntEqualZero();
+    if (IsNodeInPlan(task_node)) { task_nodes.emplace_back(task_node); }
+  });
+  std::vector<std::unique_ptr<TaskProto>> task_protos(task_nodes.size());
+  LazyCompileParallelFor(task_nodes.size(), [&](int64_t i) {
+    if (task_nodes.at(i)->IsMeaningLess()) { return; }
+    task_protos.at(i).reset(new TaskProto());
+    task_nodes.at(i)->ToProto(task_protos.at(i).get());
+    if (rank != kAllRanks && task_nodes.at(i)->machine_id() != rank) {
+      KeepRegstsConsumedOnRank(*task_nodes.at(i), rank, task_protos.at(i).get());
+    }
+  });
+  FOR_RANGE(int64_t, i, 0, task_nodes.size()) {
+    if (!task_protos.at(i)) { continue; }
+    const TaskType task_type = task_nodes.at(i)->GetTaskType();
+    if (task_type == kNormalForward || task_type == kRepeat || task_type == kAcc) {
+      CreateOpAttributeRef(plan, job_desc.job_id(), task_protos.at(i).get());
+    }
+    plan->mutable_task()->Add(std::move(*task_protos.at(i)));
+    task_protos.at(i).reset();
+  }
   // NOTE(levi): release task_gph here to decrise memory peak.
   task_gph.reset();
+  timer.Tick("task to proto");
 
   // Step4: post-process for plan and delete Singleton<OpGraph>.
   auto* job_id2job_conf = plan->mutable_job_confs()->mutable_job_id2job_conf();
@@ -107,6 +279,9 @@ void Compiler::Compile(Job* job, Plan* plan) const {
   IntraJobMemSharingUtil::InferMemBlockId4MemReusedRegst(plan, IsReachable);
   PlanUtil::SetUniqueMemBlockId4UnreusedMemRegst(plan);
   Singleton<OpGraph>::Delete();
+  timer.Tick("mem reuse");
+  LOG(INFO) << timer.ToString();
+  return cross_rank_fingerprint;
 }
 
 }  // namespace oneflow
@@ -29,7 +29,51 @@ class Compiler final {
   Compiler() = default;
   ~Compiler() = default;
 
+  // Compiles the tasks of all ranks.
   void Compile(Job*, Plan*) const;
+  // Compiles the tasks of `rank`, plus the tasks of other ranks that produce registers for them.
+  // Only the tasks those transitively consume from are built, to infer the blob descs of the
+  // registers that cross ranks. Returns a hash of the task ids and the registers between ranks,
+  // which must be the same on all ranks that compile the same job.
+  size_t CompileForRank(Job*, Plan*, int64_t rank) const;
+
+ private:
+  // Compiles the tasks of all ranks when rank is kAllRanks.
+  size_t DoCompile(Job*, Plan*, int64_t rank) const;
+  static constexpr int64_t kAllRanks = -1;
+};
+
+// Number of threads used by the parallel passes of plan compilation, read from
+// ONEFLOW_LAZY_COMPILE_THREAD_NUM. 1 runs every pass serially.
+int64_t LazyCompileThreadNum();
+
+// The pool of LazyCompileThreadNum() threads shared by all parallel passes of plan compilation,
+// nullptr when they run serially. Work added to it must not wait for other work of the pool.
+ThreadPool* LazyCompileThreadPool();
+
+// Runs Handler(i) for each i in [0, num) on the threads of LazyCompileThreadPool().
+void LazyCompileParallelFor(int64_t num, const std::function<void(int64_t i)>& Handler);
+
+// Wall time of consecutive compile stages, e.g.
+//   CompileStageTimer timer("job_name");
+//   BuildTaskGraph(); timer.Tick("task graph");
+//   GenPlan(); timer.Tick("plan");
+//   LOG(INFO) << timer.ToString();
+class CompileStageTimer final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CompileStageTimer);
+  explicit CompileStageTimer(const std::string& name);
+  ~CompileStageTimer() = default;
+
+  // Ends the stage started by the previous Tick, or by the constructor.
+  void Tick(const std::string& stage);
+  std::string ToString() const;
+
+ private:
+  std::string name_;
+  double start_time_;
+  double last_tick_time_;
+  std::vector<std::pair<std::string, double>> stage_seconds_;
 };
 
 }  // namespace oneflow
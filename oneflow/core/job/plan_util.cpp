@@ -19,6 +19,7 @@ limitations under the License.
 #include "oneflow/core/control/global_process_ctx.h"
 #include "oneflow/core/job/plan_util.h"
 #include "oneflow/core/job/global_for.h"
+#include "oneflow/core/job/compiler.h"
 #include "oneflow/core/graph/plan_task_graph.h"
 #include "oneflow/core/graph/boxing/collective_boxing_util.h"
 #include "oneflow/core/memory/chunk_manager.h"
@@ -209,30 +210,52 @@ void PlanUtil::GenMemBlockAndChunkWithVariableOpNames4Plan(
     return true;
   };
 
-  auto GenMemBlock4RegstIfNeed = [&](RegstDescProto* regst_desc, const TaskProto* task) {
+  struct RegstMemInfo {
+    RegstDescProto* regst_desc;
+    std::string var_name;
+    int64_t main_size;
+    int64_t separated_size;
+  };
+
+  // NOTE: the runtime regst sizes only depend on the regst itself, so they are computed for all
+  //   tasks in parallel. Mem blocks are then merged serially in task order since the separated
+  //   header mem block ids depend on that order.
+  std::vector<std::vector<RegstMemInfo>> task_regst_mem_infos(plan->task_size());
+  LazyCompileParallelFor(plan->task_size(), [&](int64_t i) {
+    TaskProto* task = plan->mutable_task(i);
+    for (auto& pair : *task->mutable_produced_regst_desc()) {
+      RegstDescProto* regst_desc = &pair.second;
+      CHECK_NE(regst_desc->mem_block_id(), -1);
+      CHECK_NE(regst_desc->mem_block_offset(), -1);
+      CHECK_EQ(regst_desc->separated_header_mem_block_id(), -1);
+      RegstMemInfo info;
+      info.regst_desc = regst_desc;
+      if (IsVariableRegst(task, &info.var_name)) {
+        CHECK(!info.var_name.empty());
+        CHECK_EQ(regst_desc->register_num(), 1);
+        CHECK_EQ(regst_desc->min_register_num(), 1);
+        // NOTE(xuxiaoyu): this check cannot pass when open ZeRO
+        // CHECK_EQ(regst_desc->max_register_num(), 1) << var_name;
+        regst_desc->set_variable_op_name(info.var_name);
+      }
+      RtRegstDesc rt_regst_desc(*regst_desc);
+      info.main_size = rt_regst_desc.TotalMainByteSize4AllRegst();
+      info.separated_size = rt_regst_desc.TotalSeparatedHeaderByteSize4AllRegst();
+      task_regst_mem_infos.at(i).emplace_back(std::move(info));
+    }
+  });
+
+  auto GenMemBlock4RegstIfNeed = [&](const RegstMemInfo& info, const TaskProto* task) {
+    RegstDescProto* regst_desc = info.regst_desc;
     const int64_t job_id = task->job_id();
     const int64_t machine_id = task->machine_id();
     const int64_t thrd_id = task->thrd_id();
     int64_t mem_block_id = regst_desc->mem_block_id();
     int64_t mem_block_offset = regst_desc->mem_block_offset();
-    CHECK_NE(mem_block_id, -1);
-    CHECK_NE(mem_block_offset, -1);
-    CHECK_EQ(regst_desc->separated_header_mem_block_id(), -1);
-
-    std::string var_name;
-    bool is_variable_regst = IsVariableRegst(task, &var_name);
-    if (is_variable_regst) {
-      CHECK(!var_name.empty());
-      CHECK_EQ(regst_desc->register_num(), 1);
-      CHECK_EQ(regst_desc->min_register_num(), 1);
-      // NOTE(xuxiaoyu): this check cannot pass when open ZeRO
-      // CHECK_EQ(regst_desc->max_register_num(), 1) << var_name;
-      regst_desc->set_variable_op_name(var_name);
-    }
-
-    RtRegstDesc rt_regst_desc(*regst_desc);
-    int64_t regst_main_size = rt_regst_desc.TotalMainByteSize4AllRegst();
-    int64_t regst_separated_size = rt_regst_desc.TotalSeparatedHeaderByteSize4AllRegst();
+    const std::string& var_name = info.var_name;
+    const bool is_variable_regst = !var_name.empty();
+    const int64_t regst_main_size = info.main_size;
+    const int64_t regst_separated_size = info.separated_size;
 
     if (mem_block_id2mem_block.find(mem_block_id) == mem_block_id2mem_block.end()) {
       MemBlockProto mem_block;
@@ -283,9 +306,9 @@ void PlanUtil::GenMemBlockAndChunkWithVariableOpNames4Plan(
   };
 
   for (int i = 0; i < plan->task_size(); i++) {
-    TaskProto* task = plan->mutable_task(i);
-    for (auto& pair : *task->mutable_produced_regst_desc()) {
-      GenMemBlock4RegstIfNeed(&pair.second, task);
+    const TaskProto* task = &plan->task(i);
+    for (const RegstMemInfo& info : task_regst_mem_infos.at(i)) {
+      GenMemBlock4RegstIfNeed(info, task);
     }
   }
 
@@ -1169,4 +1192,15 @@ void PlanUtil::PopulateOpAttribute(
   return GetStreamId(task).device_id().device_index();
 }
 
+/*static*/ void PlanUtil::FilterPlanForRank(Plan* plan, int64_t rank) {
+  Erase<PbRpf<TaskProto>>(*plan->mutable_task(),
+                          [rank](const TaskProto& task) { return task.machine_id() != rank; });
+  auto* block_chunk_list = plan->mutable_block_chunk_list();
+  Erase<PbRpf<MemBlockProto>>(
+      *block_chunk_list->mutable_mem_block(),
+      [rank](const MemBlockProto& mem_block) { return mem_block.machine_id() != rank; });
+  Erase<PbRpf<ChunkProto>>(*block_chunk_list->mutable_chunk(),
+                           [rank](const ChunkProto& chunk) { return chunk.machine_id() != rank; });
+}
+
 }  // namespace oneflow
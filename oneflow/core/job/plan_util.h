@@ -49,6 +49,8 @@ struct PlanUtil {
       const PbMap<int64_t, ::oneflow::OpAttributeRefTable>& job_id2op_attribute_ref_table);
   static StreamId GetStreamId(const TaskProto& task);
   static int64_t GetDeviceIndex(const TaskProto& task);
+  // Drops the tasks, memory blocks and chunks of other ranks
+  static void FilterPlanForRank(Plan* plan, int64_t rank);
 };
 
 }  // namespace oneflow
@@ -0,0 +1,251 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/auto_parallel/sbp_graph.h"
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/sbp_infer_util.h"
+#include "oneflow/core/job_rewriter/calculation_pass.h"
+#include "oneflow/core/job_rewriter/job_pass.h"
+
+namespace oneflow {
+
+namespace {
+
+constexpr int32_t kMaxSearchSweeps = 16;
+
+// These ops carry the sbp given by the user, e.g. to_global in nn.Graph
+bool IsUserSbpConstrainedOp(const OperatorConf& op_conf) {
+  if (!op_conf.has_user_conf()) { return true; }
+  const std::string& op_type_name = op_conf.user_conf().op_type_name();
+  return op_type_name == "hierarchical_parallel_cast"
+         || op_type_name == "hierarchical_parallel_cast_like";
+}
+
+struct OpSbpCandidates {
+  const OpNode* op_node;
+  std::vector<NdSbpSignature> nd_sbp_sigs;
+  // Index of the signature chosen by the greedy inference
+  int32_t greedy_choice;
+};
+
+// Collect the valid signatures of the op. Ops which can not be searched keep their current
+// signature as the only candidate.
+Maybe<void> CollectCandidates(const OpNode& op_node, OpSbpCandidates* candidates) {
+  candidates->op_node = &op_node;
+  candidates->nd_sbp_sigs = {op_node.nd_sbp_signature()};
+  candidates->greedy_choice = 0;
+  const Operator& op = op_node.op();
+  if (op_node.parallel_desc().parallel_num() <= 1 || IsUserSbpConstrainedOp(op.op_conf())) {
+    return Maybe<void>::Ok();
+  }
+  const auto LogicalBlobDesc4Ibn = [&](const std::string& ibn) -> Maybe<const BlobDesc&> {
+    return op_node.LogicalBlobDesc4Lbi(op.BnInOp2Lbi(ibn));
+  };
+  std::vector<NdSbpSignature> nd_sbp_sigs;
+  if (!op.GetValidNdSbpSignatureList(LogicalBlobDesc4Ibn, op_node.parallel_desc(), &nd_sbp_sigs)
+           .IsOk()) {
+    return Maybe<void>::Ok();
+  }
+  // Signatures coming from a customized inference may be missing from the list. Keep them.
+  const auto& bn2nd_sbp = op_node.nd_sbp_signature().bn_in_op2nd_sbp();
+  const auto it = std::find_if(nd_sbp_sigs.begin(), nd_sbp_sigs.end(), [&](const auto& sig) {
+    for (const auto& pair : sig.bn_in_op2nd_sbp()) {
+      const auto& current_it = bn2nd_sbp.find(pair.first);
+      if (current_it == bn2nd_sbp.end() || current_it->second != pair.second) { return false; }
+    }
+    return true;
+  });
+  if (nd_sbp_sigs.size() <= 1 || it == nd_sbp_sigs.end()) { return Maybe<void>::Ok(); }
+  candidates->greedy_choice = it - nd_sbp_sigs.begin();
+  candidates->nd_sbp_sigs = std::move(nd_sbp_sigs);
+  return Maybe<void>::Ok();
+}
+
+// Bytes per rank of the blob under nd_sbp
+double Bytes4NdSbp(const NdSbp& nd_sbp, const BlobDesc& logical_blob_desc,
+                   const ParallelDesc& parallel_desc) {
+  Shape logical_shape = logical_blob_desc.shape();
+  return Storage4NdSbp(nd_sbp, logical_shape, *parallel_desc.hierarchy())
+         * GetSizeOfDataType(logical_blob_desc.data_type());
+}
+
+// The computation cost is estimated by the bytes each rank reads and writes, and the memory cost
+// by the bytes each rank holds for the outputs.
+Maybe<double> ComputeNodeCost(const OpNode& op_node, const NdSbpSignature& nd_sbp_sig,
+                              double computation_cost_ratio, double memory_cost_ratio) {
+  const Operator& op = op_node.op();
+  const auto& bn2nd_sbp = nd_sbp_sig.bn_in_op2nd_sbp();
+  double computation_cost = 0.0;
+  double memory_cost = 0.0;
+  for (const auto& ibn : op.input_bns()) {
+    const auto& it = bn2nd_sbp.find(ibn);
+    if (it == bn2nd_sbp.end()) { continue; }
+    computation_cost += Bytes4NdSbp(it->second, op_node.LogicalBlobDesc4Lbi(op.BnInOp2Lbi(ibn)),
+                                    *JUST(op.GetParallelDesc4BnInOp(ibn)));
+  }
+  for (const auto& obn : op.output_bns()) {
+    const auto& it = bn2nd_sbp.find(obn);
+    if (it == bn2nd_sbp.end()) { continue; }
+    const double bytes = Bytes4NdSbp(it->second, op_node.LogicalBlobDesc4Lbi(op.BnInOp2Lbi(obn)),
+                                     *JUST(op.GetParallelDesc4BnInOp(obn)));
+    computation_cost += bytes;
+    memory_cost += bytes;
+  }
+  return computation_cost_ratio * computation_cost + memory_cost_ratio * memory_cost;
+}
+
+// Deduplicate the nd_sbp of bn over the signatures, most signatures share the same few ones.
+void GroupNdSbp4Bn(const std::vector<NdSbpSignature>& nd_sbp_sigs, const std::string& bn,
+                   std::vector<NdSbp>* nd_sbps, std::vector<int32_t>* sig_id2nd_sbp_id) {
+  HashMap<NdSbp, int32_t> nd_sbp2id;
+  for (const auto& sig : nd_sbp_sigs) {
+    const NdSbp& nd_sbp = sig.bn_in_op2nd_sbp().at(bn);
+    auto it = nd_sbp2id.find(nd_sbp);
+    if (it == nd_sbp2id.end()) {
+      it = nd_sbp2id.emplace(nd_sbp, nd_sbps->size()).first;
+      nd_sbps->emplace_back(nd_sbp);
+    }
+    sig_id2nd_sbp_id->emplace_back(it->second);
+  }
+}
+
+// Boxing cost of the blobs on op_edge for each pair of signatures, with the middle nodes given by
+// the boxing collector.
+Maybe<void> ComputeEdgeCost(const OpEdge& op_edge, const OpSbpCandidates& producer,
+                            const OpSbpCandidates& consumer,
+                            std::vector<std::vector<double>>* cost) {
+  cost->assign(producer.nd_sbp_sigs.size(),
+               std::vector<double>(consumer.nd_sbp_sigs.size(), 0.0));
+  const Operator& producer_op = producer.op_node->op();
+  const Operator& consumer_op = consumer.op_node->op();
+  for (const auto& lbi : op_edge.lbis()) {
+    const std::string& obn = op_edge.lbi2obn().at(lbi);
+    const BlobDesc& logical_blob_desc = producer.op_node->LogicalBlobDesc4Lbi(lbi);
+    const ParallelDesc& producer_parallel_desc = *JUST(producer_op.GetParallelDesc4BnInOp(obn));
+    std::vector<NdSbp> producer_nd_sbps;
+    std::vector<int32_t> producer_sig_id2nd_sbp_id;
+    GroupNdSbp4Bn(producer.nd_sbp_sigs, obn, &producer_nd_sbps, &producer_sig_id2nd_sbp_id);
+    for (const auto& ibn : op_edge.lbi2ibns().at(lbi)) {
+      const ParallelDesc& consumer_parallel_desc = *JUST(consumer_op.GetParallelDesc4BnInOp(ibn));
+      const auto& blob_modifier = consumer_op.InputBlobModifier4Ibn(ibn);
+      const bool requires_same_sbp =
+          (blob_modifier.has_is_mutable() && blob_modifier.is_mutable())
+          || NotSupportBoxingDataType(logical_blob_desc.data_type());
+      std::vector<NdSbp> consumer_nd_sbps;
+      std::vector<int32_t> consumer_sig_id2nd_sbp_id;
+      GroupNdSbp4Bn(consumer.nd_sbp_sigs, ibn, &consumer_nd_sbps, &consumer_sig_id2nd_sbp_id);
+      std::vector<std::vector<double>> copy_cost(producer_nd_sbps.size(),
+                                                 std::vector<double>(consumer_nd_sbps.size()));
+      for (int32_t i = 0; i < producer_nd_sbps.size(); ++i) {
+        for (int32_t j = 0; j < consumer_nd_sbps.size(); ++j) {
+          copy_cost[i][j] = JUST(ComputeCopyCostWithMiddleNodes(
+              producer_nd_sbps[i], consumer_nd_sbps[j], logical_blob_desc, producer_parallel_desc,
+              consumer_parallel_desc, requires_same_sbp));
+        }
+      }
+      for (int32_t i = 0; i < producer.nd_sbp_sigs.size(); ++i) {
+        for (int32_t j = 0; j < consumer.nd_sbp_sigs.size(); ++j) {
+          (*cost)[i][j] +=
+              copy_cost[producer_sig_id2nd_sbp_id[i]][consumer_sig_id2nd_sbp_id[j]];
+        }
+      }
+    }
+  }
+  return Maybe<void>::Ok();
+}
+
+// Search the sbp signatures of the whole graph with a cost model of computation, memory and
+// boxing, instead of picking the cheapest one for each op in topological order.
+class AutoParallelPass final : public JobPass {
+ public:
+  AutoParallelPass() = default;
+  ~AutoParallelPass() override = default;
+
+  bool IsEnabled(const JobPassCtx& ctx) const {
+    return ctx.job_desc().job_conf().enable_auto_parallel();
+  }
+  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder,
+                    const JobConfigProto& job_conf) const;
+
+  Maybe<void> Apply(Job* job, JobPassCtx* ctx) const override {
+    if (!IsEnabled(*ctx)) { return Maybe<void>::Ok(); }
+    const OpGraph op_graph(*job);
+    JobBuilder job_builder(job);
+    return Apply(op_graph, &job_builder, ctx->job_desc().job_conf());
+  }
+};
+
+Maybe<void> AutoParallelPass::Apply(const OpGraph& op_graph, JobBuilder* job_builder,
+                                    const JobConfigProto& job_conf) const {
+  // Every rank compiles the job, so the ops and edges are visited in the same order everywhere
+  std::vector<const OpNode*> op_nodes;
+  NameSortedTopoForEachNode(op_graph, [&](OpNode* op_node) { op_nodes.emplace_back(op_node); });
+  std::vector<OpSbpCandidates> op_candidates(op_nodes.size());
+  HashMap<const OpNode*, int32_t> op_node2sbp_node_id;
+  SbpGraph sbp_graph;
+  int32_t searchable_op_num = 0;
+  for (const OpNode* op_node : op_nodes) {
+    OpSbpCandidates* candidates = &op_candidates.at(sbp_graph.NodeNum());
+    JUST(CollectCandidates(*op_node, candidates));
+    if (candidates->nd_sbp_sigs.size() > 1) { ++searchable_op_num; }
+    std::vector<double> node_cost;
+    for (const auto& nd_sbp_sig : candidates->nd_sbp_sigs) {
+      node_cost.emplace_back(JUST(ComputeNodeCost(*op_node, nd_sbp_sig,
+                                                  job_conf.auto_parallel_computation_cost_ratio(),
+                                                  job_conf.auto_parallel_memory_cost_ratio())));
+    }
+    const int32_t sbp_node_id = sbp_graph.AddNode(std::move(node_cost));
+    sbp_graph.SetChoice(sbp_node_id, candidates->greedy_choice);
+    op_node2sbp_node_id.emplace(op_node, sbp_node_id);
+    std::vector<std::pair<int32_t, const OpEdge*>> in_edges;
+    for (const OpEdge* op_edge : op_node->in_edges()) {
+      in_edges.emplace_back(op_node2sbp_node_id.at(op_edge->src_node()), op_edge);
+    }
+    std::sort(in_edges.begin(), in_edges.end());
+    for (const auto& pair : in_edges) {
+      std::vector<std::vector<double>> edge_cost;
+      JUST(ComputeEdgeCost(*pair.second, op_candidates.at(pair.first), *candidates, &edge_cost));
+      sbp_graph.AddEdge(pair.first, sbp_node_id, edge_cost);
+    }
+  }
+  if (searchable_op_num == 0) { return Maybe<void>::Ok(); }
+
+  const double greedy_cost = sbp_graph.ComputeCost();
+  const double greedy_boxing_cost = sbp_graph.ComputeEdgeCost();
+  const double searched_cost = sbp_graph.Search(kMaxSearchSweeps);
+  // Pins the choice of every searchable op, even the ones the search kept at the greedy choice:
+  // the greedy inference that runs later picks op by op given the sbp of the producers, so it may
+  // pick differently once a producer changed.
+  int32_t changed_op_num = 0;
+  for (int32_t i = 0; i < op_candidates.size(); ++i) {
+    const OpSbpCandidates& candidates = op_candidates.at(i);
+    if (candidates.nd_sbp_sigs.size() <= 1) { continue; }
+    job_builder->AddNdSbpSignature4OpName(candidates.op_node->op().op_name(),
+                                          candidates.nd_sbp_sigs.at(sbp_graph.Choice(i)));
+    if (sbp_graph.Choice(i) != candidates.greedy_choice) { ++changed_op_num; }
+  }
+  LOG(INFO) << "Auto parallel of job " << job_conf.job_name() << " searched " << searchable_op_num
+            << " of " << op_candidates.size() << " ops and changed " << changed_op_num
+            << ". Estimated cost: " << searched_cost << " (greedy " << greedy_cost
+            << "), boxing cost: " << sbp_graph.ComputeEdgeCost() << " (greedy "
+            << greedy_boxing_cost << ")";
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+REGISTER_JOB_PASS("AutoParallelPass", AutoParallelPass);
+
+}  // namespace oneflow
@@ -14,6 +14,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/job_rewriter/calculation_pass.h"
+#include "oneflow/core/job/scope.h"
+#include "oneflow/core/framework/sbp_infer_util.h"
+#include "oneflow/core/rpc/include/global_process_ctx.h"
+#include "oneflow/core/vm/symbol_storage.h"
 
 namespace oneflow {
 
@@ -21,4 +25,37 @@ const std::string kForwardPass = "forward_pass";
 const std::string kBackwardPass = "backward_pass";
 const std::string kOptimizerPass = "optimizer_pass";
 
+const std::string kCheckpointingFakeOpNamePrefix = "OneFlow-System-Checkpointing-Fake-Fw-Op_";
+
+bool IsForwardOpNode(const OpNode* op_node) {
+  const OperatorConf& op_conf = op_node->op().op_conf();
+  if (!op_conf.has_scope_symbol_id()) { return true; }
+  const int64_t scope_symbol_id = op_conf.scope_symbol_id();
+  CHECK(Singleton<symbol::Storage<Scope>>::Get()->Has(scope_symbol_id))
+      << "rank[" << GlobalProcessCtx::Rank() << "] "
+      << "scope_symbol_id: " << scope_symbol_id;
+  const Scope& scope = Singleton<symbol::Storage<Scope>>::Get()->Get(scope_symbol_id);
+  return scope.scope_proto().calculation_pass_name() == kForwardPass;
+}
+
+int64_t DeviceBytes4Lbi(const OpNode* producer, const LogicalBlobId& lbi) {
+  const BlobDesc& logical_blob_desc = producer->LogicalBlobDesc4Lbi(lbi);
+  Shape shape = logical_blob_desc.shape();
+  const double storage =
+      Storage4NdSbp(producer->NdSbp4Lbi(lbi), shape, *producer->parallel_desc().hierarchy());
+  const double elem_cnt =
+      std::min(storage, static_cast<double>(logical_blob_desc.shape().elem_cnt()));
+  return static_cast<int64_t>(elem_cnt) * GetSizeOfDataType(logical_blob_desc.data_type());
+}
+
+void NameSortedTopoForEachNode(const OpGraph& op_graph,
+                               const std::function<void(OpNode*)>& Handler) {
+  op_graph.SortedTopoForEachNode(
+      [](const OpEdge* lhs, const OpEdge* rhs) {
+        return std::make_pair(lhs->src_node()->op().op_name(), lhs->dst_node()->op().op_name())
+               < std::make_pair(rhs->src_node()->op().op_name(), rhs->dst_node()->op().op_name());
+      },
+      Handler);
+}
+
 }  // namespace oneflow
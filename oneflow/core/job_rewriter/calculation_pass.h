@@ -16,7 +16,9 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_JOB_REWRITE_CALCULATION_PASS_H_
 #define ONEFLOW_CORE_JOB_REWRITE_CALCULATION_PASS_H_
 
+#include <functional>
 #include <string>
+#include "oneflow/core/graph/op_graph.h"
 
 namespace oneflow {
 
@@ -24,6 +26,20 @@ extern const std::string kForwardPass;
 extern const std::string kBackwardPass;
 extern const std::string kOptimizerPass;
 
+// Prefix of the forward ops the checkpointing pass copies into the backward pass.
+extern const std::string kCheckpointingFakeOpNamePrefix;
+
+// Whether the op is in the forward pass, ops without a scope count as forward.
+bool IsForwardOpNode(const OpNode* op_node);
+
+// Per device bytes of the blob, partial sum blobs take the full size.
+int64_t DeviceBytes4Lbi(const OpNode* producer, const LogicalBlobId& lbi);
+
+// Topological order which breaks ties by op name, so that every rank compiling the job visits
+// the ops in the same order.
+void NameSortedTopoForEachNode(const OpGraph& op_graph,
+                               const std::function<void(OpNode*)>& Handler);
+
 }  // namespace oneflow
 
 #endif  // ONEFLOW_CORE_JOB_REWRITE_CALCULATION_PASS_H_
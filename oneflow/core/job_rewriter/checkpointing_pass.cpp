@@ -13,12 +13,17 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <limits>
+#include <map>
+#include <tuple>
 #include "oneflow/core/job_rewriter/job_pass.h"
 #include "oneflow/core/job/job.pb.h"
 #include "oneflow/core/job/scope.h"
 #include "oneflow/core/job_rewriter/calculation_pass.h"
 #include "oneflow/core/vm/symbol_storage.h"
+#include "oneflow/core/common/container_util.h"
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/sbp_infer_util.h"
 #include "oneflow/core/operator/operator.h"
 #include "oneflow/core/rpc/include/global_process_ctx.h"
 
@@ -37,15 +42,18 @@ class CheckpointingPass final : public JobPass {
     if (!IsEnabled(*ctx)) { return Maybe<void>::Ok(); }
     const OpGraph op_graph(*job);
     JobBuilder job_builder(job);
-    return Apply(op_graph, &job_builder);
+    const int64_t memory_budget =
+        ctx->job_desc().job_conf().activation_checkpointing_memory_budget_mb() * 1024 * 1024;
+    return Apply(op_graph, &job_builder, memory_budget);
   }
 
   bool IsEnabled(const JobPassCtx& ctx) const { return ctx.job_desc().IsTrain(); }
 
-  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder) const;
+  // memory_budget is the bytes each device may use, 0 means no automatic checkpointing.
+  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder,
+                    int64_t memory_budget) const;
 };
 
-const std::string kCheckpointingFakeOpNamePrefix = "OneFlow-System-Checkpointing-Fake-Fw-Op_";
 const std::string kCheckpointingBadOpName = "OneFlow-System-CheckpointPassBadEndOpName";
 
 const Scope& Scope4OpNode(const OpNode* op_node) {
@@ -64,24 +72,26 @@ bool IsForwardPass7CheckpointingScope(const Scope& scope) {
   return IsForwardPassScope(scope) && scope.Bool("checkpointing");
 }
 
-void CollectAllCheckpointingOpsInForwardPass(
-    const OpGraph& op_graph, HashMap<std::string, const OpNode*>* checkpointing_op_name2op_node) {
+bool IsCheckpointableOpNode(const OpNode* op_node) {
   // NOTE(chengcheng):
   //   ignore batch_norm ops because of recompute bn will repeat the calculation of 'm' and 'v'.
   //   in the future, we need to support the recomputation version of batch_norm which do NOT
   //   update forward variables.
-  HashSet<std::string> ignore_op_type_names = {"normalization", "normalization_add_relu",
-                                               "cudnn_fused_normalization_add_relu", "repeat",
-                                               "unpack"};
+  static const HashSet<std::string> ignore_op_type_names = {
+      "normalization", "normalization_add_relu", "cudnn_fused_normalization_add_relu", "repeat",
+      "unpack"};
+  const OperatorConf& op_conf = op_node->op().op_conf();
+  if (!op_conf.has_user_conf()) { return false; }
+  return ignore_op_type_names.find(op_conf.user_conf().op_type_name())
+         == ignore_op_type_names.end();
+}
+
+void CollectAllCheckpointingOpsInForwardPass(
+    const OpGraph& op_graph, HashMap<std::string, const OpNode*>* checkpointing_op_name2op_node) {
   op_graph.ForEachNode([&](const OpNode* op_node) {
-    const OperatorConf& op_conf = op_node->op().op_conf();
-    if (!op_conf.has_user_conf()) { return; }
-    if (ignore_op_type_names.find(op_conf.user_conf().op_type_name())
-        != ignore_op_type_names.end()) {
-      return;
-    }
+    if (!IsCheckpointableOpNode(op_node)) { return; }
     if (IsForwardPass7CheckpointingScope(Scope4OpNode(op_node))) {
-      CHECK(checkpointing_op_name2op_node->emplace(op_conf.name(), op_node).second);
+      CHECK(checkpointing_op_name2op_node->emplace(op_node->op().op_name(), op_node).second);
     }
   });
 }
@@ -124,15 +134,387 @@ void GenConnectedCheckpointingSubgraphs(
   }
 }
 
-Maybe<void> CheckpointingPass::Apply(const OpGraph& op_graph, JobBuilder* job_builder) const {
+// Per device flops to recompute the op. Matmuls and convolutions count the multiply-adds, other
+// ops count one flop per element they read or write.
+double RecomputeFlops(const OpNode* op_node) {
+  const Operator& op = op_node->op();
+  const user_op::UserOpConfWrapper user_op_conf(op.op_conf());
+  const std::string& op_type_name = user_op_conf.op_type_name();
+  const auto LogicalShape4Arg = [&](const std::string& arg_name) -> const Shape& {
+    return op_node->LogicalBlobDesc4Lbi(GenLogicalBlobId(user_op_conf.input(arg_name, 0))).shape();
+  };
+  double flops = 0;
+  if (op_type_name == "matmul" || op_type_name == "batch_matmul"
+      || op_type_name == "broadcast_matmul") {
+    const Shape& a_shape = LogicalShape4Arg("a");
+    const int64_t k = user_op_conf.attr<bool>("transpose_a") ? a_shape.At(a_shape.NumAxes() - 2)
+                                                              : a_shape.At(a_shape.NumAxes() - 1);
+    const Shape& out_shape = op_node->LogicalBlobDesc4Lbi(op.BnInOp2Lbi("out_0")).shape();
+    flops = 2.0 * out_shape.elem_cnt() * k;
+  } else if (op_type_name == "conv1d" || op_type_name == "conv2d" || op_type_name == "conv3d") {
+    const Shape& weight_shape = LogicalShape4Arg("weight");
+    const Shape& out_shape = op_node->LogicalBlobDesc4Lbi(op.BnInOp2Lbi("out_0")).shape();
+    flops = 2.0 * out_shape.elem_cnt() * (weight_shape.elem_cnt() / weight_shape.At(0));
+  } else {
+    for (const auto& bn : op.input_bns()) {
+      flops += op_node->LogicalBlobDesc4Lbi(op.BnInOp2Lbi(bn)).shape().elem_cnt();
+    }
+    for (const auto& bn : op.output_bns()) {
+      flops += op_node->LogicalBlobDesc4Lbi(op.BnInOp2Lbi(bn)).shape().elem_cnt();
+    }
+  }
+  return flops / op_node->parallel_desc().parallel_num();
+}
+
+// Range add and global max over the time line of one device group.
+class MemoryTimeLine final {
+ public:
+  explicit MemoryTimeLine(int32_t size)
+      : size_(size), max_(4 * std::max(size, 1), 0), add_(4 * std::max(size, 1), 0) {}
+  ~MemoryTimeLine() = default;
+
+  void Add(int32_t begin, int32_t end, int64_t bytes) { Add(1, 0, size_ - 1, begin, end, bytes); }
+  int64_t Max() const { return max_[1]; }
+
+ private:
+  void Add(int32_t node, int32_t lo, int32_t hi, int32_t begin, int32_t end, int64_t bytes) {
+    if (end < lo || hi < begin) { return; }
+    if (begin <= lo && hi <= end) {
+      max_[node] += bytes;
+      add_[node] += bytes;
+      return;
+    }
+    const int32_t mid = (lo + hi) / 2;
+    Add(2 * node, lo, mid, begin, end, bytes);
+    Add(2 * node + 1, mid + 1, hi, begin, end, bytes);
+    max_[node] = add_[node] + std::max(max_[2 * node], max_[2 * node + 1]);
+  }
+
+  int32_t size_;
+  std::vector<int64_t> max_;
+  std::vector<int64_t> add_;
+};
+
+// Estimates the peak memory of each device by the alloc and free time line of the blobs over a
+// topological order of the ops, like the memory sharing of registers does on the plan. Devices
+// in the same placements share one time line. Marking an op as recomputed only updates the
+// lifetimes of the blobs it changes, so the peak is kept up to date incrementally.
+class CheckpointingMemoryModel final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(CheckpointingMemoryModel);
+  explicit CheckpointingMemoryModel(const std::vector<const OpNode*>& ordered_op_nodes);
+  ~CheckpointingMemoryModel() = default;
+
+  int32_t OpNum() const { return op_nodes_.size(); }
+  const OpNode* OpNode4Order(int32_t order) const { return op_nodes_.at(order); }
+  int32_t Order4OpNode(const OpNode* op_node) const { return op_node2order_.at(op_node); }
+  // Bytes of the op outputs which are kept for the backward pass
+  int64_t SavedBytes(int32_t order) const;
+  bool IsRecomputed(int32_t order) const { return recomputed_.at(order); }
+  void SetRecomputed(int32_t order, bool recomputed);
+  // Peak bytes over all devices with the ops marked by SetRecomputed recomputed in backward
+  int64_t PeakMemory() const;
+
+ private:
+  struct BlobLife {
+    int32_t producer;
+    int32_t placement_id;
+    int64_t bytes;
+    bool is_variable;
+    int32_t last_forward_use;
+    int32_t first_backward_use;
+    int32_t last_backward_use;
+    std::vector<int32_t> consumers;
+    // The [begin, end] ranges the blob is currently allocated in
+    std::vector<std::pair<int32_t, int32_t>> lives;
+  };
+
+  static constexpr int32_t kNever = std::numeric_limits<int32_t>::max();
+
+  // An op is recomputed right before the first backward use of its outputs, or before the
+  // recomputation of its consumers
+  int32_t ComputeRecomputeOrder(int32_t order) const;
+  void UpdateBlobLives(int32_t blob_id);
+
+  std::vector<const OpNode*> op_nodes_;
+  HashMap<const OpNode*, int32_t> op_node2order_;
+  std::vector<BlobLife> blobs_;
+  std::vector<std::vector<int32_t>> op_out_blobs_;
+  std::vector<std::vector<int32_t>> op_in_blobs_;
+  std::vector<std::vector<int32_t>> op_consumers_;
+  std::vector<std::vector<int32_t>> op_producers_;
+  // The device groups covered by each placement
+  std::vector<std::vector<int32_t>> placement_id2groups_;
+  std::vector<MemoryTimeLine> group2time_line_;
+  std::vector<bool> recomputed_;
+  std::vector<int32_t> recompute_order_;
+};
+
+CheckpointingMemoryModel::CheckpointingMemoryModel(
+    const std::vector<const OpNode*>& ordered_op_nodes)
+    : op_nodes_(ordered_op_nodes),
+      op_out_blobs_(ordered_op_nodes.size()),
+      op_in_blobs_(ordered_op_nodes.size()),
+      op_consumers_(ordered_op_nodes.size()),
+      op_producers_(ordered_op_nodes.size()),
+      recomputed_(ordered_op_nodes.size(), false),
+      recompute_order_(ordered_op_nodes.size(), kNever) {
+  for (int32_t i = 0; i < op_nodes_.size(); ++i) { op_node2order_.emplace(op_nodes_[i], i); }
+  std::vector<bool> is_forward(op_nodes_.size());
+  for (int32_t i = 0; i < op_nodes_.size(); ++i) { is_forward[i] = IsForwardOpNode(op_nodes_[i]); }
+  HashMap<ParallelDesc, int32_t> parallel_desc2placement_id;
+  std::vector<const ParallelDesc*> placements;
+  for (int32_t i = 0; i < op_nodes_.size(); ++i) {
+    const OpNode* op_node = op_nodes_[i];
+    auto placement_it = parallel_desc2placement_id.find(op_node->parallel_desc());
+    if (placement_it == parallel_desc2placement_id.end()) {
+      placement_it =
+          parallel_desc2placement_id.emplace(op_node->parallel_desc(), placements.size()).first;
+      placements.emplace_back(&op_node->parallel_desc());
+    }
+    HashMap<LogicalBlobId, int32_t> lbi2blob_id;
+    for (const auto& obn : op_node->op().output_bns()) {
+      const LogicalBlobId& lbi = op_node->op().BnInOp2Lbi(obn);
+      lbi2blob_id.emplace(lbi, blobs_.size());
+      op_out_blobs_[i].emplace_back(blobs_.size());
+      blobs_.emplace_back(BlobLife{i, placement_it->second, DeviceBytes4Lbi(op_node, lbi),
+                                   op_node->op().op_conf().has_variable_conf(), i, -1, -1, {}, {}});
+    }
+    HashSet<int32_t> consumers;
+    op_node->ForEachNodeOnOutEdge([&](const OpNode* consumer) {
+      consumers.insert(op_node2order_.at(consumer));
+    });
+    for (const OpEdge* out_edge : op_node->out_edges()) {
+      const int32_t consumer = op_node2order_.at(out_edge->dst_node());
+      for (const auto& lbi : out_edge->lbis()) {
+        const int32_t blob_id = lbi2blob_id.at(lbi);
+        BlobLife* blob = &blobs_[blob_id];
+        blob->consumers.emplace_back(consumer);
+        op_in_blobs_[consumer].emplace_back(blob_id);
+        if (is_forward[consumer]) {
+          blob->last_forward_use = std::max(blob->last_forward_use, consumer);
+        } else {
+          blob->first_backward_use = blob->first_backward_use == -1
+                                         ? consumer
+                                         : std::min(blob->first_backward_use, consumer);
+          blob->last_backward_use = std::max(blob->last_backward_use, consumer);
+        }
+      }
+    }
+    op_consumers_[i].assign(consumers.begin(), consumers.end());
+    for (int32_t consumer : consumers) { op_producers_[consumer].emplace_back(i); }
+  }
+  // Group the devices by the placements containing them
+  std::map<std::tuple<DeviceType, int64_t, int64_t>, std::vector<int32_t>> device2placement_ids;
+  for (int32_t placement_id = 0; placement_id < placements.size(); ++placement_id) {
+    const ParallelDesc& parallel_desc = *placements[placement_id];
+    for (int64_t parallel_id = 0; parallel_id < parallel_desc.parallel_num(); ++parallel_id) {
+      device2placement_ids[std::make_tuple(parallel_desc.device_type(),
+                                           parallel_desc.parallel_id2machine_id().at(parallel_id),
+                                           parallel_desc.parallel_id2device_id().at(parallel_id))]
+          .emplace_back(placement_id);
+    }
+  }
+  std::map<std::vector<int32_t>, int32_t> placement_ids2group;
+  placement_id2groups_.resize(placements.size());
+  for (const auto& pair : device2placement_ids) {
+    if (placement_ids2group.emplace(pair.second, placement_ids2group.size()).second) {
+      const int32_t group = placement_ids2group.size() - 1;
+      for (int32_t placement_id : pair.second) {
+        placement_id2groups_[placement_id].emplace_back(group);
+      }
+    }
+  }
+  group2time_line_.assign(placement_ids2group.size(), MemoryTimeLine(op_nodes_.size()));
+  for (int32_t blob_id = 0; blob_id < blobs_.size(); ++blob_id) { UpdateBlobLives(blob_id); }
+}
+
+int64_t CheckpointingMemoryModel::SavedBytes(int32_t order) const {
+  int64_t saved_bytes = 0;
+  for (int32_t blob_id : op_out_blobs_.at(order)) {
+    if (blobs_[blob_id].last_backward_use != -1) { saved_bytes += blobs_[blob_id].bytes; }
+  }
+  return saved_bytes;
+}
+
+int32_t CheckpointingMemoryModel::ComputeRecomputeOrder(int32_t order) const {
+  if (!recomputed_[order]) { return kNever; }
+  int32_t recompute_order = kNever;
+  for (int32_t blob_id : op_out_blobs_[order]) {
+    const int32_t first_use = blobs_[blob_id].first_backward_use;
+    if (first_use != -1) { recompute_order = std::min(recompute_order, first_use); }
+  }
+  for (int32_t consumer : op_consumers_[order]) {
+    if (recomputed_[consumer]) {
+      recompute_order = std::min(recompute_order, recompute_order_[consumer]);
+    }
+  }
+  return recompute_order;
+}
+
+void CheckpointingMemoryModel::UpdateBlobLives(int32_t blob_id) {
+  BlobLife* blob = &blobs_[blob_id];
+  std::vector<std::pair<int32_t, int32_t>> lives;
+  if (blob->is_variable) {
+    lives.emplace_back(0, op_nodes_.size() - 1);
+  } else if (recomputed_[blob->producer]) {
+    lives.emplace_back(blob->producer, blob->last_forward_use);
+    if (blob->last_backward_use != -1) {
+      lives.emplace_back(recompute_order_[blob->producer], blob->last_backward_use);
+    }
+  } else {
+    int32_t last_use = std::max(blob->last_forward_use, blob->last_backward_use);
+    // The inputs of recomputed ops live until the recomputation
+    for (int32_t consumer : blob->consumers) {
+      if (recomputed_[consumer] && recompute_order_[consumer] != kNever) {
+        last_use = std::max(last_use, recompute_order_[consumer]);
+      }
+    }
+    lives.emplace_back(blob->producer, last_use);
+  }
+  if (lives == blob->lives) { return; }
+  for (int32_t group : placement_id2groups_[blob->placement_id]) {
+    for (const auto& life : blob->lives) {
+      group2time_line_[group].Add(life.first, life.second, -blob->bytes);
+    }
+    for (const auto& life : lives) {
+      group2time_line_[group].Add(life.first, life.second, blob->bytes);
+    }
+  }
+  blob->lives = std::move(lives);
+}
+
+void CheckpointingMemoryModel::SetRecomputed(int32_t order, bool recomputed) {
+  if (recomputed_.at(order) == recomputed) { return; }
+  recomputed_[order] = recomputed;
+  // The recompute order of an op depends on its recomputed consumers, so a change goes up through
+  // the recomputed producers
+  std::vector<int32_t> changed_ops{order};
+  recompute_order_[order] = ComputeRecomputeOrder(order);
+  for (int32_t i = 0; i < changed_ops.size(); ++i) {
+    for (int32_t producer : op_producers_[changed_ops[i]]) {
+      if (!recomputed_[producer]) { continue; }
+      const int32_t recompute_order = ComputeRecomputeOrder(producer);
+      if (recompute_order == recompute_order_[producer]) { continue; }
+      recompute_order_[producer] = recompute_order;
+      changed_ops.emplace_back(producer);
+    }
+  }
+  for (int32_t op : changed_ops) {
+    for (int32_t blob_id : op_out_blobs_[op]) { UpdateBlobLives(blob_id); }
+    for (int32_t blob_id : op_in_blobs_[op]) { UpdateBlobLives(blob_id); }
+  }
+}
+
+int64_t CheckpointingMemoryModel::PeakMemory() const {
+  int64_t peak = 0;
+  for (const auto& time_line : group2time_line_) { peak = std::max(peak, time_line.Max()); }
+  return peak;
+}
+
+// Pick forward ops to recompute so that the estimated peak memory fits the budget. Ops saving
+// the most bytes per recomputed flop are taken first, then the ops which are not needed to fit
+// the budget are dropped again.
+void AutoSelectCheckpointingOps(
+    const OpGraph& op_graph, int64_t memory_budget,
+    HashMap<std::string, const OpNode*>* checkpointing_op_name2op_node) {
+  // Every rank compiles the job, so the ops are visited in the same order everywhere
+  std::vector<const OpNode*> ordered_op_nodes;
+  NameSortedTopoForEachNode(op_graph,
+                            [&](OpNode* op_node) { ordered_op_nodes.emplace_back(op_node); });
+  CheckpointingMemoryModel memory_model(ordered_op_nodes);
+  for (const auto& pair : *checkpointing_op_name2op_node) {
+    memory_model.SetRecomputed(memory_model.Order4OpNode(pair.second), true);
+  }
+  const int64_t origin_peak = memory_model.PeakMemory();
+
+  std::vector<std::pair<double, int32_t>> candidates;
+  for (int32_t i = 0; i < memory_model.OpNum(); ++i) {
+    const OpNode* op_node = memory_model.OpNode4Order(i);
+    if (memory_model.IsRecomputed(i) || !IsCheckpointableOpNode(op_node)
+        || !IsForwardOpNode(op_node)) {
+      continue;
+    }
+    // Recomputing a random op would not reproduce its outputs
+    const auto* op_reg_result = user_op::UserOpRegistryMgr::Get().GetOpRegistryResult(
+        op_node->op().op_conf().user_conf().op_type_name());
+    if (op_node->op().input_bns().empty() || op_reg_result == nullptr || op_reg_result->random) {
+      continue;
+    }
+    const int64_t saved_bytes = memory_model.SavedBytes(i);
+    if (saved_bytes == 0) { continue; }
+    candidates.emplace_back(-saved_bytes / (RecomputeFlops(op_node) + 1.0), i);
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  int64_t peak = origin_peak;
+  std::vector<int32_t> selected;
+  for (const auto& candidate : candidates) {
+    if (peak <= memory_budget) { break; }
+    memory_model.SetRecomputed(candidate.second, true);
+    selected.emplace_back(candidate.second);
+    peak = memory_model.PeakMemory();
+  }
+  for (auto it = selected.rbegin(); it != selected.rend(); ++it) {
+    memory_model.SetRecomputed(*it, false);
+    const int64_t new_peak = memory_model.PeakMemory();
+    if (new_peak <= std::max(memory_budget, peak)) {
+      peak = new_peak;
+    } else {
+      memory_model.SetRecomputed(*it, true);
+    }
+  }
+
+  double recompute_flops = 0;
+  double forward_flops = 0;
+  int32_t recomputed_op_num = 0;
+  for (int32_t i = 0; i < memory_model.OpNum(); ++i) {
+    const OpNode* op_node = memory_model.OpNode4Order(i);
+    if (!op_node->op().op_conf().has_user_conf() || !IsForwardOpNode(op_node)) { continue; }
+    const double flops = RecomputeFlops(op_node);
+    forward_flops += flops;
+    if (!memory_model.IsRecomputed(i)) { continue; }
+    recompute_flops += flops;
+    if (checkpointing_op_name2op_node->emplace(op_node->op().op_name(), op_node).second) {
+      ++recomputed_op_num;
+    }
+  }
+  constexpr double kMiB = 1024.0 * 1024.0;
+  LOG(INFO) << "Auto activation checkpointing recomputes " << recomputed_op_num
+            << " more ops. Predicted peak memory per device: " << peak / kMiB << " MiB (budget "
+            << memory_budget / kMiB << " MiB, " << origin_peak / kMiB
+            << " MiB without auto checkpointing). Recompute overhead: " << recompute_flops
+            << " flops per device, " << 100.0 * recompute_flops / std::max(forward_flops, 1.0)
+            << "% of the forward pass";
+  LOG_IF(WARNING, peak > memory_budget)
+      << "Auto activation checkpointing can not fit the memory budget";
+}
+
+Maybe<void> CheckpointingPass::Apply(const OpGraph& op_graph, JobBuilder* job_builder,
+                                     int64_t memory_budget) const {
   // step 1. collect all checkpointing ops in forwardpass.
   HashMap<std::string, const OpNode*> checkpointing_op_name2op_node;
   CollectAllCheckpointingOpsInForwardPass(op_graph, &checkpointing_op_name2op_node);
+  // step 1.1 recompute more ops until the memory budget is met in automatic mode.
+  if (memory_budget > 0) {
+    AutoSelectCheckpointingOps(op_graph, memory_budget, &checkpointing_op_name2op_node);
+  }
   if (checkpointing_op_name2op_node.empty()) { return Maybe<void>::Ok(); }
 
   // step 2. get all connected subgraphs in checkpointing ops.
   std::vector<HashSet<const OpNode*>> checkpointing_subgraphs;
   GenConnectedCheckpointingSubgraphs(checkpointing_op_name2op_node, &checkpointing_subgraphs);
+  if (memory_budget > 0) {
+    for (int32_t i = 0; i < checkpointing_subgraphs.size(); ++i) {
+      std::vector<std::string> op_names;
+      for (const OpNode* node : checkpointing_subgraphs.at(i)) {
+        op_names.emplace_back(node->op().op_name());
+      }
+      std::sort(op_names.begin(), op_names.end());
+      LOG(INFO) << "Activation checkpointing segment " << i << " recomputes " << op_names.size()
+                << " ops: " << Join(op_names, ", ");
+    }
+  }
 
   HashMap<const OpNode*, int32_t> op_node2order;
   int32_t order = 0;
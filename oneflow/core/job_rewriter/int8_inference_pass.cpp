@@ -0,0 +1,238 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job_rewriter/job_pass.h"
+#include "oneflow/core/framework/framework.h"
+
+namespace oneflow {
+
+namespace {
+
+const std::string QUANTIZE_SUFFIX = "-int8-quantize";
+
+bool IsUserOpWithTypeName(const OperatorConf& op_conf, const std::string& op_type_name) {
+  return op_conf.has_user_conf() && op_conf.user_conf().op_type_name() == op_type_name;
+}
+
+// Returns the fake_quantization producing lbn if it is the symmetric 8 bit quantization the
+// int8 kernels implement, otherwise nullptr.
+const OpNode* FindInt8FakeQuantization(const OpGraph& op_graph, const std::string& lbn) {
+  const OpNode& producer = op_graph.ProducerOpNode4Lbi(GenLogicalBlobId(lbn));
+  const OperatorConf& op_conf = producer.op().op_conf();
+  if (!IsUserOpWithTypeName(op_conf, "fake_quantization")) { return nullptr; }
+  const user_op::UserOpConfWrapper fake_quant_conf(op_conf);
+  if (fake_quant_conf.attr<std::string>("quantization_scheme") != "symmetric") { return nullptr; }
+  if (fake_quant_conf.attr<std::string>("quantization_formula") != "google") { return nullptr; }
+  if (fake_quant_conf.attr<int32_t>("quantization_bit") != 8) { return nullptr; }
+  return &producer;
+}
+
+// Returns the min_max_observer producing the scale of weight_fake_quant if it observes the
+// quantized variable itself with the symmetric 8 bit scheme. Such a scale only depends on the
+// weight, so the int8 kernels compute it when quantizing the weight, otherwise nullptr.
+const OpNode* FindInt8WeightObserver(const OpGraph& op_graph, const OpNode* weight_fake_quant) {
+  const user_op::UserOpConfWrapper weight_conf(weight_fake_quant->op().op_conf());
+  const OpNode& producer =
+      op_graph.ProducerOpNode4Lbi(GenLogicalBlobId(weight_conf.input("scale", 0)));
+  const OperatorConf& op_conf = producer.op().op_conf();
+  if (!IsUserOpWithTypeName(op_conf, "min_max_observer")) { return nullptr; }
+  const user_op::UserOpConfWrapper observer_conf(op_conf);
+  if (observer_conf.input("in", 0) != weight_conf.input("in", 0)) { return nullptr; }
+  if (observer_conf.attr<std::string>("quantization_scheme") != "symmetric") { return nullptr; }
+  if (observer_conf.attr<std::string>("quantization_formula") != "google") { return nullptr; }
+  if (observer_conf.attr<int32_t>("quantization_bit") != 8) { return nullptr; }
+  return &producer;
+}
+
+// The activation and weight pair of a matmul or conv2d that runs on int8.
+struct Int8Operands {
+  const OpNode* activation_fake_quant;
+  const OpNode* weight_fake_quant;
+  // nullptr if the weight scale is an input of the int8 op.
+  const OpNode* weight_observer;
+  bool per_channel_weight_scale;
+};
+
+// Both operands have to be fake quantized, the weight has to be a variable so that the kernel
+// may quantize it once, and the activation needs a single scale.
+bool GetInt8Operands(const OpGraph& op_graph, const std::string& activation_lbn,
+                     const std::string& weight_lbn, int64_t num_output_channels,
+                     Int8Operands* operands) {
+  const OpNode* activation_fake_quant = FindInt8FakeQuantization(op_graph, activation_lbn);
+  const OpNode* weight_fake_quant = FindInt8FakeQuantization(op_graph, weight_lbn);
+  if (activation_fake_quant == nullptr || weight_fake_quant == nullptr) { return false; }
+  const user_op::UserOpConfWrapper activation_conf(activation_fake_quant->op().op_conf());
+  const user_op::UserOpConfWrapper weight_conf(weight_fake_quant->op().op_conf());
+  const auto BlobDesc4Lbn = [&](const OpNode* node, const std::string& lbn) -> const BlobDesc& {
+    return node->LogicalBlobDesc4Lbi(GenLogicalBlobId(lbn));
+  };
+  if (BlobDesc4Lbn(activation_fake_quant, activation_conf.input("in", 0)).data_type()
+      != DataType::kFloat) {
+    return false;
+  }
+  if (BlobDesc4Lbn(activation_fake_quant, activation_conf.input("scale", 0)).shape().elem_cnt()
+      != 1) {
+    return false;
+  }
+  const int64_t weight_scale_size =
+      BlobDesc4Lbn(weight_fake_quant, weight_conf.input("scale", 0)).shape().elem_cnt();
+  if (weight_scale_size != 1 && weight_scale_size != num_output_channels) { return false; }
+  const OpNode& weight_producer =
+      op_graph.ProducerOpNode4Lbi(GenLogicalBlobId(weight_conf.input("in", 0)));
+  if (!weight_producer.op().op_conf().has_variable_conf()) { return false; }
+  operands->activation_fake_quant = activation_fake_quant;
+  operands->weight_fake_quant = weight_fake_quant;
+  operands->weight_observer = FindInt8WeightObserver(op_graph, weight_fake_quant);
+  operands->per_channel_weight_scale = weight_scale_size > 1;
+  return true;
+}
+
+// Replaces fake_quantization -> matmul/conv2d <- fake_quantization <- variable with
+// requantize -> quantized_matmul/quantized_conv2d <- variable for cpu inference, the weight is
+// quantized by the kernel and the int32 accumulators are dequantized to float. When the weight
+// scale comes from a min_max_observer of the variable, the observer is dropped too and the kernel
+// computes the scale, so the float weight is only read when it is quantized.
+class Int8InferencePass final : public JobPass {
+ public:
+  Int8InferencePass() = default;
+  ~Int8InferencePass() override = default;
+
+  bool IsEnabled(const JobPassCtx& ctx) const {
+    return ctx.job_desc().job_conf().enable_int8_inference() && !ctx.job_desc().IsTrain();
+  }
+  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder) const;
+
+  Maybe<void> Apply(Job* job, JobPassCtx* ctx) const override {
+    if (!IsEnabled(*ctx)) { return Maybe<void>::Ok(); }
+    const OpGraph op_graph(*job);
+    JobBuilder job_builder(job);
+    return Apply(op_graph, &job_builder);
+  }
+};
+
+Maybe<void> Int8InferencePass::Apply(const OpGraph& op_graph, JobBuilder* job_builder) const {
+  std::vector<OperatorConf> quantized_op_confs;
+  HashMap<const OpNode*, int64_t> fake_quant2num_rewritten_consumers;
+  HashSet<const OpNode*> weight_observers;
+  op_graph.ForEachNode([&](const OpNode* op_node) {
+    const OperatorConf& op_conf = op_node->op().op_conf();
+    if (op_node->parallel_desc().device_type() != DeviceType::kCPU) { return; }
+    const bool is_matmul = IsUserOpWithTypeName(op_conf, "matmul");
+    const bool is_conv2d = IsUserOpWithTypeName(op_conf, "conv2d");
+    if (!is_matmul && !is_conv2d) { return; }
+    const user_op::UserOpConfWrapper user_op_conf(op_conf);
+    Int8Operands operands{};
+    user_op::UserOpConfWrapperBuilder builder(op_conf.name());
+    if (is_matmul) {
+      if (user_op_conf.attr<bool>("transpose_a") || user_op_conf.has_input("_add_to_output", 0)) {
+        return;
+      }
+      const bool transpose_b = user_op_conf.attr<bool>("transpose_b");
+      const Shape& b_shape =
+          op_node->LogicalBlobDesc4Lbi(GenLogicalBlobId(user_op_conf.input("b", 0))).shape();
+      // Per-channel weight scales are along the first axis, which is n only if b is transposed.
+      const int64_t num_output_channels = transpose_b ? b_shape.At(0) : 1;
+      if (!GetInt8Operands(op_graph, user_op_conf.input("a", 0), user_op_conf.input("b", 0),
+                           num_output_channels, &operands)) {
+        return;
+      }
+      builder.Op("quantized_matmul")
+          .Attr<bool>("transpose_b", transpose_b)
+          .Attr<double>("alpha", user_op_conf.attr<double>("alpha"));
+    } else {
+      if (user_op_conf.attr<std::string>("data_format") != "channels_first"
+          || user_op_conf.attr<int32_t>("groups") != 1
+          || user_op_conf.has_input("bias_multiplier", 0)) {
+        return;
+      }
+      if (!GetInt8Operands(op_graph, user_op_conf.input("in", 0), user_op_conf.input("weight", 0),
+                           user_op_conf.attr<int32_t>("filters"), &operands)) {
+        return;
+      }
+      builder.Op("quantized_conv2d")
+          .Attr<int32_t>("filters", user_op_conf.attr<int32_t>("filters"))
+          .Attr<std::vector<int32_t>>("padding_before",
+                                      user_op_conf.attr<std::vector<int32_t>>("padding_before"))
+          .Attr<std::string>("data_format", "channels_first")
+          .Attr<std::vector<int32_t>>("kernel_size",
+                                      user_op_conf.attr<std::vector<int32_t>>("kernel_size"))
+          .Attr<std::vector<int32_t>>("strides",
+                                      user_op_conf.attr<std::vector<int32_t>>("strides"))
+          .Attr<std::vector<int32_t>>("dilation_rate",
+                                      user_op_conf.attr<std::vector<int32_t>>("dilation_rate"))
+          .Attr<int32_t>("groups", 1);
+      if (user_op_conf.has_input("bias", 0)) {
+        builder.Input("bias", user_op_conf.input("bias", 0));
+      }
+    }
+    const user_op::UserOpConfWrapper activation_conf(
+        operands.activation_fake_quant->op().op_conf());
+    const user_op::UserOpConfWrapper weight_conf(operands.weight_fake_quant->op().op_conf());
+    const auto quantize_op =
+        user_op::UserOpConfWrapperBuilder(op_conf.name() + QUANTIZE_SUFFIX)
+            .Op("requantize")
+            .Input("in", activation_conf.input("in", 0))
+            .Input("scale", activation_conf.input("scale", 0))
+            .Output("out")
+            .Attr<DataType>("out_dtype", DataType::kInt8)
+            .ScopeSymbolId(op_conf.scope_symbol_id())
+            .Build();
+    job_builder->AddOps(op_node->parallel_desc().parallel_conf(), {quantize_op.op_conf()});
+    const std::string activation_arg = is_matmul ? "a" : "in";
+    const std::string weight_arg = is_matmul ? "b" : "weight";
+    if (operands.weight_observer != nullptr) {
+      builder.Attr<bool>("per_channel_" + weight_arg + "_scale", operands.per_channel_weight_scale);
+      weight_observers.insert(operands.weight_observer);
+    } else {
+      builder.Input(weight_arg + "_scale", weight_conf.input("scale", 0));
+    }
+    const auto quantized_op =
+        builder.Input(activation_arg, quantize_op.output("out", 0))
+            .Input(weight_arg, weight_conf.input("in", 0))
+            .Input(activation_arg + "_scale", activation_conf.input("scale", 0))
+            .Output("out")
+            .ScopeSymbolId(op_conf.scope_symbol_id())
+            .Build();
+    OperatorConf quantized_op_conf = op_conf;
+    *quantized_op_conf.mutable_user_conf() = quantized_op.op_conf().user_conf();
+    quantized_op_confs.emplace_back(quantized_op_conf);
+    fake_quant2num_rewritten_consumers[operands.activation_fake_quant] += 1;
+    fake_quant2num_rewritten_consumers[operands.weight_fake_quant] += 1;
+  });
+  job_builder->MutOpsOnlyOnce(quantized_op_confs);
+  // Fake quantizations whose consumers were all rewritten are dead now, and so are the weight
+  // observers that only fed dead fake quantizations.
+  HashSet<const OpNode*> dead_nodes;
+  for (const auto& pair : fake_quant2num_rewritten_consumers) {
+    if (pair.first->out_edges().size() == pair.second) { dead_nodes.insert(pair.first); }
+  }
+  for (const OpNode* observer : weight_observers) {
+    bool all_consumers_dead = true;
+    for (const OpEdge* edge : observer->out_edges()) {
+      all_consumers_dead = all_consumers_dead && dead_nodes.count(edge->dst_node()) > 0;
+    }
+    if (all_consumers_dead) { dead_nodes.insert(observer); }
+  }
+  std::vector<std::string> dead_op_names;
+  for (const OpNode* node : dead_nodes) { dead_op_names.emplace_back(node->op().op_name()); }
+  job_builder->DelOps(dead_op_names);
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+REGISTER_JOB_PASS("Int8InferencePass", Int8InferencePass);
+
+}  // namespace oneflow
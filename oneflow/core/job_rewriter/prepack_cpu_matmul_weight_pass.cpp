@@ -0,0 +1,71 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job_rewriter/job_pass.h"
+#include "oneflow/core/framework/framework.h"
+
+namespace oneflow {
+
+namespace {
+
+// Marks cpu matmuls whose b is a variable so that the kernel packs b once instead of on every
+// launch. Only inference jobs qualify, the variables of training jobs are updated every step. A
+// fp32 b which is not transposed is left alone, the packed layout would be a plain copy of it.
+class PrepackCpuMatmulWeightPass final : public JobPass {
+ public:
+  PrepackCpuMatmulWeightPass() = default;
+  ~PrepackCpuMatmulWeightPass() override = default;
+
+  bool IsEnabled(const JobPassCtx& ctx) const {
+    return ctx.job_desc().job_conf().enable_cpu_matmul_weight_prepack()
+           && !ctx.job_desc().IsTrain();
+  }
+  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder) const;
+
+  Maybe<void> Apply(Job* job, JobPassCtx* ctx) const override {
+    if (!IsEnabled(*ctx)) { return Maybe<void>::Ok(); }
+    const OpGraph op_graph(*job);
+    JobBuilder job_builder(job);
+    return Apply(op_graph, &job_builder);
+  }
+};
+
+Maybe<void> PrepackCpuMatmulWeightPass::Apply(const OpGraph& op_graph,
+                                              JobBuilder* job_builder) const {
+  op_graph.ForEachNode([&](const OpNode* op_node) {
+    const OperatorConf& op_conf = op_node->op().op_conf();
+    if (!op_conf.has_user_conf()) { return; }
+    const std::string& op_type_name = op_conf.user_conf().op_type_name();
+    if (op_type_name != "matmul" && op_type_name != "broadcast_matmul") { return; }
+    if (op_node->parallel_desc().device_type() != DeviceType::kCPU) { return; }
+    const user_op::UserOpConfWrapper user_op_conf(op_conf);
+    const LogicalBlobId b_lbi = GenLogicalBlobId(user_op_conf.input("b", 0));
+    if (!op_graph.ProducerOpNode4Lbi(b_lbi).op().op_conf().has_variable_conf()) { return; }
+    if (op_node->LogicalBlobDesc4Lbi(b_lbi).data_type() == DataType::kFloat
+        && !user_op_conf.attr<bool>("transpose_b")) {
+      return;
+    }
+    OperatorConf new_op_conf = op_conf;
+    (*new_op_conf.mutable_user_conf()->mutable_attr())["prepack_b"].set_at_bool(true);
+    job_builder->MutOpsOnlyOnce({new_op_conf});
+  });
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+REGISTER_JOB_PASS("PrepackCpuMatmulWeightPass", PrepackCpuMatmulWeightPass);
+
+}  // namespace oneflow
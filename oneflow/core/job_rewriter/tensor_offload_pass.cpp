@@ -0,0 +1,214 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/job_rewriter/job_pass.h"
+#include "oneflow/core/job/job.pb.h"
+#include "oneflow/core/job/sbp_parallel.h"
+#include "oneflow/core/job_rewriter/calculation_pass.h"
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/operator/operator.h"
+
+namespace oneflow {
+
+namespace {
+
+// TensorOffloadPass moves forward activations which are only used again by the backward pass
+// out of device memory. Each activation gets a tensor_offload op right after it is produced, a
+// tensor_prefetch op a few ops before its first backward use and a tensor_reload op which
+// replaces it for all backward consumers.
+class TensorOffloadPass final : public JobPass {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(TensorOffloadPass);
+  TensorOffloadPass() = default;
+  ~TensorOffloadPass() override = default;
+
+  bool IsEnabled(const JobPassCtx& ctx) const {
+    return ctx.job_desc().IsTrain() && !ctx.job_desc().job_conf().tensor_offload_tier().empty();
+  }
+
+  Maybe<void> Apply(Job* job, JobPassCtx* ctx) const override {
+    if (!IsEnabled(*ctx)) { return Maybe<void>::Ok(); }
+    const OpGraph op_graph(*job);
+    JobBuilder job_builder(job);
+    return Apply(op_graph, &job_builder, ctx->job_desc());
+  }
+
+  Maybe<void> Apply(const OpGraph& op_graph, JobBuilder* job_builder,
+                    const JobDesc& job_desc) const;
+};
+
+const std::string kTensorOffloadOpNamePrefix = "System-TensorOffload-";
+// Number of ops in topological order between a tensor_prefetch and the tensor_reload it
+// prepares, which gives the disk reads time to finish.
+constexpr int64_t kDefaultPrefetchDistance = 8;
+
+std::string OffloadKey(const std::string& job_name, const std::string& lbn) {
+  std::string key = job_name + "-" + lbn;
+  std::replace(key.begin(), key.end(), '/', '-');
+  return key;
+}
+
+Maybe<void> TensorOffloadPass::Apply(const OpGraph& op_graph, JobBuilder* job_builder,
+                                     const JobDesc& job_desc) const {
+  const std::string& tier = job_desc.job_conf().tensor_offload_tier();
+  CHECK_OR_RETURN(tier == "host" || tier == "disk")
+      << "tensor_offload_tier must be \"host\" or \"disk\" but got \"" << tier << "\"";
+  const std::string& dir = job_desc.job_conf().tensor_offload_dir();
+  CHECK_OR_RETURN(tier != "disk" || !dir.empty())
+      << "tensor_offload_dir is required when offloading tensors to disk";
+  const int64_t min_bytes = job_desc.job_conf().tensor_offload_min_bytes();
+  const int64_t prefetch_distance =
+      ParseIntegerFromEnv("ONEFLOW_TENSOR_OFFLOAD_PREFETCH_DISTANCE", kDefaultPrefetchDistance);
+
+  // step 1. order all ops, the order must be the same on all ranks
+  std::vector<const OpNode*> ordered_op_nodes;
+  HashMap<const OpNode*, int64_t> op_node2order;
+  NameSortedTopoForEachNode(op_graph, [&](const OpNode* op_node) {
+    op_node2order.emplace(op_node, ordered_op_nodes.size());
+    ordered_op_nodes.emplace_back(op_node);
+  });
+
+  // step 2. offload each activation which is big enough and used by the backward pass
+  HashMap<std::string, OperatorConf> bw_consumer_op_name2conf;
+  int64_t offloaded_tensor_num = 0;
+  int64_t offloaded_bytes = 0;
+  for (const OpNode* producer : ordered_op_nodes) {
+    const OperatorConf& producer_conf = producer->op().op_conf();
+    if (!producer_conf.has_user_conf() || !IsForwardOpNode(producer)) { continue; }
+    // activations of checkpointing subgraphs are already recomputed by the backward pass
+    if (producer->op().op_name().rfind(kCheckpointingFakeOpNamePrefix, 0) == 0) { continue; }
+    const int64_t producer_order = op_node2order.at(producer);
+    for (const std::string& obn : producer->op().output_bns()) {
+      const LogicalBlobId& lbi = producer->op().BnInOp2Lbi(obn);
+      const BlobDesc& logical_blob_desc = producer->LogicalBlobDesc4Lbi(lbi);
+      if (logical_blob_desc.is_dynamic()) { continue; }
+      const int64_t bytes = DeviceBytes4Lbi(producer, lbi);
+      if (bytes < min_bytes) { continue; }
+
+      std::vector<const OpNode*> bw_consumers;
+      for (const OpEdge* out_edge : producer->out_edges()) {
+        const OpNode* consumer = out_edge->dst_node();
+        if (!consumer->op().op_conf().has_user_conf() || IsForwardOpNode(consumer)) { continue; }
+        if (std::find(out_edge->lbis().begin(), out_edge->lbis().end(), lbi)
+            == out_edge->lbis().end()) {
+          continue;
+        }
+        bw_consumers.emplace_back(consumer);
+      }
+      if (bw_consumers.empty()) { continue; }
+      std::sort(bw_consumers.begin(), bw_consumers.end(),
+                [&](const OpNode* lhs, const OpNode* rhs) {
+                  return op_node2order.at(lhs) < op_node2order.at(rhs);
+                });
+      const OpNode* first_bw_consumer = bw_consumers.front();
+
+      // The reload starts once every other input of the first backward consumer is ready, the
+      // tensor is not worth offloading when that happens right after it is produced.
+      const OpNode* reload_after = nullptr;
+      first_bw_consumer->ForEachNodeOnInEdge([&](const OpNode* in_node) {
+        if (reload_after == nullptr || op_node2order.at(in_node) > op_node2order.at(reload_after)) {
+          reload_after = in_node;
+        }
+      });
+      CHECK_NOTNULL_OR_RETURN(reload_after);
+      const int64_t reload_order = op_node2order.at(reload_after);
+      if (reload_order <= producer_order + 1) { continue; }
+      const OpNode* prefetch_after = nullptr;
+      for (int64_t i = std::max(reload_order - prefetch_distance, producer_order + 1);
+           i <= reload_order; ++i) {
+        if (ordered_op_nodes.at(i)->parallel_desc() == producer->parallel_desc()) {
+          prefetch_after = ordered_op_nodes.at(i);
+          break;
+        }
+      }
+
+      const std::string lbn = GenLogicalBlobName(lbi);
+      const std::string key = OffloadKey(job_desc.job_name(), lbn);
+      const std::string op_name_prefix = kTensorOffloadOpNamePrefix + lbn;
+      const int64_t bw_scope_symbol_id = first_bw_consumer->op().op_conf().scope_symbol_id();
+      const auto offload_op =
+          user_op::UserOpConfWrapperBuilder(op_name_prefix + "-offload")
+              .Op("tensor_offload")
+              .Input("in", lbn)
+              .Output("token")
+              .Attr<std::string>("key", key)
+              .Attr<std::string>("dir", tier == "disk" ? dir : "")
+              .ScopeSymbolId(producer_conf.scope_symbol_id())
+              .Build();
+      const auto prefetch_op = user_op::UserOpConfWrapperBuilder(op_name_prefix + "-prefetch")
+                                   .Op("tensor_prefetch")
+                                   .Input("in", offload_op.output("token", 0))
+                                   .Output("out")
+                                   .Attr<std::string>("key", key)
+                                   .ScopeSymbolId(bw_scope_symbol_id)
+                                   .Build();
+      const auto reload_op =
+          user_op::UserOpConfWrapperBuilder(op_name_prefix + "-reload")
+              .Op("tensor_reload")
+              .Input("token", prefetch_op.output("out", 0))
+              .Output("out")
+              .Attr<std::string>("key", key)
+              .Attr<Shape>("shape", logical_blob_desc.shape())
+              .Attr<DataType>("dtype", logical_blob_desc.data_type())
+              .Attr<std::vector<std::string>>("nd_sbp",
+                                              NdSbpToStringList(producer->NdSbp4Lbi(lbi)))
+              .ScopeSymbolId(bw_scope_symbol_id)
+              .Build();
+      OperatorConf prefetch_op_conf = prefetch_op.op_conf();
+      if (prefetch_after != nullptr) {
+        prefetch_op_conf.add_ctrl_in_op_name(prefetch_after->op().op_name());
+      }
+      OperatorConf reload_op_conf = reload_op.op_conf();
+      reload_op_conf.add_ctrl_in_op_name(reload_after->op().op_name());
+      job_builder->AddOps(producer->parallel_desc().parallel_conf(),
+                          {offload_op.op_conf(), prefetch_op_conf, reload_op_conf});
+
+      // step 3. let backward consumers read the reloaded tensor
+      const std::string reload_lbn = reload_op.output("out", 0);
+      for (const OpNode* bw_consumer : bw_consumers) {
+        const std::string& consumer_name = bw_consumer->op().op_name();
+        auto it = bw_consumer_op_name2conf.find(consumer_name);
+        if (it == bw_consumer_op_name2conf.end()) {
+          it = bw_consumer_op_name2conf.emplace(consumer_name, bw_consumer->op().op_conf()).first;
+        }
+        for (auto& pair : *it->second.mutable_user_conf()->mutable_input()) {
+          for (int i = 0; i < pair.second.s_size(); ++i) {
+            if (pair.second.s(i) == lbn) { pair.second.set_s(i, reload_lbn); }
+          }
+        }
+      }
+      offloaded_tensor_num += 1;
+      offloaded_bytes += bytes;
+    }
+  }
+
+  // step 4. update bw consumers in job builder only once
+  std::vector<OperatorConf> bw_consumer_op_confs;
+  bw_consumer_op_confs.reserve(bw_consumer_op_name2conf.size());
+  for (const auto& pair : bw_consumer_op_name2conf) {
+    bw_consumer_op_confs.emplace_back(pair.second);
+  }
+  job_builder->MutOpsOnlyOnce(bw_consumer_op_confs);
+  LOG(INFO) << "TensorOffloadPass offloads " << offloaded_tensor_num << " tensors ("
+            << offloaded_bytes << " bytes per device) of job " << job_desc.job_name() << " to "
+            << tier;
+  return Maybe<void>::Ok();
+}
+
+}  // namespace
+
+REGISTER_JOB_PASS("TensorOffloadPass", TensorOffloadPass);
+
+}  // namespace oneflow
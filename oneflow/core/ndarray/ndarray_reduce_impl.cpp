@@ -17,26 +17,291 @@ limitations under the License.
 #include "oneflow/core/common/preprocessor.h"
 #include "oneflow/core/ndarray/ndarray_reduce_impl.h"
 #include "oneflow/core/ndarray/binary_func.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
 
 namespace oneflow {
 
-#define SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(struct_name)                                        \
-  template<typename T, template<typename> class binary_func>                                   \
-  struct struct_name<DeviceType::kCPU, T, binary_func> final {                                 \
-    using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;                        \
-    static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {       \
-      return false;                                                                            \
-    }                                                                                          \
-    static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,                       \
-                       const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) { \
-      UNIMPLEMENTED();                                                                         \
-    }                                                                                          \
-  }
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayScalarReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixRowReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayMatrixColReduce);
-SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL(NdarrayXYZCubeXZReduce);
-#undef SPECIALIZE_CPU_NDARRAY_REDUCE_IMPL
+namespace {
+
+// Elements reduced by one task, tasks are distributed over the threads of the cpu stream. The
+// partition only depends on the shape, so results don't change with the number of threads.
+constexpr int64_t kReduceBlockSize = 16384;
+constexpr int64_t kPairwiseBlockSize = 128;
+constexpr int64_t kNumPartialAccs = 8;
+constexpr int64_t kMaxNumPartialBlocks = 64;
+constexpr int64_t kColTileSize = 512;
+
+int64_t DivUp(int64_t x, int64_t y) { return (x + y - 1) / y; }
+
+template<typename T>
+struct ReduceAccType {
+  using type = T;
+};
+
+template<>
+struct ReduceAccType<float16> {
+  using type = float;
+};
+
+template<typename T, template<typename> class binary_func>
+struct CpuReduceFunc final {
+  using AccT = typename ReduceAccType<T>::type;
+  // float sums are pairwise or compensated so that the error doesn't grow with the length
+  static constexpr bool kIsFloatSum =
+      std::is_floating_point<AccT>::value
+      && (std::is_same<binary_func<AccT>, BinaryFuncSum<AccT>>::value
+          || std::is_same<binary_func<AccT>, BinaryFuncAdd<AccT>>::value);
+
+  static AccT Unit() { return UnitOfBinaryFunc<AccT, binary_func>::Val(); }
+
+  static AccT Invoke(AccT x, AccT y) { return static_cast<AccT>(binary_func<AccT>::Invoke(x, y)); }
+
+  // Reduces n contiguous elements. The independent partial accumulators let the compiler
+  // vectorize the loop, float sums are split in halves until the blocks are short enough.
+  template<typename U>
+  static AccT ReduceContiguous(const U* x, int64_t n) {
+    if (kIsFloatSum && n > kPairwiseBlockSize) {
+      int64_t half = n / 2;
+      half -= half % kNumPartialAccs;
+      return ReduceContiguous(x, half) + ReduceContiguous(x + half, n - half);
+    }
+    AccT acc[kNumPartialAccs];
+    std::fill(acc, acc + kNumPartialAccs, Unit());
+    int64_t i = 0;
+    for (; i + kNumPartialAccs <= n; i += kNumPartialAccs) {
+      for (int64_t j = 0; j < kNumPartialAccs; ++j) {
+        acc[j] = Invoke(acc[j], static_cast<AccT>(x[i + j]));
+      }
+    }
+    for (; i < n; ++i) { acc[0] = Invoke(acc[0], static_cast<AccT>(x[i])); }
+    for (int64_t j = 1; j < kNumPartialAccs; ++j) { acc[0] = Invoke(acc[0], acc[j]); }
+    return acc[0];
+  }
+
+  // Kahan summation for strided float sums, which are accumulated across lanes
+  static void Accumulate(AccT* acc, AccT* compensation, AccT x) {
+    Accumulate(acc, compensation, x, std::integral_constant<bool, kIsFloatSum>());
+  }
+
+ private:
+  static void Accumulate(AccT* acc, AccT* compensation, AccT x, std::true_type) {
+    const AccT y = x - *compensation;
+    const AccT t = *acc + y;
+    *compensation = (t - *acc) - y;
+    *acc = t;
+  }
+  static void Accumulate(AccT* acc, AccT* compensation, AccT x, std::false_type) {
+    *acc = Invoke(*acc, x);
+  }
+};
+
+template<typename T, template<typename> class binary_func, typename RetT>
+void CpuRowReduce(ep::Stream* stream, int64_t num_rows, int64_t num_cols, const T* x, RetT* y) {
+  using F = CpuReduceFunc<T, binary_func>;
+  using AccT = typename F::AccT;
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  const int64_t num_blocks_per_row = DivUp(num_cols, kReduceBlockSize);
+  if (num_blocks_per_row == 1) {
+    cpu_stream->ParallelFor(
+        0, num_rows,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            y[i] = static_cast<RetT>(F::ReduceContiguous(x + i * num_cols, num_cols));
+          }
+        },
+        std::max<int64_t>(kReduceBlockSize / std::max<int64_t>(num_cols, 1), 1));
+    return;
+  }
+  // long rows are split into blocks which are reduced in parallel
+  std::vector<AccT> partials(num_rows * num_blocks_per_row);
+  cpu_stream->ParallelFor(
+      0, partials.size(),
+      [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+          const int64_t row = i / num_blocks_per_row;
+          const int64_t col = (i % num_blocks_per_row) * kReduceBlockSize;
+          partials[i] = F::ReduceContiguous(x + row * num_cols + col,
+                                            std::min(kReduceBlockSize, num_cols - col));
+        }
+      },
+      1);
+  FOR_RANGE(int64_t, row, 0, num_rows) {
+    y[row] = static_cast<RetT>(
+        F::ReduceContiguous(partials.data() + row * num_blocks_per_row, num_blocks_per_row));
+  }
+}
+
+// Reduces partials of shape (num_blocks, n) along the first axis
+template<typename T, template<typename> class binary_func, typename RetT>
+void CpuReducePartialBlocks(ep::Stream* stream, int64_t num_blocks, int64_t n,
+                            const typename CpuReduceFunc<T, binary_func>::AccT* partials,
+                            RetT* y) {
+  using F = CpuReduceFunc<T, binary_func>;
+  using AccT = typename F::AccT;
+  stream->As<ep::CpuStream>()->ParallelFor(0, n, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      AccT acc = F::Unit();
+      AccT compensation = 0;
+      for (int64_t b = 0; b < num_blocks; ++b) {
+        F::Accumulate(&acc, &compensation, partials[b * n + i]);
+      }
+      y[i] = static_cast<RetT>(acc);
+    }
+  });
+}
+
+template<typename T, template<typename> class binary_func, typename RetT>
+void CpuColReduce(ep::Stream* stream, int64_t num_rows, int64_t num_cols, const T* x, RetT* y) {
+  using F = CpuReduceFunc<T, binary_func>;
+  using AccT = typename F::AccT;
+  if (num_rows == 0) {
+    std::fill(y, y + num_cols, static_cast<RetT>(F::Unit()));
+    return;
+  }
+  const int64_t max_num_row_blocks = std::min(num_rows, kMaxNumPartialBlocks);
+  const int64_t rows_per_block = DivUp(
+      num_rows,
+      std::min(std::max<int64_t>(num_rows * num_cols / kReduceBlockSize, 1), max_num_row_blocks));
+  const int64_t num_row_blocks = DivUp(num_rows, rows_per_block);
+  const int64_t num_col_tiles = DivUp(num_cols, kColTileSize);
+  std::vector<AccT> partials(num_row_blocks > 1 ? num_row_blocks * num_cols : 0);
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, num_row_blocks * num_col_tiles,
+      [&](int64_t begin, int64_t end) {
+        AccT acc[kColTileSize];
+        AccT compensation[kColTileSize];
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t row_block = task / num_col_tiles;
+          const int64_t col_begin = (task % num_col_tiles) * kColTileSize;
+          const int64_t tile_size = std::min(kColTileSize, num_cols - col_begin);
+          std::fill(acc, acc + tile_size, F::Unit());
+          std::fill(compensation, compensation + tile_size, AccT(0));
+          const int64_t row_end = std::min(num_rows, (row_block + 1) * rows_per_block);
+          for (int64_t row = row_block * rows_per_block; row < row_end; ++row) {
+            const T* x_row = x + row * num_cols + col_begin;
+            for (int64_t j = 0; j < tile_size; ++j) {
+              F::Accumulate(acc + j, compensation + j, static_cast<AccT>(x_row[j]));
+            }
+          }
+          if (num_row_blocks == 1) {
+            for (int64_t j = 0; j < tile_size; ++j) {
+              y[col_begin + j] = static_cast<RetT>(acc[j]);
+            }
+          } else {
+            std::copy(acc, acc + tile_size, partials.data() + row_block * num_cols + col_begin);
+          }
+        }
+      },
+      1);
+  if (num_row_blocks > 1) {
+    CpuReducePartialBlocks<T, binary_func>(stream, num_row_blocks, num_cols, partials.data(), y);
+  }
+}
+
+template<typename T, template<typename> class binary_func, typename RetT>
+void CpuXYZCubeXZReduce(ep::Stream* stream, int64_t dim_x, int64_t dim_y, int64_t dim_z,
+                        const T* x, RetT* y) {
+  using F = CpuReduceFunc<T, binary_func>;
+  using AccT = typename F::AccT;
+  if (dim_x == 0) {
+    std::fill(y, y + dim_y, static_cast<RetT>(F::Unit()));
+    return;
+  }
+  const int64_t max_num_x_blocks = std::min(dim_x, kMaxNumPartialBlocks);
+  const int64_t x_per_block = DivUp(
+      dim_x, std::min(std::max<int64_t>(dim_x * dim_z / kReduceBlockSize, 1), max_num_x_blocks));
+  const int64_t num_x_blocks = DivUp(dim_x, x_per_block);
+  std::vector<AccT> partials(num_x_blocks > 1 ? num_x_blocks * dim_y : 0);
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, num_x_blocks * dim_y,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t task = begin; task < end; ++task) {
+          const int64_t x_block = task / dim_y;
+          const int64_t j = task % dim_y;
+          AccT acc = F::Unit();
+          AccT compensation = 0;
+          const int64_t x_end = std::min(dim_x, (x_block + 1) * x_per_block);
+          for (int64_t i = x_block * x_per_block; i < x_end; ++i) {
+            F::Accumulate(&acc, &compensation,
+                          F::ReduceContiguous(x + (i * dim_y + j) * dim_z, dim_z));
+          }
+          if (num_x_blocks == 1) {
+            y[j] = static_cast<RetT>(acc);
+          } else {
+            partials[x_block * dim_y + j] = acc;
+          }
+        }
+      },
+      std::max<int64_t>(kReduceBlockSize / std::max<int64_t>(x_per_block * dim_z, 1), 1));
+  if (num_x_blocks > 1) {
+    CpuReducePartialBlocks<T, binary_func>(stream, num_x_blocks, dim_y, partials.data(), y);
+  }
+}
+
+}  // namespace
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayScalarReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    return y.shape().ElemNum() == 1;
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    CpuRowReduce<T, binary_func>(stream, 1, x.shape().ElemNum(), x.ptr(), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixRowReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return x.shape().At(0) == y.shape().At(0) && y.shape().At(1) == 1;
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    CpuRowReduce<T, binary_func>(stream, x.shape().At(0), x.shape().At(1), x.ptr(), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayMatrixColReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 2) { return false; }
+    if (y.shape().NumAxes() != 2) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1);
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    CpuColReduce<T, binary_func>(stream, x.shape().At(0), x.shape().At(1), x.ptr(), y.ptr());
+  }
+};
+
+template<typename T, template<typename> class binary_func>
+struct NdarrayXYZCubeXZReduce<DeviceType::kCPU, T, binary_func> final {
+  using RetT = typename BinaryFuncTrait<binary_func, T>::return_type;
+  static bool Matched(const XpuVarNdarray<RetT>& y, const XpuVarNdarray<const T>& x) {
+    if (x.shape().NumAxes() != 3) { return false; }
+    if (y.shape().NumAxes() != 3) { return false; }
+    return y.shape().At(0) == 1 && x.shape().At(1) == y.shape().At(1) && y.shape().At(2) == 1;
+  }
+
+  static void Reduce(ep::Stream* stream, const XpuVarNdarray<RetT>& y,
+                     const XpuVarNdarray<const T>& x, const XpuVarNdarray<T>& tmp_storage) {
+    CHECK(Matched(y, x));
+    CpuXYZCubeXZReduce<T, binary_func>(stream, x.shape().At(0), x.shape().At(1), x.shape().At(2),
+                                       x.ptr(), y.ptr());
+  }
+};
 
 #define INSTANTIATE_NDARRAY_REDUCE_IMPL(dtype, binary_func)                                       \
   template struct NdarrayScalarReduce<DeviceType::kCPU, OF_PP_PAIR_FIRST(dtype), binary_func>;    \
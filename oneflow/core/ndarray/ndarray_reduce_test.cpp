@@ -0,0 +1,178 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include "oneflow/core/ep/test/benchmark_util.h"
+#include "oneflow/core/ndarray/ndarray_reduce.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+class NdarrayReduceTest : public ep::test::TestCase {};
+
+class NdarrayReduceBenchmark : public ep::test::BenchmarkCase {};
+
+// reduced axes of y have dim 1
+double ReduceSumReference(const std::vector<float>& x, const Shape& x_shape,
+                          const Shape& y_shape, int64_t y_index) {
+  double sum = 0;
+  const int64_t num_axes = x_shape.NumAxes();
+  FOR_RANGE(int64_t, i, 0, x_shape.elem_cnt()) {
+    int64_t offset = i;
+    int64_t y_offset = 0;
+    int64_t y_stride = 1;
+    for (int64_t axis = num_axes - 1; axis >= 0; --axis) {
+      const int64_t coord = offset % x_shape.At(axis);
+      offset /= x_shape.At(axis);
+      if (y_shape.At(axis) != 1) { y_offset += coord * y_stride; }
+      y_stride *= y_shape.At(axis);
+    }
+    if (y_offset == y_index) { sum += x.at(i); }
+  }
+  return sum;
+}
+
+void TestReduceSum(ep::Stream* stream, const Shape& x_shape, const Shape& y_shape) {
+  std::vector<float> x(x_shape.elem_cnt());
+  FOR_RANGE(size_t, i, 0, x.size()) { x[i] = 0.1f + 0.01f * (i % 13); }
+  std::vector<float> y(y_shape.elem_cnt());
+  std::vector<float> tmp(x.size());
+  NdarrayReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(
+      stream, XpuVarNdarray<float>(y_shape, y.data()),
+      XpuVarNdarray<const float>(x_shape, x.data()), XpuVarNdarray<float>(x_shape, tmp.data()));
+  FOR_RANGE(int64_t, i, 0, y_shape.elem_cnt()) {
+    const double expected = ReduceSumReference(x, x_shape, y_shape, i);
+    ASSERT_NEAR(y[i], expected, std::abs(expected) * 1e-6) << x_shape.ToString() << " " << i;
+  }
+}
+
+}  // namespace
+
+TEST_F(NdarrayReduceTest, sum) {
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  ep::test::StreamGuard stream(device.get());
+  // scalar
+  TestReduceSum(stream.stream(), Shape({1 << 20}), Shape({1}));
+  TestReduceSum(stream.stream(), Shape({7, 9, 11}), Shape({1, 1, 1}));
+  // rows, also longer than one block
+  TestReduceSum(stream.stream(), Shape({33, 1000}), Shape({33, 1}));
+  TestReduceSum(stream.stream(), Shape({3, 100001}), Shape({3, 1}));
+  // columns, also with partial blocks over rows
+  TestReduceSum(stream.stream(), Shape({1000, 77}), Shape({1, 77}));
+  TestReduceSum(stream.stream(), Shape({5000, 1031}), Shape({1, 1031}));
+  // xz of a cube
+  TestReduceSum(stream.stream(), Shape({16, 5, 49}), Shape({1, 5, 1}));
+  TestReduceSum(stream.stream(), Shape({300, 3, 1000}), Shape({1, 3, 1}));
+}
+
+TEST_F(NdarrayReduceTest, max) {
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  ep::test::StreamGuard stream(device.get());
+  const int64_t num_rows = 129;
+  const int64_t num_cols = 257;
+  std::vector<int32_t> x(num_rows * num_cols);
+  FOR_RANGE(size_t, i, 0, x.size()) { x[i] = static_cast<int32_t>((i * 7919) % 100003) - 50000; }
+  std::vector<int32_t> row_max(num_rows);
+  std::vector<int32_t> col_max(num_cols);
+  std::vector<int32_t> tmp(x.size());
+  NdarrayReduce<DeviceType::kCPU, int32_t, BinaryFuncMax>::Reduce(
+      stream.stream(), XpuVarNdarray<int32_t>(Shape({num_rows, 1}), row_max.data()),
+      XpuVarNdarray<const int32_t>(Shape({num_rows, num_cols}), x.data()),
+      XpuVarNdarray<int32_t>(Shape({num_rows, num_cols}), tmp.data()));
+  NdarrayReduce<DeviceType::kCPU, int32_t, BinaryFuncMax>::Reduce(
+      stream.stream(), XpuVarNdarray<int32_t>(Shape({1, num_cols}), col_max.data()),
+      XpuVarNdarray<const int32_t>(Shape({num_rows, num_cols}), x.data()),
+      XpuVarNdarray<int32_t>(Shape({num_rows, num_cols}), tmp.data()));
+  FOR_RANGE(int64_t, i, 0, num_rows) {
+    ASSERT_EQ(row_max[i], *std::max_element(x.begin() + i * num_cols,
+                                            x.begin() + (i + 1) * num_cols));
+  }
+  FOR_RANGE(int64_t, j, 0, num_cols) {
+    int32_t expected = x[j];
+    FOR_RANGE(int64_t, i, 0, num_rows) { expected = std::max(expected, x[i * num_cols + j]); }
+    ASSERT_EQ(col_max[j], expected);
+  }
+}
+
+TEST_F(NdarrayReduceTest, float_sum_accuracy) {
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  ep::test::StreamGuard stream(device.get());
+  // a naive float sum of 2^24 elements of 0.1 is off by more than 10%
+  const int64_t n = 1 << 24;
+  std::vector<float> x(n, 0.1f);
+  std::vector<float> tmp(n);
+  float scalar_sum = 0;
+  NdarrayReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(
+      stream.stream(), XpuVarNdarray<float>(Shape({1}), &scalar_sum),
+      XpuVarNdarray<const float>(Shape({n}), x.data()),
+      XpuVarNdarray<float>(Shape({n}), tmp.data()));
+  ASSERT_NEAR(scalar_sum, n * static_cast<double>(0.1f), n * 1e-7);
+  std::vector<float> col_sum(2);
+  NdarrayReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(
+      stream.stream(), XpuVarNdarray<float>(Shape({1, 2}), col_sum.data()),
+      XpuVarNdarray<const float>(Shape({n / 2, 2}), x.data()),
+      XpuVarNdarray<float>(Shape({n / 2, 2}), tmp.data()));
+  ASSERT_NEAR(col_sum[0], n / 2 * static_cast<double>(0.1f), n * 1e-7);
+}
+
+TEST_F(NdarrayReduceBenchmark, ReduceSumBenchmark) {
+  struct Case {
+    std::string name;
+    Shape x_shape;
+    Shape y_shape;
+  };
+  const std::vector<Case> cases = {
+      {"scalar/loss", Shape({32 * 1000 * 128}), Shape({1})},
+      {"row/layer_norm", Shape({4096, 768}), Shape({4096, 1})},
+      {"row/softmax", Shape({32 * 12 * 128, 128}), Shape({32 * 12 * 128, 1})},
+      {"col/bias_grad_bert_ffn", Shape({4096, 3072}), Shape({1, 3072})},
+      {"col/bias_grad_fc", Shape({256, 1000}), Shape({1, 1000})},
+      {"xz/bn_resnet50_conv2", Shape({32, 64, 56 * 56}), Shape({1, 64, 1})},
+      {"xz/bn_resnet50_conv5", Shape({32, 2048, 7 * 7}), Shape({1, 2048, 1})},
+  };
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  for (const auto& c : cases) {
+    std::vector<float> x(c.x_shape.elem_cnt(), 0.5f);
+    std::vector<float> y(c.y_shape.elem_cnt());
+    std::vector<float> tmp(x.size());
+    XpuVarNdarray<float> y_ndarray(c.y_shape, y.data());
+    XpuVarNdarray<const float> x_ndarray(c.x_shape, x.data());
+    XpuVarNdarray<float> tmp_ndarray(c.x_shape, tmp.data());
+    const double bytes = (x.size() + y.size()) * sizeof(float);
+    ForEachDeviceAndNumThreads([&](ep::Device* device, size_t num_threads) {
+      if (device->device_type() != DeviceType::kCPU) { return; }
+      ep::test::StreamGuard stream(device);
+      const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+        NdarrayReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(stream.stream(), y_ndarray,
+                                                                     x_ndarray, tmp_ndarray);
+      });
+      Report("reduce_sum/" + c.name, DeviceType::kCPU, num_threads, time_us, bytes, 0);
+      // the axis by axis reduction every shape fell back to before
+      const double default_time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+        NdarrayDefaultReduce<DeviceType::kCPU, float, BinaryFuncSum>::Reduce(
+            stream.stream(), y_ndarray, x_ndarray, tmp_ndarray);
+      });
+      Report("reduce_sum_default/" + c.name, DeviceType::kCPU, num_threads, default_time_us, bytes,
+             0);
+    });
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -26,6 +26,21 @@ namespace oneflow {
 
 namespace fs {
 
+Maybe<void> WritableFile::TryAppend(const char* data, size_t n) {
+  Append(data, n);
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> WritableFile::TryClose() {
+  Close();
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> WritableFile::TryFlush() {
+  Flush();
+  return Maybe<void>::Ok();
+}
+
 std::string FileSystem::SplitRecursiveDir(const std::string& dirname,
                                           std::vector<std::string>& sub_dirs) {
   std::string remaining_dir = dirname;
@@ -44,6 +59,35 @@ std::string FileSystem::SplitRecursiveDir(const std::string& dirname,
   return remaining_dir;
 }
 
+constexpr size_t FileSystem::kDirectIoAlignment;
+
+void FileSystem::NewDirectWritableFile(const std::string& fname,
+                                       std::unique_ptr<WritableFile>* result) {
+  NewWritableFile(fname, result);
+}
+
+void FileSystem::NewDirectAppendableFile(const std::string& fname,
+                                         std::unique_ptr<WritableFile>* result) {
+  NewAppendableFile(fname, result);
+}
+
+Maybe<void> FileSystem::TryNewWritableFile(const std::string& fname,
+                                           std::unique_ptr<WritableFile>* result) {
+  NewWritableFile(fname, result);
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> FileSystem::TryNewDirectWritableFile(const std::string& fname,
+                                                 std::unique_ptr<WritableFile>* result) {
+  NewDirectWritableFile(fname, result);
+  return Maybe<void>::Ok();
+}
+
+Maybe<void> FileSystem::TryRenameFile(const std::string& old_name, const std::string& new_name) {
+  RenameFile(old_name, new_name);
+  return Maybe<void>::Ok();
+}
+
 void FileSystem::CreateDirIfNotExist(const std::string& dirname) {
   if (IsDirectory(dirname)) { return; }
   CreateDir(dirname);
@@ -63,6 +107,24 @@ void FileSystem::RecursivelyCreateDirIfNotExist(const std::string& dirname) {
   }
 }
 
+void FileSystem::TruncateFile(const std::string& fname, uint64_t size) {
+  CHECK_LE(size, GetFileSize(fname));
+  const std::string temp_fname = fname + ".truncating";
+  std::unique_ptr<RandomAccessFile> src;
+  NewRandomAccessFile(fname, &src);
+  std::unique_ptr<WritableFile> dst;
+  NewWritableFile(temp_fname, &dst);
+  constexpr uint64_t kCopyBufferSize = 4 << 20;
+  std::vector<char> buffer(std::min(size, kCopyBufferSize));
+  for (uint64_t offset = 0; offset < size; offset += buffer.size()) {
+    const size_t n = std::min<uint64_t>(buffer.size(), size - offset);
+    src->Read(offset, n, buffer.data());
+    dst->Append(buffer.data(), n);
+  }
+  dst->Close();
+  RenameFile(temp_fname, fname);
+}
+
 bool FileSystem::IsDirEmpty(const std::string& dirname) { return ListDir(dirname).empty(); }
 
 std::string FileSystem::TranslateName(const std::string& name) const { return CleanPath(name); }
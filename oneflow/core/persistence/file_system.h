@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_PERSISTENCE_FILE_SYSTEM_H_
 #define ONEFLOW_CORE_PERSISTENCE_FILE_SYSTEM_H_
 
+#include "oneflow/core/common/maybe.h"
 #include "oneflow/core/common/platform.h"
 #include "oneflow/core/common/util.h"
 
@@ -69,11 +70,19 @@ class WritableFile {
   // persisted, depending on the implementation.
   virtual void Flush() = 0;
 
+  // Like Append, Close and Flush, but return the error instead of aborting. The implementations
+  // in this class call those, a file system overrides them where it can report the error.
+  virtual Maybe<void> TryAppend(const char* data, size_t n);
+  virtual Maybe<void> TryClose();
+  virtual Maybe<void> TryFlush();
+
  private:
 };
 
 class FileSystem {
  public:
+  static constexpr size_t kDirectIoAlignment = 4096;
+
   virtual ~FileSystem() = default;
 
   // Creates a brand new random access read-only file with the
@@ -115,6 +124,25 @@ class FileSystem {
   virtual void NewAppendableFile(const std::string& fname,
                                  std::unique_ptr<WritableFile>* result) = 0;
 
+  // Like NewWritableFile, but the data appended in multiples of kDirectIoAlignment from buffers
+  // aligned to kDirectIoAlignment bypasses the page cache where the file system supports it.
+  // Other appends are written as usual. Falls back to NewWritableFile by default.
+  virtual void NewDirectWritableFile(const std::string& fname,
+                                     std::unique_ptr<WritableFile>* result);
+
+  // Like NewAppendableFile, with the direct io of NewDirectWritableFile. Falls back to
+  // NewAppendableFile by default.
+  virtual void NewDirectAppendableFile(const std::string& fname,
+                                       std::unique_ptr<WritableFile>* result);
+
+  // Like NewWritableFile, NewDirectWritableFile and RenameFile, but return the error instead of
+  // aborting. The implementations in this class call those.
+  virtual Maybe<void> TryNewWritableFile(const std::string& fname,
+                                         std::unique_ptr<WritableFile>* result);
+  virtual Maybe<void> TryNewDirectWritableFile(const std::string& fname,
+                                               std::unique_ptr<WritableFile>* result);
+  virtual Maybe<void> TryRenameFile(const std::string& old_name, const std::string& new_name);
+
   // Returns true if the named path exists and false otherwise.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -151,6 +179,10 @@ class FileSystem {
   // Overwrites the target if it exists.
   virtual void RenameFile(const std::string& old_name, const std::string& new_name) = 0;
 
+  // Keeps the first `size` bytes of `fname`. The implementation in this class copies them to a
+  // new file and renames it to `fname`.
+  virtual void TruncateFile(const std::string& fname, uint64_t size);
+
   // Translate an URI to a filename for the FileSystem implementation.
   //
   // The implementation in this class cleans up the path, removing
@@ -14,26 +14,246 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/persistence/persistent_out_stream.h"
+#include <sstream>
+#include "oneflow/core/common/crc32c.h"
 #include "oneflow/core/common/str_util.h"
 #include "oneflow/core/control/ctrl_client.h"
 #include "oneflow/core/control/global_process_ctx.h"
 
 namespace oneflow {
 
-PersistentOutStream::PersistentOutStream(fs::FileSystem* fs, const std::string& file_path) {
+namespace {
+
+std::string TempPath(const std::string& file_path) { return file_path + ".tmp"; }
+
+std::string ChecksumPath(const std::string& file_path) { return file_path + ".crc32c"; }
+
+// The checksum file has a line "<size> <crc32c>" for every block, a torn last line is ignored.
+bool ReadChecksums(fs::FileSystem* fs, const std::string& checksum_path,
+                   std::vector<std::pair<size_t, uint32_t>>* blocks) {
+  if (!fs->FileExists(checksum_path)) { return false; }
+  std::string content(fs->GetFileSize(checksum_path), '\0');
+  if (!content.empty()) {
+    std::unique_ptr<fs::RandomAccessFile> file;
+    fs->NewRandomAccessFile(checksum_path, &file);
+    file->Read(0, content.size(), &content.at(0));
+  }
+  const size_t end = content.rfind('\n');
+  std::istringstream lines(end == std::string::npos ? "" : content.substr(0, end + 1));
+  size_t size = 0;
+  uint32_t crc = 0;
+  while (lines >> size >> crc) { blocks->emplace_back(size, crc); }
+  return lines.eof();
+}
+
+// Returns the number of leading blocks which are in the file and match their checksums.
+size_t CountVerifiedBlocks(fs::FileSystem* fs, const std::string& file_path,
+                           const std::vector<std::pair<size_t, uint32_t>>& blocks) {
+  if (!fs->FileExists(file_path)) { return 0; }
+  const uint64_t file_size = fs->GetFileSize(file_path);
+  size_t max_block_size = 0;
+  for (const auto& block : blocks) { max_block_size = std::max(max_block_size, block.first); }
+  std::unique_ptr<fs::RandomAccessFile> file;
+  if (file_size > 0) { fs->NewRandomAccessFile(file_path, &file); }
+  std::vector<char> buffer(max_block_size);
+  uint64_t offset = 0;
+  size_t block_num = 0;
+  for (const auto& block : blocks) {
+    if (offset + block.first > file_size) { break; }
+    if (block.first > 0) { file->Read(offset, block.first, buffer.data()); }
+    if (Crc32c(buffer.data(), block.first) != block.second) { break; }
+    offset += block.first;
+    block_num += 1;
+  }
+  return block_num;
+}
+
+bool VerifyBlocks(fs::FileSystem* fs, const std::string& file_path,
+                  const std::vector<std::pair<size_t, uint32_t>>& blocks) {
+  size_t file_size = 0;
+  for (const auto& block : blocks) { file_size += block.first; }
+  if (!fs->FileExists(file_path) || fs->GetFileSize(file_path) != file_size) { return false; }
+  return CountVerifiedBlocks(fs, file_path, blocks) == blocks.size();
+}
+
+}  // namespace
+
+PersistentOutStreamConf::PersistentOutStreamConf()
+    : block_size(ParseIntegerFromEnv("ONEFLOW_PERSISTENT_OUT_STREAM_BLOCK_SIZE_KB", 1024) * 1024),
+      buffer_num(2),
+      direct_io(false),
+      atomic(false),
+      resume(false) {}
+
+PersistentOutStream::PersistentOutStream(fs::FileSystem* fs, const std::string& file_path)
+    : PersistentOutStream(fs, file_path, PersistentOutStreamConf()) {}
+
+PersistentOutStream::PersistentOutStream(fs::FileSystem* fs, const std::string& file_path,
+                                         const PersistentOutStreamConf& conf)
+    : fs_(fs), file_path_(file_path), conf_(conf), resumed_size_(0), closed_(false) {
+  CHECK_GT(conf_.block_size, 0);
+  CHECK_GT(conf_.buffer_num, 0);
   std::string file_dir = Dirname(file_path);
   OfCallOnce(GlobalProcessCtx::LogDirEntry() + "/" + file_dir, fs,
              &fs::FileSystem::RecursivelyCreateDirIfNotExist, file_dir);
-  fs->NewWritableFile(file_path, &file_);
+  if (!(conf_.atomic && conf_.resume && TryResume())) {
+    const auto& opened = OpenFiles();
+    // the other streams append to the file right away
+    if (!IsBuffered()) { CHECK_JUST(opened); }
+    error_ = opened.GetDataAndErrorProto();
+  }
+  // NOTE: without atomic or direct_io the stream appends to the file directly, so the streams
+  //   with the default conf, such as logs, take no buffers and no thread.
+  if (!IsBuffered()) { return; }
+  // the buffers are aligned for direct io
+  const size_t alignment = fs::FileSystem::kDirectIoAlignment;
+  FOR_RANGE(int64_t, i, 0, conf_.buffer_num) {
+    buffers_.emplace_back(new char[conf_.block_size + alignment]);
+    void* data = buffers_.back().get();
+    size_t space = conf_.block_size + alignment;
+    CHECK_NOTNULL(std::align(alignment, conf_.block_size, data, space));
+    free_blocks_.Send(Block{static_cast<char*>(data), 0, 0});
+  }
+  CHECK_EQ(free_blocks_.Receive(&cur_block_), kChannelStatusSuccess);
+  write_thread_ = std::thread(&PersistentOutStream::WriteBlocks, this);
+}
+
+PersistentOutStream::~PersistentOutStream() {
+  if (!closed_) { CHECK_JUST(Close()); }
+}
+
+Maybe<void> PersistentOutStream::Close() {
+  if (closed_) { return Maybe<void>::Ok(); }
+  closed_ = true;
+  if (IsBuffered()) {
+    if (cur_block_.size > 0) { SubmitCurBlock(/*is_last=*/true); }
+    full_blocks_.Close();
+    write_thread_.join();
+    free_blocks_.Close();
+  }
+  if (error_) { return Maybe<void>(error_); }
+  JUST(file_->TryClose());
+  if (conf_.atomic) {
+    JUST(checksum_file_->TryClose());
+    // the data file is renamed last, so that its presence means the file is complete
+    const std::string temp_path = TempPath(file_path_);
+    JUST(fs_->TryRenameFile(ChecksumPath(temp_path), ChecksumPath(file_path_)));
+    JUST(fs_->TryRenameFile(temp_path, file_path_));
+  }
+  return Maybe<void>::Ok();
 }
 
-PersistentOutStream::~PersistentOutStream() { file_->Close(); }
+bool PersistentOutStream::TryResume() {
+  const std::string temp_path = TempPath(file_path_);
+  std::vector<std::pair<size_t, uint32_t>> blocks;
+  if (!ReadChecksums(fs_, ChecksumPath(temp_path), &blocks)) { return false; }
+  // the data after the last verified block, written without its checksum or torn, is dropped
+  blocks.resize(CountVerifiedBlocks(fs_, temp_path, blocks));
+  if (blocks.empty()) { return false; }
+  size_t verified_size = 0;
+  for (const auto& block : blocks) { verified_size += block.first; }
+  if (fs_->GetFileSize(temp_path) != verified_size) { fs_->TruncateFile(temp_path, verified_size); }
+  if (conf_.direct_io) {
+    fs_->NewDirectAppendableFile(temp_path, &file_);
+  } else {
+    fs_->NewAppendableFile(temp_path, &file_);
+  }
+  // rewritten to drop a torn last line
+  fs_->NewWritableFile(ChecksumPath(temp_path), &checksum_file_);
+  for (const auto& block : blocks) {
+    const std::string line =
+        std::to_string(block.first) + " " + std::to_string(block.second) + "\n";
+    checksum_file_->Append(line.data(), line.size());
+    resumed_size_ += block.first;
+  }
+  checksum_file_->Flush();
+  return true;
+}
+
+Maybe<void> PersistentOutStream::OpenFiles() {
+  const std::string path = conf_.atomic ? TempPath(file_path_) : file_path_;
+  if (conf_.direct_io) {
+    JUST(fs_->TryNewDirectWritableFile(path, &file_));
+  } else {
+    JUST(fs_->TryNewWritableFile(path, &file_));
+  }
+  if (conf_.atomic) { JUST(fs_->TryNewWritableFile(ChecksumPath(path), &checksum_file_)); }
+  return Maybe<void>::Ok();
+}
 
 PersistentOutStream& PersistentOutStream::Write(const char* s, size_t n) {
-  file_->Append(s, n);
+  if (!IsBuffered()) {
+    file_->Append(s, n);
+    return *this;
+  }
+  while (n > 0) {
+    const size_t copy_size = std::min(n, conf_.block_size - cur_block_.size);
+    std::memcpy(cur_block_.data + cur_block_.size, s, copy_size);
+    cur_block_.size += copy_size;
+    s += copy_size;
+    n -= copy_size;
+    if (cur_block_.size == conf_.block_size) { SubmitCurBlock(/*is_last=*/false); }
+  }
   return *this;
 }
 
-void PersistentOutStream::Flush() { file_->Flush(); }
+void PersistentOutStream::Flush() {
+  if (IsBuffered()) {
+    if (cur_block_.size > 0) { SubmitCurBlock(/*is_last=*/false); }
+    WaitAllBlocksWritten();
+    // the failure is returned by Close
+    if (error_) { return; }
+  }
+  file_->Flush();
+}
+
+void PersistentOutStream::SubmitCurBlock(bool is_last) {
+  // NOTE: the checksum is computed here rather than on the write thread, so that it overlaps with
+  //   the write of the previous block.
+  if (checksum_file_) { cur_block_.crc = Crc32c(cur_block_.data, cur_block_.size); }
+  CHECK_EQ(full_blocks_.Send(cur_block_), kChannelStatusSuccess);
+  if (!is_last) { CHECK_EQ(free_blocks_.Receive(&cur_block_), kChannelStatusSuccess); }
+}
+
+void PersistentOutStream::WaitAllBlocksWritten() {
+  // all the blocks but the current one are written once they are back in the free list
+  std::vector<Block> blocks(conf_.buffer_num - 1);
+  for (Block& block : blocks) { CHECK_EQ(free_blocks_.Receive(&block), kChannelStatusSuccess); }
+  for (Block& block : blocks) { CHECK_EQ(free_blocks_.Send(block), kChannelStatusSuccess); }
+}
+
+void PersistentOutStream::WriteBlocks() {
+  Block block{};
+  while (full_blocks_.Receive(&block) == kChannelStatusSuccess) {
+    // NOTE: the blocks after a failure are dropped, so that Write never blocks on a dead stream
+    if (!error_) { error_ = WriteBlock(block).GetDataAndErrorProto(); }
+    block.size = 0;
+    CHECK_EQ(free_blocks_.Send(block), kChannelStatusSuccess);
+  }
+}
+
+Maybe<void> PersistentOutStream::WriteBlock(const Block& block) {
+  JUST(file_->TryAppend(block.data, block.size));
+  if (checksum_file_) {
+    // the checksum of a block is recorded after the block, so that a resumed stream never
+    // trusts a block which has not been written completely
+    JUST(file_->TryFlush());
+    const std::string line = std::to_string(block.size) + " " + std::to_string(block.crc) + "\n";
+    JUST(checksum_file_->TryAppend(line.data(), line.size()));
+    JUST(checksum_file_->TryFlush());
+  }
+  return Maybe<void>::Ok();
+}
+
+bool VerifyPersistentFile(fs::FileSystem* fs, const std::string& file_path) {
+  std::vector<std::pair<size_t, uint32_t>> blocks;
+  if (!ReadChecksums(fs, ChecksumPath(file_path), &blocks)) { return false; }
+  return VerifyBlocks(fs, file_path, blocks);
+}
+
+void DeletePersistentFile(fs::FileSystem* fs, const std::string& file_path) {
+  if (fs->FileExists(file_path)) { fs->DelFile(file_path); }
+  if (fs->FileExists(ChecksumPath(file_path))) { fs->DelFile(ChecksumPath(file_path)); }
+}
 
 }  // namespace oneflow
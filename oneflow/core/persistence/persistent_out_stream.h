@@ -16,11 +16,31 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_PERSISTENCE_PERSISTENT_OUT_STREAM_H_
 #define ONEFLOW_CORE_PERSISTENCE_PERSISTENT_OUT_STREAM_H_
 
+#include <thread>
+#include "oneflow/core/common/channel.h"
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/persistence/file_system.h"
 
 namespace oneflow {
 
+struct PersistentOutStreamConf {
+  // Size of the blocks handed to the file, ONEFLOW_PERSISTENT_OUT_STREAM_BLOCK_SIZE_KB by default.
+  // The blocks are written on a background thread, only with `direct_io` or `atomic`.
+  size_t block_size;
+  // Number of blocks buffered, one is filled by Write while the others are being written.
+  int64_t buffer_num;
+  // Bypasses the page cache, see fs::FileSystem::NewDirectWritableFile.
+  bool direct_io;
+  // Writes to `file_path + ".tmp"` and renames it to `file_path` when the stream is closed. A
+  // CRC32C of every block is kept in `file_path + ".crc32c"`, see VerifyPersistentFile.
+  bool atomic;
+  // With `atomic`, continues the temp file left by an interrupted stream from its last block
+  // which matches its checksum, see PersistentOutStream::resumed_size.
+  bool resume;
+
+  PersistentOutStreamConf();
+};
+
 class PersistentOutStream final {
  public:
   OF_DISALLOW_COPY_AND_MOVE(PersistentOutStream);
@@ -28,17 +48,63 @@ class PersistentOutStream final {
   ~PersistentOutStream();
 
   PersistentOutStream(fs::FileSystem*, const std::string& file_path);
+  PersistentOutStream(fs::FileSystem*, const std::string& file_path,
+                      const PersistentOutStreamConf& conf);
 
   // Write block of data
   // Inserts the first n characters of the array pointed by s into the stream.
   PersistentOutStream& Write(const char* s, size_t n);
 
+  // Blocks until all the data written has been handed to the file.
   void Flush();
 
+  // Hands the rest of the data to the file and closes it, with `atomic` renames it to `file_path`.
+  // A buffered stream returns the first failure to open or write its files here rather than
+  // aborting, in which case an atomic stream leaves `file_path` untouched. Does nothing when
+  // called again. The destructor closes the stream if needed and aborts on failure.
+  Maybe<void> Close();
+
+  // Size of the data kept from an interrupted stream, the caller continues writing from there.
+  size_t resumed_size() const { return resumed_size_; }
+
  private:
+  struct Block {
+    char* data;
+    size_t size;
+    uint32_t crc;
+  };
+
+  bool IsBuffered() const { return conf_.atomic || conf_.direct_io; }
+  bool TryResume();
+  Maybe<void> OpenFiles();
+  void SubmitCurBlock(bool is_last);
+  void WaitAllBlocksWritten();
+  void WriteBlocks();
+  Maybe<void> WriteBlock(const Block& block);
+
+  fs::FileSystem* fs_;
+  std::string file_path_;
+  PersistentOutStreamConf conf_;
   std::unique_ptr<fs::WritableFile> file_;
+  std::unique_ptr<fs::WritableFile> checksum_file_;
+  size_t resumed_size_;
+  // the first failure of a buffered stream, set by the write thread once it is started
+  std::shared_ptr<ErrorProto> error_;
+  bool closed_;
+
+  std::vector<std::unique_ptr<char[]>> buffers_;
+  Block cur_block_;
+  Channel<Block> free_blocks_;
+  Channel<Block> full_blocks_;
+  std::thread write_thread_;
 };
 
+// Checks a file written by an atomic PersistentOutStream against the checksums of its blocks.
+bool VerifyPersistentFile(fs::FileSystem* fs, const std::string& file_path);
+
+// Deletes a file written by an atomic PersistentOutStream together with its checksums.
+void DeletePersistentFile(fs::FileSystem* fs, const std::string& file_path);
+
 template<typename T>
 typename std::enable_if<std::is_fundamental<T>::value, PersistentOutStream&>::type operator<<(
     PersistentOutStream& out_stream, const T& x) {
@@ -0,0 +1,280 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <chrono>
+#include "oneflow/core/common/process_state.h"
+#include "oneflow/core/common/str_util.h"
+#include "oneflow/core/control/ctrl_bootstrap.pb.h"
+#include "oneflow/core/persistence/persistent_out_stream.h"
+#include "oneflow/core/persistence/posix/posix_file_system.h"
+
+namespace oneflow {
+
+namespace test {
+
+#ifdef OF_PLATFORM_POSIX
+
+namespace {
+
+// PersistentOutStream names its directories after the log dir entry of the process.
+struct ProcessCtxScope final {
+  ProcessCtxScope() {
+    Singleton<ProcessCtx>::New();
+    auto* addr = Singleton<ProcessCtx>::Get()->mutable_ctrl_addr()->Add();
+    addr->set_host("localhost");
+    addr->set_port(0);
+    Singleton<ProcessCtx>::Get()->set_rank(0);
+    Singleton<ProcessCtx>::Get()->set_node_size(1);
+  }
+  ~ProcessCtxScope() { Singleton<ProcessCtx>::Delete(); }
+};
+
+std::string TestDir(fs::FileSystem* fs, const std::string& name) {
+  std::string current_dir = GetCwd();
+  StringReplace(&current_dir, '\\', '/');
+  const std::string dir = JoinPath(current_dir, "tmp_persistent_out_stream_test", name);
+  if (fs->IsDirectory(dir)) { fs->RecursivelyDeleteDir(dir); }
+  fs->RecursivelyCreateDir(dir);
+  return dir;
+}
+
+std::string ReadAll(fs::FileSystem* fs, const std::string& path) {
+  std::string content(fs->GetFileSize(path), '\0');
+  if (content.empty()) { return content; }
+  std::unique_ptr<fs::RandomAccessFile> file;
+  fs->NewRandomAccessFile(path, &file);
+  file->Read(0, content.size(), &content.at(0));
+  return content;
+}
+
+std::string MakeContent(size_t size) {
+  std::string content;
+  for (size_t i = 0; i < size; ++i) { content.push_back(static_cast<char>(i % 251)); }
+  return content;
+}
+
+// Writes in pieces of varying size with a flush in the middle.
+void WriteInPieces(PersistentOutStream* out_stream, const std::string& content) {
+  size_t offset = 0;
+  for (size_t i = 1; offset < content.size(); ++i) {
+    const size_t size = std::min(i * 37 % 9000, content.size() - offset);
+    out_stream->Write(content.data() + offset, size);
+    offset += size;
+    if (i == 50) { out_stream->Flush(); }
+  }
+}
+
+}  // namespace
+
+TEST(PersistentOutStream, buffered_write) {
+  ProcessCtxScope scope;
+  fs::PosixFileSystem fs;
+  const std::string dir = TestDir(&fs, "buffered_write");
+  const std::string content = MakeContent(100000);
+  for (bool direct_io : {false, true}) {
+    PersistentOutStreamConf conf;
+    conf.block_size = 3 * fs::FileSystem::kDirectIoAlignment;
+    conf.buffer_num = 3;
+    conf.direct_io = direct_io;
+    const std::string path = JoinPath(dir, direct_io ? "direct" : "buffered");
+    {
+      PersistentOutStream out_stream(&fs, path, conf);
+      WriteInPieces(&out_stream, content);
+    }
+    ASSERT_EQ(ReadAll(&fs, path), content);
+  }
+  fs.RecursivelyDeleteDir(dir);
+}
+
+TEST(PersistentOutStream, atomic_write_with_checksum) {
+  ProcessCtxScope scope;
+  fs::PosixFileSystem fs;
+  const std::string dir = TestDir(&fs, "atomic_write_with_checksum");
+  const std::string content = MakeContent(100000);
+  const std::string path = JoinPath(dir, "file");
+  PersistentOutStreamConf conf;
+  conf.block_size = 4096;
+  conf.atomic = true;
+  {
+    PersistentOutStream out_stream(&fs, path, conf);
+    WriteInPieces(&out_stream, content);
+    ASSERT_FALSE(fs.FileExists(path));
+  }
+  ASSERT_FALSE(fs.FileExists(path + ".tmp"));
+  ASSERT_EQ(ReadAll(&fs, path), content);
+  ASSERT_TRUE(VerifyPersistentFile(&fs, path));
+
+  std::string corrupted = content;
+  corrupted.at(5000) ^= 1;
+  std::unique_ptr<fs::WritableFile> file;
+  fs.NewWritableFile(path, &file);
+  file->Append(corrupted.data(), corrupted.size());
+  file->Close();
+  ASSERT_FALSE(VerifyPersistentFile(&fs, path));
+  fs.RecursivelyDeleteDir(dir);
+}
+
+TEST(PersistentOutStream, close_returns_failure) {
+  ProcessCtxScope scope;
+  fs::PosixFileSystem fs;
+  const std::string dir = TestDir(&fs, "close_returns_failure");
+  const std::string content = MakeContent(100000);
+  const std::string path = JoinPath(dir, "file");
+  // the temp file can not be opened where a directory has its name
+  fs.RecursivelyCreateDir(path + ".tmp");
+  PersistentOutStreamConf conf;
+  conf.block_size = 4096;
+  conf.atomic = true;
+  {
+    PersistentOutStream out_stream(&fs, path, conf);
+    WriteInPieces(&out_stream, content);
+    ASSERT_FALSE(out_stream.Close().IsOk());
+    ASSERT_TRUE(out_stream.Close().IsOk());
+  }
+  ASSERT_FALSE(fs.FileExists(path));
+  fs.RecursivelyDeleteDir(dir);
+}
+
+TEST(PersistentOutStream, resume) {
+  ProcessCtxScope scope;
+  fs::PosixFileSystem fs;
+  const std::string dir = TestDir(&fs, "resume");
+  const std::string content = MakeContent(100000);
+  const std::string path = JoinPath(dir, "file");
+  PersistentOutStreamConf conf;
+  conf.block_size = 4096;
+  conf.atomic = true;
+  // leaves the temp files of a stream interrupted after 10000 bytes
+  const auto Interrupt = [&]() {
+    {
+      PersistentOutStream out_stream(&fs, path, conf);
+      out_stream.Write(content.data(), 10000);
+    }
+    fs.RenameFile(path, path + ".tmp");
+    fs.RenameFile(path + ".crc32c", path + ".tmp.crc32c");
+  };
+  conf.resume = true;
+
+  Interrupt();
+  {
+    PersistentOutStream out_stream(&fs, path, conf);
+    ASSERT_EQ(out_stream.resumed_size(), 10000);
+    out_stream.Write(content.data() + 10000, content.size() - 10000);
+  }
+  ASSERT_EQ(ReadAll(&fs, path), content);
+  ASSERT_TRUE(VerifyPersistentFile(&fs, path));
+
+  // data not covered by the checksums is truncated and the verified blocks are kept
+  Interrupt();
+  std::unique_ptr<fs::WritableFile> file;
+  fs.NewAppendableFile(path + ".tmp", &file);
+  file->Append("torn", 4);
+  file->Close();
+  {
+    PersistentOutStream out_stream(&fs, path, conf);
+    ASSERT_EQ(out_stream.resumed_size(), 10000);
+    out_stream.Write(content.data() + 10000, content.size() - 10000);
+  }
+  ASSERT_EQ(ReadAll(&fs, path), content);
+  ASSERT_TRUE(VerifyPersistentFile(&fs, path));
+
+  // a corrupted block and the ones after it are written again
+  Interrupt();
+  fs.NewWritableFile(path + ".tmp", &file);
+  std::string corrupted = content.substr(0, 10000);
+  corrupted.at(5000) ^= 1;
+  file->Append(corrupted.data(), corrupted.size());
+  file->Close();
+  {
+    PersistentOutStream out_stream(&fs, path, conf);
+    ASSERT_EQ(out_stream.resumed_size(), 4096);
+    out_stream.Write(content.data() + 4096, content.size() - 4096);
+  }
+  ASSERT_EQ(ReadAll(&fs, path), content);
+
+  // the resumed stream keeps writing with direct io
+  conf.direct_io = true;
+  Interrupt();
+  {
+    PersistentOutStream out_stream(&fs, path, conf);
+    ASSERT_EQ(out_stream.resumed_size(), 10000);
+    out_stream.Write(content.data() + 10000, content.size() - 10000);
+  }
+  ASSERT_EQ(ReadAll(&fs, path), content);
+  ASSERT_TRUE(VerifyPersistentFile(&fs, path));
+  fs.RecursivelyDeleteDir(dir);
+}
+
+// Skipped unless ONEFLOW_PERSISTENT_OUT_STREAM_BENCHMARK is set, writes
+// ONEFLOW_PERSISTENT_OUT_STREAM_BENCHMARK_SIZE_MB (default 1024) in 1MB pieces to the posix file
+// system under the working directory and records the throughput of every configuration.
+TEST(PersistentOutStream, write_throughput_benchmark) {
+  if (!ParseBooleanFromEnv("ONEFLOW_PERSISTENT_OUT_STREAM_BENCHMARK", false)) {
+    GTEST_SKIP() << "set ONEFLOW_PERSISTENT_OUT_STREAM_BENCHMARK=1 to run the benchmark";
+  }
+  ProcessCtxScope scope;
+  fs::PosixFileSystem fs;
+  const std::string dir = TestDir(&fs, "benchmark");
+  const size_t total_size =
+      ParseIntegerFromEnv("ONEFLOW_PERSISTENT_OUT_STREAM_BENCHMARK_SIZE_MB", 1024) << 20;
+  const std::string piece(1 << 20, 'x');
+  const auto Measure = [&](const std::string& name, const std::function<void()>& Write) {
+    const auto start = std::chrono::steady_clock::now();
+    Write();
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const int64_t mb_per_second = static_cast<int64_t>(total_size / seconds / (1 << 20));
+    std::cout << name << ": " << mb_per_second << " MB/s" << std::endl;
+    ::testing::Test::RecordProperty(name + "_MBps", std::to_string(mb_per_second));
+    fs.RecursivelyDeleteDir(dir);
+    fs.RecursivelyCreateDir(dir);
+  };
+  Measure("posix_writable_file", [&]() {
+    std::unique_ptr<fs::WritableFile> file;
+    fs.NewWritableFile(JoinPath(dir, "file"), &file);
+    for (size_t size = 0; size < total_size; size += piece.size()) {
+      file->Append(piece.data(), piece.size());
+    }
+    file->Close();
+  });
+  for (size_t block_size_mb : {1, 4, 16}) {
+    for (bool direct_io : {false, true}) {
+      for (bool atomic : {false, true}) {
+        // without either the stream appends directly, which posix_writable_file measures
+        if (!direct_io && !atomic) { continue; }
+        PersistentOutStreamConf conf;
+        conf.block_size = block_size_mb << 20;
+        conf.direct_io = direct_io;
+        conf.atomic = atomic;
+        const std::string name = "block_" + std::to_string(block_size_mb) + "mb"
+                                 + (direct_io ? "_direct" : "") + (atomic ? "_atomic" : "");
+        Measure(name, [&]() {
+          PersistentOutStream out_stream(&fs, JoinPath(dir, "file"), conf);
+          for (size_t size = 0; size < total_size; size += piece.size()) {
+            out_stream.Write(piece.data(), piece.size());
+          }
+        });
+      }
+    }
+  }
+  fs.RecursivelyDeleteDir(dir);
+}
+
+#endif  // OF_PLATFORM_POSIX
+
+}  // namespace test
+
+}  // namespace oneflow
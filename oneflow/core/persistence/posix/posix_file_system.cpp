@@ -74,22 +74,112 @@ class PosixWritableFile : public WritableFile {
     if (file_ != nullptr) { fclose(file_); }
   }
 
-  void Append(const char* data, size_t n) override {
-    PCHECK(fwrite(data, sizeof(char), n, file_) == n)
-        << "Fail to append to file " << fname_ << ", errno is " << errno;
+  void Append(const char* data, size_t n) override { CHECK_JUST(TryAppend(data, n)); }
+
+  void Close() override { CHECK_JUST(TryClose()); }
+
+  void Flush() override { CHECK_JUST(TryFlush()); }
+
+  Maybe<void> TryAppend(const char* data, size_t n) override {
+    CHECK_OR_RETURN(fwrite(data, sizeof(char), n, file_) == n)
+        << Error::RuntimeError() << "Fail to append to file " << fname_ << ", errno is " << errno;
+    return Maybe<void>::Ok();
   }
 
-  void Close() override {
-    Flush();
-    PCHECK(fclose(file_) == 0) << "Fail to close file " << fname_ << ", errno is " << errno;
+  Maybe<void> TryClose() override {
+    JUST(TryFlush());
+    // NOTE: the stream is released even if fclose fails
+    FILE* file = file_;
     file_ = nullptr;
+    CHECK_OR_RETURN(fclose(file) == 0)
+        << Error::RuntimeError() << "Fail to close file " << fname_ << ", errno is " << errno;
+    return Maybe<void>::Ok();
+  }
+
+  Maybe<void> TryFlush() override {
+    CHECK_OR_RETURN(fflush(file_) == 0)
+        << Error::RuntimeError() << "Fail to flush file " << fname_ << ", errno is " << errno;
+    return Maybe<void>::Ok();
+  }
+};
+
+// Writes with O_DIRECT while the appends are aligned, the first unaligned append turns O_DIRECT
+// off for the rest of the file, which is usually only the tail.
+class PosixDirectWritableFile : public WritableFile {
+ private:
+  std::string fname_;
+  int fd_;
+  bool is_direct_;
+
+ public:
+  PosixDirectWritableFile(const std::string& fname, int fd, bool is_direct)
+      : fname_(fname), fd_(fd), is_direct_(is_direct) {}
+
+  ~PosixDirectWritableFile() override {
+    if (fd_ >= 0) { close(fd_); }
+  }
+
+  void Append(const char* data, size_t n) override { CHECK_JUST(TryAppend(data, n)); }
+
+  void Close() override { CHECK_JUST(TryClose()); }
+
+  Maybe<void> TryAppend(const char* data, size_t n) override {
+    const size_t alignment = FileSystem::kDirectIoAlignment;
+    if (is_direct_ && (reinterpret_cast<uintptr_t>(data) % alignment != 0 || n % alignment != 0)) {
+#ifdef O_DIRECT
+      const int flags = fcntl(fd_, F_GETFL);
+      CHECK_OR_RETURN(flags >= 0 && fcntl(fd_, F_SETFL, flags & ~O_DIRECT) == 0)
+          << Error::RuntimeError() << "Fail to turn off O_DIRECT of file " << fname_
+          << ", errno is " << errno;
+#endif
+      is_direct_ = false;
+    }
+    while (n > 0) {
+      ssize_t r = write(fd_, data, n);
+      if (r > 0) {
+        data += r;
+        n -= r;
+      } else {
+        CHECK_OR_RETURN(r < 0 && (errno == EINTR || errno == EAGAIN))
+            << Error::RuntimeError() << "Fail to append to file " << fname_ << ", errno is "
+            << errno;
+        // Retry
+      }
+    }
+    return Maybe<void>::Ok();
   }
 
-  void Flush() override {
-    PCHECK(fflush(file_) == 0) << "Fail to flush file " << fname_ << ", errno is " << errno;
+  Maybe<void> TryClose() override {
+    const int fd = fd_;
+    fd_ = -1;
+    CHECK_OR_RETURN(close(fd) == 0)
+        << Error::RuntimeError() << "Fail to close file " << fname_ << ", errno is " << errno;
+    return Maybe<void>::Ok();
   }
+
+  // NOTE: nothing is buffered in user space
+  void Flush() override {}
 };
 
+namespace {
+
+// Opens with O_DIRECT where the file system supports it, returns the fd or -1 on failure.
+int OpenDirectFile(const std::string& translated_fname, int flags, bool* is_direct) {
+  *is_direct = false;
+#ifdef O_DIRECT
+  int fd = open(translated_fname.c_str(), flags | O_DIRECT, 0644);
+  if (fd >= 0) {
+    *is_direct = true;
+    return fd;
+  }
+  // the file system, e.g. tmpfs, does not support O_DIRECT
+  if (errno != EINVAL) { return fd; }
+#endif
+  return open(translated_fname.c_str(), flags, 0644);
+}
+
+}  // namespace
+
 void PosixFileSystem::NewRandomAccessFile(const std::string& fname,
                                           std::unique_ptr<RandomAccessFile>* result) {
   std::string translated_fname = TranslateName(fname);
@@ -101,11 +191,17 @@ void PosixFileSystem::NewRandomAccessFile(const std::string& fname,
 
 void PosixFileSystem::NewWritableFile(const std::string& fname,
                                       std::unique_ptr<WritableFile>* result) {
+  CHECK_JUST(TryNewWritableFile(fname, result));
+}
+
+Maybe<void> PosixFileSystem::TryNewWritableFile(const std::string& fname,
+                                                std::unique_ptr<WritableFile>* result) {
   std::string translated_fname = TranslateName(fname);
   FILE* f = fopen(translated_fname.c_str(), "w");
-  PCHECK(f != nullptr) << "Fail to open file " << fname << ", errno is " << errno;
+  CHECK_OR_RETURN(f != nullptr) << Error::RuntimeError() << "Fail to open file " << fname
+                                << ", errno is " << errno;
   result->reset(new PosixWritableFile(translated_fname, f));
-  CHECK_NOTNULL(result->get());
+  return Maybe<void>::Ok();
 }
 
 void PosixFileSystem::NewAppendableFile(const std::string& fname,
@@ -117,6 +213,42 @@ void PosixFileSystem::NewAppendableFile(const std::string& fname,
   CHECK_NOTNULL(result->get());
 }
 
+void PosixFileSystem::NewDirectWritableFile(const std::string& fname,
+                                            std::unique_ptr<WritableFile>* result) {
+  CHECK_JUST(TryNewDirectWritableFile(fname, result));
+}
+
+Maybe<void> PosixFileSystem::TryNewDirectWritableFile(const std::string& fname,
+                                                      std::unique_ptr<WritableFile>* result) {
+  std::string translated_fname = TranslateName(fname);
+  bool is_direct = false;
+  const int fd = OpenDirectFile(translated_fname, O_WRONLY | O_CREAT | O_TRUNC, &is_direct);
+  CHECK_OR_RETURN(fd >= 0) << Error::RuntimeError() << "Fail to open file " << fname
+                           << ", errno is " << errno;
+  result->reset(new PosixDirectWritableFile(translated_fname, fd, is_direct));
+  return Maybe<void>::Ok();
+}
+
+void PosixFileSystem::NewDirectAppendableFile(const std::string& fname,
+                                              std::unique_ptr<WritableFile>* result) {
+  std::string translated_fname = TranslateName(fname);
+  bool is_direct = false;
+  const int fd = OpenDirectFile(translated_fname, O_WRONLY | O_CREAT | O_APPEND, &is_direct);
+  PCHECK(fd >= 0) << "Fail to open file " << fname << ", errno is " << errno;
+  const off_t size = lseek(fd, 0, SEEK_END);
+  PCHECK(size >= 0) << "Fail to seek file " << fname << ", errno is " << errno;
+  // O_DIRECT also needs the file offset aligned, which only the appends made from here keep
+  if (is_direct && size % FileSystem::kDirectIoAlignment != 0) {
+#ifdef O_DIRECT
+    const int flags = fcntl(fd, F_GETFL);
+    PCHECK(flags >= 0 && fcntl(fd, F_SETFL, flags & ~O_DIRECT) == 0)
+        << "Fail to turn off O_DIRECT of file " << fname << ", errno is " << errno;
+#endif
+    is_direct = false;
+  }
+  result->reset(new PosixDirectWritableFile(translated_fname, fd, is_direct));
+}
+
 bool PosixFileSystem::FileExists(const std::string& fname) {
   if (access(TranslateName(fname).c_str(), F_OK) == 0) { return true; }
   return false;
@@ -165,8 +297,20 @@ uint64_t PosixFileSystem::GetFileSize(const std::string& fname) {
 }
 
 void PosixFileSystem::RenameFile(const std::string& old_name, const std::string& new_name) {
-  PCHECK(rename(TranslateName(old_name).c_str(), TranslateName(new_name).c_str()) == 0)
-      << "Fail to rename file from " << old_name << " to " << new_name << ", errno is " << errno;
+  CHECK_JUST(TryRenameFile(old_name, new_name));
+}
+
+Maybe<void> PosixFileSystem::TryRenameFile(const std::string& old_name,
+                                           const std::string& new_name) {
+  CHECK_OR_RETURN(rename(TranslateName(old_name).c_str(), TranslateName(new_name).c_str()) == 0)
+      << Error::RuntimeError() << "Fail to rename file from " << old_name << " to " << new_name
+      << ", errno is " << errno;
+  return Maybe<void>::Ok();
+}
+
+void PosixFileSystem::TruncateFile(const std::string& fname, uint64_t size) {
+  PCHECK(truncate(TranslateName(fname).c_str(), size) == 0)
+      << "Fail to truncate file " << fname << " to " << size << " bytes, errno is " << errno;
 }
 
 bool PosixFileSystem::IsDirectory(const std::string& fname) {
@@ -37,6 +37,18 @@ class PosixFileSystem final : public FileSystem {
 
   void NewAppendableFile(const std::string& fname, std::unique_ptr<WritableFile>* result) override;
 
+  void NewDirectWritableFile(const std::string& fname,
+                             std::unique_ptr<WritableFile>* result) override;
+
+  void NewDirectAppendableFile(const std::string& fname,
+                               std::unique_ptr<WritableFile>* result) override;
+
+  Maybe<void> TryNewWritableFile(const std::string& fname,
+                                 std::unique_ptr<WritableFile>* result) override;
+
+  Maybe<void> TryNewDirectWritableFile(const std::string& fname,
+                                       std::unique_ptr<WritableFile>* result) override;
+
   bool FileExists(const std::string& fname) override;
 
   std::vector<std::string> ListDir(const std::string& dir) override;
@@ -53,6 +65,10 @@ class PosixFileSystem final : public FileSystem {
 
   void RenameFile(const std::string& old_name, const std::string& new_name) override;
 
+  Maybe<void> TryRenameFile(const std::string& old_name, const std::string& new_name) override;
+
+  void TruncateFile(const std::string& fname, uint64_t size) override;
+
   bool IsDirectory(const std::string& fname) override;
 
  private:
@@ -19,19 +19,25 @@ limitations under the License.
 
 namespace oneflow {
 
-TeePersistentLogStream::TeePersistentLogStream(const std::string& path) {
+TeePersistentLogStream::TeePersistentLogStream(const std::string& path,
+                                               const PersistentOutStreamConf& conf) {
   destinations_.emplace_back(LocalFS(), FLAGS_log_dir);
   branches_.reserve(destinations_.size());
   for (const auto& destination : destinations_) {
     branches_.emplace_back(std::make_unique<PersistentOutStream>(
-        destination.mut_file_system(), JoinPath(destination.base_dir(), path)));
+        destination.mut_file_system(), JoinPath(destination.base_dir(), path), conf));
   }
 }
 
 TeePersistentLogStream::~TeePersistentLogStream() { Flush(); }
 
 std::unique_ptr<TeePersistentLogStream> TeePersistentLogStream::Create(const std::string& path) {
-  auto stream_ptr = new TeePersistentLogStream(path);
+  return Create(path, PersistentOutStreamConf());
+}
+
+std::unique_ptr<TeePersistentLogStream> TeePersistentLogStream::Create(
+    const std::string& path, const PersistentOutStreamConf& conf) {
+  auto stream_ptr = new TeePersistentLogStream(path, conf);
   return std::unique_ptr<TeePersistentLogStream>(stream_ptr);
 }
 
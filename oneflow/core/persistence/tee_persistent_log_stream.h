@@ -44,10 +44,14 @@ class TeePersistentLogStream final {
   void Write(const PbMessage& proto);
 
   static std::unique_ptr<TeePersistentLogStream> Create(const std::string& path);
+  // Every destination is written with `conf`, e.g. `atomic` for a large dump which must not be
+  // left half written.
+  static std::unique_ptr<TeePersistentLogStream> Create(const std::string& path,
+                                                        const PersistentOutStreamConf& conf);
   void Flush();
 
  private:
-  explicit TeePersistentLogStream(const std::string& path);
+  TeePersistentLogStream(const std::string& path, const PersistentOutStreamConf& conf);
   std::vector<LogStreamDestination> destinations_;
   std::vector<std::unique_ptr<PersistentOutStream>> branches_;
 };
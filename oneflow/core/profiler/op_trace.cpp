@@ -0,0 +1,324 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <cmath>
+#include <mutex>
+#include <tuple>
+#include "nlohmann/json.hpp"
+#include "oneflow/core/profiler/op_trace.h"
+
+using json = nlohmann::json;
+
+namespace oneflow {
+
+namespace profiler {
+
+namespace {
+
+constexpr int32_t kMaxNumOpTraceIds = 4096;
+
+struct OpTraceRecord {
+  std::atomic<int32_t> id;
+  std::atomic<time_t> start;
+  std::atomic<time_t> end;
+};
+
+// Trace state of one thread. Only the owner thread records, queries may read it concurrently.
+class ThreadOpTrace final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(ThreadOpTrace);
+  ThreadOpTrace(int64_t thread_index, size_t capacity)
+      : thread_index_(thread_index),
+        capacity_(capacity),
+        records_(new OpTraceRecord[capacity]()),
+        histograms_(new std::atomic<LatencyHistogram*>[kMaxNumOpTraceIds]()),
+        head_(0),
+        begin_(0) {}
+  ~ThreadOpTrace() {
+    for (int32_t i = 0; i < kMaxNumOpTraceIds; ++i) { delete histograms_[i].load(); }
+  }
+
+  void Record(int32_t id, time_t start, time_t end) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    OpTraceRecord* record = &records_[head % capacity_];
+    record->id.store(id, std::memory_order_relaxed);
+    record->start.store(start, std::memory_order_relaxed);
+    record->end.store(end, std::memory_order_relaxed);
+    head_.store(head + 1, std::memory_order_release);
+    if (id < 0 || id >= kMaxNumOpTraceIds) { return; }
+    LatencyHistogram* histogram = histograms_[id].load(std::memory_order_acquire);
+    if (histogram == nullptr) {
+      histogram = new LatencyHistogram();
+      histograms_[id].store(histogram, std::memory_order_release);
+    }
+    histogram->Record(end - start);
+  }
+
+  const LatencyHistogram* histogram(int32_t id) const {
+    return histograms_[id].load(std::memory_order_acquire);
+  }
+
+  // Calls `Handler(id, start, end)` for the records in the ring buffer, from the oldest to the
+  // newest. Records overwritten by the owner thread while copying them are skipped.
+  void ForEachRecord(const std::function<void(int32_t, time_t, time_t)>& Handler) const {
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    const uint64_t begin =
+        std::max<uint64_t>(head > capacity_ ? head - capacity_ : 0, begin_.load());
+    std::vector<std::tuple<int32_t, time_t, time_t>> records;
+    records.reserve(head - begin);
+    for (uint64_t i = begin; i < head; ++i) {
+      const OpTraceRecord& record = records_[i % capacity_];
+      records.emplace_back(record.id.load(std::memory_order_relaxed),
+                           record.start.load(std::memory_order_relaxed),
+                           record.end.load(std::memory_order_relaxed));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t new_head = head_.load(std::memory_order_relaxed);
+    // the owner may be writing slot new_head % capacity_ before bumping the head, so the record
+    // new_head - capacity_ that lives there may be torn as well
+    const uint64_t valid_begin = new_head + 1 > capacity_ ? new_head + 1 - capacity_ : 0;
+    for (uint64_t i = std::max(begin, valid_begin); i < head; ++i) {
+      const auto& record = records.at(i - begin);
+      Handler(std::get<0>(record), std::get<1>(record), std::get<2>(record));
+    }
+  }
+
+  // Called by query threads, so the ring buffer is cleared by moving its begin instead of
+  // touching the head owned by the recording thread.
+  void Reset() {
+    begin_.store(head_.load(std::memory_order_acquire));
+    for (int32_t i = 0; i < kMaxNumOpTraceIds; ++i) {
+      LatencyHistogram* histogram = histograms_[i].load(std::memory_order_acquire);
+      if (histogram != nullptr) { histogram->Reset(); }
+    }
+  }
+
+  int64_t thread_index() const { return thread_index_; }
+
+ private:
+  int64_t thread_index_;
+  size_t capacity_;
+  std::unique_ptr<OpTraceRecord[]> records_;
+  std::unique_ptr<std::atomic<LatencyHistogram*>[]> histograms_;
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> begin_;
+};
+
+class OpTraceRegistry final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OpTraceRegistry);
+  OpTraceRegistry()
+      : enabled_(ParseBooleanFromEnv("ONEFLOW_PROFILER_ENABLE_OP_TRACE", false)),
+        buffer_size_(std::max<int64_t>(
+            ParseIntegerFromEnv("ONEFLOW_PROFILER_OP_TRACE_BUFFER_SIZE", 4096), 1)) {}
+  ~OpTraceRegistry() = default;
+
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+  void set_enabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+
+  int32_t Id4Name(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = name2id_.find(name);
+    if (it != name2id_.end()) { return it->second; }
+    const int32_t id = names_.size();
+    names_.emplace_back(name);
+    name2id_.emplace(name, id);
+    return id;
+  }
+
+  ThreadOpTrace* NewThreadOpTrace() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_traces_.emplace_back(
+        std::make_shared<ThreadOpTrace>(thread_traces_.size(), buffer_size_));
+    return thread_traces_.back().get();
+  }
+
+  // Thread traces are never released, so they can be read after the lock is released.
+  std::vector<std::shared_ptr<ThreadOpTrace>> thread_traces() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return thread_traces_;
+  }
+
+  std::vector<std::string> names() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return names_;
+  }
+
+ private:
+  std::atomic<bool> enabled_;
+  int64_t buffer_size_;
+  std::mutex mutex_;
+  std::vector<std::string> names_;
+  HashMap<std::string, int32_t> name2id_;
+  std::vector<std::shared_ptr<ThreadOpTrace>> thread_traces_;
+};
+
+// Never deleted, threads may record while static objects are being destroyed.
+OpTraceRegistry* GetOpTraceRegistry() {
+  static OpTraceRegistry* registry = new OpTraceRegistry();
+  return registry;
+}
+
+ThreadOpTrace* GetThisThreadOpTrace() {
+  thread_local ThreadOpTrace* thread_trace = GetOpTraceRegistry()->NewThreadOpTrace();
+  return thread_trace;
+}
+
+}  // namespace
+
+constexpr int64_t LatencyHistogram::kSubBucketBits;
+constexpr int64_t LatencyHistogram::kNumBuckets;
+
+LatencyHistogram::LatencyHistogram()
+    : buckets_(new std::atomic<int64_t>[kNumBuckets]()), count_(0), sum_(0), max_(0) {}
+
+void LatencyHistogram::Record(int64_t value) {
+  value = std::max<int64_t>(value, 0);
+  buckets_[BucketIndex4Value(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  int64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (int64_t i = 0; i < kNumBuckets; ++i) {
+    const int64_t bucket = other.buckets_[i].load(std::memory_order_relaxed);
+    if (bucket != 0) { buckets_[i].fetch_add(bucket, std::memory_order_relaxed); }
+  }
+  count_.fetch_add(other.count(), std::memory_order_relaxed);
+  sum_.fetch_add(other.sum(), std::memory_order_relaxed);
+  const int64_t other_max = other.max();
+  int64_t max = max_.load(std::memory_order_relaxed);
+  while (other_max > max
+         && !max_.compare_exchange_weak(max, other_max, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::Reset() {
+  for (int64_t i = 0; i < kNumBuckets; ++i) { buckets_[i].store(0, std::memory_order_relaxed); }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::ValueAtQuantile(double quantile) const {
+  int64_t total = 0;
+  for (int64_t i = 0; i < kNumBuckets; ++i) {
+    total += buckets_[i].load(std::memory_order_relaxed);
+  }
+  if (total == 0) { return 0; }
+  const int64_t rank =
+      std::min(std::max<int64_t>(static_cast<int64_t>(std::ceil(quantile * total)), 1), total);
+  int64_t accumulated = 0;
+  for (int64_t i = 0; i < kNumBuckets; ++i) {
+    accumulated += buckets_[i].load(std::memory_order_relaxed);
+    if (accumulated >= rank) { return std::min(MaxValue4BucketIndex(i), max()); }
+  }
+  return max();
+}
+
+/* static */ int64_t LatencyHistogram::BucketIndex4Value(int64_t value) {
+  constexpr int64_t kNumSubBuckets = int64_t(1) << kSubBucketBits;
+  if (value < kNumSubBuckets) { return std::max<int64_t>(value, 0); }
+  const int64_t shift = 63 - __builtin_clzll(value) - kSubBucketBits;
+  return ((shift + 1) << kSubBucketBits) + ((value >> shift) & (kNumSubBuckets - 1));
+}
+
+/* static */ int64_t LatencyHistogram::MaxValue4BucketIndex(int64_t index) {
+  constexpr int64_t kNumSubBuckets = int64_t(1) << kSubBucketBits;
+  if (index < kNumSubBuckets) { return index; }
+  const int64_t shift = (index >> kSubBucketBits) - 1;
+  const int64_t min_value = (kNumSubBuckets + (index & (kNumSubBuckets - 1))) << shift;
+  return min_value + ((int64_t(1) << shift) - 1);
+}
+
+bool IsOpTraceEnabled() { return GetOpTraceRegistry()->enabled(); }
+
+void EnableOpTrace(bool enabled) { GetOpTraceRegistry()->set_enabled(enabled); }
+
+int32_t OpTraceId4Name(const std::string& name) { return GetOpTraceRegistry()->Id4Name(name); }
+
+void RecordOpTrace(int32_t id, time_t start, time_t end) {
+  GetThisThreadOpTrace()->Record(id, start, end);
+}
+
+std::vector<OpTraceStat> GetOpTraceStats() {
+  auto* registry = GetOpTraceRegistry();
+  const auto thread_traces = registry->thread_traces();
+  const auto names = registry->names();
+  std::vector<OpTraceStat> stats;
+  for (int32_t id = 0; id < std::min<int32_t>(names.size(), kMaxNumOpTraceIds); ++id) {
+    LatencyHistogram histogram;
+    for (const auto& thread_trace : thread_traces) {
+      const LatencyHistogram* thread_histogram = thread_trace->histogram(id);
+      if (thread_histogram != nullptr) { histogram.Merge(*thread_histogram); }
+    }
+    if (histogram.count() == 0) { continue; }
+    OpTraceStat stat;
+    stat.name = names.at(id);
+    stat.count = histogram.count();
+    stat.total_ns = histogram.sum();
+    stat.max_ns = histogram.max();
+    stat.p50_ns = histogram.ValueAtQuantile(0.5);
+    stat.p90_ns = histogram.ValueAtQuantile(0.9);
+    stat.p99_ns = histogram.ValueAtQuantile(0.99);
+    stats.emplace_back(std::move(stat));
+  }
+  return stats;
+}
+
+std::string DumpOpTraceStatsJson() {
+  json j = json::array();
+  for (const auto& stat : GetOpTraceStats()) {
+    j.push_back({{"name", stat.name},
+                 {"count", stat.count},
+                 {"total_ns", stat.total_ns},
+                 {"max_ns", stat.max_ns},
+                 {"p50_ns", stat.p50_ns},
+                 {"p90_ns", stat.p90_ns},
+                 {"p99_ns", stat.p99_ns}});
+  }
+  return j.dump();
+}
+
+std::string DumpOpTraceChromeTrace() {
+  auto* registry = GetOpTraceRegistry();
+  const auto thread_traces = registry->thread_traces();
+  const auto names = registry->names();
+  json events = json::array();
+  for (const auto& thread_trace : thread_traces) {
+    thread_trace->ForEachRecord([&](int32_t id, time_t start, time_t end) {
+      // registered after `names` was copied
+      if (static_cast<size_t>(id) >= names.size()) { return; }
+      // chrome trace timestamps are in microseconds
+      events.push_back({{"name", names.at(id)},
+                        {"ph", "X"},
+                        {"ts", start / 1000.0},
+                        {"dur", (end - start) / 1000.0},
+                        {"pid", 0},
+                        {"tid", thread_trace->thread_index()}});
+    });
+  }
+  const json j = {{"traceEvents", events}};
+  return j.dump();
+}
+
+void ResetOpTrace() {
+  for (const auto& thread_trace : GetOpTraceRegistry()->thread_traces()) { thread_trace->Reset(); }
+}
+
+}  // namespace profiler
+
+}  // namespace oneflow
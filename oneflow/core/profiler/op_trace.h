@@ -0,0 +1,116 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_PROFILER_OP_TRACE_H_
+#define ONEFLOW_CORE_PROFILER_OP_TRACE_H_
+
+#include <atomic>
+#include <memory>
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/profiler/util.h"
+
+namespace oneflow {
+
+namespace profiler {
+
+// Op tracing is a low overhead alternative to ProfileManager that is meant to stay enabled in
+// production. Every thread owns a fixed size ring buffer of its most recent launches and a
+// latency histogram per traced name, so recording never locks or allocates after warm up.
+// It is enabled by ONEFLOW_PROFILER_ENABLE_OP_TRACE or EnableOpTrace(), the ring buffer size is
+// set by ONEFLOW_PROFILER_OP_TRACE_BUFFER_SIZE.
+
+// Log-linear latency histogram. Values below 2^kSubBucketBits are exact, larger values keep
+// kSubBucketBits bits after the leading one, so reported values have a relative error below
+// 1 / 2^kSubBucketBits.
+class LatencyHistogram final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(LatencyHistogram);
+  static constexpr int64_t kSubBucketBits = 4;
+  static constexpr int64_t kNumBuckets = (64 - kSubBucketBits + 1) << kSubBucketBits;
+
+  LatencyHistogram();
+  ~LatencyHistogram() = default;
+
+  void Record(int64_t value);
+  void Merge(const LatencyHistogram& other);
+  void Reset();
+
+  int64_t count() const { return count_.load(std::memory_order_relaxed); }
+  int64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+  int64_t max() const { return max_.load(std::memory_order_relaxed); }
+  // Returns the smallest recorded value v such that a fraction `quantile` of all values is not
+  // greater than v, up to the bucket resolution.
+  int64_t ValueAtQuantile(double quantile) const;
+
+  static int64_t BucketIndex4Value(int64_t value);
+  static int64_t MaxValue4BucketIndex(int64_t index);
+
+ private:
+  std::unique_ptr<std::atomic<int64_t>[]> buckets_;
+  std::atomic<int64_t> count_;
+  std::atomic<int64_t> sum_;
+  std::atomic<int64_t> max_;
+};
+
+struct OpTraceStat {
+  std::string name;
+  int64_t count;
+  int64_t total_ns;
+  int64_t max_ns;
+  int64_t p50_ns;
+  int64_t p90_ns;
+  int64_t p99_ns;
+};
+
+bool IsOpTraceEnabled();
+
+void EnableOpTrace(bool enabled);
+
+// Returns the id of `name`. Ids are never released, so callers should look them up once, e.g.
+// when constructing a kernel, and not on every launch.
+int32_t OpTraceId4Name(const std::string& name);
+
+void RecordOpTrace(int32_t id, time_t start, time_t end);
+
+// Stats of every traced name, merged over all threads.
+std::vector<OpTraceStat> GetOpTraceStats();
+
+std::string DumpOpTraceStatsJson();
+
+// The recent launches still in the ring buffers, as a json of the chrome trace event format.
+std::string DumpOpTraceChromeTrace();
+
+// Clears histograms and ring buffers. Launches that are recorded while resetting may be kept.
+void ResetOpTrace();
+
+// Records the lifetime of the guard under `id` if op tracing is enabled.
+class OpTraceGuard final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OpTraceGuard);
+  explicit OpTraceGuard(int32_t id) : id_(id), start_(IsOpTraceEnabled() ? GetTimeNow(true) : -1) {}
+  ~OpTraceGuard() {
+    if (start_ >= 0) { RecordOpTrace(id_, start_, GetTimeNow(true)); }
+  }
+
+ private:
+  int32_t id_;
+  time_t start_;
+};
+
+}  // namespace profiler
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_PROFILER_OP_TRACE_H_
@@ -0,0 +1,133 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <thread>
+#include "gtest/gtest.h"
+#include "oneflow/core/ep/test/benchmark_util.h"
+#include "oneflow/core/ep/include/primitive/elementwise_unary.h"
+#include "oneflow/core/profiler/op_trace.h"
+
+namespace oneflow {
+
+namespace profiler {
+
+namespace test {
+
+namespace {
+
+class OpTraceBenchmark : public ep::test::BenchmarkCase {};
+
+}  // namespace
+
+TEST(LatencyHistogram, bucket_index) {
+  int64_t last_index = -1;
+  for (int64_t value = 0; value < (int64_t(1) << 20); value += 1 + value / 64) {
+    const int64_t index = LatencyHistogram::BucketIndex4Value(value);
+    ASSERT_GE(index, last_index);
+    ASSERT_LT(index, LatencyHistogram::kNumBuckets);
+    ASSERT_GE(LatencyHistogram::MaxValue4BucketIndex(index), value);
+    if (index > 0) { ASSERT_LT(LatencyHistogram::MaxValue4BucketIndex(index - 1), value); }
+    last_index = index;
+  }
+  const int64_t max_index = LatencyHistogram::BucketIndex4Value(GetMaxVal<int64_t>());
+  ASSERT_LT(max_index, LatencyHistogram::kNumBuckets);
+  ASSERT_EQ(LatencyHistogram::MaxValue4BucketIndex(max_index), GetMaxVal<int64_t>());
+}
+
+TEST(LatencyHistogram, quantile) {
+  LatencyHistogram histogram;
+  for (int64_t i = 1; i <= 1000; ++i) { histogram.Record(i * 1000); }
+  ASSERT_EQ(histogram.count(), 1000);
+  ASSERT_EQ(histogram.sum(), 500500 * 1000);
+  ASSERT_EQ(histogram.max(), 1000 * 1000);
+  const double max_error = 1.0 / (1 << LatencyHistogram::kSubBucketBits);
+  for (double quantile : {0.5, 0.9, 0.99}) {
+    const double expected = quantile * 1000 * 1000;
+    ASSERT_NEAR(histogram.ValueAtQuantile(quantile), expected, expected * max_error);
+  }
+  ASSERT_EQ(histogram.ValueAtQuantile(1.0), histogram.max());
+}
+
+TEST(OpTrace, record_from_threads) {
+  const int32_t id = OpTraceId4Name("op_trace_test");
+  ASSERT_EQ(OpTraceId4Name("op_trace_test"), id);
+  EnableOpTrace(true);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([id]() {
+      for (int j = 0; j < 100; ++j) { RecordOpTrace(id, j * 1000, j * 1000 + 500); }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  EnableOpTrace(false);
+  bool found = false;
+  for (const auto& stat : GetOpTraceStats()) {
+    if (stat.name != "op_trace_test") { continue; }
+    found = true;
+    ASSERT_EQ(stat.count, 400);
+    ASSERT_EQ(stat.total_ns, 400 * 500);
+    ASSERT_EQ(stat.p50_ns, 500);
+  }
+  ASSERT_TRUE(found);
+  ASSERT_NE(DumpOpTraceChromeTrace().find("op_trace_test"), std::string::npos);
+  ResetOpTrace();
+  for (const auto& stat : GetOpTraceStats()) { ASSERT_NE(stat.name, "op_trace_test"); }
+  ASSERT_EQ(DumpOpTraceChromeTrace().find("op_trace_test"), std::string::npos);
+}
+
+TEST_F(OpTraceBenchmark, overhead) {
+  // Op tracing is meant to stay enabled in production, so its cost is measured on launches as
+  // small as the ones that dominate eager inference, where a fixed per-launch cost shows most.
+  const std::vector<size_t> counts = {256, 4096, 65536, 4096 * 768};
+  const int32_t trace_id = OpTraceId4Name("op_trace_overhead_benchmark");
+  const bool saved_enabled = IsOpTraceEnabled();
+  for (size_t count : counts) {
+    ForEachDeviceAndNumThreads([&](ep::Device* device, size_t num_threads) {
+      std::unique_ptr<ep::primitive::ElementwiseUnary> relu =
+          ep::primitive::NewPrimitive<ep::primitive::ElementwiseUnaryFactory>(
+              device->device_type(), ep::primitive::UnaryOp::kRelu, DataType::kFloat,
+              DataType::kFloat);
+      if (!relu) { return; }
+      ep::test::DeviceMemoryGuard src(device, count * sizeof(float));
+      ep::test::DeviceMemoryGuard dst(device, count * sizeof(float));
+      ep::test::StreamGuard stream(device);
+      const auto TracedLaunch = [&]() {
+        OpTraceGuard guard(trace_id);
+        relu->Launch(stream.stream(), src.ptr(), dst.ptr(), count);
+      };
+      EnableOpTrace(false);
+      const double disabled_time_us = MeasureLaunchTimeUs(stream.stream(), TracedLaunch);
+      EnableOpTrace(true);
+      const double enabled_time_us = MeasureLaunchTimeUs(stream.stream(), TracedLaunch);
+      const std::string name = "op_trace/relu/count:" + std::to_string(count);
+      Report(name + "/disabled", device->device_type(), num_threads, disabled_time_us, 0, 0);
+      Report(name + "/enabled", device->device_type(), num_threads, enabled_time_us, 0, 0);
+      const double overhead_percent = (enabled_time_us / disabled_time_us - 1.0) * 100;
+      RecordProperty(name + "/" + DeviceType_Name(device->device_type())
+                         + "/threads:" + std::to_string(num_threads) + "/overhead_percent",
+                     std::to_string(overhead_percent));
+      std::cout << name << " op trace overhead: " << std::fixed << std::setprecision(2)
+                << overhead_percent << "%" << std::endl;
+    });
+  }
+  EnableOpTrace(saved_enabled);
+  ResetOpTrace();
+}
+
+}  // namespace test
+
+}  // namespace profiler
+
+}  // namespace oneflow
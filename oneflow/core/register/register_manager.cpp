@@ -89,6 +89,7 @@ void RegstMgr::AddPlan(
         CHECK_GE(var_blob->AlignedByteSizeOfBlobBody(), mem_block.mem_size());
         CHECK_GE(mem_block.mem_size(), var_blob->ByteSizeOfBlobBody());
         CHECK(mem_block_id2ptr_.emplace(mem_block_id, var_blob->mut_dptr<char>()).second);
+        var_blob->tensor_storage()->set_is_bound_to_lazy_job(true);
         // NOTE(chengcheng):
         //   CPU eager var tensor mem case is host_mem WITHOUT cuda pinned, but Lazy Complier
         //   will set variable op output blob mem_case with cuda pinned memory if this output
@@ -100,6 +100,12 @@ class CtrlClient {
     *v = oneflow_cast<T>(v_str);
   }
 
+  // Called by all ranks. The master's value is copied to every other rank along a tree of ranks
+  // instead of all of them pulling it from one ctrl server. The key can be broadcast again only
+  // after all ranks have returned, e.g. after a barrier.
+  virtual void BroadcastKV(const std::string& k, std::string* v) = 0;
+  virtual void BroadcastKV(const std::string& k, PbMessage* msg) = 0;
+
   virtual void Clear() = 0;
   virtual int32_t IncreaseCount(const std::string& k, int32_t v) = 0;
   int32_t IncreaseCount(const std::string& k) { return IncreaseCount(k, 1); }
@@ -132,6 +132,11 @@ void LocalCtrlClient::PullMasterKV(const std::string& k, PbMessage* msg) {
   PullKV(k, [&](const std::string& i) { msg->ParseFromString(i); });
 }
 
+// NOTE: the local backend only runs a single rank, which already holds the master's value.
+void LocalCtrlClient::BroadcastKV(const std::string& k, std::string* v) {}
+
+void LocalCtrlClient::BroadcastKV(const std::string& k, PbMessage* msg) {}
+
 void LocalCtrlClient::Clear() {
   {
     std::unique_lock<std::mutex> lck(done_names_mtx_);
@@ -211,6 +216,12 @@ class DryRunCtrlClient : public CtrlClient {
   void PullMasterKV(const std::string& k, PbMessage* msg) override {
     local_ctrl_client_->PullMasterKV(k, msg);
   }
+  void BroadcastKV(const std::string& k, std::string* v) override {
+    local_ctrl_client_->BroadcastKV(k, v);
+  }
+  void BroadcastKV(const std::string& k, PbMessage* msg) override {
+    local_ctrl_client_->BroadcastKV(k, msg);
+  }
   void Clear() override { local_ctrl_client_->Clear(); }
   int32_t IncreaseCount(const std::string& k, int32_t v) override {
     return local_ctrl_client_->IncreaseCount(k, v);
@@ -51,6 +51,7 @@ class AccessBlobArgCbPhyInstrOperand : public PhyInstrOperand {
   ~AccessBlobArgCbPhyInstrOperand() = default;
 
   const std::function<void(uint64_t)>& callback() const { return callback_; }
+  const std::string& modifier() const { return modifier_; }
   const std::shared_ptr<vm::EagerBlobObject>& eager_blob_object() const {
     return eager_blob_object_;
   }
@@ -17,8 +17,11 @@ limitations under the License.
 #define ONEFLOW_CORE_VM_BIN_ALLOCATOR_H_
 
 #include <cstdint>
+#include <mutex>
+#include <thread>
 #include "oneflow/core/vm/allocator.h"
 #include "oneflow/core/vm/caching_allocator.h"
+#include "oneflow/core/vm/radix_page_map.h"
 #include "oneflow/core/common/util.h"
 
 namespace oneflow {
@@ -27,7 +30,9 @@ namespace vm {
 template<typename ThreadLock>
 class BinAllocator final : public CachingAllocator {
  public:
+  // The thread caches are enabled unless `ONEFLOW_VM_BIN_ALLOCATOR_THREAD_CACHE` is false
   explicit BinAllocator(size_t alignment, std::unique_ptr<Allocator>&& backend);
+  BinAllocator(size_t alignment, std::unique_ptr<Allocator>&& backend, bool enable_thread_cache);
   ~BinAllocator();
 
   Maybe<void> Allocate(char** mem_ptr, std::size_t size) override;
@@ -37,14 +42,27 @@ class BinAllocator final : public CachingAllocator {
     backend_->DeviceReset();
   }
   void Shrink() override {
+    FlushThreadCaches();
     typename ThreadLock::RAIIGuard guard(thread_lock_);
     DeallocateFreeBlockForGarbageCollection();
   }
+  CachingAllocatorStats GetStats() override;
 
  private:
   static constexpr int32_t kInvalidBinNum = -1;
   static constexpr int32_t kBinNumSize = 20;
 
+  // Pieces up to kMaxThreadCachedPieceSize are kept in per-thread caches after Deallocate(), one
+  // free list for each size class. Size classes are multiples of kThreadCacheGranularity.
+  static constexpr size_t kThreadCacheGranularity = 512;
+  static constexpr size_t kMaxThreadCachedPieceSize = 64 * 1024;
+  static constexpr size_t kMaxThreadCachedPieceNumPerSizeClass = 64;
+  static constexpr size_t kMaxThreadCachedBytes = 8 * 1024 * 1024;
+  // Number of pieces fetched from the bins when a size class of a thread cache is empty
+  static constexpr size_t kThreadCacheRefillNum = 4;
+  // Threads beyond this number allocate from the bins directly
+  static constexpr size_t kMaxThreadCacheNum = 64;
+
   // Piece is the basic memory unit of BinAllocator.
   // A Piece is either is free(is_free = true) or in used(is_free = false).
   // If the Piece is_free = true, the pointer to the piece will be stored in the Bin structure of
@@ -91,6 +109,19 @@ class BinAllocator final : public CachingAllocator {
     Block(Piece* p) : size(p->size), ptr(p->ptr), start_piece(p) {}
   };
 
+  // ThreadCache is owned by the allocator and used by one thread. The fast paths only lock its
+  // mutex, which is contended by FlushThreadCaches() and GetStats() only.
+  struct ThreadCache {
+    ThreadCache(size_t size_class_num, std::thread::id thread_id)
+        : thread_id(thread_id), size_class2pieces(size_class_num) {}
+    const std::thread::id thread_id;
+    std::mutex mutex;
+    std::vector<std::vector<Piece*>> size_class2pieces;
+    size_t cached_bytes = 0;
+    size_t hit_cnt = 0;
+    size_t miss_cnt = 0;
+  };
+
   size_t BinSize4BinNum(int32_t bin_num) { return kCudaMemAllocAlignSize << bin_num; }
 
   int32_t BinNum4BinSize(size_t size) {
@@ -110,7 +141,7 @@ class BinAllocator final : public CachingAllocator {
   // Delete a Piece and move in the linked list recycle_piece_list_
   void DeallocatePiece(Piece* piece);
 
-  // Insert a {piece->ptr, piece} pair into the ptr2piece_ map for search Piece when call
+  // Insert a {piece->ptr, piece} pair into the ptr2piece_ page map for search Piece when call
   // Deallocate()
   void MarkPiece(Piece* piece);
   // Erase the {piece->ptr, piece} pair from ptr2piece_ because the ptr is useless
@@ -123,16 +154,43 @@ class BinAllocator final : public CachingAllocator {
   Maybe<bool> AllocateBlockToExtendTotalMem(size_t aligned_size);
   bool DeallocateFreeBlockForGarbageCollection();
 
+  // Find a piece for `aligned_size`, extending the total memory if needed. Must be called with
+  // thread_lock_ held. Return nullptr when out of memory
+  Maybe<Piece*> AllocatePieceFromBins(size_t aligned_size);
+  // Return a piece in use to the bins, merging it with its free neighbours. Must be called with
+  // thread_lock_ held
+  void DeallocatePieceToBins(Piece* piece);
+
+  // Return nullptr when kMaxThreadCacheNum threads already have a cache
+  ThreadCache* GetThreadCache();
+  size_t SizeClass4PieceSize(size_t size) const { return size / kThreadCacheGranularity - 1; }
+  bool IsThreadCachedPieceSize(size_t size) const {
+    return size <= kMaxThreadCachedPieceSize && size % kThreadCacheGranularity == 0;
+  }
+  Maybe<Piece*> AllocatePieceFromThreadCache(size_t aligned_size);
+  void DeallocatePieceToThreadCache(Piece* piece);
+  // Return the pieces of all thread caches to the bins
+  void FlushThreadCaches();
+
   const size_t alignment_;
   const std::unique_ptr<Allocator> backend_;
+  const bool enable_thread_cache_;
+  // Identifies this allocator in the thread local cache slots, never reused
+  const uint64_t uid_;
   ThreadLock thread_lock_;
   size_t total_memory_bytes_;
   HashMap<char*, Block> mem_ptr2block_;
 
   std::vector<Bin> bins_;
   std::vector<std::unique_ptr<Piece>> pieces_;
-  HashMap<char*, Piece*> ptr2piece_;
+  RadixPageMap<Piece> ptr2piece_;
   Piece* recycle_piece_list_;
+
+  std::vector<std::unique_ptr<ThreadCache>> thread_caches_;
+  size_t free_bytes_in_bins_;
+  // Bytes of the pieces handed out from the bins, including those kept in thread caches
+  size_t allocated_bytes_from_bins_;
+  size_t peak_allocated_bytes_from_bins_;
 };
 
 namespace {
@@ -145,13 +203,31 @@ static const size_t kPieceSplitThreshold = 128 << 20;  // 128MiB
 
 }  // namespace
 
+// Shared by all translation units, so the uids of allocators are unique in the process
+inline uint64_t NewBinAllocatorUid() {
+  static std::atomic<uint64_t> uid(0);
+  return ++uid;
+}
+
 template<typename ThreadLock>
 BinAllocator<ThreadLock>::BinAllocator(size_t alignment, std::unique_ptr<Allocator>&& backend)
+    : BinAllocator(alignment, std::move(backend),
+                   ParseBooleanFromEnv("ONEFLOW_VM_BIN_ALLOCATOR_THREAD_CACHE", true)) {}
+
+template<typename ThreadLock>
+BinAllocator<ThreadLock>::BinAllocator(size_t alignment, std::unique_ptr<Allocator>&& backend,
+                                       bool enable_thread_cache)
     : CachingAllocator(),
       alignment_(alignment),
       backend_(std::move(backend)),
+      enable_thread_cache_(enable_thread_cache),
+      uid_(NewBinAllocatorUid()),
       total_memory_bytes_(0),
-      recycle_piece_list_(nullptr) {
+      ptr2piece_(alignment),
+      recycle_piece_list_(nullptr),
+      free_bytes_in_bins_(0),
+      allocated_bytes_from_bins_(0),
+      peak_allocated_bytes_from_bins_(0) {
   CHECK_GE(alignment, 1);
   CHECK_EQ(1 << static_cast<int>(std::log2(alignment)), alignment);
   bins_.resize(kBinNumSize);
@@ -180,6 +256,7 @@ void BinAllocator<ThreadLock>::InsertPiece2Bin(Piece* piece) {
   int32_t bin_num = BinNum4BinSize(piece->size);
   piece->bin_num = bin_num;
   CHECK(bins_.at(bin_num).pieces.insert(piece).second);
+  free_bytes_in_bins_ += piece->size;
 }
 
 template<typename ThreadLock>
@@ -188,6 +265,7 @@ void BinAllocator<ThreadLock>::RemovePieceFromBin(Piece* piece) {
   CHECK_NE(piece->bin_num, kInvalidBinNum);
   CHECK_GT(bins_.at(piece->bin_num).pieces.erase(piece), 0);
   piece->bin_num = kInvalidBinNum;
+  free_bytes_in_bins_ -= piece->size;
 }
 
 template<typename ThreadLock>
@@ -216,14 +294,14 @@ void BinAllocator<ThreadLock>::DeallocatePiece(Piece* piece) {
 template<typename ThreadLock>
 void BinAllocator<ThreadLock>::MarkPiece(Piece* piece) {
   CHECK_NOTNULL(piece->ptr);
-  CHECK(ptr2piece_.emplace(piece->ptr, piece).second);
+  CHECK(ptr2piece_.Get(piece->ptr) == nullptr);
+  ptr2piece_.Set(piece->ptr, piece);
 }
 template<typename ThreadLock>
 void BinAllocator<ThreadLock>::UnMarkPiece(Piece* piece) {
   CHECK_NOTNULL(piece->ptr);
-  auto it = ptr2piece_.find(piece->ptr);
-  CHECK(it != ptr2piece_.end());
-  ptr2piece_.erase(it);
+  CHECK(ptr2piece_.Get(piece->ptr) == piece);
+  ptr2piece_.Set(piece->ptr, nullptr);
 }
 
 template<typename ThreadLock>
@@ -239,6 +317,7 @@ typename BinAllocator<ThreadLock>::Piece* BinAllocator<ThreadLock>::FindPiece(si
       CHECK(IsAlignedSize(piece->size, alignment_));
       if (piece->size >= aligned_size) {
         bin->pieces.erase(it);
+        free_bytes_in_bins_ -= piece->size;
         piece->bin_num = kInvalidBinNum;
         piece->is_free = false;
         if (piece->size >= aligned_size * 2 || piece->size - aligned_size >= kPieceSplitThreshold) {
@@ -370,26 +449,233 @@ bool BinAllocator<ThreadLock>::DeallocateFreeBlockForGarbageCollection() {
       }
       CHECK_EQ(block.size, piece_size_sum);
 
-      mem_ptr2block_.erase(it);
       backend_->Deallocate(ptr, block.size);
+      mem_ptr2block_.erase(it);
     }
   }
   return total_free_bytes > 0;
 }
 
 template<typename ThreadLock>
-Maybe<void> BinAllocator<ThreadLock>::Allocate(char** mem_ptr, std::size_t size) {
+Maybe<typename BinAllocator<ThreadLock>::Piece*> BinAllocator<ThreadLock>::AllocatePieceFromBins(
+    size_t aligned_size) {
+  Piece* piece = FindPiece(aligned_size);
+
+  if (piece == nullptr) {
+    if (JUST(AllocateBlockToExtendTotalMem(aligned_size))) { piece = FindPiece(aligned_size); }
+  }
+  if (piece != nullptr) {
+    CHECK_NOTNULL_OR_RETURN(piece->ptr) << "invalid piece null ptr";
+    CHECK_OR_RETURN(ptr2piece_.Get(piece->ptr) == piece) << "piece is not found";
+    allocated_bytes_from_bins_ += piece->size;
+    peak_allocated_bytes_from_bins_ =
+        std::max(peak_allocated_bytes_from_bins_, allocated_bytes_from_bins_);
+  }
+  return piece;
+}
+
+template<typename ThreadLock>
+void BinAllocator<ThreadLock>::DeallocatePieceToBins(Piece* piece) {
+  CHECK(!piece->is_free);
+  allocated_bytes_from_bins_ -= piece->size;
+
+  piece->is_free = true;
+
+  Piece* last_piece_insert_to_bin = piece;
+  Piece* next_p = piece->next;
+  Piece* prev_p = piece->prev;
+
+  if (next_p != nullptr && next_p->is_free) {
+    CHECK_EQ(next_p->ptr, piece->ptr + piece->size);
+    RemovePieceFromBin(next_p);
+    MergeNeighbourFreePiece(piece, next_p);
+  }
+
+  if (prev_p != nullptr && prev_p->is_free) {
+    CHECK_EQ(piece->ptr, prev_p->ptr + prev_p->size);
+    RemovePieceFromBin(prev_p);
+    MergeNeighbourFreePiece(prev_p, piece);
+    last_piece_insert_to_bin = prev_p;
+  }
+  InsertPiece2Bin(last_piece_insert_to_bin);
+}
+
+template<typename ThreadLock>
+typename BinAllocator<ThreadLock>::ThreadCache* BinAllocator<ThreadLock>::GetThreadCache() {
+  // A thread normally uses a few allocators, so a small array searched linearly is enough. The
+  // cache of an evicted slot stays owned by its allocator, which hands it back to the same thread
+  // on its next miss, so there is at most one cache per thread.
+  struct Slot {
+    uint64_t allocator_uid = 0;
+    ThreadCache* cache = nullptr;
+  };
+  static constexpr size_t kSlotNum = 16;
+  static thread_local Slot slots[kSlotNum];
+  static thread_local size_t next_victim_slot = 0;
+  for (const Slot& slot : slots) {
+    if (slot.allocator_uid == uid_) { return slot.cache; }
+  }
+  const std::thread::id thread_id = std::this_thread::get_id();
+  ThreadCache* cache = nullptr;
+  {
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    for (const auto& thread_cache : thread_caches_) {
+      if (thread_cache->thread_id == thread_id) {
+        cache = thread_cache.get();
+        break;
+      }
+    }
+    if (cache == nullptr) {
+      if (thread_caches_.size() >= kMaxThreadCacheNum) { return nullptr; }
+      thread_caches_.emplace_back(
+          new ThreadCache(kMaxThreadCachedPieceSize / kThreadCacheGranularity, thread_id));
+      cache = thread_caches_.back().get();
+    }
+  }
+  Slot* slot = &slots[next_victim_slot];
+  next_victim_slot = (next_victim_slot + 1) % kSlotNum;
+  slot->allocator_uid = uid_;
+  slot->cache = cache;
+  return cache;
+}
+
+template<typename ThreadLock>
+Maybe<typename BinAllocator<ThreadLock>::Piece*>
+BinAllocator<ThreadLock>::AllocatePieceFromThreadCache(size_t aligned_size) {
+  ThreadCache* cache = GetThreadCache();
+  if (cache == nullptr) {
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    return AllocatePieceFromBins(aligned_size);
+  }
+  std::unique_lock<std::mutex> cache_lock(cache->mutex);
+  std::vector<Piece*>* pieces = &cache->size_class2pieces.at(SizeClass4PieceSize(aligned_size));
+  if (!pieces->empty()) {
+    Piece* piece = pieces->back();
+    pieces->pop_back();
+    cache->cached_bytes -= piece->size;
+    ++cache->hit_cnt;
+    return piece;
+  }
+  ++cache->miss_cnt;
+  // Fetch a batch under one acquisition of the global lock
   typename ThreadLock::RAIIGuard guard(thread_lock_);
+  Piece* piece = JUST(AllocatePieceFromBins(aligned_size));
+  if (piece == nullptr) { return piece; }
+  for (size_t i = 1; i < kThreadCacheRefillNum; ++i) {
+    if (cache->cached_bytes + aligned_size > kMaxThreadCachedBytes) { break; }
+    Piece* cached_piece = FindPiece(aligned_size);
+    if (cached_piece == nullptr) { break; }
+    allocated_bytes_from_bins_ += cached_piece->size;
+    peak_allocated_bytes_from_bins_ =
+        std::max(peak_allocated_bytes_from_bins_, allocated_bytes_from_bins_);
+    if (cached_piece->size != aligned_size) {
+      DeallocatePieceToBins(cached_piece);
+      break;
+    }
+    pieces->emplace_back(cached_piece);
+    cache->cached_bytes += cached_piece->size;
+  }
+  return piece;
+}
+
+template<typename ThreadLock>
+void BinAllocator<ThreadLock>::DeallocatePieceToThreadCache(Piece* piece) {
+  ThreadCache* cache = GetThreadCache();
+  if (cache == nullptr) {
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    DeallocatePieceToBins(piece);
+    return;
+  }
+  std::unique_lock<std::mutex> cache_lock(cache->mutex);
+  std::vector<Piece*>* pieces = &cache->size_class2pieces.at(SizeClass4PieceSize(piece->size));
+  if (pieces->size() < kMaxThreadCachedPieceNumPerSizeClass
+      && cache->cached_bytes + piece->size <= kMaxThreadCachedBytes) {
+    pieces->emplace_back(piece);
+    cache->cached_bytes += piece->size;
+    return;
+  }
+  // Return half of the size class to the bins under one acquisition of the global lock
+  typename ThreadLock::RAIIGuard guard(thread_lock_);
+  DeallocatePieceToBins(piece);
+  const size_t keep_num = pieces->size() / 2;
+  while (pieces->size() > keep_num) {
+    Piece* cached_piece = pieces->back();
+    pieces->pop_back();
+    cache->cached_bytes -= cached_piece->size;
+    DeallocatePieceToBins(cached_piece);
+  }
+}
+
+template<typename ThreadLock>
+void BinAllocator<ThreadLock>::FlushThreadCaches() {
+  std::vector<ThreadCache*> caches;
+  {
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    for (const auto& cache : thread_caches_) { caches.emplace_back(cache.get()); }
+  }
+  // Lock order is always a thread cache before thread_lock_
+  for (ThreadCache* cache : caches) {
+    std::unique_lock<std::mutex> cache_lock(cache->mutex);
+    if (cache->cached_bytes == 0) { continue; }
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    for (auto& pieces : cache->size_class2pieces) {
+      for (Piece* piece : pieces) { DeallocatePieceToBins(piece); }
+      pieces.clear();
+    }
+    cache->cached_bytes = 0;
+  }
+}
+
+template<typename ThreadLock>
+CachingAllocatorStats BinAllocator<ThreadLock>::GetStats() {
+  CachingAllocatorStats stats;
+  std::vector<ThreadCache*> caches;
+  {
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    for (const auto& cache : thread_caches_) { caches.emplace_back(cache.get()); }
+  }
+  stats.thread_cache_num = caches.size();
+  for (ThreadCache* cache : caches) {
+    std::unique_lock<std::mutex> cache_lock(cache->mutex);
+    stats.thread_cached_bytes += cache->cached_bytes;
+    stats.thread_cache_hit_cnt += cache->hit_cnt;
+    stats.thread_cache_miss_cnt += cache->miss_cnt;
+  }
+  typename ThreadLock::RAIIGuard guard(thread_lock_);
+  stats.reserved_bytes = total_memory_bytes_;
+  stats.allocated_bytes = allocated_bytes_from_bins_ - stats.thread_cached_bytes;
+  stats.peak_allocated_bytes = peak_allocated_bytes_from_bins_;
+  stats.free_bytes = free_bytes_in_bins_;
+  for (const Bin& bin : bins_) {
+    if (!bin.pieces.empty()) {
+      stats.largest_free_bytes = std::max(stats.largest_free_bytes, (*bin.pieces.rbegin())->size);
+    }
+  }
+  return stats;
+}
+
+template<typename ThreadLock>
+Maybe<void> BinAllocator<ThreadLock>::Allocate(char** mem_ptr, std::size_t size) {
   if (size == 0) {
     *mem_ptr = nullptr;
     return Maybe<void>::Ok();
   }
   size_t aligned_size = MemAlignedBytes(size, alignment_);
 
-  Piece* piece = FindPiece(aligned_size);
+  Piece* piece = nullptr;
+  if (enable_thread_cache_ && aligned_size <= kMaxThreadCachedPieceSize) {
+    aligned_size = MemAlignedBytes(aligned_size, kThreadCacheGranularity);
+    piece = JUST(AllocatePieceFromThreadCache(aligned_size));
+  } else {
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    piece = JUST(AllocatePieceFromBins(aligned_size));
+  }
 
-  if (piece == nullptr) {
-    if (JUST(AllocateBlockToExtendTotalMem(aligned_size))) { piece = FindPiece(aligned_size); }
+  if (piece == nullptr && enable_thread_cache_) {
+    // The memory kept in thread caches may be able to serve this allocation
+    FlushThreadCaches();
+    typename ThreadLock::RAIIGuard guard(thread_lock_);
+    piece = JUST(AllocatePieceFromBins(aligned_size));
   }
 
   CHECK_NOTNULL_OR_RETURN(piece)
@@ -402,8 +688,6 @@ Maybe<void> BinAllocator<ThreadLock>::Allocate(char** mem_ptr, std::size_t size)
                << ".\n The total_memory_bytes allocated by this BinAllocator is : "
                << total_memory_bytes_;
   }
-  CHECK_NOTNULL_OR_RETURN(piece->ptr) << "invalid piece null ptr";
-  CHECK_OR_RETURN(ptr2piece_.find(piece->ptr) != ptr2piece_.end()) << "piece is not found";
   *mem_ptr = piece->ptr;
   return Maybe<void>::Ok();
 }
@@ -411,35 +695,20 @@ Maybe<void> BinAllocator<ThreadLock>::Allocate(char** mem_ptr, std::size_t size)
 template<typename ThreadLock>
 void BinAllocator<ThreadLock>::Deallocate(char* mem_ptr, std::size_t size) {
   if (mem_ptr == nullptr) { return; }
-  typename ThreadLock::RAIIGuard guard(thread_lock_);
 
-  auto it = ptr2piece_.find(mem_ptr);
-  CHECK(it != ptr2piece_.end()) << "Error! : Try deallocate mem_ptr non-existent. mem ptr = "
-                                << mem_ptr << " size = " << size;
-  Piece* piece = it->second;
-  CHECK_NOTNULL(piece);
+  // The page map can be read without the lock because entries of pieces in use don't change
+  Piece* piece = ptr2piece_.Get(mem_ptr);
+  CHECK(piece != nullptr) << "Error! : Try deallocate mem_ptr non-existent. mem ptr = "
+                          << mem_ptr << " size = " << size;
   CHECK_EQ(piece->ptr, mem_ptr);
   CHECK(!piece->is_free);
 
-  piece->is_free = true;
-
-  Piece* last_piece_insert_to_bin = piece;
-  Piece* next_p = piece->next;
-  Piece* prev_p = piece->prev;
-
-  if (next_p != nullptr && next_p->is_free) {
-    CHECK_EQ(next_p->ptr, piece->ptr + piece->size);
-    RemovePieceFromBin(next_p);
-    MergeNeighbourFreePiece(piece, next_p);
-  }
-
-  if (prev_p != nullptr && prev_p->is_free) {
-    CHECK_EQ(piece->ptr, prev_p->ptr + prev_p->size);
-    RemovePieceFromBin(prev_p);
-    MergeNeighbourFreePiece(prev_p, piece);
-    last_piece_insert_to_bin = prev_p;
+  if (enable_thread_cache_ && IsThreadCachedPieceSize(piece->size)) {
+    DeallocatePieceToThreadCache(piece);
+    return;
   }
-  InsertPiece2Bin(last_piece_insert_to_bin);
+  typename ThreadLock::RAIIGuard guard(thread_lock_);
+  DeallocatePieceToBins(piece);
 }
 
 }  // namespace vm
@@ -14,15 +14,22 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include <memory>
-#ifdef WITH_CUDA
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
 #include "gtest/gtest.h"
 #include "oneflow/core/vm/bin_allocator.h"
 #include "oneflow/core/vm/thread_safe_guard.h"
+#ifdef WITH_CUDA
 #include "oneflow/core/device/cuda_util.h"
+#endif  // WITH_CUDA
 
 namespace oneflow {
 namespace vm {
 
+#ifdef WITH_CUDA
+
 class CudaBackendAllocator final : public CachingAllocator {
  public:
   explicit CudaBackendAllocator(int64_t device_id) : device_id_(device_id) {}
@@ -126,7 +133,147 @@ TEST(CudaBinAllocator, cuda_allocator) {
   a->Deallocate(data_ptr_1, 2048 * sizeof(float));
 }
 
+#endif  // WITH_CUDA
+
+namespace {
+
+class HostBackendAllocator final : public Allocator {
+ public:
+  HostBackendAllocator() = default;
+  ~HostBackendAllocator() override = default;
+
+  Maybe<void> Allocate(char** mem_ptr, std::size_t size) override {
+    *mem_ptr = static_cast<char*>(aligned_alloc(kCudaMemAllocAlignSize, size));
+    return Maybe<void>::Ok();
+  }
+  void Deallocate(char* mem_ptr, std::size_t size) override { free(mem_ptr); }
+  void DeviceReset() override {}
+};
+
+std::unique_ptr<BinAllocator<ThreadSafeLock>> NewHostBinAllocator(bool enable_thread_cache) {
+  return std::make_unique<BinAllocator<ThreadSafeLock>>(
+      kCudaMemAllocAlignSize, std::make_unique<HostBackendAllocator>(), enable_thread_cache);
+}
+
+// Keeps `live_num` allocations of random small sizes alive on each thread, writes a pattern to
+// every allocation and checks it before the deallocation. Returns the nanoseconds per
+// Allocate/Deallocate pair.
+double RunSmallAllocations(Allocator* allocator, int thread_num, int iter_num, int live_num) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int thread_id = 0; thread_id < thread_num; ++thread_id) {
+    threads.emplace_back([allocator, thread_id, iter_num, live_num]() {
+      std::mt19937 gen(thread_id);
+      std::uniform_int_distribution<size_t> size_dist(2, 16 * 1024);
+      std::vector<std::pair<char*, size_t>> live(live_num, std::make_pair(nullptr, 0));
+      for (int i = 0; i < iter_num; ++i) {
+        auto* slot = &live.at(i % live_num);
+        if (slot->first != nullptr) {
+          CHECK_EQ(slot->first[0], static_cast<char>(thread_id));
+          CHECK_EQ(slot->first[slot->second - 1], static_cast<char>(i % live_num));
+          allocator->Deallocate(slot->first, slot->second);
+        }
+        slot->second = size_dist(gen);
+        CHECK_JUST(allocator->Allocate(&slot->first, slot->second));
+        slot->first[0] = static_cast<char>(thread_id);
+        slot->first[slot->second - 1] = static_cast<char>(i % live_num);
+      }
+      for (const auto& pair : live) { allocator->Deallocate(pair.first, pair.second); }
+    });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / (thread_num * iter_num);
+}
+
+}  // namespace
+
+TEST(HostBinAllocator, thread_cache) {
+  for (bool enable_thread_cache : {false, true}) {
+    auto allocator = NewHostBinAllocator(enable_thread_cache);
+    std::vector<std::pair<char*, size_t>> ptrs;
+    for (size_t size : {1, 511, 512, 513, 4096, 65536, 65537, 1048576}) {
+      for (int i = 0; i < 16; ++i) {
+        char* ptr = nullptr;
+        CHECK_JUST(allocator->Allocate(&ptr, size));
+        ASSERT_TRUE(ptr != nullptr);
+        ptrs.emplace_back(ptr, size);
+      }
+    }
+    std::sort(ptrs.begin(), ptrs.end());
+    for (int i = 1; i < ptrs.size(); ++i) {
+      ASSERT_TRUE(ptrs.at(i - 1).first + ptrs.at(i - 1).second <= ptrs.at(i).first);
+    }
+    CachingAllocatorStats stats = allocator->GetStats();
+    ASSERT_GT(stats.allocated_bytes, 0);
+    ASSERT_GE(stats.peak_allocated_bytes, stats.allocated_bytes);
+    ASSERT_LE(stats.allocated_bytes + stats.thread_cached_bytes + stats.free_bytes,
+              stats.reserved_bytes);
+    for (const auto& pair : ptrs) { allocator->Deallocate(pair.first, pair.second); }
+
+    stats = allocator->GetStats();
+    ASSERT_EQ(stats.allocated_bytes, 0);
+    ASSERT_EQ(stats.thread_cached_bytes + stats.free_bytes, stats.reserved_bytes);
+    if (enable_thread_cache) { ASSERT_GT(stats.thread_cached_bytes, 0); }
+    allocator->Shrink();
+    stats = allocator->GetStats();
+    ASSERT_EQ(stats.reserved_bytes, 0);
+    ASSERT_EQ(stats.thread_cached_bytes, 0);
+  }
+}
+
+TEST(HostBinAllocator, multi_thread) {
+  auto allocator = NewHostBinAllocator(/*enable_thread_cache=*/true);
+  RunSmallAllocations(allocator.get(), /*thread_num=*/4, /*iter_num=*/20000, /*live_num=*/64);
+  CachingAllocatorStats stats = allocator->GetStats();
+  ASSERT_EQ(stats.allocated_bytes, 0);
+  ASSERT_GT(stats.thread_cache_hit_rate(), 0);
+  allocator->Shrink();
+  ASSERT_EQ(allocator->GetStats().reserved_bytes, 0);
+}
+
+TEST(HostBinAllocator, thread_cache_reuse) {
+  // More allocators than thread local slots, so the slots of each allocator keep being evicted
+  std::vector<std::unique_ptr<BinAllocator<ThreadSafeLock>>> allocators;
+  for (int i = 0; i < 32; ++i) { allocators.emplace_back(NewHostBinAllocator(true)); }
+  for (int iter = 0; iter < 8; ++iter) {
+    for (auto& allocator : allocators) {
+      char* ptr = nullptr;
+      CHECK_JUST(allocator->Allocate(&ptr, 4096));
+      allocator->Deallocate(ptr, 4096);
+    }
+  }
+  for (auto& allocator : allocators) { ASSERT_EQ(allocator->GetStats().thread_cache_num, 1); }
+
+  // Threads beyond the limit bypass the thread caches
+  auto allocator = NewHostBinAllocator(true);
+  for (int i = 0; i < 128; ++i) {
+    std::thread thread([&allocator]() {
+      char* ptr = nullptr;
+      CHECK_JUST(allocator->Allocate(&ptr, 4096));
+      allocator->Deallocate(ptr, 4096);
+    });
+    thread.join();
+  }
+  CachingAllocatorStats stats = allocator->GetStats();
+  ASSERT_LE(stats.thread_cache_num, 64);
+  ASSERT_EQ(stats.allocated_bytes, 0);
+}
+
+TEST(HostBinAllocator, benchmark) {
+  for (int thread_num : {1, 4}) {
+    for (bool enable_thread_cache : {false, true}) {
+      auto allocator = NewHostBinAllocator(enable_thread_cache);
+      const double ns = RunSmallAllocations(allocator.get(), thread_num, /*iter_num=*/200000,
+                                            /*live_num=*/256);
+      const CachingAllocatorStats stats = allocator->GetStats();
+      LOG(INFO) << "HostBinAllocator benchmark: threads " << thread_num << ", thread cache "
+                << enable_thread_cache << ", " << ns << " ns per allocation, hit rate "
+                << stats.thread_cache_hit_rate() << ", fragmentation " << stats.fragmentation()
+                << ", peak " << stats.peak_allocated_bytes << " bytes";
+    }
+  }
+}
+
 }  // namespace vm
 }  // namespace oneflow
-
-#endif  // WITH_CUDA
@@ -23,10 +23,35 @@ limitations under the License.
 namespace oneflow {
 namespace vm {
 
+struct CachingAllocatorStats {
+  // Memory held from the backend allocator
+  size_t reserved_bytes = 0;
+  // Memory handed out to users, not counting the pieces kept in thread caches
+  size_t allocated_bytes = 0;
+  // Peak of the memory handed out to users and thread caches
+  size_t peak_allocated_bytes = 0;
+  size_t thread_cached_bytes = 0;
+  size_t free_bytes = 0;
+  size_t largest_free_bytes = 0;
+  size_t thread_cache_hit_cnt = 0;
+  size_t thread_cache_miss_cnt = 0;
+  size_t thread_cache_num = 0;
+
+  // Share of free memory which can't serve an allocation as large as the largest free piece
+  double fragmentation() const {
+    return free_bytes == 0 ? 0 : 1 - static_cast<double>(largest_free_bytes) / free_bytes;
+  }
+  double thread_cache_hit_rate() const {
+    const size_t total_cnt = thread_cache_hit_cnt + thread_cache_miss_cnt;
+    return total_cnt == 0 ? 0 : static_cast<double>(thread_cache_hit_cnt) / total_cnt;
+  }
+};
+
 class CachingAllocator : public Allocator {
  public:
   virtual ~CachingAllocator() = default;
   virtual void Shrink() = 0;
+  virtual CachingAllocatorStats GetStats() { return CachingAllocatorStats(); }
 
  protected:
   CachingAllocator() = default;
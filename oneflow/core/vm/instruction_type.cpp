@@ -13,6 +13,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <cxxabi.h>
 #include "oneflow/core/vm/instruction_type.h"
 #include "oneflow/core/vm/instruction.h"
 #include "oneflow/core/eager/eager_blob_object.h"
@@ -21,6 +22,20 @@ limitations under the License.
 namespace oneflow {
 namespace vm {
 
+int32_t InstructionType::op_trace_id() const {
+  int32_t id = op_trace_id_.load(std::memory_order_relaxed);
+  if (id < 0) {
+    const char* mangled_name = typeid(*this).name();
+    int status = 0;
+    char* demangled_name = abi::__cxa_demangle(mangled_name, nullptr, nullptr, &status);
+    id = profiler::OpTraceId4Name(std::string("vm:")
+                                  + (status == 0 ? demangled_name : mangled_name));
+    free(demangled_name);
+    op_trace_id_.store(id, std::memory_order_relaxed);
+  }
+  return id;
+}
+
 void InstructionType::InitInstructionStatus(Instruction* instruction) const {
   instruction->stream_type().InitInstructionStatus(instruction->stream(),
                                                    instruction->mut_status_buffer());
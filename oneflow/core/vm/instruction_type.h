@@ -16,10 +16,12 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_VM_INSTRUCTION_TYPE_H_
 #define ONEFLOW_CORE_VM_INSTRUCTION_TYPE_H_
 
+#include <atomic>
 #include <glog/logging.h>
 #include "oneflow/core/common/maybe.h"
 #include "oneflow/core/vm/stream_type.h"
 #include "oneflow/core/profiler/profiler.h"
+#include "oneflow/core/profiler/op_trace.h"
 
 namespace oneflow {
 namespace vm {
@@ -45,6 +47,7 @@ class InstructionType {
 
   void ComputeIf(Instruction* instruction) const {
     OF_PROFILER_RANGE_GUARD(std::string("Compute:") + DebugName(*instruction));
+    profiler::OpTraceGuard op_trace_guard(op_trace_id());
     Compute(instruction);
   }
 
@@ -61,9 +64,12 @@ class InstructionType {
   virtual std::string DebugName(const Instruction&) const = 0;
 
  protected:
-  InstructionType() = default;
+  InstructionType() : op_trace_id_(-1) {}
 
  private:
+  // Instructions are traced by their instruction type, named after the demangled class name.
+  int32_t op_trace_id() const;
+
   // Allocating tensors, deallocating tensors, preparing opkernel states and preparing opkernel
   // caches.
   virtual Maybe<void> Prepare(Instruction* instruction) const = 0;
@@ -73,6 +79,8 @@ class InstructionType {
   virtual void InitInstructionStatus(Instruction* instruction) const;
   virtual void DeleteInstructionStatus(Instruction* instruction) const;
   void InitOrCheckInputBlobsMemPtrForAllocationCompuationPipelining(Instruction* instruction) const;
+
+  mutable std::atomic<int32_t> op_trace_id_;
 };
 
 }  // namespace vm
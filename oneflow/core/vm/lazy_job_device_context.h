@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef ONEFLOW_CORE_VM_LAZY_JOB_DEVICE_CONTEXT_H_
 #define ONEFLOW_CORE_VM_LAZY_JOB_DEVICE_CONTEXT_H_
 
+#include <list>
 #include "oneflow/core/framework/nn_graph_if.h"
 #include "oneflow/core/common/util.h"
 #include "oneflow/core/device/device_context.h"
@@ -42,32 +43,44 @@ class LazyJobDeviceCtx final : public DeviceCtx {
     return nullptr;
   }
 
-  std::queue<std::weak_ptr<NNGraphIf>>* mut_queue() { return &queue_; }
   std::mutex* mut_mutex() { return &mutex_; }
   std::condition_variable* mut_cond() { return &cond_; }
 
-  void WaitUntilQueueEmptyIfFrontNNGraphNotEquals(const std::shared_ptr<NNGraphIf>& nn_graph) {
+  // Jobs of the same graph are pipelined by its runtime. Jobs of different graphs only overlap
+  // when all of them may run concurrently, otherwise the launch waits until the running ones are
+  // finished.
+  void WaitUntilNNGraphCanLaunch(const std::shared_ptr<NNGraphIf>& nn_graph) {
     std::unique_lock<std::mutex> lock(mutex_);
-    if (queue_.empty()) { return; }
-    const auto& last_nn_graph = queue_.front().lock();
-    if (!last_nn_graph) { return; }
-    if (last_nn_graph == nn_graph) { return; }
-    cond_.wait(lock, [this]() { return queue_.empty(); });
+    cond_.wait(lock, [&]() { return CanLaunch(*nn_graph); });
   }
 
   void EnqueueNNGraph(const std::shared_ptr<NNGraphIf>& nn_graph) {
     std::unique_lock<std::mutex> lock(mutex_);
-    queue_.emplace(nn_graph);
+    running_nn_graphs_.emplace_back(nn_graph.get(), nn_graph->may_run_concurrently());
   }
 
-  void DequeueNNGraph() {
+  void DequeueNNGraph(const NNGraphIf* nn_graph) {
     std::unique_lock<std::mutex> lock(mutex_);
-    queue_.pop();
+    auto iter = running_nn_graphs_.begin();
+    while (iter != running_nn_graphs_.end() && iter->first != nn_graph) { ++iter; }
+    CHECK(iter != running_nn_graphs_.end()) << "nn graph " << nn_graph->job_name()
+                                            << " is not running";
+    running_nn_graphs_.erase(iter);
     cond_.notify_all();
   }
 
  private:
-  std::queue<std::weak_ptr<NNGraphIf>> queue_;
+  bool CanLaunch(const NNGraphIf& nn_graph) const {
+    for (const auto& pair : running_nn_graphs_) {
+      if (pair.first == &nn_graph) { continue; }
+      if (!pair.second || !nn_graph.may_run_concurrently()) { return false; }
+    }
+    return true;
+  }
+
+  // the running jobs in launch order, a graph shows up once per running job of it. Every graph
+  // outlives its jobs since the launch instructions hold it.
+  std::list<std::pair<const NNGraphIf*, bool>> running_nn_graphs_;
   std::mutex mutex_;
   std::condition_variable cond_;
 };
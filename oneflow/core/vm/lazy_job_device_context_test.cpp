@@ -0,0 +1,99 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <chrono>
+#include <future>
+#include "gtest/gtest.h"
+#include "oneflow/core/vm/lazy_job_device_context.h"
+
+namespace oneflow {
+namespace vm {
+
+namespace {
+
+class TestNNGraph final : public NNGraphIf {
+ public:
+  TestNNGraph(const std::string& job_name, bool may_run_concurrently)
+      : job_name_(job_name), may_run_concurrently_(may_run_concurrently) {}
+  ~TestNNGraph() override = default;
+
+  const std::string& job_name() const override { return job_name_; }
+  const std::vector<std::string>& inputs_op_names() const override { return op_names_; }
+  const std::vector<std::string>& outputs_op_names() const override { return op_names_; }
+  const std::vector<bool>& inputs_valid() const override { return valid_; }
+  const std::vector<bool>& outputs_valid() const override { return valid_; }
+  bool writes_variables() const override { return !may_run_concurrently_; }
+  bool may_run_concurrently() const override { return may_run_concurrently_; }
+
+ private:
+  std::string job_name_;
+  bool may_run_concurrently_;
+  std::vector<std::string> op_names_;
+  std::vector<bool> valid_;
+};
+
+constexpr std::chrono::milliseconds kBlockedTimeout(100);
+constexpr std::chrono::seconds kLaunchTimeout(10);
+
+std::future<void> AsyncWaitUntilNNGraphCanLaunch(LazyJobDeviceCtx* device_ctx,
+                                                 const std::shared_ptr<NNGraphIf>& nn_graph) {
+  return std::async(std::launch::async,
+                    [device_ctx, nn_graph]() { device_ctx->WaitUntilNNGraphCanLaunch(nn_graph); });
+}
+
+}  // namespace
+
+TEST(LazyJobDeviceCtx, concurrent_graphs_overlap) {
+  LazyJobDeviceCtx device_ctx;
+  const auto graph0 = std::make_shared<TestNNGraph>("graph0", true);
+  const auto graph1 = std::make_shared<TestNNGraph>("graph1", true);
+  device_ctx.EnqueueNNGraph(graph0);
+  auto launched = AsyncWaitUntilNNGraphCanLaunch(&device_ctx, graph1);
+  ASSERT_EQ(launched.wait_for(kLaunchTimeout), std::future_status::ready);
+  device_ctx.EnqueueNNGraph(graph1);
+  // both graphs are running now, and either of them may be launched again
+  launched = AsyncWaitUntilNNGraphCanLaunch(&device_ctx, graph0);
+  ASSERT_EQ(launched.wait_for(kLaunchTimeout), std::future_status::ready);
+  device_ctx.DequeueNNGraph(graph0.get());
+  device_ctx.DequeueNNGraph(graph1.get());
+}
+
+TEST(LazyJobDeviceCtx, writing_graph_waits_for_other_graphs) {
+  LazyJobDeviceCtx device_ctx;
+  const auto reader0 = std::make_shared<TestNNGraph>("reader0", true);
+  const auto reader1 = std::make_shared<TestNNGraph>("reader1", true);
+  const auto writer = std::make_shared<TestNNGraph>("writer", false);
+  device_ctx.EnqueueNNGraph(reader0);
+  device_ctx.EnqueueNNGraph(reader1);
+  auto launched = AsyncWaitUntilNNGraphCanLaunch(&device_ctx, writer);
+  ASSERT_EQ(launched.wait_for(kBlockedTimeout), std::future_status::timeout);
+  device_ctx.DequeueNNGraph(reader0.get());
+  ASSERT_EQ(launched.wait_for(kBlockedTimeout), std::future_status::timeout);
+  device_ctx.DequeueNNGraph(reader1.get());
+  ASSERT_EQ(launched.wait_for(kLaunchTimeout), std::future_status::ready);
+  device_ctx.EnqueueNNGraph(writer);
+  // jobs of the writing graph itself are still pipelined, other graphs wait for them
+  launched = AsyncWaitUntilNNGraphCanLaunch(&device_ctx, writer);
+  ASSERT_EQ(launched.wait_for(kLaunchTimeout), std::future_status::ready);
+  device_ctx.EnqueueNNGraph(writer);
+  launched = AsyncWaitUntilNNGraphCanLaunch(&device_ctx, reader0);
+  device_ctx.DequeueNNGraph(writer.get());
+  ASSERT_EQ(launched.wait_for(kBlockedTimeout), std::future_status::timeout);
+  device_ctx.DequeueNNGraph(writer.get());
+  ASSERT_EQ(launched.wait_for(kLaunchTimeout), std::future_status::ready);
+}
+
+}  // namespace vm
+}  // namespace oneflow
@@ -0,0 +1,147 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_CORE_VM_RADIX_PAGE_MAP_H_
+#define ONEFLOW_CORE_VM_RADIX_PAGE_MAP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+namespace vm {
+
+// RadixPageMap maps addresses aligned to `alignment` to T* with a three-level radix tree.
+//
+// Get() takes three dependent loads and never locks, so it can be called concurrently with Set()
+// as long as the entry being read is not modified at the same time. Set() must be serialized by
+// the caller. Leaves are allocated on first use and released when their last entry is erased, so
+// the map costs at most one pointer per `alignment` bytes of the address ranges holding entries.
+// Only the lower 48 address bits are used, which covers the user space of x86_64 and aarch64.
+template<typename T>
+class RadixPageMap final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(RadixPageMap);
+  explicit RadixPageMap(size_t alignment);
+  ~RadixPageMap();
+
+  T* Get(const char* ptr) const;
+  void Set(const char* ptr, T* value);
+
+ private:
+  static constexpr int32_t kAddressBits = 48;
+
+  struct Leaf {
+    explicit Leaf(int64_t size) : values(new std::atomic<T*>[size]), entry_cnt(0) {
+      for (int64_t i = 0; i < size; ++i) { values[i].store(nullptr, std::memory_order_relaxed); }
+    }
+    std::unique_ptr<std::atomic<T*>[]> values;
+    size_t entry_cnt;
+  };
+
+  struct Mid {
+    explicit Mid(int64_t size) : leaves(new std::atomic<Leaf*>[size]) {
+      for (int64_t i = 0; i < size; ++i) { leaves[i].store(nullptr, std::memory_order_relaxed); }
+    }
+    std::unique_ptr<std::atomic<Leaf*>[]> leaves;
+  };
+
+  uint64_t Key4Ptr(const char* ptr) const {
+    const uint64_t addr = reinterpret_cast<uint64_t>(ptr);
+    CHECK_EQ(addr >> kAddressBits, 0) << "address out of range of RadixPageMap";
+    return addr >> shift_;
+  }
+  uint64_t RootIndex4Key(uint64_t key) const { return key >> (leaf_bits_ + mid_bits_); }
+  uint64_t MidIndex4Key(uint64_t key) const {
+    return (key >> leaf_bits_) & ((uint64_t(1) << mid_bits_) - 1);
+  }
+  uint64_t LeafIndex4Key(uint64_t key) const { return key & ((uint64_t(1) << leaf_bits_) - 1); }
+
+  const int32_t shift_;
+  // The key bits are split evenly between the three levels
+  const int32_t leaf_bits_;
+  const int32_t mid_bits_;
+  const int32_t root_bits_;
+  std::unique_ptr<std::atomic<Mid*>[]> root_;
+};
+
+template<typename T>
+RadixPageMap<T>::RadixPageMap(size_t alignment)
+    : shift_(63 ^ __builtin_clzll(alignment)),
+      leaf_bits_((kAddressBits - shift_ + 2) / 3),
+      mid_bits_((kAddressBits - shift_ + 2) / 3),
+      root_bits_(kAddressBits - shift_ - leaf_bits_ - mid_bits_),
+      root_(new std::atomic<Mid*>[int64_t(1) << root_bits_]) {
+  CHECK_EQ(static_cast<size_t>(1) << shift_, alignment);
+  for (int64_t i = 0; i < (int64_t(1) << root_bits_); ++i) {
+    root_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+template<typename T>
+RadixPageMap<T>::~RadixPageMap() {
+  for (int64_t i = 0; i < (int64_t(1) << root_bits_); ++i) {
+    Mid* mid = root_[i].load(std::memory_order_relaxed);
+    if (mid == nullptr) { continue; }
+    for (int64_t j = 0; j < (int64_t(1) << mid_bits_); ++j) {
+      delete mid->leaves[j].load(std::memory_order_relaxed);
+    }
+    delete mid;
+  }
+}
+
+template<typename T>
+T* RadixPageMap<T>::Get(const char* ptr) const {
+  const uint64_t key = Key4Ptr(ptr);
+  const Mid* mid = root_[RootIndex4Key(key)].load(std::memory_order_acquire);
+  if (mid == nullptr) { return nullptr; }
+  const Leaf* leaf = mid->leaves[MidIndex4Key(key)].load(std::memory_order_acquire);
+  if (leaf == nullptr) { return nullptr; }
+  return leaf->values[LeafIndex4Key(key)].load(std::memory_order_acquire);
+}
+
+template<typename T>
+void RadixPageMap<T>::Set(const char* ptr, T* value) {
+  const uint64_t key = Key4Ptr(ptr);
+  std::atomic<Mid*>* mid_slot = &root_[RootIndex4Key(key)];
+  Mid* mid = mid_slot->load(std::memory_order_relaxed);
+  if (mid == nullptr) {
+    if (value == nullptr) { return; }
+    mid = new Mid(int64_t(1) << mid_bits_);
+    mid_slot->store(mid, std::memory_order_release);
+  }
+  std::atomic<Leaf*>* leaf_slot = &mid->leaves[MidIndex4Key(key)];
+  Leaf* leaf = leaf_slot->load(std::memory_order_relaxed);
+  if (leaf == nullptr) {
+    if (value == nullptr) { return; }
+    leaf = new Leaf(int64_t(1) << leaf_bits_);
+    leaf_slot->store(leaf, std::memory_order_release);
+  }
+  std::atomic<T*>* value_slot = &leaf->values[LeafIndex4Key(key)];
+  T* old_value = value_slot->load(std::memory_order_relaxed);
+  value_slot->store(value, std::memory_order_release);
+  if (old_value == nullptr && value != nullptr) {
+    ++leaf->entry_cnt;
+  } else if (old_value != nullptr && value == nullptr && --leaf->entry_cnt == 0) {
+    leaf_slot->store(nullptr, std::memory_order_release);
+    delete leaf;
+  }
+}
+
+}  // namespace vm
+}  // namespace oneflow
+
+#endif  // ONEFLOW_CORE_VM_RADIX_PAGE_MAP_H_
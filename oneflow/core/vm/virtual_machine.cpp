@@ -33,6 +33,7 @@ limitations under the License.
 #include "oneflow/core/framework/to_string.h"
 #include "oneflow/core/framework/stream_on_independent_thread.h"
 #include "oneflow/core/framework/stream_is_comm_net_stream.h"
+#include "oneflow/core/framework/stream_get_stream_role_name.h"
 #include "oneflow/core/profiler/profiler.h"
 #include "oneflow/core/platform/include/pthread_fork.h"
 #include "oneflow/core/common/env_var/env_var.h"
@@ -192,6 +193,27 @@ Maybe<void> VirtualMachine::ShrinkAllMem() {
   return BlockingRunProbeFunc(try_shrink_men);
 }
 
+Maybe<HashMap<std::string, vm::CachingAllocatorStats>> VirtualMachine::GetAllocatorStats() {
+  auto stream_name2stats = std::make_shared<HashMap<std::string, vm::CachingAllocatorStats>>();
+  auto collect_stats = [stream_name2stats](vm::VirtualMachineEngine* engine) -> bool {
+    INTRUSIVE_FOR_EACH_PTR(thread_ctx, engine->mut_thread_ctx_list()) {
+      INTRUSIVE_FOR_EACH_PTR(stream, thread_ctx->mut_stream_list()) {
+        const auto& device_ctx = stream->device_ctx();
+        if (device_ctx.get() && device_ctx->mut_allocator()) {
+          auto* cache = dynamic_cast<vm::CachingAllocator*>(device_ctx->mut_allocator());
+          if (cache == nullptr) { continue; }
+          const std::string stream_name = stream->device()->ToString() + "/"
+                                          + GetStreamRoleName::Visit(stream->stream_role());
+          (*stream_name2stats)[stream_name] = cache->GetStats();
+        }
+      }
+    }
+    return true;
+  };
+  JUST(BlockingRunProbeFunc(collect_stats));
+  return stream_name2stats;
+}
+
 VirtualMachine::~VirtualMachine() {
   if (!disable_vm_threads_) { CHECK_JUST(CloseVMThreads()); }
   CHECK(engine_->SchedulerEmpty());
@@ -19,6 +19,7 @@ limitations under the License.
 #include <mutex>
 #include "oneflow/core/common/notifier.h"
 #include "oneflow/core/vm/virtual_machine_engine.h"
+#include "oneflow/core/vm/caching_allocator.h"
 #include "oneflow/core/thread/thread_pool.h"
 #include "oneflow/core/common/stream_role.h"
 #include "oneflow/core/common/steady_vector.h"
@@ -48,6 +49,8 @@ class VirtualMachine final {
   // Never called in vm work threads.
   // VM sync must be called to ensure all working instructions are finished.
   Maybe<void> ShrinkAllMem();
+  // Stats of the caching allocators keyed by "<device>/<stream role>", like "cuda:0/compute"
+  Maybe<HashMap<std::string, vm::CachingAllocatorStats>> GetAllocatorStats();
   Maybe<vm::Stream*> GetVmStream(Symbol<Stream> stream);
 
  private:
@@ -47,6 +47,15 @@ LogicalResult LowerModuleToLLVM(mlir::MLIRContext* context, ModuleOp module);
 LogicalResult LowerModuleToCUDALLVM(mlir::MLIRContext* context, ModuleOp module);
 #endif  // WITH_MLIR_CUDA_CODEGEN
 void populateFuserPasses(::mlir::RewritePatternSet& patterns);
+
+struct ElementwiseChainFusionStats {
+  int64_t num_fused_chains = 0;
+  int64_t num_fused_ops = 0;
+  // bytes of intermediate tensors that are no longer written to and read from memory
+  int64_t saved_memory_traffic_bytes = 0;
+};
+void populateElementwiseChainFuserPatterns(::mlir::RewritePatternSet& patterns,
+                                           ElementwiseChainFusionStats* stats);
 void populateFuserForExistingOp(::mlir::RewritePatternSet& patterns);
 void populateGpuHelperPatterns(::mlir::RewritePatternSet& patterns);
 void populateAutoNhwcPatterns(::mlir::RewritePatternSet& patterns);
@@ -273,6 +273,124 @@ struct Add2OpLowering final : public OpConversionPattern<Add2Op> {
   }
 };
 
+struct BroadcastSubOpLowering final : public OpConversionPattern<BroadcastSubOp> {
+ public:
+  using OpConversionPattern<BroadcastSubOp>::OpConversionPattern;
+  LogicalResult matchAndRewrite(BroadcastSubOp op, OpAdaptor adaptor,
+                                ConversionPatternRewriter& rewriter) const override {
+    rewriter.replaceOpWithNewOp<tosa::SubOp>(op, op.z().getType(), op.x(), op.y());
+    return success();
+  }
+};
+
+struct BroadcastMulOpLowering final : public OpConversionPattern<BroadcastMulOp> {
+ public:
+  using OpConversionPattern<BroadcastMulOp>::OpConversionPattern;
+  LogicalResult matchAndRewrite(BroadcastMulOp op, OpAdaptor adaptor,
+                                ConversionPatternRewriter& rewriter) const override {
+    rewriter.replaceOpWithNewOp<tosa::MulOp>(op, op.z().getType(), op.x(), op.y(), 0);
+    return success();
+  }
+};
+
+// Returns a tensor of the rank of `like` with every dim 1, filled by the scalar operand.
+Value CreateScalarOperandConst(Location loc, ConversionPatternRewriter& rewriter, Value like,
+                               bool has_float_operand, double float_operand,
+                               int64_t int_operand) {
+  const auto like_type = like.getType().cast<RankedTensorType>();
+  const auto element_type = like_type.getElementType();
+  const auto const_type =
+      RankedTensorType::get(SmallVector<int64_t, 4>(like_type.getRank(), 1), element_type);
+  Attribute value;
+  if (element_type.isa<FloatType>()) {
+    value = rewriter.getFloatAttr(element_type, has_float_operand
+                                                    ? float_operand
+                                                    : static_cast<double>(int_operand));
+  } else {
+    value = rewriter.getIntegerAttr(element_type, has_float_operand
+                                                      ? static_cast<int64_t>(float_operand)
+                                                      : int_operand);
+  }
+  return rewriter.create<tosa::ConstOp>(loc, const_type, DenseElementsAttr::get(const_type, value));
+}
+
+struct ScalarAddOpLowering final : public OpConversionPattern<ScalarAddOp> {
+ public:
+  using OpConversionPattern<ScalarAddOp>::OpConversionPattern;
+  LogicalResult matchAndRewrite(ScalarAddOp op, OpAdaptor adaptor,
+                                ConversionPatternRewriter& rewriter) const override {
+    auto scalar = CreateScalarOperandConst(op->getLoc(), rewriter, op.in(), op.has_float_operand(),
+                                           op.float_operand().convertToDouble(), op.int_operand());
+    rewriter.replaceOpWithNewOp<tosa::AddOp>(op, op.out().getType(), op.in(), scalar);
+    return success();
+  }
+};
+
+struct ScalarMulOpLowering final : public OpConversionPattern<ScalarMulOp> {
+ public:
+  using OpConversionPattern<ScalarMulOp>::OpConversionPattern;
+  LogicalResult matchAndRewrite(ScalarMulOp op, OpAdaptor adaptor,
+                                ConversionPatternRewriter& rewriter) const override {
+    auto scalar = CreateScalarOperandConst(op->getLoc(), rewriter, op.in(), op.has_float_operand(),
+                                           op.float_operand().convertToDouble(), op.int_operand());
+    rewriter.replaceOpWithNewOp<tosa::MulOp>(op, op.out().getType(), op.in(), scalar, 0);
+    return success();
+  }
+};
+
+struct BiasAddOpLowering final : public OpConversionPattern<BiasAddOp> {
+ public:
+  using OpConversionPattern<BiasAddOp>::OpConversionPattern;
+  LogicalResult matchAndRewrite(BiasAddOp op, OpAdaptor adaptor,
+                                ConversionPatternRewriter& rewriter) const override {
+    // reshape the 1-d bias to the rank of a, with its dim at axis
+    const auto a_type = op.a().getType().cast<RankedTensorType>();
+    const auto b_type = op.b().getType().cast<RankedTensorType>();
+    const int64_t rank = a_type.getRank();
+    const int64_t axis = op.axis() < 0 ? op.axis() + rank : op.axis();
+    SmallVector<int64_t, 4> new_shape(rank, 1);
+    new_shape[axis] = b_type.getDimSize(0);
+    auto bias = rewriter.create<tosa::ReshapeOp>(
+        op->getLoc(), RankedTensorType::get(new_shape, b_type.getElementType()), op.b(),
+        rewriter.getI64ArrayAttr(new_shape));
+    rewriter.replaceOpWithNewOp<tosa::AddOp>(op, op.out().getType(), op.a(), bias);
+    return success();
+  }
+};
+
+struct TanhOpLowering final : public OpConversionPattern<TanhOp> {
+ public:
+  using OpConversionPattern<TanhOp>::OpConversionPattern;
+  LogicalResult matchAndRewrite(TanhOp op, OpAdaptor adaptor,
+                                ConversionPatternRewriter& rewriter) const override {
+    rewriter.replaceOpWithNewOp<tosa::TanhOp>(op, op.y().getType(), op.x());
+    return success();
+  }
+};
+
+struct SigmoidV2OpLowering final : public OpConversionPattern<SigmoidV2Op> {
+ public:
+  using OpConversionPattern<SigmoidV2Op>::OpConversionPattern;
+  LogicalResult matchAndRewrite(SigmoidV2Op op, OpAdaptor adaptor,
+                                ConversionPatternRewriter& rewriter) const override {
+    rewriter.replaceOpWithNewOp<tosa::SigmoidOp>(op, op.y().getType(), op.x());
+    return success();
+  }
+};
+
+struct SiluOpLowering final : public OpConversionPattern<SiluOp> {
+ public:
+  using OpConversionPattern<SiluOp>::OpConversionPattern;
+  LogicalResult matchAndRewrite(SiluOp op, OpAdaptor adaptor,
+                                ConversionPatternRewriter& rewriter) const override {
+    // silu(x) = x * sigmoid(x)
+    const auto output = op.out().getType();
+    auto sigmoid = rewriter.create<tosa::SigmoidOp>(op->getLoc(), output, op.in());
+    rewriter.replaceOpWithNewOp<tosa::MulOp>(op, output, op.in(), sigmoid, 0);
+    return success();
+  }
+};
+
 struct AvgPool2DOpLowering final : public OpConversionPattern<AvgPool2DOp> {
  public:
   using OpConversionPattern<AvgPool2DOp>::OpConversionPattern;
@@ -594,8 +712,10 @@ void OneFlowLoweringToTosaPass::runOnOperation() {
       .add<CastOpLowering, ScalarMulByTensorOpLowering, ReluOpLowering, Conv2DOpLowering,
            AvgPool2DOpLowering, FlattenOpLowering, Add2OpLowering, MaxPool2DOpLowering,
            MatmulOpLowering, BroadcastAddOpLowering, JobLowering, ReturnOpLowering, InputOpLowering,
-           OutputOpLowering, NormalizationOpLowering, NormalizationInferenceOpLowering>(
-          typeConverter, context);
+           OutputOpLowering, NormalizationOpLowering, NormalizationInferenceOpLowering,
+           BroadcastSubOpLowering, BroadcastMulOpLowering, ScalarAddOpLowering,
+           ScalarMulOpLowering, BiasAddOpLowering, TanhOpLowering, SigmoidV2OpLowering,
+           SiluOpLowering>(typeConverter, context);
   if (failed(applyPartialConversion(getOperation(), target, std::move(patterns)))) {
     getOperation()->dump();
     signalPassFailure();
@@ -19,6 +19,8 @@ limitations under the License.
 #include "OneFlow/Passes.h"
 #include "OneFlow/OneFlowSupport.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "mlir-c/BuiltinAttributes.h"
 #include "mlir/IR/Attributes.h"
@@ -29,12 +31,14 @@ limitations under the License.
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/None.h"
 #include "llvm/Support/Casting.h"
+#include "mlir/Conversion/AsyncToLLVM/AsyncToLLVM.h"
 #include "mlir/Conversion/LinalgToLLVM/LinalgToLLVM.h"
 #include "mlir/Conversion/MemRefToLLVM/MemRefToLLVM.h"
 #include "mlir/Conversion/ReconcileUnrealizedCasts/ReconcileUnrealizedCasts.h"
 #include "mlir/Conversion/FuncToLLVM/ConvertFuncToLLVMPass.h"
 #include "mlir/Conversion/TosaToLinalg/TosaToLinalg.h"
 #include "mlir/Dialect/Affine/IR/AffineOps.h"
+#include "mlir/Dialect/Async/Passes.h"
 #include "mlir/Dialect/Linalg/Passes.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/Transforms/Passes.h"
@@ -145,6 +149,17 @@ func::FuncOp GetOrInsertFuncOp(::mlir::PatternRewriter& rewriter, mlir::Location
   return function;
 }
 
+// Checks the conditions under which GetOrInsertFuncOp fails, so that patterns can bail out before
+// they touch the IR.
+LogicalResult CheckCanInsertFuncOp(Operation* op, StringRef func_name) {
+  auto parent_func_op = op->getParentOfType<oneflow::Job>();
+  if (!parent_func_op || parent_func_op->hasAttr("llvm.emit_c_interface")) { return failure(); }
+  auto parent_module_op = parent_func_op->getParentOfType<ModuleOp>();
+  if (!parent_module_op) { return failure(); }
+  if (SymbolTable(parent_module_op).lookup(func_name)) { return failure(); }
+  return success();
+}
+
 NamedAttrList GetJitOpAttributes(::mlir::PatternRewriter& rewriter, StringRef op_name,
                                  int32_t input_size, int32_t output_size, Operation* op) {
   NamedAttrList attributes;
@@ -257,6 +272,128 @@ static StringRef sanitizeIdentifier(StringRef name, SmallString<16>& buffer,
   return {};
 }
 
+bool IsFusibleElementwiseOp(Operation* op) {
+  if (!llvm::isa<CastOp, ReluOp, TanhOp, SigmoidV2Op, SiluOp, BroadcastAddOp, BroadcastSubOp,
+                 BroadcastMulOp, Add2Op, ScalarAddOp, ScalarMulOp, ScalarMulByTensorOp,
+                 BiasAddOp>(op)) {
+    return false;
+  }
+  if (op->getNumResults() != 1) { return false; }
+  // the jit kernel is compiled for the host, gpu codegen goes through OutlineJitFunctionPass
+  if (OpTrait::IsOpConfCompatible<void>::getDeviceTag(op).getValue() != "cpu") { return false; }
+  for (auto type : llvm::concat<const Type>(op->getOperandTypes(), op->getResultTypes())) {
+    auto tensor_type = type.dyn_cast<RankedTensorType>();
+    if (!tensor_type || !tensor_type.hasStaticShape()) { return false; }
+  }
+  return true;
+}
+
+bool HaveIdenticalPlacement(Operation* a, Operation* b) {
+  return OpTrait::IsOpConfCompatible<void>::getDeviceTag(a)
+             == OpTrait::IsOpConfCompatible<void>::getDeviceTag(b)
+         && OpTrait::IsOpConfCompatible<void>::getDeviceName(a)
+                == OpTrait::IsOpConfCompatible<void>::getDeviceName(b);
+}
+
+int64_t GetTensorBytes(Value value) {
+  auto tensor_type = value.getType().cast<RankedTensorType>();
+  return tensor_type.getNumElements() * ((tensor_type.getElementTypeBitWidth() + 7) / 8);
+}
+
+// Outlines a tree of fusible elementwise ops into one MlirJitOp. The pattern matches the tail of
+// the tree, an op whose result is used by anything but fusible ops, and absorbs producers whose
+// results are only used inside the tree, so the intermediate tensors are never materialized.
+struct OutlineElementwiseChainPattern final : public RewritePattern {
+  OutlineElementwiseChainPattern(MLIRContext* context, ElementwiseChainFusionStats* stats)
+      : RewritePattern(MatchAnyOpTypeTag(), /*benefit=*/1, context), stats_(stats) {}
+
+  LogicalResult matchAndRewrite(Operation* tail, PatternRewriter& rewriter) const override {
+    if (!IsFusibleElementwiseOp(tail)) { return failure(); }
+    const auto tail_type = tail->getResult(0).getType().cast<RankedTensorType>().getElementType();
+    // the data types mlir_jit cpu kernel is registered for
+    if (!(tail_type.isF32() || tail_type.isF64() || tail_type.isInteger(32)
+          || tail_type.isInteger(64))) {
+      return failure();
+    }
+    const auto users = tail->getResult(0).getUsers();
+    const bool is_tail = users.empty() || llvm::any_of(users, [&](Operation* user) {
+      return !IsFusibleElementwiseOp(user) || !HaveIdenticalPlacement(tail, user);
+    });
+    if (!is_tail) { return failure(); }
+
+    llvm::SmallPtrSet<Operation*, 8> cluster{tail};
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (Operation* op : llvm::SmallVector<Operation*, 8>(cluster.begin(), cluster.end())) {
+        for (Value operand : op->getOperands()) {
+          Operation* producer = operand.getDefiningOp();
+          if (!producer || cluster.count(producer) || !IsFusibleElementwiseOp(producer)
+              || producer->getBlock() != tail->getBlock()
+              || !HaveIdenticalPlacement(tail, producer)) {
+            continue;
+          }
+          if (llvm::all_of(producer->getUsers(),
+                           [&](Operation* user) { return cluster.count(user); })) {
+            cluster.insert(producer);
+            changed = true;
+          }
+        }
+      }
+    }
+    if (cluster.size() < 2) { return failure(); }
+
+    SmallVector<Operation*, 4> ops(cluster.begin(), cluster.end());
+    llvm::sort(ops, [](Operation* a, Operation* b) { return a->isBeforeInBlock(b); });
+    llvm::SetVector<Value> operands;
+    for (Operation* op : ops) {
+      for (Value operand : op->getOperands()) {
+        if (!cluster.count(operand.getDefiningOp())) { operands.insert(operand); }
+      }
+    }
+    SmallString<64> op_name_storage;
+    auto op_name =
+        (OpTrait::IsOpConfCompatible<void>::getOpName(tail).getValue() + "__FUSE_ELEMENTWISE")
+            .toStringRef(op_name_storage);
+    SmallString<16> tempBuffer;
+    op_name = sanitizeIdentifier(op_name, tempBuffer);
+    // every step that can fail is checked before the first mutation, a pattern must not report
+    // failure after changing the IR
+    if (failed(CheckCanInsertFuncOp(tail, op_name))) { return failure(); }
+    NamedAttrList attributes =
+        GetJitOpAttributes(rewriter, op_name, operands.size(), tail->getNumResults(), tail);
+    auto function = GetOrInsertFuncOp(rewriter, tail->getLoc(), op_name,
+                                      operands.getArrayRef(), tail->getResults(), ops);
+    if (!function) { llvm::report_fatal_error("fail to outline " + op_name); }
+    // the outlined function is printed directly instead of being looked up again by DumpAssembly
+    std::string mlir_assembly;
+    llvm::raw_string_ostream os_mlir(mlir_assembly);
+    function->print(os_mlir);
+    attributes.set("mlir_assembly", rewriter.getStringAttr(os_mlir.str()));
+    auto created =
+        rewriter.create<MlirJitOp>(tail->getLoc(), function, attributes, operands.getArrayRef());
+    if (stats_) {
+      stats_->num_fused_chains += 1;
+      stats_->num_fused_ops += ops.size();
+      for (Operation* op : ops) {
+        if (op == tail) { continue; }
+        // written once by the producer and read by every user
+        const Value result = op->getResult(0);
+        const int64_t num_uses = std::distance(result.use_begin(), result.use_end());
+        stats_->saved_memory_traffic_bytes += GetTensorBytes(result) * (1 + num_uses);
+      }
+    }
+    rewriter.replaceOp(tail, created->getResults());
+    for (auto it = ops.rbegin(); it != ops.rend(); ++it) {
+      if (*it != tail) { rewriter.eraseOp(*it); }
+    }
+    return success();
+  }
+
+ private:
+  ElementwiseChainFusionStats* stats_;
+};
+
 ::llvm::SmallVector<::mlir::Value, 4> CreateGPUMemcpyOpFromMemrefCopy(
     ::mlir::PatternRewriter& rewriter, ::mlir::memref::CopyOp copyOp) {
   // NOTE: to get lowered to LLVM, it has to be async
@@ -750,9 +887,24 @@ void AddLowerToLinalgMemRefPasses(PassManager& pm) {
 LogicalResult LowerModuleToLLVM(mlir::MLIRContext* context, ModuleOp module) {
   mlir::PassManager pm(context);
   AddLowerToLinalgMemRefPasses(pm);
-  pm.addNestedPass<func::FuncOp>(createConvertLinalgToLoopsPass());  // convert-linalg-to-loops
-  pm.addNestedPass<func::FuncOp>(createConvertSCFToCFPass());        // convert-scf-to-cf
-  pm.addPass(createConvertLinalgToLLVMPass());                       // convert-linalg-to-llvm
+  // parallel loops run on the async runtime, libmlir_async_runtime must be loaded by
+  // load_jit_shared_lib for the jit function to find its symbols
+  const int64_t num_threads = ::oneflow::ParseIntegerFromEnv("ONEFLOW_MLIR_JIT_CPU_NUM_THREADS", 1);
+  if (num_threads > 1) {
+    pm.addNestedPass<func::FuncOp>(
+        createConvertLinalgToParallelLoopsPass());  // convert-linalg-to-parallel-loops
+    pm.addNestedPass<func::FuncOp>(createAsyncParallelForPass(
+        /*asyncDispatch=*/true, num_threads, /*minTaskSize=*/4096));  // async-parallel-for
+    pm.addPass(createAsyncToAsyncRuntimePass());                         // async-to-async-runtime
+    pm.addNestedPass<func::FuncOp>(createAsyncRuntimeRefCountingPass());
+    pm.addNestedPass<func::FuncOp>(createAsyncRuntimeRefCountingOptPass());
+    pm.addPass(createCanonicalizerPass());
+  } else {
+    pm.addNestedPass<func::FuncOp>(createConvertLinalgToLoopsPass());  // convert-linalg-to-loops
+  }
+  pm.addNestedPass<func::FuncOp>(createConvertSCFToCFPass());  // convert-scf-to-cf
+  if (num_threads > 1) { pm.addPass(createConvertAsyncToLLVMPass()); }  // convert-async-to-llvm
+  pm.addPass(createConvertLinalgToLLVMPass());                         // convert-linalg-to-llvm
   pm.addPass(createMemRefToLLVMPass());                              // convert-memref-to-llvm
   pm.addPass(createConvertFuncToLLVMPass());                         // convert-func-to-llvm
   pm.addPass(createReconcileUnrealizedCastsPass());                  // reconcile-unrealized-casts
@@ -794,6 +946,11 @@ void populateFuserPasses(::mlir::RewritePatternSet& patterns) {
   patterns.add<MulCastPattern>(patterns.getContext());
 }
 
+void populateElementwiseChainFuserPatterns(::mlir::RewritePatternSet& patterns,
+                                           ElementwiseChainFusionStats* stats) {
+  patterns.add<OutlineElementwiseChainPattern>(patterns.getContext(), stats);
+}
+
 void populateFuserForExistingOp(::mlir::RewritePatternSet& patterns) {
   patterns.add<FusedBiasAddGeluPattern>(patterns.getContext());
   patterns.add<FusedScaleTrilPattern>(patterns.getContext());
@@ -16,6 +16,7 @@ limitations under the License.
 #include <iostream>
 #include <string>
 #include "OneFlow/Passes.h"
+#include "oneflow/core/common/util.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 
@@ -32,6 +33,24 @@ class OutlineJitFunctionPass : public OutlineJitFunctionPassBase<OutlineJitFunct
   }
 };
 
+class FuseElementwiseChainPass : public FuseElementwiseChainPassBase<FuseElementwiseChainPass> {
+  void runOnOperation() override {
+    Operation* op = getOperation();
+    RewritePatternSet patterns(op->getContext());
+    oneflow::ElementwiseChainFusionStats stats;
+    oneflow::populateElementwiseChainFuserPatterns(patterns, &stats);
+    (void)applyPatternsAndFoldGreedily(op, std::move(patterns));
+    numFusedChains += stats.num_fused_chains;
+    numFusedOps += stats.num_fused_ops;
+    numSavedBytes += stats.saved_memory_traffic_bytes;
+    if (::oneflow::ParseBooleanFromEnv("ONEFLOW_MLIR_STDOUT", false)) {
+      llvm::outs() << "fused " << stats.num_fused_ops << " elementwise ops into "
+                   << stats.num_fused_chains << " chains, saved "
+                   << stats.saved_memory_traffic_bytes << " bytes of memory traffic\n";
+    }
+  }
+};
+
 class FuseIntoExistingOpPass : public FuseIntoExistingOpPassBase<FuseIntoExistingOpPass> {
   void runOnOperation() override {
     Operation* op = getOperation();
@@ -51,6 +70,10 @@ std::unique_ptr<Pass> createOutlineJitFunctionPass() {
   return std::make_unique<OutlineJitFunctionPass>();
 }
 
+std::unique_ptr<Pass> createFuseElementwiseChainPass() {
+  return std::make_unique<FuseElementwiseChainPass>();
+}
+
 std::unique_ptr<Pass> createFuseIntoExistingOpPass() {
   return std::make_unique<FuseIntoExistingOpPass>();
 }
@@ -13,12 +13,26 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 */
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <unistd.h>
 #include "mlir/Parser/Parser.h"
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/ExecutionEngine/ExecutionEngine.h"
 #include "mlir/ExecutionEngine/MemRefUtils.h"
+#include "mlir/ExecutionEngine/OptUtils.h"
 #include "mlir/Target/LLVMIR/Dialect/LLVMIR/LLVMToLLVMIRTranslation.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Support/TargetSelect.h"
 #include "OneFlow/OneFlowDialect.h"
 #include "oneflow/core/common/str_util.h"
@@ -40,32 +54,105 @@ const SharedLibs* SharedLibPaths() { return MutSharedLibPaths(); }
 
 namespace {
 
+Maybe<DataType> GetDataTypeFromMLIRElementType(mlir::Type type) {
+  if (type.isF32()) { return DataType::kFloat; }
+  if (type.isF64()) { return DataType::kDouble; }
+  if (type.isF16()) { return DataType::kFloat16; }
+  if (type.isBF16()) { return DataType::kBFloat16; }
+  if (type.isInteger(8)) { return DataType::kInt8; }
+  if (type.isInteger(32)) { return DataType::kInt32; }
+  if (type.isInteger(64)) { return DataType::kInt64; }
+  return Error::UnimplementedError() << "unsupported element type of mlir_jit result";
+}
+
+// The result of the jit function is only known from the assembly, ops fused into it could change
+// both the shape and the data type of the inputs.
+Maybe<std::pair<Shape, DataType>> ParseJitFunctionResult(const std::string& mlir_assembly) {
+  mlir::DialectRegistry registry;
+  registry.insert<mlir::oneflow::OneFlowDialect, mlir::func::FuncDialect>();
+  mlir::MLIRContext mlir_ctx(registry);
+  mlir::OwningOpRef<mlir::ModuleOp> module =
+      mlir::parseSourceString<mlir::ModuleOp>(mlir_assembly, &mlir_ctx);
+  CHECK_OR_RETURN(!!module) << "fail to parse the assembly of mlir_jit";
+  auto functions = module->getOps<mlir::func::FuncOp>();
+  CHECK_EQ_OR_RETURN(std::distance(functions.begin(), functions.end()), 1);
+  auto result_types = (*functions.begin()).getFunctionType().getResults();
+  CHECK_EQ_OR_RETURN(result_types.size(), 1);
+  auto tensor_type = result_types.front().dyn_cast<mlir::RankedTensorType>();
+  CHECK_OR_RETURN(tensor_type && tensor_type.hasStaticShape());
+  const DataType data_type = JUST(GetDataTypeFromMLIRElementType(tensor_type.getElementType()));
+  const auto dims = tensor_type.getShape();
+  return std::make_pair(Shape(DimVector(dims.begin(), dims.end())), data_type);
+}
+
+// Shape and data type inference run many times per op during compilation, the assembly is only
+// parsed the first time.
+Maybe<std::pair<Shape, DataType>> InferJitFunctionResult(const std::string& mlir_assembly) {
+  static std::mutex mutex;
+  static HashMap<std::string, std::pair<Shape, DataType>> assembly2result;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = assembly2result.find(mlir_assembly);
+    if (it != assembly2result.end()) { return it->second; }
+  }
+  const auto result = JUST(ParseJitFunctionResult(mlir_assembly));
+  std::lock_guard<std::mutex> lock(mutex);
+  assembly2result.emplace(mlir_assembly, result);
+  return result;
+}
+
+// The fused ops are elementwise with numpy style broadcasting, except bias_add whose bias may be
+// aligned to any axis. An input of the output rank is aligned axis by axis. A lower rank input is
+// only known to be constant along the output axes whose size none of its dims has, so the output
+// may only be split along such an axis while that input is broadcast.
+Maybe<void> GetJitFunctionSbp(user_op::SbpContext* ctx) {
+  const auto result = JUST(InferJitFunctionResult(ctx->Attr<std::string>("mlir_assembly")));
+  const Shape& out_shape = result.first;
+  FOR_RANGE(int64_t, axis, 0, out_shape.NumAxes()) {
+    if (out_shape.At(axis) <= 1) { continue; }
+    auto builder = ctx->NewBuilder();
+    bool splittable = true;
+    for (const auto& in_arg : ctx->inputs()) {
+      const Shape& in_shape =
+          ctx->LogicalTensorDesc4InputArgNameAndIndex(in_arg.first, in_arg.second).shape();
+      const user_op::OpArg op_arg(in_arg.first, in_arg.second);
+      if (in_shape.NumAxes() == out_shape.NumAxes()) {
+        if (in_shape.At(axis) == out_shape.At(axis)) {
+          builder.Split(op_arg, axis);
+        } else if (in_shape.At(axis) == 1) {
+          builder.Broadcast(op_arg);
+        } else {
+          splittable = false;
+        }
+      } else {
+        const auto dims = in_shape.dim_vec();
+        if (std::find(dims.begin(), dims.end(), out_shape.At(axis)) != dims.end()) {
+          splittable = false;
+        }
+        builder.Broadcast(op_arg);
+      }
+    }
+    if (splittable) { builder.Split(user_op::OpArg("out", 0), axis).Build(); }
+  }
+  ctx->NewBuilder().Broadcast(ctx->inputs()).Broadcast(ctx->outputs()).Build();
+  return Maybe<void>::Ok();
+}
+
 REGISTER_USER_OP("mlir_jit")
     .Attr<std::string>("mlir_assembly")
-    .Input("in")
+    .InputWithMinimum("in", 1)
     .Output("out")
     .SetTensorDescInferFn([](user_op::InferContext* ctx) -> Maybe<void> {
-      // TODO: infer shape by extracting Ops from mlir_assembly
-      CHECK_EQ(ctx->inputs().size(), 2);
-      CHECK_EQ(ctx->outputs().size(), 1);
-      const Shape& in_shape = ctx->InputShape("in", 0);
-      Shape* out_shape = ctx->OutputShape("out", 0);
-      *out_shape = in_shape;
-      *ctx->OutputDType("out", 0) = ctx->InputDType("in", 1);
-      return Maybe<void>::Ok();
-    })
-    .SetGetSbpFn([](user_op::SbpContext* ctx) -> Maybe<void> {
-      const user_op::TensorDesc& in_tensor = ctx->LogicalTensorDesc4InputArgNameAndIndex("in", 0);
-      FOR_RANGE(int64_t, i, 0, in_tensor.shape().NumAxes()) {
-        ctx->NewBuilder()
-            .Split(user_op::OpArg("in", 0), i)
-            .Split(user_op::OpArg("out", 0), i)
-            .Build();
-      }
+      CHECK_EQ_OR_RETURN(ctx->outputs().size(), 1);
+      const auto result = JUST(InferJitFunctionResult(ctx->Attr<std::string>("mlir_assembly")));
+      *ctx->OutputShape("out", 0) = result.first;
+      *ctx->OutputDType("out", 0) = result.second;
       return Maybe<void>::Ok();
     })
+    .SetGetSbpFn(GetJitFunctionSbp)
     .SetDataTypeInferFn([](user_op::InferContext* ctx) -> Maybe<void> {
-      *ctx->OutputDType("out", 0) = ctx->InputDType("in", 0);
+      const auto result = JUST(InferJitFunctionResult(ctx->Attr<std::string>("mlir_assembly")));
+      *ctx->OutputDType("out", 0) = result.second;
       return Maybe<void>::Ok();
     });
 
@@ -132,45 +219,268 @@ llvm::SmallVector<OpaqueMemRefDescriptor> GetMLIRCInterfaceArgs(
   return args;
 }
 
-void WithMlirContext(
-    user_op::KernelComputeContext* ctx, const llvm::SmallVector<llvm::StringRef, 4>& ext_libs,
-    const std::function<mlir::OwningOpRef<mlir::ModuleOp>(mlir::MLIRContext* mlir_ctx)>& parse,
+using PackedFunction = void (*)(void**);
+
+// A compiled mlir_jit module. It is owned by an mlir::ExecutionEngine when compiled in this
+// process, or by a LLJIT instance when loaded from the on-disk object cache.
+class JitFunction final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(JitFunction);
+  JitFunction(std::unique_ptr<mlir::ExecutionEngine>&& engine, PackedFunction function)
+      : engine_(std::move(engine)), function_(function) {}
+  JitFunction(std::unique_ptr<llvm::orc::LLJIT>&& lljit, PackedFunction function)
+      : lljit_(std::move(lljit)), function_(function) {}
+  ~JitFunction() {
+    if (lljit_) { llvm::consumeError(lljit_->deinitialize(lljit_->getMainJITDylib())); }
+  }
+
+  void Invoke(llvm::SmallVector<void*>* packed_args) const { function_(packed_args->data()); }
+
+ private:
+  std::unique_ptr<mlir::ExecutionEngine> engine_;
+  std::unique_ptr<llvm::orc::LLJIT> lljit_;
+  PackedFunction function_;
+};
+
+using JitFunctionFuture = std::shared_future<std::shared_ptr<const JitFunction>>;
+
+// Process-wide table of compiled modules, so that kernels of the same op in different graphs or
+// eager calls share one compilation.
+class JitFunctionCache final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(JitFunctionCache);
+  JitFunctionCache() = default;
+  ~JitFunctionCache() = default;
+
+  static JitFunctionCache* Get() {
+    static JitFunctionCache* cache = new JitFunctionCache();
+    return cache;
+  }
+
+  // Compilation runs in a background thread, the returned future is shared by every caller
+  // asking for the same key.
+  JitFunctionFuture GetOrCompile(
+      const std::string& key, const std::function<std::shared_ptr<const JitFunction>()>& Compile) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = key2function_.find(key);
+    if (it != key2function_.end()) { return it->second; }
+    JitFunctionFuture future = std::async(std::launch::async, Compile).share();
+    key2function_.emplace(key, future);
+    return future;
+  }
+
+ private:
+  std::mutex mutex_;
+  HashMap<std::string, JitFunctionFuture> key2function_;
+};
+
+// Generated code depends on the host cpu features, so they are part of the cache key.
+const std::string& HostCpuKey() {
+  static const std::string host_cpu_key = []() {
+    std::vector<std::string> features;
+    llvm::StringMap<bool> feature_map;
+    if (llvm::sys::getHostCPUFeatures(feature_map)) {
+      for (const auto& feature : feature_map) {
+        if (feature.getValue()) { features.emplace_back(feature.getKey().str()); }
+      }
+    }
+    std::sort(features.begin(), features.end());
+    std::string key = llvm::sys::getHostCPUName().str();
+    for (const auto& feature : features) { key += "," + feature; }
+    return key;
+  }();
+  return host_cpu_key;
+}
+
+constexpr unsigned kJitOptLevel = 3;
+constexpr unsigned kJitSizeLevel = 0;
+constexpr llvm::CodeGenOpt::Level kJitCodeGenOptLevel = llvm::CodeGenOpt::Level::Aggressive;
+
+// Everything the generated code depends on: the target, the llvm version, the lowering and
+// optimization options, and the module itself.
+std::string JitFunctionKey(DeviceType device_type, const std::string& op_name,
+                           const std::string& mlir_assembly) {
+  std::ostringstream ss;
+  ss << DeviceType_Name(device_type) << "\n"
+     << llvm::sys::getProcessTriple() << "\n"
+     << HostCpuKey() << "\n"
+     << "llvm " << LLVM_VERSION_STRING << "\n"
+     << "opt " << kJitOptLevel << " size " << kJitSizeLevel << " codegen "
+     << static_cast<int>(kJitCodeGenOptLevel) << "\n"
+     << "cpu threads " << ParseIntegerFromEnv("ONEFLOW_MLIR_JIT_CPU_NUM_THREADS", 1) << "\n"
+     << op_name << "\n"
+     << mlir_assembly;
+  return ss.str();
+}
+
+// Returns the object file of `key` in ONEFLOW_MLIR_JIT_CACHE_DIR, or an empty string if the
+// on-disk cache is disabled. The full key is stored next to the object in a ".key" file and
+// compared on load, so a digest collision only costs a recompilation.
+std::string JitObjectCachePath(const std::string& key) {
+  const std::string cache_dir = GetStringFromEnv("ONEFLOW_MLIR_JIT_CACHE_DIR", "");
+  if (cache_dir.empty()) { return ""; }
+  const auto digest = llvm::SHA1::hash(llvm::arrayRefFromStringRef(key));
+  return JoinPath(cache_dir, llvm::toHex(digest, /*LowerCase=*/true) + ".o");
+}
+
+std::string JitKeyCachePath(const std::string& object_path) { return object_path + ".key"; }
+
+// `Write` fills a temporary file which is then renamed to `path`, so that concurrent processes
+// never read a partial file.
+bool WriteJitCacheFile(const std::string& path,
+                       const std::function<void(const std::string& tmp_path)>& Write) {
+  const std::string tmp_path = path + "." + std::to_string(getpid()) + ".tmp";
+  Write(tmp_path);
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "fail to write jit cache file " << path;
+    std::remove(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::shared_ptr<const JitFunction> LoadJitFunction(
+    const std::string& object_path, const std::string& key, const std::string& op_name,
+    const llvm::SmallVector<llvm::StringRef, 4>& ext_libs) {
+  auto key_buffer = llvm::MemoryBuffer::getFile(JitKeyCachePath(object_path));
+  if (!key_buffer || (*key_buffer)->getBuffer() != key) { return nullptr; }
+  auto buffer = llvm::MemoryBuffer::getFile(object_path);
+  if (!buffer) { return nullptr; }
+  auto lljit_or_error = llvm::orc::LLJITBuilder().create();
+  if (!lljit_or_error) {
+    LOG(WARNING) << "fail to create LLJIT, " << llvm::toString(lljit_or_error.takeError());
+    return nullptr;
+  }
+  std::unique_ptr<llvm::orc::LLJIT> lljit = std::move(*lljit_or_error);
+  for (const auto& lib : ext_libs) {
+    std::string error;
+    if (llvm::sys::DynamicLibrary::LoadLibraryPermanently(lib.str().c_str(), &error)) {
+      LOG(WARNING) << "fail to load " << lib.str() << ", " << error;
+      return nullptr;
+    }
+  }
+  lljit->getMainJITDylib().addGenerator(
+      llvm::cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          lljit->getDataLayout().getGlobalPrefix())));
+  if (auto error = lljit->addObjectFile(std::move(*buffer))) {
+    LOG(WARNING) << "fail to add " << object_path << ", " << llvm::toString(std::move(error));
+    return nullptr;
+  }
+  // run the static constructors of the object, as mlir::ExecutionEngine does for its modules
+  if (auto error = lljit->initialize(lljit->getMainJITDylib())) {
+    LOG(WARNING) << "fail to initialize " << object_path << ", "
+                 << llvm::toString(std::move(error));
+    return nullptr;
+  }
+  // the packed wrapper that mlir::ExecutionEngine generates for every function
+  auto symbol_or_error = lljit->lookup("_mlir_" + GetMLIRCInterface(op_name));
+  if (!symbol_or_error) {
+    LOG(WARNING) << "fail to find the entry of " << op_name << " in " << object_path << ", "
+                 << llvm::toString(symbol_or_error.takeError());
+    return nullptr;
+  }
+  auto function = reinterpret_cast<PackedFunction>(symbol_or_error->getAddress());
+  return std::make_shared<JitFunction>(std::move(lljit), function);
+}
+
+std::shared_ptr<const JitFunction> CompileJitFunction(
+    const std::string& op_name, const std::string& mlir_assembly, const std::string& key,
+    const std::string& object_path, const llvm::SmallVector<llvm::StringRef, 4>& ext_libs,
     const std::function<void(mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module)>& lower) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  if (!object_path.empty()) {
+    auto function = LoadJitFunction(object_path, key, op_name, ext_libs);
+    if (function) { return function; }
+  }
   mlir::DialectRegistry registry;
   registry
       .insert<mlir::oneflow::OneFlowDialect, mlir::func::FuncDialect, mlir::memref::MemRefDialect,
               mlir::tosa::TosaDialect, mlir::linalg::LinalgDialect>();
   mlir::registerLLVMDialectTranslation(registry);
   mlir::MLIRContext mlir_ctx(registry);
-  mlir::OwningOpRef<mlir::ModuleOp> module = parse(&mlir_ctx);
-  CHECK(!!module) << "fail to parse MLIR, op: " << ctx->op_name();
+  mlir::OwningOpRef<mlir::ModuleOp> module =
+      mlir::parseSourceString<mlir::ModuleOp>(mlir_assembly, &mlir_ctx);
+  CHECK(!!module) << "fail to parse MLIR, op: " << op_name;
   if (ParseBooleanFromEnv("ONEFLOW_MLIR_STDOUT", false)) { module->print(llvm::outs()); }
-  llvm::InitializeNativeTarget();
-  llvm::InitializeNativeTargetAsmPrinter();
   lower(&mlir_ctx, *module);
   if (ParseBooleanFromEnv("ONEFLOW_MLIR_STDOUT", false)) { module->print(llvm::outs()); }
   if (ParseBooleanFromEnv("ONEFLOW_MLIR_DUMP_IR", false)) {
     std::string mlir;
     llvm::raw_string_ostream os_mlir(mlir);
     module->print(os_mlir);
-    TeePersistentLogStream::Create(JoinPath("jit", ctx->op_name() + ".mlir"))->Write(mlir);
+    TeePersistentLogStream::Create(JoinPath("jit", op_name + ".mlir"))->Write(mlir);
   }
 
+  // optimize for the host so that the loops of fused elementwise ops get vectorized with the widest
+  // vector instructions the cpu supports
+  auto tm_builder_or_error = llvm::orc::JITTargetMachineBuilder::detectHost();
+  CHECK(!!tm_builder_or_error) << llvm::toString(tm_builder_or_error.takeError());
+  auto tm_or_error = tm_builder_or_error->createTargetMachine();
+  CHECK(!!tm_or_error) << llvm::toString(tm_or_error.takeError());
+  std::unique_ptr<llvm::TargetMachine> tm = std::move(*tm_or_error);
   mlir::ExecutionEngineOptions jitOptions;
-  jitOptions.transformer = {};
-  jitOptions.jitCodeGenOptLevel = llvm::None;
+  jitOptions.transformer = mlir::makeOptimizingTransformer(kJitOptLevel, kJitSizeLevel, tm.get());
+  jitOptions.jitCodeGenOptLevel = kJitCodeGenOptLevel;
   jitOptions.sharedLibPaths = ext_libs;
+  jitOptions.enableObjectDump = !object_path.empty();
 
   auto jit_or_error = mlir::ExecutionEngine::create(*module, jitOptions);
   CHECK(!!jit_or_error) << "failed to create JIT exe engine, "
                         << llvm::toString(jit_or_error.takeError());
-  auto jit = std::move(jit_or_error.get());
+  std::unique_ptr<mlir::ExecutionEngine> jit = std::move(jit_or_error.get());
+  auto function_or_error = jit->lookupPacked(GetMLIRCInterface(op_name));
+  CHECK(!!function_or_error) << "fail to find jit function, "
+                             << llvm::toString(function_or_error.takeError());
+  if (!object_path.empty()) {
+    // the key is written last, a crash in between leaves an object that is never loaded
+    std::remove(JitKeyCachePath(object_path).c_str());
+    const bool object_written = WriteJitCacheFile(
+        object_path, [&](const std::string& tmp_path) { jit->dumpToObjectFile(tmp_path); });
+    if (object_written) {
+      WriteJitCacheFile(JitKeyCachePath(object_path), [&](const std::string& tmp_path) {
+        std::ofstream(tmp_path, std::ios::binary) << key;
+      });
+    }
+  }
+  return std::make_shared<JitFunction>(std::move(jit), *function_or_error);
+}
+
+class MlirJitKernelState final : public user_op::OpKernelState {
+ public:
+  explicit MlirJitKernelState(const JitFunctionFuture& function) : function_(function) {}
+  ~MlirJitKernelState() override = default;
+
+  // Blocks until the background compilation is done.
+  const JitFunction& function() const { return *function_.get(); }
+
+ private:
+  JitFunctionFuture function_;
+};
+
+std::shared_ptr<user_op::OpKernelState> CreateMlirJitKernelState(
+    user_op::KernelInitContext* ctx,
+    const std::function<void(mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module)>& lower) {
+  const std::string op_name = ctx->op_name();
+  const std::string mlir_assembly = ctx->Attr<std::string>("mlir_assembly");
+  const std::string key = JitFunctionKey(ctx->device_type(), op_name, mlir_assembly);
+  const std::string object_path = JitObjectCachePath(key);
+  return std::make_shared<MlirJitKernelState>(
+      JitFunctionCache::Get()->GetOrCompile(key, [op_name, mlir_assembly, key, object_path,
+                                                   lower]() {
+        llvm::SmallVector<llvm::StringRef, 4> ext_libs(
+            {SharedLibPaths()->begin(), SharedLibPaths()->end()});
+        return CompileJitFunction(op_name, mlir_assembly, key, object_path, ext_libs, lower);
+      }));
+}
+
+void InvokeJitFunction(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state) {
+  const JitFunction& function = CHECK_NOTNULL(dynamic_cast<MlirJitKernelState*>(state))->function();
   llvm::SmallVector<OpaqueMemRefDescriptor> args /* args must outlive JIT invocation */ =
       GetMLIRCInterfaceArgs(ctx);
   llvm::SmallVector<void*> packed_args{};
   for (auto& arg /* arg must be a reference*/ : args) { packed_args.push_back(&arg); }
-  auto error = jit->invokePacked(GetMLIRCInterface(ctx->op_name()), packed_args);
-  CHECK(!error) << "fail to invoke jit engine, error: " << llvm::toString(std::move(error));
+  function.Invoke(&packed_args);
 }
 
 template<typename T>
@@ -179,20 +489,19 @@ class MlirJitCpuKernel final : public user_op::OpKernel {
   MlirJitCpuKernel() = default;
   ~MlirJitCpuKernel() = default;
 
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return CreateMlirJitKernelState(ctx, [](mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module) {
+      CHECK(mlir::succeeded(mlir::oneflow::LowerModuleToLLVM(mlir_ctx, module)))
+          << "fail to lower OneFlow to LLVM";
+    });
+  }
+
  private:
-  void Compute(user_op::KernelComputeContext* ctx) const override {
-    llvm::SmallVector<llvm::StringRef, 4> ext_libs(
-        {SharedLibPaths()->begin(), SharedLibPaths()->end()});
-    WithMlirContext(
-        ctx, ext_libs,
-        [&ctx](mlir::MLIRContext* mlir_ctx) {
-          return mlir::parseSourceString<mlir::ModuleOp>(ctx->Attr<std::string>("mlir_assembly"),
-                                                         mlir_ctx);
-        },
-        [](mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module) {
-          CHECK(mlir::succeeded(mlir::oneflow::LowerModuleToLLVM(mlir_ctx, module)))
-              << "fail to lower OneFlow to LLVM";
-        });
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
+    InvokeJitFunction(ctx, state);
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
@@ -222,20 +531,19 @@ class MlirJitGpuKernel final : public user_op::OpKernel {
   MlirJitGpuKernel() = default;
   ~MlirJitGpuKernel() = default;
 
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return CreateMlirJitKernelState(ctx, [](mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module) {
+      CHECK(mlir::succeeded(mlir::oneflow::LowerModuleToCUDALLVM(mlir_ctx, module)))
+          << "fail to lower OneFlow to CUDA LLVM";
+    });
+  }
+
  private:
-  void Compute(user_op::KernelComputeContext* ctx) const override {
-    llvm::SmallVector<llvm::StringRef, 4> ext_libs(
-        {SharedLibPaths()->begin(), SharedLibPaths()->end()});
-    WithMlirContext(
-        ctx, ext_libs,
-        [&ctx](mlir::MLIRContext* mlir_ctx) {
-          return mlir::parseSourceString<mlir::ModuleOp>(ctx->Attr<std::string>("mlir_assembly"),
-                                                         mlir_ctx);
-        },
-        [](mlir::MLIRContext* mlir_ctx, mlir::ModuleOp module) {
-          CHECK(mlir::succeeded(mlir::oneflow::LowerModuleToCUDALLVM(mlir_ctx, module)))
-              << "fail to lower OneFlow to CUDA LLVM";
-        });
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
+    InvokeJitFunction(ctx, state);
   }
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 };
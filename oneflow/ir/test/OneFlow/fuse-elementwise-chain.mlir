@@ -0,0 +1,16 @@
+// RUN: oneflow-opt -fuse-elementwise-chain %s | FileCheck %s
+builtin.module  {
+  "oneflow.job" () ({
+    %data_output = "oneflow.system"() {device_name = ["@0:0"], device_tag = "cpu", hierarchy = [1], input_bns = [], op_name = "Input_0", op_type_case = 137 : i32, operand_segment_sizes = dense<0> : vector<2xi32>, output_lbns = ["Input_0/out"], result_segment_sizes = dense<[1, 0]> : vector<2xi32>, scope_symbol_id = 4611686018427432958 : i64} : () -> tensor<64x256xf32>
+    %data_output_0 = "oneflow.system"() {device_name = ["@0:0"], device_tag = "cpu", hierarchy = [1], input_bns = [], op_name = "bias", op_type_case = 122 : i32, operand_segment_sizes = dense<0> : vector<2xi32>, output_lbns = ["bias/out"], result_segment_sizes = dense<[1, 0]> : vector<2xi32>, scope_symbol_id = 4611686018427437054 : i64} : () -> tensor<256xf32>
+    %0 = "oneflow.bias_add"(%data_output, %data_output_0) {axis = 1 : si32, device_name = ["@0:0"], device_tag = "cpu", hierarchy = [1], op_name = "BiasAdd_1", scope_symbol_id = 4611686018427437054 : i64} : (tensor<64x256xf32>, tensor<256xf32>) -> tensor<64x256xf32>
+    %1 = "oneflow.silu"(%0) {device_name = ["@0:0"], device_tag = "cpu", hierarchy = [1], op_name = "Silu_2", scope_symbol_id = 4611686018427437054 : i64} : (tensor<64x256xf32>) -> tensor<64x256xf32>
+    %2 = "oneflow.scalar_mul"(%1) {device_name = ["@0:0"], device_tag = "cpu", float_operand = 5.000000e-01 : f64, has_float_operand = true, has_int_operand = false, hierarchy = [1], int_operand = 0 : si64, op_name = "ScalarMul_3", scope_symbol_id = 4611686018427437054 : i64} : (tensor<64x256xf32>) -> tensor<64x256xf32>
+    "oneflow.system"(%2) {device_name = ["@0:0"], device_tag = "cpu", hierarchy = [1], input_bns = ["in"], op_name = "Return_4", op_type_case = 146 : i32, operand_segment_sizes = dense<[1, 0]> : vector<2xi32>, output_lbns = [], result_segment_sizes = dense<0> : vector<2xi32>, scope_symbol_id = 4611686018427445246 : i64} : (tensor<64x256xf32>) -> ()
+    oneflow.return
+  }) {sym_name = "FuseElementwiseChainJob", function_type = () -> ()} : () -> ()
+}
+// CHECK: func.func @ScalarMul_3__FUSE_ELEMENTWISE
+// CHECK: %[[OUT:[a-zA-Z0-9_]+]] = oneflow.mlir_jit
+// CHECK-NOT: oneflow.silu
+// CHECK: "oneflow.system"(%[[OUT]])
@@ -0,0 +1,103 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+# RUN: python3 %s | FileCheck %s
+# CHECK: mlp block
+
+import os
+import time
+import unittest
+import numpy as np
+
+os.environ["ONEFLOW_MLIR_ENABLE_ROUND_TRIP"] = "1"
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class MlpBlock(flow.nn.Module):
+    # the feed forward block of a transformer layer, everything after each matmul is elementwise
+    def __init__(self, hidden_size, intermediate_size):
+        super().__init__()
+        self.fc1_weight = flow.nn.Parameter(
+            flow.randn(hidden_size, intermediate_size) * 0.02
+        )
+        self.fc1_bias = flow.nn.Parameter(flow.randn(intermediate_size) * 0.02)
+        self.fc2_weight = flow.nn.Parameter(
+            flow.randn(intermediate_size, hidden_size) * 0.02
+        )
+        self.fc2_bias = flow.nn.Parameter(flow.randn(hidden_size) * 0.02)
+
+    def forward(self, x):
+        h = flow._C.bias_add(flow.matmul(x, self.fc1_weight), self.fc1_bias, axis=1)
+        h = flow.nn.functional.silu(h)
+        y = flow._C.bias_add(flow.matmul(h, self.fc2_weight), self.fc2_bias, axis=1)
+        return flow.tanh(y * 0.5 + x)
+
+
+class MlpGraph(flow.nn.Graph):
+    def __init__(self, module):
+        super().__init__()
+        self.m = module
+
+    def build(self, x):
+        return self.m(x)
+
+
+def count_mlir_jit_ops(graph):
+    return sum(
+        1
+        for op in graph._compiled_graph_proto.net.op
+        if op.HasField("user_conf") and op.user_conf.op_type_name == "mlir_jit"
+    )
+
+
+def run_graph(module, x, fuse, num_iters):
+    if fuse:
+        os.environ["ONEFLOW_MLIR_FUSE_ELEMENTWISE_CHAIN"] = "1"
+    else:
+        os.environ.pop("ONEFLOW_MLIR_FUSE_ELEMENTWISE_CHAIN", None)
+    graph = MlpGraph(module)
+    # the first run compiles the graph and the jit functions
+    y = graph(x).numpy()
+    start = time.perf_counter()
+    for _ in range(num_iters):
+        y = graph(x).numpy()
+    return y, (time.perf_counter() - start) / num_iters, count_mlir_jit_ops(graph)
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestFuseElementwiseChain(oneflow.unittest.TestCase):
+    def test_mlp_block(test_case):
+        batch_size, hidden_size, intermediate_size = 128, 768, 3072
+        module = MlpBlock(hidden_size, intermediate_size)
+        x = flow.randn(batch_size, hidden_size)
+        y_eager = module(x).numpy()
+        y_unfused, unfused_time, num_unfused_jit_ops = run_graph(module, x, False, 20)
+        y_fused, fused_time, num_fused_jit_ops = run_graph(module, x, True, 20)
+        test_case.assertEqual(num_unfused_jit_ops, 0)
+        # at least the bias_add + silu chain after fc1 is outlined into a mlir_jit op
+        test_case.assertGreater(num_fused_jit_ops, 0)
+        test_case.assertTrue(np.allclose(y_eager, y_unfused, rtol=1e-4, atol=1e-5))
+        test_case.assertTrue(np.allclose(y_eager, y_fused, rtol=1e-4, atol=1e-5))
+        print(
+            "mlp block, unfused: {:.3f} ms, fused: {:.3f} ms, speedup: {:.2f}x".format(
+                unfused_time * 1e3, fused_time * 1e3, unfused_time / fused_time
+            )
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()
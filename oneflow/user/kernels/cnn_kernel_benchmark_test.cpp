@@ -0,0 +1,201 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include "oneflow/core/common/shape.h"
+#include "oneflow/core/ep/test/benchmark_util.h"
+#include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/user/kernels/avg_pool_kernel_util.h"
+#include "oneflow/user/kernels/conv_kernel_util.h"
+#include "oneflow/user/kernels/max_pool_kernel_util.h"
+#include "oneflow/user/kernels/normalization_kernel_util.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+// The cpu kernels of the convolution, pooling and batch normalization layers of resnet50 at batch
+// 8, in channels first layout. Every case runs the code of the conv2d, max_pool_2d, avg_pool_2d
+// and inference normalization kernels.
+
+class CnnKernelBenchmark : public ep::test::BenchmarkCase {};
+
+constexpr int64_t kBatchSize = 8;
+
+float* FilledHostMemory(ep::test::DeviceMemoryGuard* guard, size_t count, float value) {
+  float* ptr = static_cast<float*>(guard->ptr());
+  std::fill(ptr, ptr + count, value);
+  return ptr;
+}
+
+}  // namespace
+
+TEST_F(CnnKernelBenchmark, Conv2dBenchmark) {
+  struct Case {
+    std::string name;
+    int64_t in_channels;
+    int64_t in_size;
+    int64_t out_channels;
+    int32_t kernel_size;
+    int32_t stride;
+    int32_t padding;
+  };
+  const std::vector<Case> cases = {
+      {"conv1_7x7_stride2", 3, 224, 64, 7, 2, 3},
+      {"res2_3x3", 64, 56, 64, 3, 1, 1},
+      {"res2_1x1_expand", 64, 56, 256, 1, 1, 0},
+      {"res3_3x3_stride2", 128, 56, 128, 3, 2, 1},
+      {"res4_3x3", 256, 14, 256, 3, 1, 1},
+      {"res5_1x1_reduce", 2048, 7, 512, 1, 1, 0},
+  };
+  for (const auto& c : cases) {
+    ForEachDeviceAndNumThreads([&](ep::Device* device, size_t num_threads) {
+      if (device->device_type() != DeviceType::kCPU) { return; }
+      std::unique_ptr<ep::primitive::Matmul> matmul =
+          ep::primitive::NewPrimitive<ep::primitive::MatmulFactory>(
+              DeviceType::kCPU, DataType::kFloat, ep::primitive::BlasTransposeType::N,
+              ep::primitive::BlasTransposeType::N);
+      ASSERT_TRUE(matmul.operator bool());
+      const int64_t out_size = (c.in_size + 2 * c.padding - c.kernel_size) / c.stride + 1;
+      const Shape in_shape({kBatchSize, c.in_channels, 1, c.in_size, c.in_size});
+      const Shape weight_shape({c.out_channels, c.in_channels, 1, c.kernel_size, c.kernel_size});
+      const Shape out_shape({kBatchSize, c.out_channels, 1, out_size, out_size});
+      const std::vector<int32_t> strides = {1, c.stride, c.stride};
+      const std::vector<int32_t> dilation_rate = {1, 1, 1};
+      const std::vector<int32_t> padding_before = {0, c.padding, c.padding};
+      const int64_t col_buf_count = weight_shape.Count(1) * out_size * out_size;
+      ep::test::DeviceMemoryGuard in(device, in_shape.elem_cnt() * sizeof(float));
+      ep::test::DeviceMemoryGuard weight(device, weight_shape.elem_cnt() * sizeof(float));
+      ep::test::DeviceMemoryGuard col_buf(device, col_buf_count * sizeof(float));
+      ep::test::DeviceMemoryGuard out(device, out_shape.elem_cnt() * sizeof(float));
+      const float* in_ptr = FilledHostMemory(&in, in_shape.elem_cnt(), 0.5);
+      const float* weight_ptr = FilledHostMemory(&weight, weight_shape.elem_cnt(), 0.5);
+      float* col_buf_ptr = static_cast<float*>(col_buf.ptr());
+      float* out_ptr = static_cast<float*>(out.ptr());
+      ep::test::StreamGuard stream(device);
+      // the loop of the cpu conv kernel: im2col of every image, then weight * col_buf
+      const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+        for (int64_t i = 0; i < kBatchSize; ++i) {
+          ConvKernelUtil<float>::NCDHWIm2Col(in_ptr + i * in_shape.Count(1), ShapeView(in_shape),
+                                             ShapeView(weight_shape), ShapeView(out_shape),
+                                             strides.data(), dilation_rate.data(),
+                                             padding_before.data(), col_buf_ptr);
+          matmul->Launch(stream.stream(), c.out_channels, out_size * out_size,
+                         weight_shape.Count(1), 1.0, weight_ptr, col_buf_ptr, 0.0,
+                         out_ptr + i * out_shape.Count(1));
+        }
+      });
+      Report("conv2d/" + c.name, device->device_type(), num_threads, time_us,
+             (in_shape.elem_cnt() + weight_shape.elem_cnt() + out_shape.elem_cnt()) * sizeof(float),
+             2.0 * out_shape.elem_cnt() * weight_shape.Count(1));
+    });
+  }
+}
+
+TEST_F(CnnKernelBenchmark, MaxPool2dBenchmark) {
+  // the pooling of the resnet50 stem: 3x3, stride 2, padding 1
+  const Shape x_shape({kBatchSize, 64, 112, 112});
+  ForEachDeviceAndNumThreads([&](ep::Device* device, size_t num_threads) {
+    if (device->device_type() != DeviceType::kCPU) { return; }
+    const MaxPoolParams3D params_3d(2, ShapeView(x_shape), "channels_first", {1, 1}, {3, 3},
+                                    {2, 2}, {1, 1}, /*return_indices=*/false,
+                                    /*ceil_mode=*/false);
+    const Shape y_shape = params_3d.GetYShape5D();
+    ep::test::DeviceMemoryGuard x(device, x_shape.elem_cnt() * sizeof(float));
+    ep::test::DeviceMemoryGuard y(device, y_shape.elem_cnt() * sizeof(float));
+    ep::test::DeviceMemoryGuard indice(device, y_shape.elem_cnt() * sizeof(int64_t));
+    const float* x_ptr = FilledHostMemory(&x, x_shape.elem_cnt(), 0.5);
+    const int64_t y_dims[3] = {y_shape.At(0) * y_shape.At(1), y_shape.At(3), y_shape.At(4)};
+    const NdIndexOffsetHelper<int32_t, 3> index_helper(y_dims);
+    ep::test::StreamGuard stream(device);
+    const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+      PoolKernelUtil<DeviceType::kCPU, float, int32_t>::Maxpool2dForwardCFirst(
+          stream.stream(), index_helper, y_shape.elem_cnt(), x_ptr,
+          static_cast<float*>(y.ptr()), static_cast<int64_t*>(indice.ptr()), params_3d);
+    });
+    Report("max_pool2d/stem_3x3_stride2", device->device_type(), num_threads, time_us,
+           (x_shape.elem_cnt() + y_shape.elem_cnt()) * sizeof(float)
+               + y_shape.elem_cnt() * sizeof(int64_t),
+           0);
+  });
+}
+
+TEST_F(CnnKernelBenchmark, AvgPool2dBenchmark) {
+  // the global pooling before the resnet50 classifier
+  const Shape x_shape({kBatchSize, 2048, 7, 7});
+  ForEachDeviceAndNumThreads([&](ep::Device* device, size_t num_threads) {
+    if (device->device_type() != DeviceType::kCPU) { return; }
+    const AvgPoolParams3D params_3d(2, ShapeView(x_shape), "channels_first", {0, 0}, {7, 7},
+                                    {7, 7}, /*ceil_mode=*/false, /*count_include_pad=*/true,
+                                    /*divisor_override=*/0);
+    const Shape y_shape = params_3d.GetYShape5D();
+    ep::test::DeviceMemoryGuard x(device, x_shape.elem_cnt() * sizeof(float));
+    ep::test::DeviceMemoryGuard y(device, y_shape.elem_cnt() * sizeof(float));
+    const float* x_ptr = FilledHostMemory(&x, x_shape.elem_cnt(), 0.5);
+    const int64_t y_dims[3] = {y_shape.At(0) * y_shape.At(1), y_shape.At(3), y_shape.At(4)};
+    const NdIndexOffsetHelper<int32_t, 3> index_helper(y_dims);
+    ep::test::StreamGuard stream(device);
+    const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+      AvgPoolKernelUtil<DeviceType::kCPU, float, int32_t>::Avgpool2dForward(
+          stream.stream(), index_helper, y_shape.elem_cnt(), x_ptr, static_cast<float*>(y.ptr()),
+          params_3d);
+    });
+    Report("avg_pool2d/global_7x7", device->device_type(), num_threads, time_us,
+           (x_shape.elem_cnt() + y_shape.elem_cnt()) * sizeof(float), x_shape.elem_cnt());
+  });
+}
+
+TEST_F(CnnKernelBenchmark, BatchNormBenchmark) {
+  // channels, spatial size of the normalizations of every resnet50 stage
+  const std::vector<std::array<int64_t, 2>> shapes = {
+      {64, 112}, {256, 56}, {512, 28}, {1024, 14}, {2048, 7},
+  };
+  for (const auto& shape : shapes) {
+    const int64_t channels = shape[0];
+    const int64_t spatial_size = shape[1] * shape[1];
+    const int64_t count = kBatchSize * channels * spatial_size;
+    ForEachDeviceAndNumThreads([&](ep::Device* device, size_t num_threads) {
+      if (device->device_type() != DeviceType::kCPU) { return; }
+      ep::test::DeviceMemoryGuard x(device, count * sizeof(float));
+      ep::test::DeviceMemoryGuard y(device, count * sizeof(float));
+      ep::test::DeviceMemoryGuard mean(device, channels * sizeof(float));
+      ep::test::DeviceMemoryGuard variance(device, channels * sizeof(float));
+      ep::test::DeviceMemoryGuard gamma(device, channels * sizeof(float));
+      ep::test::DeviceMemoryGuard beta(device, channels * sizeof(float));
+      const float* x_ptr = FilledHostMemory(&x, count, 0.5);
+      const float* mean_ptr = FilledHostMemory(&mean, channels, 0.1);
+      const float* variance_ptr = FilledHostMemory(&variance, channels, 1.0);
+      const float* gamma_ptr = FilledHostMemory(&gamma, channels, 1.0);
+      const float* beta_ptr = FilledHostMemory(&beta, channels, 0.0);
+      ep::test::StreamGuard stream(device);
+      const double time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+        NormalizeCpu(x_ptr, mean_ptr, variance_ptr, gamma_ptr, beta_ptr,
+                     static_cast<float*>(y.ptr()), kBatchSize, channels, spatial_size,
+                     /*epsilon=*/1e-5, /*training=*/false);
+      });
+      Report("batch_norm_inference/c:" + std::to_string(channels)
+                 + "/hw:" + std::to_string(spatial_size),
+             device->device_type(), num_threads, time_us, 2 * count * sizeof(float), 2.0 * count);
+    });
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -0,0 +1,267 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_CONV_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_CONV_KERNEL_UTIL_H_
+
+#include "oneflow/core/common/shape_view.h"
+#include "oneflow/core/common/util.h"
+
+namespace oneflow {
+
+// The im2col and col2im used by the cpu convolution kernels, the shapes are the 5d shapes of the
+// kernel caches.
+template<typename T>
+using Im2ColFunc = void (*)(const T* in_dptr, const ShapeView& in_shape,
+                            const ShapeView& weight_shape, const ShapeView& out_shape,
+                            const int32_t* strides, const int32_t* dilation_rate,
+                            const int32_t* padding_before, T* col_buf);
+
+template<typename T>
+using Col2ImFunc = void (*)(const T* col_buf, const ShapeView& in_shape,
+                            const ShapeView& weight_shape, const ShapeView& out_shape,
+                            const int32_t* strides, const int32_t* dilation_rate,
+                            const int32_t* padding_before, T* in_diff_ptr);
+
+inline size_t CalcElemNumOfColBuf(const ShapeView& out_shape, const ShapeView& weight_shape,
+                                  const int32_t idx_offset) {
+  int64_t col_buf_elem_cnt = 1;
+  int64_t ndims = out_shape.NumAxes() - 2;
+
+  for (size_t i = 0; i != ndims + 1; ++i) { col_buf_elem_cnt *= weight_shape.At(i + 1); }
+  for (size_t i = 0; i != ndims; ++i) { col_buf_elem_cnt *= out_shape.At(idx_offset + i); }
+  return col_buf_elem_cnt;
+}
+
+template<typename T>
+class ColBufWriter {
+ public:
+  ColBufWriter(const T* src_ptr, T* dst_ptr, int64_t c_size, int64_t id_size, int64_t ih_size,
+               int64_t iw_size, int64_t od_size, int64_t oh_size, int64_t ow_size)
+      : src_ptr_(src_ptr),
+        dst_ptr_(dst_ptr),
+        c_size_(c_size),
+        id_size_(id_size),
+        ih_size_(ih_size),
+        iw_size_(iw_size),
+        od_size_(od_size),
+        oh_size_(oh_size),
+        ow_size_(ow_size) {}
+  virtual ~ColBufWriter() = default;
+  virtual void DHWCWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) = 0;
+  virtual void CDHWWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) = 0;
+  virtual void InvalidDFunc() = 0;
+  virtual void InvalidHFunc() = 0;
+  virtual void InvalidWFunc() = 0;
+  virtual void NextImCSize() = 0;
+
+ protected:
+  const T* src_ptr_;
+  T* dst_ptr_;
+  int64_t c_size_;
+  int64_t id_size_;
+  int64_t ih_size_;
+  int64_t iw_size_;
+  int64_t od_size_;
+  int64_t oh_size_;
+  int64_t ow_size_;
+};
+
+template<typename T>
+class Im2ColWriter final : public ColBufWriter<T> {
+ public:
+  Im2ColWriter(const T* src_ptr, T* dst_ptr, int64_t c_size, int64_t id_size, int64_t ih_size,
+               int64_t iw_size, int64_t od_size, int64_t oh_size, int64_t ow_size)
+      : ColBufWriter<T>::ColBufWriter(src_ptr, dst_ptr, c_size, id_size, ih_size, iw_size, od_size,
+                                      oh_size, ow_size) {}
+  ~Im2ColWriter() = default;
+  void DHWCWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
+    *(this->dst_ptr_++) =
+        this->src_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw * this->iw_size_ + c];
+  }
+  void CDHWWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
+    *(this->dst_ptr_++) = this->src_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw];
+  }
+  void InvalidDFunc() override {
+    FOR_RANGE(int64_t, i, 0, this->od_size_) { *(this->dst_ptr_++) = 0; }
+  }
+  void InvalidHFunc() override {
+    FOR_RANGE(int64_t, i, 0, this->oh_size_) { *(this->dst_ptr_++) = 0; }
+  }
+  void InvalidWFunc() override {
+    FOR_RANGE(int64_t, i, 0, this->ow_size_) { *(this->dst_ptr_++) = 0; }
+  }
+  void NextImCSize() override { this->src_ptr_ += this->c_size_; }
+};
+
+template<typename T>
+class Col2ImWriter final : public ColBufWriter<T> {
+ public:
+  Col2ImWriter(const T* src_ptr, T* dst_ptr, int64_t c_size, int64_t id_size, int64_t ih_size,
+               int64_t iw_size, int64_t od_size, int64_t oh_size, int64_t ow_size)
+      : ColBufWriter<T>::ColBufWriter(src_ptr, dst_ptr, c_size, id_size, ih_size, iw_size, od_size,
+                                      oh_size, ow_size) {}
+  ~Col2ImWriter() = default;
+  void DHWCWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
+    this->dst_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw * this->iw_size_ + c] +=
+        *(this->src_ptr_++);
+  }
+  void CDHWWrite(int64_t c, int64_t id, int64_t ih, int64_t iw) override {
+    this->dst_ptr_[id * this->id_size_ + ih * this->ih_size_ + iw] += *(this->src_ptr_++);
+  }
+  void InvalidDFunc() override { this->src_ptr_ += this->od_size_; }
+  void InvalidHFunc() override { this->src_ptr_ += this->oh_size_; }
+  void InvalidWFunc() override { this->src_ptr_ += this->ow_size_; }
+  void NextImCSize() override { this->dst_ptr_ += this->c_size_; }
+};
+
+template<typename T>
+using DHWValidFunc = void (ColBufWriter<T>::*)(int64_t c, int64_t kd, int64_t kh, int64_t kw);
+
+template<typename T>
+class ColBufUtil final {
+ public:
+  ColBufUtil(const ShapeView& in_shape, const ShapeView& out_shape, int32_t dhw_offset,
+             const int32_t* strides, const int32_t* dilation_rate, const int32_t* padding_before)
+      : strides_(strides), dilation_rate_(dilation_rate), padding_before_(padding_before) {
+    id_num_ = in_shape.At(dhw_offset);
+    ih_num_ = in_shape.At(dhw_offset + 1);
+    iw_num_ = in_shape.At(dhw_offset + 2);
+    od_num_ = out_shape.At(dhw_offset);
+    oh_num_ = out_shape.At(dhw_offset + 1);
+    ow_num_ = out_shape.At(dhw_offset + 2);
+    if (dhw_offset == 2) {
+      dhw_valid_func_ = &ColBufWriter<T>::CDHWWrite;
+    } else {
+      dhw_valid_func_ = &ColBufWriter<T>::DHWCWrite;
+    }
+  }
+  void operator()(ColBufWriter<T>* col_buf_writer, int64_t c, int64_t kd, int64_t kh, int64_t kw) {
+    int64_t id = kd * dilation_rate_[0] - padding_before_[0];
+    FOR_RANGE(int64_t, od, 0, od_num_) {
+      if (id < 0 || id >= id_num_) {
+        col_buf_writer->InvalidDFunc();
+      } else {
+        int64_t ih = kh * dilation_rate_[1] - padding_before_[1];
+        FOR_RANGE(int64_t, oh, 0, oh_num_) {
+          if (ih < 0 || ih >= ih_num_) {
+            col_buf_writer->InvalidHFunc();
+          } else {
+            int64_t iw = kw * dilation_rate_[2] - padding_before_[2];
+            FOR_RANGE(int64_t, ow, 0, ow_num_) {
+              if (iw < 0 || iw >= iw_num_) {
+                col_buf_writer->InvalidWFunc();
+              } else {
+                (col_buf_writer->*dhw_valid_func_)(c, id, ih, iw);
+              }
+              iw += strides_[2];
+            }
+          }
+          ih += strides_[1];
+        }
+      }
+      id += strides_[0];
+    }
+  }
+
+ private:
+  int64_t id_num_;
+  int64_t ih_num_;
+  int64_t iw_num_;
+  int64_t od_num_;
+  int64_t oh_num_;
+  int64_t ow_num_;
+  const int32_t* strides_;
+  const int32_t* dilation_rate_;
+  const int32_t* padding_before_;
+  DHWValidFunc<T> dhw_valid_func_;
+};
+
+template<typename T>
+struct ConvKernelUtil final {
+ public:
+  static void NCDHWIm2Col(const T* in_dptr, const ShapeView& in_shape,
+                          const ShapeView& weight_shape, const ShapeView& out_shape,
+                          const int32_t* strides, const int32_t* dilation_rate,
+                          const int32_t* padding_before, T* col_buf_ptr) {
+    ColBufUtil<T> col_buf_util(in_shape, out_shape, 2, strides, dilation_rate, padding_before);
+    Im2ColWriter<T> col_buf_writer(in_dptr, col_buf_ptr, in_shape.Count(2), in_shape.Count(3),
+                                   in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
+    DoNCDWHFunc(weight_shape, col_buf_util, &col_buf_writer);
+  }
+
+  static void NDHWCIm2Col(const T* in_dptr, const ShapeView& in_shape,
+                          const ShapeView& weight_shape, const ShapeView& out_shape,
+                          const int32_t* strides, const int32_t* dilation_rate,
+                          const int32_t* padding_before, T* col_buf_ptr) {
+    ColBufUtil<T> col_buf_util(in_shape, out_shape, 1, strides, dilation_rate, padding_before);
+    Im2ColWriter<T> col_buf_writer(in_dptr, col_buf_ptr, in_shape.Count(2), in_shape.Count(2),
+                                   in_shape.Count(3), in_shape.Count(4), out_shape.Count(2, 4),
+                                   out_shape.Count(3, 4), 1);
+    DoNDWHCFunc(weight_shape, col_buf_util, &col_buf_writer);
+  }
+
+  static void NCDHWCol2Im(const T* col_buf_ptr, const ShapeView& in_shape,
+                          const ShapeView& weight_shape, const ShapeView& out_shape,
+                          const int32_t* strides, const int32_t* dilation_rate,
+                          const int32_t* padding_before, T* in_diff_ptr) {
+    ColBufUtil<T> col_buf_util(in_shape, out_shape, 2, strides, dilation_rate, padding_before);
+    Col2ImWriter<T> col_buf_writer(col_buf_ptr, in_diff_ptr, in_shape.Count(2), in_shape.Count(3),
+                                   in_shape.Count(4), 1, out_shape.Count(3), out_shape.Count(4), 1);
+    DoNCDWHFunc(weight_shape, col_buf_util, &col_buf_writer);
+  }
+
+  static void NDHWCCol2Im(const T* col_buf_ptr, const ShapeView& in_shape,
+                          const ShapeView& weight_shape, const ShapeView& out_shape,
+                          const int32_t* strides, const int32_t* dilation_rate,
+                          const int32_t* padding_before, T* in_diff_ptr) {
+    ColBufUtil<T> col_buf_util(in_shape, out_shape, 1, strides, dilation_rate, padding_before);
+    Col2ImWriter<T> col_buf_writer(col_buf_ptr, in_diff_ptr, in_shape.Count(2), in_shape.Count(2),
+                                   in_shape.Count(3), in_shape.Count(4), out_shape.Count(2, 4),
+                                   out_shape.Count(3, 4), 1);
+    DoNDWHCFunc(weight_shape, col_buf_util, &col_buf_writer);
+  }
+
+ private:
+  static void DoNCDWHFunc(const ShapeView& weight_shape, ColBufUtil<T>& col_buf_util,
+                          ColBufWriter<T>* col_buf_writer) {
+    for (int64_t c = 0; c != weight_shape.At(1); col_buf_writer->NextImCSize(), ++c) {
+      for (int64_t kd = 0; kd != weight_shape.At(2); ++kd) {
+        for (int64_t kh = 0; kh != weight_shape.At(3); ++kh) {
+          for (int64_t kw = 0; kw != weight_shape.At(4); ++kw) {
+            col_buf_util(col_buf_writer, c, kd, kh, kw);
+          }
+        }
+      }
+    }
+  }
+
+  static void DoNDWHCFunc(const ShapeView& weight_shape, ColBufUtil<T>& col_buf_util,
+                          ColBufWriter<T>* col_buf_writer) {
+    for (int64_t kd = 0; kd != weight_shape.At(1); ++kd) {
+      for (int64_t kh = 0; kh != weight_shape.At(2); ++kh) {
+        for (int64_t kw = 0; kw != weight_shape.At(3); ++kw) {
+          for (int64_t c = 0; c != weight_shape.At(4); ++c) {
+            col_buf_util(col_buf_writer, c, kd, kh, kw);
+          }
+        }
+      }
+    }
+  }
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_CONV_KERNEL_UTIL_H_
@@ -0,0 +1,365 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/int8_gemm.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define OF_INT8_GEMM_X86
+#include <immintrin.h>
+#endif
+
+namespace oneflow {
+
+namespace {
+
+// Every task computes a block of c, 64 rows of w times 4096 columns of int8 stay in L2.
+constexpr int64_t kRowBlockSize = 64;
+constexpr int64_t kColBlockSize = 64;
+// Register tile, every load of a is shared by kTileCols rows of w and vice versa.
+constexpr int64_t kTileRows = 4;
+constexpr int64_t kTileCols = 4;
+
+enum class Int8GemmIsa { kGeneric, kAvx2, kAvx512Vnni };
+
+// Computes the block c[i][j] = dot(a[i], w[j]) for i in [0, rows) and j in [col_begin, col_end).
+using BlockKernel = void (*)(int64_t rows, const int8_t* a, int64_t lda, int64_t k,
+                             const int8_t* w, const int32_t* row_sums, int64_t col_begin,
+                             int64_t col_end, int32_t* c, int64_t ldc);
+
+void GenericBlockKernel(int64_t rows, const int8_t* a, int64_t lda, int64_t k, const int8_t* w,
+                        const int32_t* row_sums, int64_t col_begin, int64_t col_end, int32_t* c,
+                        int64_t ldc) {
+  for (int64_t i = 0; i < rows; ++i) {
+    for (int64_t j = col_begin; j < col_end; ++j) {
+      const int8_t* a_row = a + i * lda;
+      const int8_t* w_row = w + j * k;
+      int32_t sum = 0;
+      for (int64_t p = 0; p < k; ++p) {
+        sum += static_cast<int32_t>(a_row[p]) * static_cast<int32_t>(w_row[p]);
+      }
+      c[i * ldc + j] = sum;
+    }
+  }
+}
+
+// Runs the tile kernel over full tiles and the 1 row or 1 column kernels over the remainders.
+template<int64_t tile_rows, typename Tile, typename TileCol, typename TileRow, typename One>
+inline void ForEachTile(int64_t rows, int64_t col_begin, int64_t col_end, const Tile& tile,
+                        const TileCol& tile_col, const TileRow& tile_row, const One& one) {
+  int64_t i = 0;
+  for (; i + tile_rows <= rows; i += tile_rows) {
+    int64_t j = col_begin;
+    for (; j + kTileCols <= col_end; j += kTileCols) { tile(i, j); }
+    for (; j < col_end; ++j) { tile_col(i, j); }
+  }
+  for (; i < rows; ++i) {
+    int64_t j = col_begin;
+    for (; j + kTileCols <= col_end; j += kTileCols) { tile_row(i, j); }
+    for (; j < col_end; ++j) { one(i, j); }
+  }
+}
+
+#ifdef OF_INT8_GEMM_X86
+
+__attribute__((target("avx2"))) inline int32_t Avx2ReduceAdd(__m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+// Widens to int16 and uses madd, maddubs would saturate on int8 x int8 products.
+template<int64_t num_rows, int64_t num_cols>
+__attribute__((target("avx2"))) inline void Avx2Tile(const int8_t* a, int64_t lda,
+                                                     const int8_t* w, int64_t k, int32_t* c,
+                                                     int64_t ldc) {
+  __m256i acc[num_rows][num_cols];
+  for (int64_t r = 0; r < num_rows; ++r) {
+    for (int64_t s = 0; s < num_cols; ++s) { acc[r][s] = _mm256_setzero_si256(); }
+  }
+  int64_t p = 0;
+  for (; p + 16 <= k; p += 16) {
+    __m256i vw[num_cols];
+    for (int64_t s = 0; s < num_cols; ++s) {
+      vw[s] =
+          _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w + s * k + p)));
+    }
+    for (int64_t r = 0; r < num_rows; ++r) {
+      const __m256i va =
+          _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + r * lda + p)));
+      for (int64_t s = 0; s < num_cols; ++s) {
+        acc[r][s] = _mm256_add_epi32(acc[r][s], _mm256_madd_epi16(va, vw[s]));
+      }
+    }
+  }
+  for (int64_t r = 0; r < num_rows; ++r) {
+    for (int64_t s = 0; s < num_cols; ++s) {
+      int32_t sum = Avx2ReduceAdd(acc[r][s]);
+      for (int64_t q = p; q < k; ++q) {
+        sum += static_cast<int32_t>(a[r * lda + q]) * static_cast<int32_t>(w[s * k + q]);
+      }
+      c[r * ldc + s] = sum;
+    }
+  }
+}
+
+__attribute__((target("avx2"))) void Avx2BlockKernel(int64_t rows, const int8_t* a, int64_t lda,
+                                                     int64_t k, const int8_t* w,
+                                                     const int32_t* row_sums, int64_t col_begin,
+                                                     int64_t col_end, int32_t* c,
+                                                     int64_t ldc) {
+  // 2 rows keep the 8 accumulators and the widened operands within 16 ymm registers.
+  constexpr int64_t kAvx2TileRows = 2;
+  ForEachTile<kAvx2TileRows>(
+      rows, col_begin, col_end,
+      [&](int64_t i, int64_t j) {
+        Avx2Tile<kAvx2TileRows, kTileCols>(a + i * lda, lda, w + j * k, k, c + i * ldc + j, ldc);
+      },
+      [&](int64_t i, int64_t j) {
+        Avx2Tile<kAvx2TileRows, 1>(a + i * lda, lda, w + j * k, k, c + i * ldc + j, ldc);
+      },
+      [&](int64_t i, int64_t j) {
+        Avx2Tile<1, kTileCols>(a + i * lda, lda, w + j * k, k, c + i * ldc + j, ldc);
+      },
+      [&](int64_t i, int64_t j) {
+        Avx2Tile<1, 1>(a + i * lda, lda, w + j * k, k, c + i * ldc + j, ldc);
+      });
+}
+
+// dpbusd multiplies unsigned by signed bytes, a is shifted to a + 128 and the extra
+// 128 * sum(w[j]) is subtracted afterwards.
+template<int64_t num_rows, int64_t num_cols>
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) inline void Avx512VnniTile(
+    const uint8_t* a, int64_t lda, const int8_t* w, int64_t k, const int32_t* row_sums,
+    int32_t* c, int64_t ldc) {
+  __m512i acc[num_rows][num_cols];
+  for (int64_t r = 0; r < num_rows; ++r) {
+    for (int64_t s = 0; s < num_cols; ++s) { acc[r][s] = _mm512_setzero_si512(); }
+  }
+  int64_t p = 0;
+  for (; p + 64 <= k; p += 64) {
+    __m512i vw[num_cols];
+    for (int64_t s = 0; s < num_cols; ++s) { vw[s] = _mm512_loadu_si512(w + s * k + p); }
+    for (int64_t r = 0; r < num_rows; ++r) {
+      const __m512i va = _mm512_loadu_si512(a + r * lda + p);
+      for (int64_t s = 0; s < num_cols; ++s) {
+        acc[r][s] = _mm512_dpbusd_epi32(acc[r][s], va, vw[s]);
+      }
+    }
+  }
+  if (p < k) {
+    const __mmask64 mask = (static_cast<uint64_t>(1) << (k - p)) - 1;
+    __m512i vw[num_cols];
+    for (int64_t s = 0; s < num_cols; ++s) {
+      vw[s] = _mm512_maskz_loadu_epi8(mask, w + s * k + p);
+    }
+    for (int64_t r = 0; r < num_rows; ++r) {
+      const __m512i va = _mm512_maskz_loadu_epi8(mask, a + r * lda + p);
+      for (int64_t s = 0; s < num_cols; ++s) {
+        acc[r][s] = _mm512_dpbusd_epi32(acc[r][s], va, vw[s]);
+      }
+    }
+  }
+  for (int64_t r = 0; r < num_rows; ++r) {
+    for (int64_t s = 0; s < num_cols; ++s) {
+      int32_t lanes[16];
+      _mm512_storeu_si512(lanes, acc[r][s]);
+      int32_t sum = 0;
+      for (int32_t lane : lanes) { sum += lane; }
+      c[r * ldc + s] = sum - 128 * row_sums[s];
+    }
+  }
+}
+
+// a holds the rows already shifted to a + 128 by Int8Gemm, once for all the column blocks.
+__attribute__((target("avx512f,avx512bw,avx512vnni"))) void Avx512VnniBlockKernel(
+    int64_t rows, const int8_t* a, int64_t lda, int64_t k, const int8_t* w,
+    const int32_t* row_sums, int64_t col_begin, int64_t col_end, int32_t* c, int64_t ldc) {
+  const uint8_t* shifted_a = reinterpret_cast<const uint8_t*>(a);
+  ForEachTile<kTileRows>(
+      rows, col_begin, col_end,
+      [&](int64_t i, int64_t j) {
+        Avx512VnniTile<kTileRows, kTileCols>(shifted_a + i * lda, lda, w + j * k, k, row_sums + j,
+                                             c + i * ldc + j, ldc);
+      },
+      [&](int64_t i, int64_t j) {
+        Avx512VnniTile<kTileRows, 1>(shifted_a + i * lda, lda, w + j * k, k, row_sums + j,
+                                     c + i * ldc + j, ldc);
+      },
+      [&](int64_t i, int64_t j) {
+        Avx512VnniTile<1, kTileCols>(shifted_a + i * lda, lda, w + j * k, k, row_sums + j,
+                                     c + i * ldc + j, ldc);
+      },
+      [&](int64_t i, int64_t j) {
+        Avx512VnniTile<1, 1>(shifted_a + i * lda, lda, w + j * k, k, row_sums + j,
+                             c + i * ldc + j, ldc);
+      });
+}
+
+#endif  // OF_INT8_GEMM_X86
+
+Int8GemmIsa DetectInt8GemmIsa() {
+  Int8GemmIsa isa = Int8GemmIsa::kGeneric;
+#ifdef OF_INT8_GEMM_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512bw")) {
+    isa = Int8GemmIsa::kAvx512Vnni;
+  } else if (__builtin_cpu_supports("avx2")) {
+    isa = Int8GemmIsa::kAvx2;
+  }
+#endif  // OF_INT8_GEMM_X86
+  // Only allows falling back to a narrower isa, e.g. to compare the kernels.
+  const std::string requested = GetStringFromEnv("ONEFLOW_INT8_GEMM_ISA", "");
+  if (requested == "generic") {
+    isa = Int8GemmIsa::kGeneric;
+  } else if (requested == "avx2" && isa == Int8GemmIsa::kAvx512Vnni) {
+    isa = Int8GemmIsa::kAvx2;
+  }
+  return isa;
+}
+
+Int8GemmIsa GetInt8GemmIsa() {
+  static const Int8GemmIsa isa = DetectInt8GemmIsa();
+  return isa;
+}
+
+BlockKernel GetBlockKernel() {
+  switch (GetInt8GemmIsa()) {
+#ifdef OF_INT8_GEMM_X86
+    case Int8GemmIsa::kAvx512Vnni: return Avx512VnniBlockKernel;
+    case Int8GemmIsa::kAvx2: return Avx2BlockKernel;
+#endif  // OF_INT8_GEMM_X86
+    default: return GenericBlockKernel;
+  }
+}
+
+}  // namespace
+
+Int8PackedWeight::Int8PackedWeight(ep::Stream* stream, int64_t n, int64_t k, bool transpose,
+                                   const float* weight, const float* scale, int64_t scale_size)
+    : n_(n), k_(k), data_(n * k), row_sums_(n), scales_(scale_size) {
+  CHECK(scale_size == 1 || scale_size == n)
+      << "weight scale should have 1 or " << n << " elements, but got " << scale_size;
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  const auto Weight = [&](int64_t j, int64_t p) {
+    return transpose ? weight[p * n + j] : weight[j * k + p];
+  };
+  if (scale != nullptr) {
+    std::copy(scale, scale + scale_size, scales_.begin());
+  } else {
+    std::vector<float> row_max_abs(n);
+    cpu_stream->ParallelFor(
+        0, n,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t j = begin; j < end; ++j) {
+            float max_abs = 0;
+            for (int64_t p = 0; p < k; ++p) { max_abs = std::max(max_abs, std::abs(Weight(j, p))); }
+            row_max_abs[j] = max_abs;
+          }
+        },
+        1);
+    if (scale_size == 1) {
+      float max_abs = 0;
+      for (float row_max : row_max_abs) { max_abs = std::max(max_abs, row_max); }
+      scales_[0] = max_abs / 127.f;
+    } else {
+      for (int64_t j = 0; j < n; ++j) { scales_[j] = row_max_abs[j] / 127.f; }
+    }
+  }
+  cpu_stream->ParallelFor(
+      0, n,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t j = begin; j < end; ++j) {
+          const float row_scale = scales_[scale_size == 1 ? 0 : j];
+          int8_t* row = data_.data() + j * k;
+          int32_t row_sum = 0;
+          for (int64_t p = 0; p < k; ++p) {
+            // An all zero row has a zero scale.
+            row[p] = row_scale == 0.f ? 0 : QuantizeToInt8(Weight(j, p), row_scale);
+            row_sum += row[p];
+          }
+          row_sums_[j] = row_sum;
+        }
+      },
+      1);
+}
+
+void ReleaseFloatWeightPages(const void* weight, size_t size) {
+#if defined(__linux__) && defined(MADV_PAGEOUT)
+  static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  // Only the pages that hold nothing but the weight, the others may be in use by other tensors.
+  const uintptr_t begin = RoundUp(reinterpret_cast<uintptr_t>(weight), page_size);
+  const uintptr_t end = (reinterpret_cast<uintptr_t>(weight) + size) / page_size * page_size;
+  // Ignores failures, e.g. EINVAL on kernels older than 5.4.
+  if (begin < end) { madvise(reinterpret_cast<void*>(begin), end - begin, MADV_PAGEOUT); }
+#endif  // __linux__ && MADV_PAGEOUT
+}
+
+void Int8Gemm(ep::Stream* stream, int64_t m, const int8_t* a, int64_t lda,
+              const Int8PackedWeight& w, int32_t* c, int64_t ldc) {
+  const int64_t n = w.n();
+  const int64_t k = w.k();
+  if (m == 0 || n == 0) { return; }
+  const BlockKernel block_kernel = GetBlockKernel();
+  auto* cpu_stream = stream->As<ep::CpuStream>();
+  std::vector<int8_t> shifted_a;
+  if (GetInt8GemmIsa() == Int8GemmIsa::kAvx512Vnni) {
+    shifted_a.resize(m * k);
+    cpu_stream->ParallelFor(
+        0, m,
+        [&](int64_t begin, int64_t end) {
+          for (int64_t i = begin; i < end; ++i) {
+            for (int64_t p = 0; p < k; ++p) {
+              shifted_a[i * k + p] =
+                  static_cast<int8_t>(static_cast<uint8_t>(a[i * lda + p]) ^ 0x80);
+            }
+          }
+        },
+        1);
+    a = shifted_a.data();
+    lda = k;
+  }
+  const int64_t num_row_blocks = (m + kRowBlockSize - 1) / kRowBlockSize;
+  const int64_t num_col_blocks = (n + kColBlockSize - 1) / kColBlockSize;
+  cpu_stream->ParallelFor(
+      0, num_row_blocks * num_col_blocks,
+      [&](int64_t begin, int64_t end) {
+        for (int64_t block = begin; block < end; ++block) {
+          const int64_t row_begin = (block / num_col_blocks) * kRowBlockSize;
+          const int64_t rows = std::min(kRowBlockSize, m - row_begin);
+          const int64_t col_begin = (block % num_col_blocks) * kColBlockSize;
+          const int64_t col_end = std::min(col_begin + kColBlockSize, n);
+          block_kernel(rows, a + row_begin * lda, lda, k, w.data(), w.row_sums(), col_begin,
+                       col_end, c + row_begin * ldc, ldc);
+        }
+      },
+      1);
+}
+
+const char* Int8GemmIsaName() {
+  switch (GetInt8GemmIsa()) {
+    case Int8GemmIsa::kAvx512Vnni: return "avx512_vnni";
+    case Int8GemmIsa::kAvx2: return "avx2";
+    default: return "generic";
+  }
+}
+
+}  // namespace oneflow
@@ -0,0 +1,123 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_INT8_GEMM_H_
+#define ONEFLOW_USER_KERNELS_INT8_GEMM_H_
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/ep/include/stream.h"
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/variable_write_epoch.h"
+
+namespace oneflow {
+
+// Symmetric 8 bit quantization shared by the requantize kernel and the int8 weights, rounds half
+// to even like the fake_quantization kernel.
+inline int8_t QuantizeToInt8(float x, float scale) {
+  float q = std::nearbyint(x / scale);
+  q = q > 127.f ? 127.f : q;
+  q = q < -128.f ? -128.f : q;
+  return static_cast<int8_t>(q);
+}
+
+// Weight of a quantized matmul or convolution, stored as int8 (n, k) row major so that every
+// output column is a contiguous dot product. Quantized with one scale per row or one scale for
+// the whole weight.
+class Int8PackedWeight final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(Int8PackedWeight);
+  // weight is float (n, k), or (k, n) if transpose is set. scale has scale_size elements, 1 or n.
+  // If scale is nullptr the scales are computed from the weight like the symmetric 8 bit
+  // min_max_observer does, max(|w|) / 127 of every row or of the whole weight.
+  Int8PackedWeight(ep::Stream* stream, int64_t n, int64_t k, bool transpose, const float* weight,
+                   const float* scale, int64_t scale_size);
+  ~Int8PackedWeight() = default;
+
+  int64_t n() const { return n_; }
+  int64_t k() const { return k_; }
+  const int8_t* data() const { return data_.data(); }
+  const int32_t* row_sums() const { return row_sums_.data(); }
+  // The scales quantized with, 1 or n elements.
+  const float* scales() const { return scales_.data(); }
+  int64_t scale_size() const { return scales_.size(); }
+
+ private:
+  int64_t n_;
+  int64_t k_;
+  std::vector<int8_t> data_;
+  std::vector<int32_t> row_sums_;
+  std::vector<float> scales_;
+};
+
+// Asks the os to reclaim the whole pages of a float weight that was just quantized and that no
+// kernel reads until it changes. The pages keep their content: pages of a mapped variable file
+// are dropped and read again from the file, anonymous pages go to swap if there is any. Only a
+// hint, does nothing where MADV_PAGEOUT is not available.
+void ReleaseFloatWeightPages(const void* weight, size_t size);
+
+// Kernel state of quantized_matmul and quantized_conv2d. The int8 weight is quantized on the
+// first launch and again whenever the float weight or its scale may have changed: the weight
+// memory moved, the VariableWriteEpoch increased (the variable was overwritten) or the scale
+// differs from the one quantized with. The scale is compared by value since it may be computed
+// in the job rather than be a variable. Without a weight_scale tensor the scales are computed
+// when quantizing, so the float weight is not read at all until it changes and its pages are
+// released rather than staying resident next to the int8 copy.
+class Int8PackedWeightState final : public user_op::OpKernelState {
+ public:
+  Int8PackedWeightState() : packed_from_(nullptr), packed_epoch_(0) {}
+  ~Int8PackedWeightState() override = default;
+
+  // weight_scale may be nullptr, then per_channel tells whether to compute a scale per row.
+  const Int8PackedWeight& GetOrPack(ep::Stream* stream, int64_t n, int64_t k, bool transpose,
+                                    const user_op::Tensor* weight,
+                                    const user_op::Tensor* weight_scale, bool per_channel) {
+    const uint64_t epoch = VariableWriteEpoch::Get();
+    const float* scale = weight_scale == nullptr ? nullptr : weight_scale->dptr<float>();
+    const int64_t scale_size = weight_scale == nullptr ? (per_channel ? n : 1)
+                                                       : weight_scale->shape_view().elem_cnt();
+    if (!packed_weight_ || packed_weight_->n() != n || packed_weight_->k() != k
+        || packed_from_ != weight->dptr() || packed_epoch_ != epoch
+        || packed_weight_->scale_size() != scale_size
+        || (scale != nullptr
+            && std::memcmp(scale, packed_weight_->scales(), scale_size * sizeof(float)) != 0)) {
+      packed_weight_.reset(
+          new Int8PackedWeight(stream, n, k, transpose, weight->dptr<float>(), scale, scale_size));
+      packed_from_ = weight->dptr();
+      packed_epoch_ = epoch;
+      if (scale == nullptr) { ReleaseFloatWeightPages(weight->dptr(), n * k * sizeof(float)); }
+    }
+    return *packed_weight_;
+  }
+
+ private:
+  std::unique_ptr<Int8PackedWeight> packed_weight_;
+  const void* packed_from_;
+  uint64_t packed_epoch_;
+};
+
+// c(m, n) = a(m, k) * w(n, k)^T accumulated in int32, lda and ldc are the row strides of a and c.
+// Uses avx512 vnni or avx2 when the cpu supports them.
+void Int8Gemm(ep::Stream* stream, int64_t m, const int8_t* a, int64_t lda,
+              const Int8PackedWeight& w, int32_t* c, int64_t ldc);
+
+// "avx512_vnni", "avx2" or "generic".
+const char* Int8GemmIsaName();
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_INT8_GEMM_H_
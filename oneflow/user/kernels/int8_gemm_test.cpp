@@ -0,0 +1,193 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "oneflow/core/ep/test/benchmark_util.h"
+#include "oneflow/core/ep/include/primitive/matmul.h"
+#include "oneflow/user/kernels/int8_gemm.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+class Int8GemmTest : public ep::test::TestCase {};
+
+class Int8GemmBenchmark : public ep::test::BenchmarkCase {};
+
+std::vector<float> RandomFloats(size_t count, uint32_t seed) {
+  std::vector<float> values(count);
+  uint32_t state = seed;
+  for (float& value : values) {
+    state = state * 1664525u + 1013904223u;
+    value = static_cast<float>(state >> 8) / static_cast<float>(1 << 24) * 2.f - 1.f;
+  }
+  return values;
+}
+
+float MaxAbs(const float* values, int64_t count) {
+  float max_abs = 0;
+  FOR_RANGE(int64_t, i, 0, count) { max_abs = std::max(max_abs, std::abs(values[i])); }
+  return max_abs;
+}
+
+}  // namespace
+
+TEST_F(Int8GemmTest, exact) {
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  ep::test::StreamGuard stream(device.get());
+  // m, n, k, covering the remainders of the register tiles and of the simd width
+  const std::vector<std::array<int64_t, 3>> shapes = {
+      {1, 1, 1}, {3, 7, 15}, {5, 13, 63}, {64, 65, 64}, {67, 130, 200}, {130, 64, 1000},
+  };
+  for (const auto& shape : shapes) {
+    const int64_t m = shape[0], n = shape[1], k = shape[2];
+    const std::vector<float> weight = RandomFloats(n * k, 1);
+    std::vector<float> weight_scale(n);
+    FOR_RANGE(int64_t, j, 0, n) { weight_scale[j] = MaxAbs(weight.data() + j * k, k) / 127.f; }
+    const Int8PackedWeight packed(stream.stream(), n, k, false, weight.data(),
+                                  weight_scale.data(), n);
+    std::vector<int8_t> a(m * k);
+    // -128 is the edge case of the unsigned shift of avx512 vnni
+    FOR_RANGE(int64_t, i, 0, m * k) { a[i] = static_cast<int8_t>((i * 37) % 256 - 128); }
+    std::vector<int32_t> c(m * n);
+    Int8Gemm(stream.stream(), m, a.data(), k, packed, c.data(), n);
+    FOR_RANGE(int64_t, i, 0, m) {
+      FOR_RANGE(int64_t, j, 0, n) {
+        int32_t expected = 0;
+        FOR_RANGE(int64_t, p, 0, k) { expected += a[i * k + p] * packed.data()[j * k + p]; }
+        ASSERT_EQ(c[i * n + j], expected)
+            << Int8GemmIsaName() << " m:" << m << " n:" << n << " k:" << k << " " << i << "," << j;
+      }
+    }
+  }
+}
+
+TEST_F(Int8GemmTest, accuracy) {
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  ep::test::StreamGuard stream(device.get());
+  const int64_t m = 32, n = 256, k = 768;
+  const std::vector<float> a = RandomFloats(m * k, 2);
+  const std::vector<float> weight = RandomFloats(k * n, 3);
+  // weight is (k, n) like an untransposed matmul, quantized per tensor
+  const float weight_scale = MaxAbs(weight.data(), k * n) / 127.f;
+  const Int8PackedWeight packed(stream.stream(), n, k, true, weight.data(), &weight_scale, 1);
+  const float a_scale = MaxAbs(a.data(), m * k) / 127.f;
+  std::vector<int8_t> a_int8(m * k);
+  FOR_RANGE(int64_t, i, 0, m * k) { a_int8[i] = QuantizeToInt8(a[i], a_scale); }
+  std::vector<int32_t> c(m * n);
+  Int8Gemm(stream.stream(), m, a_int8.data(), k, packed, c.data(), n);
+  double error = 0;
+  double norm = 0;
+  FOR_RANGE(int64_t, i, 0, m) {
+    FOR_RANGE(int64_t, j, 0, n) {
+      double expected = 0;
+      FOR_RANGE(int64_t, p, 0, k) { expected += a[i * k + p] * weight[p * n + j]; }
+      const double actual = c[i * n + j] * a_scale * weight_scale;
+      error += (actual - expected) * (actual - expected);
+      norm += expected * expected;
+    }
+  }
+  // 8 bit quantization of uniform data keeps the relative error of the product around 1%.
+  ASSERT_LT(std::sqrt(error / norm), 0.02);
+}
+
+TEST_F(Int8GemmTest, computed_scale) {
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  ep::test::StreamGuard stream(device.get());
+  const int64_t n = 33, k = 70;
+  // (k, n) like an untransposed matmul, with an all zero output channel.
+  std::vector<float> weight = RandomFloats(k * n, 7);
+  FOR_RANGE(int64_t, p, 0, k) { weight[p * n + 5] = 0; }
+  std::vector<float> transposed(n * k);
+  FOR_RANGE(int64_t, p, 0, k) {
+    FOR_RANGE(int64_t, j, 0, n) { transposed[j * k + p] = weight[p * n + j]; }
+  }
+  // The scales min_max_observer computes.
+  std::vector<float> per_channel_scale(n);
+  FOR_RANGE(int64_t, j, 0, n) {
+    per_channel_scale[j] = MaxAbs(transposed.data() + j * k, k) / 127.f;
+  }
+  const float per_tensor_scale = MaxAbs(weight.data(), k * n) / 127.f;
+  for (const int64_t scale_size : {static_cast<int64_t>(1), n}) {
+    const float* scale = scale_size == 1 ? &per_tensor_scale : per_channel_scale.data();
+    const Int8PackedWeight expected(stream.stream(), n, k, true, weight.data(), scale,
+                                    scale_size);
+    const Int8PackedWeight computed(stream.stream(), n, k, true, weight.data(), nullptr,
+                                    scale_size);
+    ASSERT_EQ(computed.scale_size(), scale_size);
+    ASSERT_TRUE(std::equal(scale, scale + scale_size, computed.scales()));
+    ASSERT_TRUE(std::equal(expected.data(), expected.data() + n * k, computed.data()));
+    ASSERT_TRUE(std::equal(expected.row_sums(), expected.row_sums() + n, computed.row_sums()));
+  }
+}
+
+TEST_F(Int8GemmTest, release_float_weight_pages) {
+  // Spans several pages and starts in the middle of one.
+  const std::vector<float> expected = RandomFloats(5 * 4096 + 7, 6);
+  std::vector<float> weight(expected.size() + 3);
+  std::copy(expected.begin(), expected.end(), weight.begin() + 3);
+  ReleaseFloatWeightPages(weight.data() + 3, expected.size() * sizeof(float));
+  ASSERT_TRUE(std::equal(expected.begin(), expected.end(), weight.begin() + 3));
+}
+
+TEST_F(Int8GemmBenchmark, GemmBenchmark) {
+  // m, n, k: bert-base ffn and projection, llm decoding projections and resnet50 3x3 conv
+  // as im2row gemm.
+  const std::vector<std::array<int64_t, 3>> shapes = {
+      {4096, 3072, 768}, {4096, 768, 768}, {1, 4096, 4096},
+      {32, 4096, 4096},  {32, 11008, 4096}, {3136, 64, 576},
+  };
+  for (const auto& shape : shapes) {
+    const int64_t m = shape[0], n = shape[1], k = shape[2];
+    const std::string name =
+        "/m:" + std::to_string(m) + "/n:" + std::to_string(n) + "/k:" + std::to_string(k);
+    const std::vector<float> a = RandomFloats(m * k, 4);
+    const std::vector<float> weight = RandomFloats(n * k, 5);
+    std::vector<int8_t> a_int8(m * k);
+    FOR_RANGE(int64_t, i, 0, m * k) { a_int8[i] = QuantizeToInt8(a[i], 1.f / 127.f); }
+    std::vector<float> c(m * n);
+    ForEachDeviceAndNumThreads([&](ep::Device* device, size_t num_threads) {
+      if (device->device_type() != DeviceType::kCPU) { return; }
+      ep::test::StreamGuard stream(device);
+      const float weight_scale = 1.f / 127.f;
+      const Int8PackedWeight packed(stream.stream(), n, k, false, weight.data(), &weight_scale, 1);
+      const double int8_time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+        Int8Gemm(stream.stream(), m, a_int8.data(), k, packed,
+                 reinterpret_cast<int32_t*>(c.data()), n);
+      });
+      Report(std::string("int8_gemm_") + Int8GemmIsaName() + name, DeviceType::kCPU, num_threads,
+             int8_time_us, m * k + n * k + m * n * sizeof(int32_t), 2.0 * m * n * k);
+      std::unique_ptr<ep::primitive::Matmul> matmul =
+          ep::primitive::NewPrimitive<ep::primitive::MatmulFactory>(
+              DeviceType::kCPU, DataType::kFloat, ep::primitive::BlasTransposeType::N,
+              ep::primitive::BlasTransposeType::T);
+      ASSERT_TRUE(matmul.operator bool());
+      const double fp32_time_us = MeasureLaunchTimeUs(stream.stream(), [&]() {
+        matmul->Launch(stream.stream(), m, n, k, 1.0, a.data(), weight.data(), 0.0, c.data());
+      });
+      Report("fp32_gemm" + name, DeviceType::kCPU, num_threads, fp32_time_us,
+             (m * k + n * k + m * n) * sizeof(float), 2.0 * m * n * k);
+    });
+  }
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -20,6 +20,8 @@ limitations under the License.
 #include "oneflow/core/ep/include/primitive/memcpy.h"
 #include "oneflow/core/ep/include/primitive/matmul.h"
 #include "oneflow/core/ep/include/primitive/batch_matmul.h"
+#include "oneflow/core/ep/include/primitive/packed_matmul.h"
+#include "oneflow/core/framework/variable_write_epoch.h"
 
 namespace oneflow {
 
@@ -114,6 +116,81 @@ auto BatchMatmulPrimitiveExists() {
   });
 }
 
+// b of a matmul packed by the PackedMatmul primitive. PrepackCpuMatmulWeightPass only sets
+// prepack_b on matmuls of variables in inference jobs. b is packed again when its memory or the
+// VariableWriteEpoch changed since the last packing, i.e. after the variable was overwritten.
+class PackedMatmulBState final : public user_op::OpKernelState {
+ public:
+  PackedMatmulBState(std::unique_ptr<ep::primitive::PackedMatmul>&& packed_matmul,
+                     ep::Device* device)
+      : packed_matmul_(std::move(packed_matmul)),
+        device_(device),
+        packed_b_(nullptr),
+        packed_b_size_(0),
+        packed_from_(nullptr),
+        packed_epoch_(0),
+        k_(0),
+        n_(0) {}
+  ~PackedMatmulBState() override {
+    if (packed_b_ != nullptr) { device_->Free(ep::AllocationOptions{}, packed_b_); }
+  }
+
+  ep::primitive::PackedMatmul* packed_matmul() const { return packed_matmul_.get(); }
+
+  const void* GetOrPack(ep::Stream* stream, const user_op::Tensor* b, size_t k, size_t n) {
+    const uint64_t epoch = VariableWriteEpoch::Get();
+    if (packed_from_ == b->dptr() && packed_epoch_ == epoch && k_ == k && n_ == n) {
+      return packed_b_;
+    }
+    const size_t size = packed_matmul_->GetPackedBSize(k, n);
+    if (size > packed_b_size_) {
+      if (packed_b_ != nullptr) { device_->Free(ep::AllocationOptions{}, packed_b_); }
+      CHECK_JUST(device_->Alloc(ep::AllocationOptions{}, &packed_b_, size));
+      packed_b_size_ = size;
+    }
+    packed_matmul_->PackB(stream, k, n, b->dptr(), packed_b_);
+    packed_from_ = b->dptr();
+    packed_epoch_ = epoch;
+    k_ = k;
+    n_ = n;
+    return packed_b_;
+  }
+
+ private:
+  std::unique_ptr<ep::primitive::PackedMatmul> packed_matmul_;
+  ep::Device* device_;
+  void* packed_b_;
+  size_t packed_b_size_;
+  const void* packed_from_;
+  uint64_t packed_epoch_;
+  size_t k_;
+  size_t n_;
+};
+
+std::shared_ptr<user_op::OpKernelState> CreatePackedMatmulBState(user_op::KernelInitContext* ctx) {
+  if (!ctx->Attr<bool>("prepack_b")) { return nullptr; }
+  const auto trans_a = GetBlasTransposeType(ctx, "transpose_a");
+  const auto trans_b = GetBlasTransposeType(ctx, "transpose_b");
+  auto packed_matmul = ep::primitive::NewPrimitive<ep::primitive::PackedMatmulFactory>(
+      ctx->device_type(), ctx->TensorDesc4ArgNameAndIndex("b", 0)->data_type(), trans_a, trans_b);
+  if (!packed_matmul) { return nullptr; }
+  return std::make_shared<PackedMatmulBState>(std::move(packed_matmul), ctx->stream()->device());
+}
+
+// Returns false if b is not packed and the matmul primitive has to be launched.
+bool TryLaunchPackedMatmul(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+                           size_t m, size_t n, size_t k, double alpha, double beta) {
+  auto* packed_b_state = dynamic_cast<PackedMatmulBState*>(state);
+  if (packed_b_state == nullptr) { return false; }
+  const user_op::Tensor* a = ctx->Tensor4ArgNameAndIndex("a", 0);
+  const user_op::Tensor* b = ctx->Tensor4ArgNameAndIndex("b", 0);
+  user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+  const void* packed_b = packed_b_state->GetOrPack(ctx->stream(), b, k, n);
+  packed_b_state->packed_matmul()->Launch(ctx->stream(), m, n, k, alpha, a->dptr(), packed_b, beta,
+                                          out->mut_dptr());
+  return true;
+}
+
 class MatmulKernel final : public user_op::OpKernel, public user_op::CudaGraphSupport {
  public:
   MatmulKernel() = default;
@@ -121,8 +198,15 @@ class MatmulKernel final : public user_op::OpKernel, public user_op::CudaGraphSu
 
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return CreatePackedMatmulBState(ctx);
+  }
+
  private:
-  void Compute(user_op::KernelComputeContext* ctx) const override {
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
     const auto trans_a = GetBlasTransposeType(ctx, "transpose_a");
     const auto trans_b = GetBlasTransposeType(ctx, "transpose_b");
     const user_op::Tensor* a = ctx->Tensor4ArgNameAndIndex("a", 0);
@@ -149,6 +233,7 @@ class MatmulKernel final : public user_op::OpKernel, public user_op::CudaGraphSu
                      add_to_output->shape_view().elem_cnt() * GetSizeOfDataType(data_type));
       beta = 1.0;
     }
+    if (TryLaunchPackedMatmul(ctx, state, m, n, k, alpha, beta)) { return; }
     auto matmul = NewMatmulPrimitive(ctx);
     CHECK(matmul);
     matmul->Launch(ctx->stream(), m, n, k, alpha, a->dptr(), b->dptr(), beta, out->mut_dptr());
@@ -238,8 +323,15 @@ class BroadcastMatmulKernel final : public user_op::OpKernel, public user_op::Cu
 
   bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
 
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return CreatePackedMatmulBState(ctx);
+  }
+
  private:
-  void Compute(user_op::KernelComputeContext* ctx) const override {
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
     double alpha = ctx->Attr<double>("alpha");
     bool transpose_a = ctx->Attr<bool>("transpose_a");
     bool transpose_b = ctx->Attr<bool>("transpose_b");
@@ -273,6 +365,7 @@ class BroadcastMatmulKernel final : public user_op::OpKernel, public user_op::Cu
       n = b->shape_view().At(0);
       CHECK_EQ(k, b->shape_view().At(1));
     }
+    if (TryLaunchPackedMatmul(ctx, state, m, n, k, alpha, beta)) { return; }
     auto matmul = NewMatmulPrimitive(ctx);
     CHECK(matmul);
     matmul->Launch(ctx->stream(), m, n, k, alpha, a->dptr(), b->dptr(), beta, out->mut_dptr());
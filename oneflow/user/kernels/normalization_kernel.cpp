@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 #include "oneflow/core/framework/framework.h"
+#include "oneflow/user/kernels/normalization_kernel_util.h"
 
 namespace oneflow {
 
@@ -67,31 +68,6 @@ static void ComputeMeanAndVar(const T* input_ptr, T* mean_ptr, T* inv_variance_p
   }
 }
 
-template<typename T>
-static void Normalize(const T* input_ptr, const T* mean_ptr, const T* variance_ptr,
-                      const T* gamma_ptr, const T* beta_ptr, T* output_ptr,
-                      const int64_t batch_size, const int64_t channel_size,
-                      const int64_t spatial_size, const float epsilon, const bool training) {
-  const T* temp_input_ptr = input_ptr;
-  T* temp_output_ptr = output_ptr;
-  const int64_t all_channels = batch_size * channel_size;
-  int64_t channel = -1;
-  for (int64_t ac = 0; ac < all_channels; ++ac) {
-    channel += 1;
-    if (channel >= channel_size) { channel = 0; }
-    T inv_variance = variance_ptr[channel];
-    if (!training) { inv_variance = 1.0f / std::sqrt(inv_variance + epsilon); }
-    const T gamma = gamma_ptr[channel] * inv_variance;
-    const T beta = beta_ptr[channel];
-    const T mean = mean_ptr[channel];
-    for (int64_t s = 0; s < spatial_size; ++s) {
-      temp_output_ptr[s] = (temp_input_ptr[s] - mean) * gamma + beta;
-    }
-    temp_input_ptr += spatial_size;
-    temp_output_ptr += spatial_size;
-  }
-}
-
 template<typename T>
 static void AddToOutput(const T* add_to_output_ptr, T* output_ptr, const int64_t elem_count) {
   for (int64_t i = 0; i < elem_count; ++i) { output_ptr[i] += add_to_output_ptr[i]; }
@@ -309,8 +285,8 @@ class NormalizationInferenceCpuKernel final : public user_op::OpKernel {
 
       // NOTE(Liang Depeng):
       // compute the normalization result
-      Normalize(input_ptr, moving_mean_ptr, moving_variance_ptr, gamma_ptr, beta_ptr, output_ptr,
-                batch_size, channel_size, spatial_size, epsilon, false);
+      NormalizeCpu(input_ptr, moving_mean_ptr, moving_variance_ptr, gamma_ptr, beta_ptr,
+                   output_ptr, batch_size, channel_size, spatial_size, epsilon, false);
 
       if (ctx->has_input("_add_to_output", 0)) {
         const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
@@ -410,8 +386,8 @@ class NormalizationTrainCpuKernel final : public user_op::OpKernel {
 
       // NOTE(Liang Depeng):
       // compute the normalization result
-      Normalize(input_ptr, mean_ptr, inv_variance_ptr, gamma_ptr, beta_ptr, output_ptr, batch_size,
-                channel_size, spatial_size, epsilon, true);
+      NormalizeCpu(input_ptr, mean_ptr, inv_variance_ptr, gamma_ptr, beta_ptr, output_ptr,
+                   batch_size, channel_size, spatial_size, epsilon, true);
 
       if (ctx->has_input("_add_to_output", 0)) {
         const user_op::Tensor* add_to_output = ctx->Tensor4ArgNameAndIndex("_add_to_output", 0);
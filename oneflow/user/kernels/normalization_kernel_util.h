@@ -0,0 +1,53 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_NORMALIZATION_KERNEL_UTIL_H_
+#define ONEFLOW_USER_KERNELS_NORMALIZATION_KERNEL_UTIL_H_
+
+#include <cmath>
+#include <cstdint>
+
+namespace oneflow {
+
+// Normalizes a nchw input by channel. In training `variance_ptr` holds the inverse standard
+// deviations of the batch, in inference the moving variances.
+template<typename T>
+void NormalizeCpu(const T* input_ptr, const T* mean_ptr, const T* variance_ptr, const T* gamma_ptr,
+                  const T* beta_ptr, T* output_ptr, const int64_t batch_size,
+                  const int64_t channel_size, const int64_t spatial_size, const float epsilon,
+                  const bool training) {
+  const T* temp_input_ptr = input_ptr;
+  T* temp_output_ptr = output_ptr;
+  const int64_t all_channels = batch_size * channel_size;
+  int64_t channel = -1;
+  for (int64_t ac = 0; ac < all_channels; ++ac) {
+    channel += 1;
+    if (channel >= channel_size) { channel = 0; }
+    T inv_variance = variance_ptr[channel];
+    if (!training) { inv_variance = 1.0f / std::sqrt(inv_variance + epsilon); }
+    const T gamma = gamma_ptr[channel] * inv_variance;
+    const T beta = beta_ptr[channel];
+    const T mean = mean_ptr[channel];
+    for (int64_t s = 0; s < spatial_size; ++s) {
+      temp_output_ptr[s] = (temp_input_ptr[s] - mean) * gamma + beta;
+    }
+    temp_input_ptr += spatial_size;
+    temp_output_ptr += spatial_size;
+  }
+}
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_NORMALIZATION_KERNEL_UTIL_H_
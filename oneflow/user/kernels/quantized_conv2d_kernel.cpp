@@ -0,0 +1,181 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/user/kernels/int8_gemm.h"
+
+namespace oneflow {
+
+namespace {
+
+struct QuantizedConv2DParams {
+  int64_t channels;
+  int64_t in_height;
+  int64_t in_width;
+  int64_t out_height;
+  int64_t out_width;
+  int32_t kernel_height;
+  int32_t kernel_width;
+  int32_t stride_height;
+  int32_t stride_width;
+  int32_t padding_height;
+  int32_t padding_width;
+  int32_t dilation_height;
+  int32_t dilation_width;
+
+  int64_t NumPatches() const { return out_height * out_width; }
+  int64_t PatchSize() const { return channels * kernel_height * kernel_width; }
+};
+
+template<typename Context>
+QuantizedConv2DParams GetQuantizedConv2DParams(Context* ctx, const ShapeView& in_shape,
+                                               const ShapeView& out_shape) {
+  const auto& kernel_size = ctx->template Attr<std::vector<int32_t>>("kernel_size");
+  const auto& strides = ctx->template Attr<std::vector<int32_t>>("strides");
+  const auto& padding_before = ctx->template Attr<std::vector<int32_t>>("padding_before");
+  const auto& dilation_rate = ctx->template Attr<std::vector<int32_t>>("dilation_rate");
+  QuantizedConv2DParams params{};
+  params.channels = in_shape.At(1);
+  params.in_height = in_shape.At(2);
+  params.in_width = in_shape.At(3);
+  params.out_height = out_shape.At(2);
+  params.out_width = out_shape.At(3);
+  params.kernel_height = kernel_size.at(0);
+  params.kernel_width = kernel_size.at(1);
+  params.stride_height = strides.at(0);
+  params.stride_width = strides.at(1);
+  params.padding_height = padding_before.at(0);
+  params.padding_width = padding_before.at(1);
+  params.dilation_height = dilation_rate.at(0);
+  params.dilation_width = dilation_rate.at(1);
+  return params;
+}
+
+// Unfolds one chw image into (num_patches, patch_size) rows, the row layout matches the
+// (filters, c, kh, kw) weight. Padding is zero, which is exact for symmetric quantization.
+void Im2Row(ep::Stream* stream, const QuantizedConv2DParams& params, const int8_t* in,
+            int8_t* rows) {
+  const int64_t patch_size = params.PatchSize();
+  stream->As<ep::CpuStream>()->ParallelFor(
+      0, params.NumPatches(),
+      [&](int64_t begin, int64_t end) {
+        for (int64_t patch = begin; patch < end; ++patch) {
+          const int64_t oh = patch / params.out_width;
+          const int64_t ow = patch % params.out_width;
+          int8_t* row = rows + patch * patch_size;
+          for (int64_t c = 0; c < params.channels; ++c) {
+            const int8_t* channel = in + c * params.in_height * params.in_width;
+            for (int32_t kh = 0; kh < params.kernel_height; ++kh) {
+              const int64_t ih =
+                  oh * params.stride_height - params.padding_height + kh * params.dilation_height;
+              for (int32_t kw = 0; kw < params.kernel_width; ++kw) {
+                const int64_t iw =
+                    ow * params.stride_width - params.padding_width + kw * params.dilation_width;
+                const bool in_bounds =
+                    ih >= 0 && ih < params.in_height && iw >= 0 && iw < params.in_width;
+                *row++ = in_bounds ? channel[ih * params.in_width + iw] : 0;
+              }
+            }
+          }
+        }
+      },
+      1024);
+}
+
+size_t Im2RowBufferSize(const QuantizedConv2DParams& params) {
+  return GetCudaAlignedSize(params.NumPatches() * params.PatchSize() * sizeof(int8_t));
+}
+
+}  // namespace
+
+class CpuQuantizedConv2DKernel final : public user_op::OpKernel {
+ public:
+  CpuQuantizedConv2DKernel() = default;
+  ~CpuQuantizedConv2DKernel() = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<Int8PackedWeightState>();
+  }
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* weight = ctx->Tensor4ArgNameAndIndex("weight", 0);
+    const user_op::Tensor* in_scale = ctx->Tensor4ArgNameAndIndex("in_scale", 0);
+    // Absent when the kernel computes the scale of the weight itself, see Int8PackedWeightState.
+    const user_op::Tensor* weight_scale = ctx->Tensor4ArgNameAndIndex("weight_scale", 0);
+    const user_op::Tensor* bias = ctx->Tensor4ArgNameAndIndex("bias", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    user_op::Tensor* tmp_buffer = ctx->Tensor4ArgNameAndIndex("tmp_buffer", 0);
+    const QuantizedConv2DParams params =
+        GetQuantizedConv2DParams(ctx, in->shape_view(), out->shape_view());
+    const int64_t filters = out->shape_view().At(1);
+    const int64_t num_patches = params.NumPatches();
+    const int64_t patch_size = params.PatchSize();
+    const Int8PackedWeight& packed_weight =
+        dynamic_cast<Int8PackedWeightState*>(state)->GetOrPack(
+            ctx->stream(), filters, patch_size, false, weight, weight_scale,
+            ctx->Attr<bool>("per_channel_weight_scale"));
+
+    int8_t* rows = tmp_buffer->mut_dptr<int8_t>();
+    int32_t* acc = reinterpret_cast<int32_t*>(tmp_buffer->mut_dptr<char>()
+                                              + Im2RowBufferSize(params));
+    const float in_scale_value = in_scale->dptr<float>()[0];
+    const float* weight_scale_ptr = packed_weight.scales();
+    const bool per_channel = packed_weight.scale_size() > 1;
+    const float* bias_ptr = bias == nullptr ? nullptr : bias->dptr<float>();
+    const int64_t in_image_size = in->shape_view().Count(1);
+    const int64_t out_image_size = out->shape_view().Count(1);
+    FOR_RANGE(int64_t, i, 0, in->shape_view().At(0)) {
+      Im2Row(ctx->stream(), params, in->dptr<int8_t>() + i * in_image_size, rows);
+      Int8Gemm(ctx->stream(), num_patches, rows, patch_size, packed_weight, acc, filters);
+      // acc is (num_patches, filters), out is (filters, num_patches).
+      float* out_ptr = out->mut_dptr<float>() + i * out_image_size;
+      ctx->stream()->As<ep::CpuStream>()->ParallelFor(
+          0, filters,
+          [&](int64_t begin, int64_t end) {
+            for (int64_t f = begin; f < end; ++f) {
+              const float scale = in_scale_value * weight_scale_ptr[per_channel ? f : 0];
+              const float bias_value = bias_ptr == nullptr ? 0.f : bias_ptr[f];
+              for (int64_t p = 0; p < num_patches; ++p) {
+                out_ptr[f * num_patches + p] =
+                    static_cast<float>(acc[p * filters + f]) * scale + bias_value;
+              }
+            }
+          },
+          1);
+    }
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("quantized_conv2d")
+    .SetCreateFn<CpuQuantizedConv2DKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)
+                     && (user_op::HobDataType("in", 0) == DataType::kInt8))
+    .SetInferTmpSizeFn([](user_op::InferContext* ctx) -> size_t {
+      const Shape& in_shape = ctx->InputTensorDesc("in", 0).shape();
+      const Shape& out_shape = ctx->OutputTensorDesc("out", 0)->shape();
+      const QuantizedConv2DParams params =
+          GetQuantizedConv2DParams(ctx, ShapeView(in_shape), ShapeView(out_shape));
+      return Im2RowBufferSize(params) + params.NumPatches() * out_shape.At(1) * sizeof(int32_t);
+    });
+
+}  // namespace oneflow
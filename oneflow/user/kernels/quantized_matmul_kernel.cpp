@@ -0,0 +1,74 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/user/kernels/int8_gemm.h"
+
+namespace oneflow {
+
+class CpuQuantizedMatmulKernel final : public user_op::OpKernel {
+ public:
+  CpuQuantizedMatmulKernel() = default;
+  ~CpuQuantizedMatmulKernel() = default;
+
+  std::shared_ptr<user_op::OpKernelState> CreateOpKernelState(
+      user_op::KernelInitContext* ctx) const override {
+    return std::make_shared<Int8PackedWeightState>();
+  }
+
+ private:
+  using user_op::OpKernel::Compute;
+  void Compute(user_op::KernelComputeContext* ctx, user_op::OpKernelState* state,
+               const user_op::OpKernelCache*) const override {
+    const user_op::Tensor* a = ctx->Tensor4ArgNameAndIndex("a", 0);
+    const user_op::Tensor* b = ctx->Tensor4ArgNameAndIndex("b", 0);
+    const user_op::Tensor* a_scale = ctx->Tensor4ArgNameAndIndex("a_scale", 0);
+    // Absent when the kernel computes the scale of b itself, see Int8PackedWeightState.
+    const user_op::Tensor* b_scale = ctx->Tensor4ArgNameAndIndex("b_scale", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const bool transpose_b = ctx->Attr<bool>("transpose_b");
+    const int64_t m = a->shape_view().At(0);
+    const int64_t k = a->shape_view().At(1);
+    const int64_t n = out->shape_view().At(1);
+    const Int8PackedWeight& packed_b = dynamic_cast<Int8PackedWeightState*>(state)->GetOrPack(
+        ctx->stream(), n, k, !transpose_b, b, b_scale, ctx->Attr<bool>("per_channel_b_scale"));
+
+    // The int32 accumulators are written to out and dequantized in place.
+    char* out_ptr = out->mut_dptr<char>();
+    Int8Gemm(ctx->stream(), m, a->dptr<int8_t>(), k, packed_b,
+             reinterpret_cast<int32_t*>(out_ptr), n);
+    const float scale = a_scale->dptr<float>()[0] * static_cast<float>(ctx->Attr<double>("alpha"));
+    const float* b_scale_ptr = packed_b.scales();
+    const bool per_channel = packed_b.scale_size() > 1;
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(0, m * n, [&](int64_t begin, int64_t end) {
+      for (int64_t i = begin; i < end; ++i) {
+        int32_t acc = 0;
+        std::memcpy(&acc, out_ptr + i * sizeof(int32_t), sizeof(int32_t));
+        const float y = static_cast<float>(acc) * scale * b_scale_ptr[per_channel ? i % n : 0];
+        std::memcpy(out_ptr + i * sizeof(float), &y, sizeof(float));
+      }
+    });
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+REGISTER_USER_KERNEL("quantized_matmul")
+    .SetCreateFn<CpuQuantizedMatmulKernel>()
+    .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)
+                     && (user_op::HobDataType("a", 0) == DataType::kInt8));
+
+}  // namespace oneflow
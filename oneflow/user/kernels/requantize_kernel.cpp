@@ -0,0 +1,82 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/cpu/cpu_stream.h"
+#include "oneflow/user/kernels/int8_gemm.h"
+
+namespace oneflow {
+
+namespace {
+
+// Integer outputs are round(in / scale), float outputs are in * scale.
+template<typename T, typename U>
+struct RequantizeFunctor;
+
+template<typename T>
+struct RequantizeFunctor<T, int8_t> {
+  int8_t operator()(T x, float scale) const {
+    return QuantizeToInt8(static_cast<float>(x), scale);
+  }
+};
+
+template<>
+struct RequantizeFunctor<int8_t, float> {
+  float operator()(int8_t x, float scale) const { return static_cast<float>(x) * scale; }
+};
+
+}  // namespace
+
+template<typename T, typename U>
+class CpuRequantizeKernel final : public user_op::OpKernel {
+ public:
+  CpuRequantizeKernel() = default;
+  ~CpuRequantizeKernel() = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const user_op::Tensor* scale = ctx->Tensor4ArgNameAndIndex("scale", 0);
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const int64_t elem_cnt = in->shape_view().elem_cnt();
+    // per-channel scales apply to the first axis
+    const int64_t inner_size =
+        scale->shape_view().elem_cnt() > 1 ? in->shape_view().Count(1) : elem_cnt;
+    const T* in_ptr = in->dptr<T>();
+    const float* scale_ptr = scale->dptr<float>();
+    U* out_ptr = out->mut_dptr<U>();
+    ctx->stream()->As<ep::CpuStream>()->ParallelFor(0, elem_cnt, [&](int64_t begin, int64_t end) {
+      RequantizeFunctor<T, U> functor;
+      for (int64_t i = begin; i < end; ++i) {
+        out_ptr[i] = functor(in_ptr[i], scale_ptr[i / inner_size]);
+      }
+    });
+  }
+
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return false; }
+};
+
+#define REGISTER_REQUANTIZE_KERNEL(in_dtype, out_dtype)                                      \
+  REGISTER_USER_KERNEL("requantize")                                                         \
+      .SetCreateFn<CpuRequantizeKernel<in_dtype, out_dtype>>()                               \
+      .SetIsMatchedHob((user_op::HobDeviceType() == DeviceType::kCPU)                        \
+                       && (user_op::HobDataType("in", 0) == GetDataType<in_dtype>::value)    \
+                       && (user_op::HobDataType("out", 0) == GetDataType<out_dtype>::value))
+
+REGISTER_REQUANTIZE_KERNEL(float, int8_t);
+REGISTER_REQUANTIZE_KERNEL(int8_t, float);
+REGISTER_REQUANTIZE_KERNEL(int32_t, int8_t);
+
+}  // namespace oneflow
@@ -25,6 +25,7 @@ limitations under the License.
 #include "oneflow/core/profiler/profiler.h"
 #include "oneflow/core/profiler/profile_manager.h"
 #include "oneflow/core/profiler/event_recorder.h"
+#include "oneflow/core/profiler/op_trace.h"
 #include "oneflow/core/eager/call_context.h"
 
 namespace oneflow {
@@ -740,6 +741,7 @@ Maybe<void> InitTensorTupleIndexes4Bns(const std::shared_ptr<const OperatorConf>
   opkernel->input_arg_tuple_ = input_arg_tuple;
   opkernel->output_arg_tuple_ = output_arg_tuple;
   opkernel->need_check_mem_case_ = true;
+  opkernel->op_trace_id_ = profiler::OpTraceId4Name(op_conf->user_conf().op_type_name());
 
   const DeviceType device_type = CHECK_JUST(DeviceType4DeviceTag(op_conf->device_tag()));
   const user_op::UserOpConfWrapper* user_op_conf = opkernel->user_op_conf_.get();
@@ -865,6 +867,7 @@ void StatefulOpKernel::Compute(eager::CallContext* call_ctx, DeviceCtx* device_c
   UserKernelComputeContext compute_context(compute_ctx_helper_.get(), call_ctx, device_ctx);
   auto* compute_ctx = &compute_context;
   OF_PROFILER_RANGE_GUARD("Compute");
+  profiler::OpTraceGuard op_trace_guard(op_trace_id_);
   if (Singleton<profiler::ProfileManager>::Get()) {
 #if defined(WITH_CUDA)
     const auto CalMemorySize = [compute_ctx](const one::ArgVec& args) -> int64_t {
@@ -116,6 +116,7 @@ class StatefulOpKernel final {
   std::shared_ptr<const ArgTuple> input_arg_tuple_;
   std::shared_ptr<const ArgTuple> output_arg_tuple_;
   bool need_check_mem_case_;
+  int32_t op_trace_id_;
   user_op::TensorDescInferFn tensor_desc_infer_fn_;
   user_op::DataTypeInferFn data_type_infer_fn_;
   // NOTE: every device has its own stateful local opkernel instance,
@@ -0,0 +1,111 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/ep/include/primitive/memcpy.h"
+#include "oneflow/core/ep/include/stream.h"
+#include "oneflow/user/kernels/tensor_offload_store.h"
+
+namespace oneflow {
+
+namespace {
+
+std::string OffloadKey(user_op::KernelComputeContext* ctx) {
+  return ctx->Attr<std::string>("key") + "-" + std::to_string(ctx->parallel_ctx().parallel_id());
+}
+
+void LaunchMemcpy(user_op::KernelComputeContext* ctx, ep::primitive::MemcpyKind kind, void* dst,
+                  const void* src, size_t count) {
+  if (count == 0) { return; }
+  std::unique_ptr<ep::primitive::Memcpy> primitive =
+      ep::primitive::NewPrimitive<ep::primitive::MemcpyFactory>(ctx->stream()->device_type(),
+                                                                 kind);
+  CHECK(primitive) << "Can not create Memcpy primitive for device type "
+                   << ctx->stream()->device_type();
+  primitive->Launch(ctx->stream(), dst, src, count);
+}
+
+class TensorOffloadKernel final : public user_op::OpKernel {
+ public:
+  TensorOffloadKernel() = default;
+  ~TensorOffloadKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    const user_op::Tensor* in = ctx->Tensor4ArgNameAndIndex("in", 0);
+    const size_t size = in->shape_view().elem_cnt() * GetSizeOfDataType(in->data_type());
+    TensorOffloadStore* store = TensorOffloadStore::Get();
+    auto buffer = store->AcquireBuffer(ctx->stream()->device(), size);
+    LaunchMemcpy(ctx, ep::primitive::MemcpyKind::kDtoH, buffer->ptr(), in->dptr(), size);
+    const std::string& dir = ctx->Attr<std::string>("dir");
+    // Buffers kept in host memory are only read back by later kernels on the same stream, while
+    // the disk writer waits for the copy on its own thread
+    ep::Event* event = nullptr;
+    if (!dir.empty()) {
+      event = ctx->stream()->device()->CreateEvent();
+      ctx->stream()->RecordEvent(event);
+    }
+    store->Put(OffloadKey(ctx), dir, std::move(buffer), event);
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return true; }
+};
+
+class TensorPrefetchKernel final : public user_op::OpKernel {
+ public:
+  TensorPrefetchKernel() = default;
+  ~TensorPrefetchKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    TensorOffloadStore::Get()->Prefetch(OffloadKey(ctx));
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return true; }
+};
+
+class TensorReloadKernel final : public user_op::OpKernel {
+ public:
+  TensorReloadKernel() = default;
+  ~TensorReloadKernel() override = default;
+
+ private:
+  void Compute(user_op::KernelComputeContext* ctx) const override {
+    user_op::Tensor* out = ctx->Tensor4ArgNameAndIndex("out", 0);
+    const size_t size = out->shape_view().elem_cnt() * GetSizeOfDataType(out->data_type());
+    std::shared_ptr<OffloadHostBuffer> buffer = TensorOffloadStore::Get()->Take(OffloadKey(ctx));
+    CHECK_EQ(buffer->size(), size);
+    LaunchMemcpy(ctx, ep::primitive::MemcpyKind::kHtoD, out->mut_dptr(), buffer->ptr(), size);
+    // The buffer goes back to the pool once the copy reading it is done
+    ep::Event* event = ctx->stream()->device()->CreateEvent();
+    ctx->stream()->RecordEvent(event);
+    TensorOffloadStore::Get()->ReleaseBufferAfter(event, std::move(buffer));
+  }
+  bool AlwaysComputeWhenAllOutputsEmpty() const override { return true; }
+};
+
+}  // namespace
+
+REGISTER_USER_KERNEL("tensor_offload")
+    .SetCreateFn<TensorOffloadKernel>()
+    .SetIsMatchedHob(user_op::HobTrue());
+
+REGISTER_USER_KERNEL("tensor_prefetch")
+    .SetCreateFn<TensorPrefetchKernel>()
+    .SetIsMatchedHob(user_op::HobTrue());
+
+REGISTER_USER_KERNEL("tensor_reload")
+    .SetCreateFn<TensorReloadKernel>()
+    .SetIsMatchedHob(user_op::HobTrue());
+
+}  // namespace oneflow
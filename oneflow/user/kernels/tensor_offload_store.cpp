@@ -0,0 +1,231 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/user/kernels/tensor_offload_store.h"
+#include "oneflow/core/embedding/posix_file.h"
+
+namespace oneflow {
+
+namespace {
+
+constexpr int64_t kDefaultNumIoThreads = 4;
+constexpr int64_t kDefaultPoolMb = 1024;
+
+ep::AllocationOptions PinnedOptions(ep::Device* device) {
+  ep::AllocationOptions options;
+  options.SetPinnedDevice(device->device_type(), device->device_index());
+  return options;
+}
+
+#ifdef __linux__
+
+void WriteFile(const std::string& path, const void* ptr, size_t size) {
+  embedding::PosixFile file(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  size_t offset = 0;
+  while (offset < size) {
+    const ssize_t n =
+        pwrite(file.fd(), static_cast<const char*>(ptr) + offset, size - offset, offset);
+    PCHECK(n > 0) << "Could not write offloaded tensor to '" << path << "'.";
+    offset += n;
+  }
+}
+
+void ReadFile(const std::string& path, void* ptr, size_t size) {
+  embedding::PosixFile file(path, O_RDONLY, 0644);
+  size_t offset = 0;
+  while (offset < size) {
+    const ssize_t n = pread(file.fd(), static_cast<char*>(ptr) + offset, size - offset, offset);
+    PCHECK(n > 0) << "Could not read offloaded tensor from '" << path << "'.";
+    offset += n;
+  }
+  file.Close();
+  PCHECK(unlink(path.c_str()) == 0);
+}
+
+#endif  // __linux__
+
+}  // namespace
+
+OffloadHostBuffer::OffloadHostBuffer(ep::Device* device, size_t size)
+    : device_(device), ptr_(nullptr), size_(size) {
+  CHECK_JUST(device_->AllocPinned(PinnedOptions(device_), &ptr_, std::max<size_t>(size_, 1)));
+}
+
+OffloadHostBuffer::~OffloadHostBuffer() { device_->FreePinned(PinnedOptions(device_), ptr_); }
+
+TensorOffloadStore::TensorOffloadStore()
+    : file_seq_(0),
+      pool_capacity_(ParseIntegerFromEnv("ONEFLOW_TENSOR_OFFLOAD_POOL_MB", kDefaultPoolMb) * 1024
+                     * 1024),
+      pooled_bytes_(0) {
+  const int64_t num_threads =
+      ParseIntegerFromEnv("ONEFLOW_TENSOR_OFFLOAD_NUM_IO_THREADS", kDefaultNumIoThreads);
+  CHECK_GT(num_threads, 0);
+  for (int64_t i = 0; i < num_threads; ++i) {
+    task_channels_.emplace_back(new Channel<IoTask>());
+    Channel<IoTask>* channel = task_channels_.back().get();
+    workers_.emplace_back([channel]() {
+      IoTask task;
+      while (channel->Receive(&task) == kChannelStatusSuccess) { task(); }
+    });
+  }
+}
+
+TensorOffloadStore::~TensorOffloadStore() {
+  for (auto& channel : task_channels_) { channel->Close(); }
+  for (auto& worker : workers_) { worker.join(); }
+  // The devices may already be gone at exit, so the pooled pinned memory and the pending events
+  // are left to the process teardown
+  pending_releases_.clear();
+  for (auto& pair : free_buffers_) {
+    for (auto& buffer : pair.second) { buffer.release(); }
+  }
+}
+
+TensorOffloadStore* TensorOffloadStore::Get() {
+  static TensorOffloadStore store;
+  return &store;
+}
+
+std::shared_ptr<OffloadHostBuffer> TensorOffloadStore::AcquireBuffer(ep::Device* device,
+                                                                     size_t size) {
+  CollectReleasedBuffers();
+  std::unique_ptr<OffloadHostBuffer> buffer;
+  {
+    std::unique_lock<std::mutex> lock(pool_mutex_);
+    auto it = free_buffers_.find(std::make_pair(device, size));
+    if (it != free_buffers_.end() && !it->second.empty()) {
+      buffer = std::move(it->second.back());
+      it->second.pop_back();
+      pooled_bytes_ -= size;
+    }
+  }
+  if (!buffer) { buffer.reset(new OffloadHostBuffer(device, size)); }
+  return std::shared_ptr<OffloadHostBuffer>(buffer.release(), [this](OffloadHostBuffer* ptr) {
+    // Freed outside of pool_mutex_ if the pool is full
+    std::unique_ptr<OffloadHostBuffer> buffer(ptr);
+    std::unique_lock<std::mutex> lock(pool_mutex_);
+    if (pooled_bytes_ + buffer->size() > pool_capacity_) { return; }
+    pooled_bytes_ += buffer->size();
+    free_buffers_[std::make_pair(buffer->device(), buffer->size())].emplace_back(
+        std::move(buffer));
+  });
+}
+
+size_t TensorOffloadStore::pooled_bytes() {
+  std::unique_lock<std::mutex> lock(pool_mutex_);
+  return pooled_bytes_;
+}
+
+void TensorOffloadStore::ReleaseBufferAfter(ep::Event* event,
+                                            std::shared_ptr<OffloadHostBuffer> buffer) {
+  std::unique_lock<std::mutex> lock(pending_mutex_);
+  pending_releases_.emplace_back(event, std::move(buffer));
+}
+
+void TensorOffloadStore::CollectReleasedBuffers() {
+  // Dropped outside of pending_mutex_, the buffers lock pool_mutex_ to go back to the pool
+  std::vector<std::shared_ptr<OffloadHostBuffer>> released;
+  std::unique_lock<std::mutex> lock(pending_mutex_);
+  for (auto it = pending_releases_.begin(); it != pending_releases_.end();) {
+    if (CHECK_JUST(it->first->QueryDone())) {
+      it->second->device()->DestroyEvent(it->first);
+      released.emplace_back(std::move(it->second));
+      it = pending_releases_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  lock.unlock();
+}
+
+void TensorOffloadStore::Schedule(const std::string& key, IoTask task) {
+  const size_t worker_id = std::hash<std::string>()(key) % task_channels_.size();
+  CHECK_EQ(task_channels_.at(worker_id)->Send(std::move(task)), kChannelStatusSuccess);
+}
+
+void TensorOffloadStore::Put(const std::string& key, const std::string& dir,
+                             std::shared_ptr<OffloadHostBuffer> buffer, ep::Event* event) {
+  std::shared_ptr<Entry> entry(new Entry());
+  entry->device = buffer->device();
+  entry->size = buffer->size();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (dir.empty()) {
+    // Only later kernels on the stream which filled the buffer read it back
+    if (event != nullptr) { entry->device->DestroyEvent(event); }
+    entry->buffer = std::move(buffer);
+  } else {
+#ifdef __linux__
+    if (created_dirs_.insert(dir).second) {
+      embedding::PosixFile::RecursiveCreateDirectory(dir, 0755);
+    }
+    entry->path = embedding::PosixFile::JoinPath(dir, key + "-" + std::to_string(file_seq_++));
+    const std::string path = entry->path;
+    CHECK_NOTNULL(event);
+    Schedule(key, [path, buffer, event]() {
+      CHECK_JUST(event->Sync());
+      buffer->device()->DestroyEvent(event);
+      WriteFile(path, buffer->ptr(), buffer->size());
+    });
+#else
+    UNIMPLEMENTED() << "Offloading tensors to disk is only supported on linux";
+#endif  // __linux__
+  }
+  key2entries_[key].push_back(std::move(entry));
+}
+
+void TensorOffloadStore::PrefetchEntry(const std::string& key,
+                                       const std::shared_ptr<Entry>& entry) {
+#ifdef __linux__
+  auto promise = std::make_shared<std::promise<void>>();
+  entry->loaded = promise->get_future().share();
+  Schedule(key, [this, entry, promise]() {
+    auto buffer = AcquireBuffer(entry->device, entry->size);
+    ReadFile(entry->path, buffer->ptr(), buffer->size());
+    entry->buffer = std::move(buffer);
+    promise->set_value();
+  });
+#else
+  UNIMPLEMENTED();
+#endif  // __linux__
+}
+
+void TensorOffloadStore::Prefetch(const std::string& key) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = key2entries_.find(key);
+  if (it == key2entries_.end()) { return; }
+  for (const auto& entry : it->second) {
+    if (entry->path.empty() || entry->loaded.valid()) { continue; }
+    PrefetchEntry(key, entry);
+    return;
+  }
+}
+
+std::shared_ptr<OffloadHostBuffer> TensorOffloadStore::Take(const std::string& key) {
+  std::shared_ptr<Entry> entry;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = key2entries_.find(key);
+    CHECK(it != key2entries_.end() && !it->second.empty())
+        << "No offloaded tensor found for key " << key;
+    entry = it->second.front();
+    it->second.pop_front();
+    if (!entry->path.empty() && !entry->loaded.valid()) { PrefetchEntry(key, entry); }
+  }
+  if (entry->loaded.valid()) { entry->loaded.wait(); }
+  return std::move(entry->buffer);
+}
+
+}  // namespace oneflow
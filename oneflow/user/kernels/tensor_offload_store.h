@@ -0,0 +1,109 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#ifndef ONEFLOW_USER_KERNELS_TENSOR_OFFLOAD_STORE_H_
+#define ONEFLOW_USER_KERNELS_TENSOR_OFFLOAD_STORE_H_
+
+#include <deque>
+#include <future>
+#include "oneflow/core/common/channel.h"
+#include "oneflow/core/common/util.h"
+#include "oneflow/core/ep/include/device.h"
+#include "oneflow/core/ep/include/event.h"
+
+namespace oneflow {
+
+// Host memory of an offloaded tensor, pinned for the device it came from.
+class OffloadHostBuffer final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(OffloadHostBuffer);
+  OffloadHostBuffer(ep::Device* device, size_t size);
+  ~OffloadHostBuffer();
+
+  void* ptr() const { return ptr_; }
+  size_t size() const { return size_; }
+  ep::Device* device() const { return device_; }
+
+ private:
+  ep::Device* device_;
+  void* ptr_;
+  size_t size_;
+};
+
+// Keeps the tensors put by tensor_offload until tensor_reload takes them back. The tensors of
+// one key are taken in the order they were put, so several steps can be in flight. With a
+// directory given, the tensors are written to one file each by background threads and the host
+// memory is released until they are prefetched.
+class TensorOffloadStore final {
+ public:
+  OF_DISALLOW_COPY_AND_MOVE(TensorOffloadStore);
+  TensorOffloadStore();
+  ~TensorOffloadStore();
+
+  static TensorOffloadStore* Get();
+
+  // Pinned buffers are pooled by device and size, so the tensors offloaded in each step reuse the
+  // buffers of the steps before. A buffer goes back to the pool when its last reference is gone,
+  // e.g. once its file is written, unless the pool already holds
+  // ONEFLOW_TENSOR_OFFLOAD_POOL_MB of buffers, then it is freed.
+  std::shared_ptr<OffloadHostBuffer> AcquireBuffer(ep::Device* device, size_t size);
+  // Bytes of the buffers in the pool.
+  size_t pooled_bytes();
+  // Keeps the buffer out of the pool until the copy recorded in event, which reads it, is done.
+  // Takes the ownership of event.
+  void ReleaseBufferAfter(ep::Event* event, std::shared_ptr<OffloadHostBuffer> buffer);
+
+  // An empty dir keeps the buffer in host memory. Otherwise it is written to disk after event,
+  // recorded behind the copy filling the buffer, is done. Takes the ownership of event.
+  void Put(const std::string& key, const std::string& dir,
+           std::shared_ptr<OffloadHostBuffer> buffer, ep::Event* event);
+  // Start reading the oldest tensor of key which is not read yet back to host memory
+  void Prefetch(const std::string& key);
+  // Wait until the oldest tensor of key is in host memory and remove it from the store
+  std::shared_ptr<OffloadHostBuffer> Take(const std::string& key);
+
+ private:
+  struct Entry {
+    std::string path;
+    ep::Device* device;
+    size_t size;
+    std::shared_ptr<OffloadHostBuffer> buffer;
+    std::shared_future<void> loaded;
+  };
+  using IoTask = std::function<void()>;
+
+  // Tasks of one key go to the same worker, so a tensor is written before it is read back
+  void Schedule(const std::string& key, IoTask task);
+  void PrefetchEntry(const std::string& key, const std::shared_ptr<Entry>& entry);
+  void CollectReleasedBuffers();
+
+  std::mutex mutex_;
+  HashSet<std::string> created_dirs_;
+  HashMap<std::string, std::deque<std::shared_ptr<Entry>>> key2entries_;
+  int64_t file_seq_;
+  std::vector<std::unique_ptr<Channel<IoTask>>> task_channels_;
+  std::vector<std::thread> workers_;
+  std::mutex pool_mutex_;
+  HashMap<std::pair<ep::Device*, size_t>, std::vector<std::unique_ptr<OffloadHostBuffer>>>
+      free_buffers_;
+  size_t pool_capacity_;
+  size_t pooled_bytes_;
+  std::mutex pending_mutex_;
+  std::vector<std::pair<ep::Event*, std::shared_ptr<OffloadHostBuffer>>> pending_releases_;
+};
+
+}  // namespace oneflow
+
+#endif  // ONEFLOW_USER_KERNELS_TENSOR_OFFLOAD_STORE_H_
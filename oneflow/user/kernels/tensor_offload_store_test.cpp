@@ -0,0 +1,114 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <gtest/gtest.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "oneflow/core/ep/test/test_util.h"
+#include "oneflow/user/kernels/tensor_offload_store.h"
+
+namespace oneflow {
+
+namespace test {
+
+namespace {
+
+class TensorOffloadStoreTest : public ep::test::TestCase {};
+
+constexpr size_t kBufferSize = 512 * 1024;
+
+std::shared_ptr<OffloadHostBuffer> FilledBuffer(TensorOffloadStore* store, ep::Device* device,
+                                                char value) {
+  auto buffer = store->AcquireBuffer(device, kBufferSize);
+  std::memset(buffer->ptr(), value, buffer->size());
+  return buffer;
+}
+
+bool IsFilledWith(const OffloadHostBuffer& buffer, char value) {
+  const char* ptr = static_cast<const char*>(buffer.ptr());
+  return std::all_of(ptr, ptr + buffer.size(), [&](char c) { return c == value; });
+}
+
+size_t NumFiles(const std::string& dir) {
+  size_t num_files = 0;
+  DIR* d = opendir(dir.c_str());
+  CHECK_NOTNULL(d);
+  while (const dirent* entry = readdir(d)) {
+    if (entry->d_name[0] != '.') { ++num_files; }
+  }
+  closedir(d);
+  return num_files;
+}
+
+}  // namespace
+
+#ifdef __linux__
+
+TEST_F(TensorOffloadStoreTest, disk_tensors_of_several_steps) {
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  char dir_template[] = "/tmp/tensor_offload_store_test_XXXXXX";
+  ASSERT_NE(mkdtemp(dir_template), nullptr);
+  const std::string dir = dir_template;
+  {
+    TensorOffloadStore store;
+    // Three steps in flight before the first one is reloaded.
+    for (char step = 0; step < 3; ++step) {
+      store.Put("a", dir, FilledBuffer(&store, device.get(), step), device->CreateEvent());
+    }
+    // Only the oldest tensor is prefetched, the reloads come back in the order of the steps and
+    // every file is removed once it is read.
+    store.Prefetch("a");
+    for (char step = 0; step < 3; ++step) {
+      const auto buffer = store.Take("a");
+      ASSERT_TRUE(IsFilledWith(*buffer, step)) << "step " << static_cast<int>(step);
+      ASSERT_LE(NumFiles(dir), static_cast<size_t>(2 - step));
+    }
+    ASSERT_EQ(NumFiles(dir), 0U);
+    // The next step writes new files under the same key.
+    store.Put("a", dir, FilledBuffer(&store, device.get(), 3), device->CreateEvent());
+    ASSERT_TRUE(IsFilledWith(*store.Take("a"), 3));
+    ASSERT_EQ(NumFiles(dir), 0U);
+  }
+  rmdir(dir.c_str());
+}
+
+#endif  // __linux__
+
+TEST_F(TensorOffloadStoreTest, pool_capacity) {
+  auto device = device_manager_registry_.GetDevice(DeviceType::kCPU, 0);
+  setenv("ONEFLOW_TENSOR_OFFLOAD_POOL_MB", "1", 1);
+  TensorOffloadStore store;
+  unsetenv("ONEFLOW_TENSOR_OFFLOAD_POOL_MB");
+  {
+    std::vector<std::shared_ptr<OffloadHostBuffer>> buffers;
+    for (int i = 0; i < 3; ++i) {
+      buffers.emplace_back(store.AcquireBuffer(device.get(), kBufferSize));
+    }
+    ASSERT_EQ(store.pooled_bytes(), 0U);
+  }
+  // Two buffers fill the 1MB pool, the third one is freed.
+  ASSERT_EQ(store.pooled_bytes(), 2 * kBufferSize);
+  const void* pooled = store.AcquireBuffer(device.get(), kBufferSize)->ptr();
+  ASSERT_EQ(store.pooled_bytes(), 2 * kBufferSize);
+  // The released buffer went back to the pool and is reused.
+  ASSERT_EQ(store.AcquireBuffer(device.get(), kBufferSize)->ptr(), pooled);
+}
+
+}  // namespace test
+
+}  // namespace oneflow
@@ -0,0 +1,99 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/user/ops/nn_util.h"
+#include "oneflow/core/framework/op_generated.h"
+
+namespace oneflow {
+
+/* static */ Maybe<void> QuantizedConv2DOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  const user_op::TensorDesc& in = ctx->InputTensorDesc("in", 0);
+  CHECK_EQ_OR_RETURN(in.shape().NumAxes(), 4);
+  const int32_t filters = ctx->Attr<int32_t>("filters");
+  const auto& kernel_size = ctx->Attr<std::vector<int32_t>>("kernel_size");
+  const auto& padding_before = ctx->Attr<std::vector<int32_t>>("padding_before");
+  const auto& dilation_rate = ctx->Attr<std::vector<int32_t>>("dilation_rate");
+  const auto& strides = ctx->Attr<std::vector<int32_t>>("strides");
+  DimVector out_shape = {in.shape().At(0), filters, 0, 0};
+  for (int32_t i = 0; i < 2; ++i) {
+    JUST(CalcConvOut(in.shape().At(2 + i), kernel_size.at(i), dilation_rate.at(i), strides.at(i),
+                     padding_before.at(i), &out_shape.at(2 + i)));
+  }
+  const Shape weight_shape({filters, in.shape().At(1), kernel_size.at(0), kernel_size.at(1)});
+  CHECK_EQ_OR_RETURN(ctx->InputShape("weight", 0), weight_shape);
+  CHECK_EQ_OR_RETURN(ctx->InputShape("in_scale", 0).elem_cnt(), 1);
+  // Without weight_scale the kernel computes it from the weight, per filter if
+  // per_channel_weight_scale.
+  if (ctx->has_input("weight_scale", 0)) {
+    const int64_t weight_scale_size = ctx->InputShape("weight_scale", 0).elem_cnt();
+    CHECK_OR_RETURN(weight_scale_size == 1 || weight_scale_size == filters)
+        << "weight_scale should be per-tensor or per output channel, but got "
+        << weight_scale_size << " elements";
+  }
+  if (ctx->has_input("bias", 0)) {
+    CHECK_EQ_OR_RETURN(ctx->InputShape("bias", 0), Shape({filters}));
+  }
+  user_op::TensorDesc* out = ctx->OutputTensorDesc("out", 0);
+  *out->mut_shape() = Shape(out_shape);
+  *out->mut_is_dynamic() = in.is_dynamic();
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> QuantizedConv2DOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  return InferLogicalTensorDesc(ctx);
+}
+
+/* static */ Maybe<void> QuantizedConv2DOp::GetSbp(user_op::SbpContext* ctx) {
+  auto builder = ctx->NewBuilder()
+                     .Split(user_op::OpArg("in", 0), 0)
+                     .Broadcast(user_op::OpArg("weight", 0))
+                     .Broadcast(user_op::OpArg("in_scale", 0))
+                     .Split(user_op::OpArg("out", 0), 0);
+  if (ctx->user_op_conf().has_input("weight_scale", 0)) {
+    builder.Broadcast(user_op::OpArg("weight_scale", 0));
+  }
+  if (ctx->user_op_conf().has_input("bias", 0)) { builder.Broadcast(user_op::OpArg("bias", 0)); }
+  builder.Build();
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> QuantizedConv2DOp::CheckAttr(const user_op::UserOpDefWrapper&,
+                                                      const user_op::UserOpConfWrapper& conf) {
+  // Produced by the int8 inference pass from conv2d, which only rewrites the plain nchw case.
+  CHECK_EQ_OR_RETURN(conf.attr<std::string>("data_format"), "channels_first");
+  CHECK_EQ_OR_RETURN(conf.attr<int32_t>("groups"), 1);
+  CHECK_EQ_OR_RETURN(conf.attr<std::vector<int32_t>>("kernel_size").size(), 2);
+  CHECK_EQ_OR_RETURN(conf.attr<std::vector<int32_t>>("padding_before").size(), 2);
+  CHECK_EQ_OR_RETURN(conf.attr<std::vector<int32_t>>("strides").size(), 2);
+  CHECK_EQ_OR_RETURN(conf.attr<std::vector<int32_t>>("dilation_rate").size(), 2);
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> QuantizedConv2DOp::InferDataType(user_op::InferContext* ctx) {
+  CHECK_EQ_OR_RETURN(ctx->InputDType("in", 0), DataType::kInt8);
+  CHECK_EQ_OR_RETURN(ctx->InputDType("weight", 0), DataType::kFloat);
+  CHECK_EQ_OR_RETURN(ctx->InputDType("in_scale", 0), DataType::kFloat);
+  if (ctx->has_input("weight_scale", 0)) {
+    CHECK_EQ_OR_RETURN(ctx->InputDType("weight_scale", 0), DataType::kFloat);
+  }
+  if (ctx->has_input("bias", 0)) {
+    CHECK_EQ_OR_RETURN(ctx->InputDType("bias", 0), DataType::kFloat);
+  }
+  *ctx->OutputDType("out", 0) = DataType::kFloat;
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
@@ -0,0 +1,72 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/op_generated.h"
+
+namespace oneflow {
+
+/* static */ Maybe<void> QuantizedMatmulOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  const user_op::TensorDesc& a = ctx->InputTensorDesc("a", 0);
+  const user_op::TensorDesc& b = ctx->InputTensorDesc("b", 0);
+  CHECK_EQ_OR_RETURN(a.shape().NumAxes(), 2);
+  CHECK_EQ_OR_RETURN(b.shape().NumAxes(), 2);
+  const bool transpose_b = ctx->Attr<bool>("transpose_b");
+  const int64_t k = transpose_b ? b.shape().At(1) : b.shape().At(0);
+  const int64_t n = transpose_b ? b.shape().At(0) : b.shape().At(1);
+  CHECK_EQ_OR_RETURN(a.shape().At(1), k);
+  CHECK_EQ_OR_RETURN(ctx->InputShape("a_scale", 0).elem_cnt(), 1);
+  // Without b_scale the kernel computes it from b, per output channel if per_channel_b_scale.
+  if (ctx->has_input("b_scale", 0)) {
+    const int64_t b_scale_size = ctx->InputShape("b_scale", 0).elem_cnt();
+    CHECK_OR_RETURN(b_scale_size == 1 || b_scale_size == n)
+        << "b_scale should be per-tensor or per output channel, but got " << b_scale_size
+        << " elements";
+  }
+  user_op::TensorDesc* out = ctx->OutputTensorDesc("out", 0);
+  *out->mut_shape() = Shape({a.shape().At(0), n});
+  *out->mut_is_dynamic() = a.is_dynamic();
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> QuantizedMatmulOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  return InferLogicalTensorDesc(ctx);
+}
+
+/* static */ Maybe<void> QuantizedMatmulOp::GetSbp(user_op::SbpContext* ctx) {
+  auto builder = ctx->NewBuilder()
+                     .Split(user_op::OpArg("a", 0), 0)
+                     .Broadcast(user_op::OpArg("b", 0))
+                     .Broadcast(user_op::OpArg("a_scale", 0))
+                     .Split(user_op::OpArg("out", 0), 0);
+  if (ctx->user_op_conf().has_input("b_scale", 0)) {
+    builder.Broadcast(user_op::OpArg("b_scale", 0));
+  }
+  builder.Build();
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> QuantizedMatmulOp::InferDataType(user_op::InferContext* ctx) {
+  CHECK_EQ_OR_RETURN(ctx->InputDType("a", 0), DataType::kInt8);
+  CHECK_EQ_OR_RETURN(ctx->InputDType("b", 0), DataType::kFloat);
+  CHECK_EQ_OR_RETURN(ctx->InputDType("a_scale", 0), DataType::kFloat);
+  if (ctx->has_input("b_scale", 0)) {
+    CHECK_EQ_OR_RETURN(ctx->InputDType("b_scale", 0), DataType::kFloat);
+  }
+  *ctx->OutputDType("out", 0) = DataType::kFloat;
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
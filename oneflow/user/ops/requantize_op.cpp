@@ -0,0 +1,72 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/op_generated.h"
+
+namespace oneflow {
+
+/* static */ Maybe<void> RequantizeOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  const Shape& in_shape = ctx->InputShape("in", 0);
+  const Shape& scale_shape = ctx->InputShape("scale", 0);
+  // scale_shape.elem_cnt() > 1 means per-channel quantization along the first axis.
+  if (scale_shape.elem_cnt() > 1) { CHECK_EQ_OR_RETURN(scale_shape.elem_cnt(), in_shape.At(0)); }
+  *ctx->OutputShape("out", 0) = in_shape;
+  *ctx->OutputIsDynamic("out", 0) = ctx->InputIsDynamic("in", 0);
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> RequantizeOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  return InferLogicalTensorDesc(ctx);
+}
+
+/* static */ Maybe<void> RequantizeOp::GetSbp(user_op::SbpContext* ctx) {
+  const user_op::TensorDesc& in_tensor = ctx->LogicalTensorDesc4InputArgNameAndIndex("in", 0);
+  const Shape& logical_scale_shape =
+      ctx->LogicalTensorDesc4InputArgNameAndIndex("scale", 0).shape();
+  if (logical_scale_shape.elem_cnt() > 1) {
+    ctx->NewBuilder()
+        .Split(user_op::OpArg("in", 0), 0)
+        .Split(user_op::OpArg("scale", 0), 0)
+        .Split(user_op::OpArg("out", 0), 0)
+        .Build();
+  }
+  FOR_RANGE(int64_t, i, logical_scale_shape.elem_cnt() > 1 ? 1 : 0, in_tensor.shape().NumAxes()) {
+    ctx->NewBuilder()
+        .Split(user_op::OpArg("in", 0), i)
+        .Broadcast(user_op::OpArg("scale", 0))
+        .Split(user_op::OpArg("out", 0), i)
+        .Build();
+  }
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> RequantizeOp::InferDataType(user_op::InferContext* ctx) {
+  const DataType in_data_type = ctx->InputDType("in", 0);
+  const DataType out_data_type = ctx->Attr<DataType>("out_dtype");
+  CHECK_EQ_OR_RETURN(ctx->InputDType("scale", 0), DataType::kFloat);
+  // float -> int8 quantizes, int8 -> float dequantizes and int32 -> int8 requantizes
+  // accumulators.
+  const bool is_supported =
+      (in_data_type == DataType::kFloat && out_data_type == DataType::kInt8)
+      || (in_data_type == DataType::kInt8 && out_data_type == DataType::kFloat)
+      || (in_data_type == DataType::kInt32 && out_data_type == DataType::kInt8);
+  CHECK_OR_RETURN(is_supported) << "requantize does not support " << DataType_Name(in_data_type)
+                                << " to " << DataType_Name(out_data_type);
+  *ctx->OutputDType("out", 0) = out_data_type;
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
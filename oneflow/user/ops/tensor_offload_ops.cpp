@@ -0,0 +1,123 @@
+/*
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "oneflow/core/framework/framework.h"
+#include "oneflow/core/framework/op_generated.h"
+#include "oneflow/core/job/nd_sbp_util.h"
+#include "oneflow/core/job/sbp_parallel.h"
+
+namespace oneflow {
+
+namespace {
+
+Maybe<void> InferTokenTensorDesc(user_op::InferContext* ctx, const std::string& token_name) {
+  *ctx->OutputShape(token_name, 0) = Shape({1});
+  *ctx->OutputStride(token_name, 0) = Stride(Shape({1}));
+  return Maybe<void>::Ok();
+}
+
+void SetBroadcastNdSbp(int64_t num_axes, NdSbp* nd_sbp) {
+  nd_sbp->clear_sbp_parallel();
+  for (int64_t i = 0; i < num_axes; ++i) {
+    nd_sbp->add_sbp_parallel()->mutable_broadcast_parallel();
+  }
+}
+
+}  // namespace
+
+/* static */ Maybe<void> TensorOffloadOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  return InferTokenTensorDesc(ctx, "token");
+}
+
+/* static */ Maybe<void> TensorOffloadOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  return InferTokenTensorDesc(ctx, "token");
+}
+
+/* static */ Maybe<void> TensorOffloadOp::GetSbp(user_op::SbpContext* ctx) {
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> TensorOffloadOp::InferNdSbp(user_op::InferNdSbpFnContext* ctx) {
+  // Each rank offloads its own slice of in, the token only orders the ops
+  *ctx->NdSbp4ArgNameAndIndex("in", 0) = ctx->NdSbpHint4InputArgNameAndIndex("in", 0);
+  SetBroadcastNdSbp(ctx->parallel_hierarchy().NumAxes(), ctx->NdSbp4ArgNameAndIndex("token", 0));
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> TensorOffloadOp::InferDataType(user_op::InferContext* ctx) {
+  *ctx->OutputDType("token", 0) = DataType::kInt8;
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> TensorPrefetchOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  return InferTokenTensorDesc(ctx, "out");
+}
+
+/* static */ Maybe<void> TensorPrefetchOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  return InferTokenTensorDesc(ctx, "out");
+}
+
+/* static */ Maybe<void> TensorPrefetchOp::GetSbp(user_op::SbpContext* ctx) {
+  return user_op::GetSbpFnUtil::DefaultBroadcastToBroadcast(ctx);
+}
+
+/* static */ Maybe<void> TensorPrefetchOp::InferDataType(user_op::InferContext* ctx) {
+  *ctx->OutputDType("out", 0) = ctx->InputDType("in", 0);
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> TensorReloadOp::InferLogicalTensorDesc(user_op::InferContext* ctx) {
+  const Shape& shape = ctx->Attr<Shape>("shape");
+  *ctx->OutputShape("out", 0) = shape;
+  *ctx->OutputStride("out", 0) = Stride(shape);
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> TensorReloadOp::InferPhysicalTensorDesc(user_op::InferContext* ctx) {
+  const Shape& parallel_hierarchy = *ctx->parallel_desc().hierarchy();
+  const NdSbp& nd_sbp = ctx->NdSbp4ArgNameAndIndex("out", 0);
+  const Shape& logical_shape = ctx->Attr<Shape>("shape");
+  const int64_t parallel_id = ctx->parallel_ctx().parallel_id();
+  const auto tensor_slice_view =
+      GetTensorSliceView4ParallelId(parallel_hierarchy, nd_sbp, logical_shape, parallel_id);
+  const Shape& physical_shape = tensor_slice_view.shape();
+  *ctx->OutputShape("out", 0) = physical_shape;
+  *ctx->OutputStride("out", 0) = Stride(physical_shape);
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> TensorReloadOp::GetSbp(user_op::SbpContext* ctx) {
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> TensorReloadOp::InferNdSbp(user_op::InferNdSbpFnContext* ctx) {
+  const Shape& parallel_hierarchy = ctx->parallel_hierarchy();
+  SetBroadcastNdSbp(parallel_hierarchy.NumAxes(), ctx->NdSbp4ArgNameAndIndex("token", 0));
+  NdSbp* out_distribution = ctx->NdSbp4ArgNameAndIndex("out", 0);
+  out_distribution->clear_sbp_parallel();
+  const auto& conf = ctx->user_op_conf().attr<std::vector<std::string>>("nd_sbp");
+  CHECK_EQ_OR_RETURN(conf.size(), parallel_hierarchy.NumAxes());
+  for (const std::string& sbp_str : conf) {
+    CHECK_OR_RETURN(ParseSbpParallelFromString(sbp_str, out_distribution->add_sbp_parallel()));
+  }
+  return Maybe<void>::Ok();
+}
+
+/* static */ Maybe<void> TensorReloadOp::InferDataType(user_op::InferContext* ctx) {
+  *ctx->OutputDType("out", 0) = ctx->Attr<DataType>("dtype");
+  return Maybe<void>::Ok();
+}
+
+}  // namespace oneflow
@@ -404,6 +404,54 @@ class Graph(object):
                 assert isinstance(item, Tensor)
                 self._additional_variable_tobe_loaded[name] = item
 
+    def save_checkpoint_async(self, path: str):
+        r"""Saves the variables of this graph to a sharded checkpoint at :attr:`path`.
+
+        The variables are copied to host memory before this call returns, then the shards are
+        written in background so that the graph can keep on running. Each rank only writes its
+        own slices of the variables, and rank 0 writes a manifest after all the shards have been
+        written. Call :meth:`nn.Graph.wait_checkpoint_saved` to wait for the checkpoint.
+
+        Args:
+            path (str): the directory to save the checkpoint to.
+
+        Note:
+            It must be called by all ranks after the graph has been compiled.
+        """
+        assert (
+            self._is_compiled
+        ), "nn.Graph's checkpoint can only be saved after the first call of a graph."
+        self._c_nn_graph.async_save_variables(path)
+
+    def load_checkpoint(self, path: str):
+        r"""Loads the variables of this graph from a checkpoint saved by
+        :meth:`nn.Graph.save_checkpoint_async`.
+
+        The checkpoint may be saved with a different number of ranks or different sbp,
+        each rank reads the shards overlapping its own slices of the variables in parallel.
+
+        Args:
+            path (str): the directory of the checkpoint.
+
+        Note:
+            It must be called by all ranks after the graph has been compiled.
+        """
+        assert (
+            self._is_compiled
+        ), "nn.Graph's checkpoint can only be loaded after the first call of a graph."
+        self._c_nn_graph.load_variables(path)
+
+    @staticmethod
+    def wait_checkpoint_saved():
+        r"""Blocks until the last checkpoint saved by :meth:`nn.Graph.save_checkpoint_async`
+        has been written.
+
+        Raises an error on all the ranks if any rank failed to write the checkpoint, in which
+        case a previous checkpoint at the same path is kept. Without this call the error is
+        raised by the next save or load.
+        """
+        oneflow._oneflow_internal.nn.graph.WaitUntilCheckpointSaved()
+
     @property
     def name(self):
         r"""Name auto-generated for this graph."""
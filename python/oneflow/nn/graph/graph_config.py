@@ -210,6 +210,171 @@ class GraphConfig(object):
         """
         self.proto.enable_fuse_cast_scale = mode
 
+    def allow_cpu_matmul_weight_prepack(self, mode: bool = True):
+        r"""If set to true, the weights of CPU matmuls are converted to float and packed on the
+        first run instead of on every run. They are packed again after being overwritten, e.g.
+        by ``load_state_dict`` or by a training graph sharing them. Only takes effect in graphs
+        without optimizers. Float weights which are not transposed are already in the packed
+        layout and are used as they are.
+
+        For example:
+
+        .. code-block:: python
+
+            import oneflow as flow
+
+            class Graph(flow.nn.Graph):
+                def __init__(self):
+                    super().__init__()
+                    self.linear = flow.nn.Linear(4096, 4096).to(flow.bfloat16)
+                    self.config.allow_cpu_matmul_weight_prepack(True)
+                def build(self, x):
+                    return self.linear(x)
+
+            graph = Graph()
+
+        Args:
+            mode (bool, optional): The default vaule is True.
+        """
+        self.proto.enable_cpu_matmul_weight_prepack = mode
+
+    def enable_int8_inference(self, mode: bool = True):
+        r"""If set to true, CPU matmul and conv2d ops whose input and weight are fake quantized
+        (e.g. by a model prepared with quantization aware training) run on int8 kernels. The
+        weights are quantized on the first run, and again after a weight is overwritten or its
+        scale changes. Only takes effect in graphs without optimizers, and only for symmetric
+        8 bit quantization with the google formula. When a weight scale comes from a
+        ``MinMaxObserver`` of the weight, the kernels compute it themselves, so the float weight
+        is not read between quantizations and its pages are handed back to the OS.
+
+        For example:
+
+        .. code-block:: python
+
+            import oneflow as flow
+
+            class Graph(flow.nn.Graph):
+                def __init__(self, qat_model):
+                    super().__init__()
+                    self.m = qat_model
+                    self.config.enable_int8_inference(True)
+                def build(self, x):
+                    return self.m(x)
+
+        Args:
+            mode (bool, optional): The default vaule is True.
+        """
+        self.proto.enable_int8_inference = mode
+
+    def enable_auto_parallel(self, mode: bool = True):
+        r"""If set to true, the sbp signatures of ops without a user given sbp are searched over
+        the whole graph with a cost model of computation, memory and boxing, instead of picked
+        greedily op by op. Ops placed on a single device are not affected.
+
+        For example:
+
+        .. code-block:: python
+
+            import oneflow as flow
+
+            class Graph(flow.nn.Graph):
+                def __init__(self, model):
+                    super().__init__()
+                    self.m = model
+                    self.config.enable_auto_parallel(True)
+                def build(self, x):
+                    return self.m(x)
+
+        Args:
+            mode (bool, optional): The default vaule is True.
+        """
+        self.proto.enable_auto_parallel = mode
+
+    def set_auto_parallel_computation_cost_ratio(self, ratio: float):
+        r"""Set the weight of the computation cost against the boxing cost in auto parallel.
+        The computation cost of an op is measured by the bytes each rank reads and writes.
+
+        Args:
+            ratio (float): The default value is 0.05.
+        """
+        self.proto.auto_parallel_computation_cost_ratio = ratio
+
+    def set_auto_parallel_memory_cost_ratio(self, ratio: float):
+        r"""Set the weight of the memory cost against the boxing cost in auto parallel.
+        The memory cost of an op is measured by the bytes each rank holds for its outputs.
+        A larger ratio prefers splitting the tensors over broadcasting them.
+
+        Args:
+            ratio (float): The default value is 0.0.
+        """
+        self.proto.auto_parallel_memory_cost_ratio = ratio
+
+    def enable_auto_activation_checkpointing(self, memory_budget_mb: int):
+        r"""Recompute activations in the backward pass so that the predicted peak memory of
+        each device fits the budget. Ops saving the most memory per recomputed flop are picked
+        first, on top of the modules with activation_checkpointing set. The chosen segments,
+        the predicted peak memory and the recompute overhead are logged. Only takes effect in
+        graphs with optimizers.
+
+        For example:
+
+        .. code-block:: python
+
+            import oneflow as flow
+
+            class Graph(flow.nn.Graph):
+                def __init__(self, model, optimizer):
+                    super().__init__()
+                    self.m = model
+                    self.add_optimizer(optimizer)
+                    self.config.enable_auto_activation_checkpointing(8 * 1024)
+                def build(self, x):
+                    loss = self.m(x)
+                    loss.backward()
+                    return loss
+
+        Args:
+            memory_budget_mb (int): The memory budget of each device in MiB, 0 disables it.
+        """
+        self.proto.activation_checkpointing_memory_budget_mb = memory_budget_mb
+
+    def enable_tensor_offload(
+        self, tier: str = "host", directory: str = "", min_bytes: int = 1024 * 1024
+    ):
+        r"""Move forward activations which are only needed again by the backward pass out of
+        device memory, and copy them back shortly before their first backward use. With
+        ``tier="host"`` they are kept in pinned host memory, with ``tier="disk"`` they are
+        written to files in ``directory``, which lets CPU graphs train models larger than RAM.
+        Only takes effect in graphs with optimizers.
+
+        For example:
+
+        .. code-block:: python
+
+            import oneflow as flow
+
+            class Graph(flow.nn.Graph):
+                def __init__(self, model, optimizer):
+                    super().__init__()
+                    self.m = model
+                    self.add_optimizer(optimizer)
+                    self.config.enable_tensor_offload("disk", "/mnt/nvme/offload")
+                def build(self, x):
+                    loss = self.m(x)
+                    loss.backward()
+                    return loss
+
+        Args:
+            tier (str): "host" or "disk".
+            directory (str): The directory of the offloaded files, required by the disk tier.
+            min_bytes (int): Activations smaller than this on each device stay in place.
+        """
+        assert tier in ("host", "disk"), "tier must be 'host' or 'disk'"
+        assert tier != "disk" or directory != "", "the disk tier requires a directory"
+        self.proto.tensor_offload_tier = tier
+        self.proto.tensor_offload_dir = directory
+        self.proto.tensor_offload_min_bytes = min_bytes
+
     def set_gradient_accumulation_steps(self, value):
         r"""Set num of steps to accumulate gradient.
 
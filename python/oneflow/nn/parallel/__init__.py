@@ -14,5 +14,6 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 from .ddp import DistributedDataParallel
+from .sharded_optimizer import ShardedOptimizer
 
-__all__ = ["DistributedDataParallel"]
+__all__ = ["DistributedDataParallel", "ShardedOptimizer"]
@@ -65,24 +65,7 @@ def allreduce_fn(module, param):
     return allreduce
 
 
-def DistributedDataParallel(
-    module: "flow.nn.Module", *, broadcast_buffers: bool = True, bucket_size: int = 10
-):
-    assert all(x.dtype == flow.float32 for x in module.parameters())
-    if parse_boolean_from_env("ONEFLOW_DISABLE_VIEW", False):
-        warnings.warn(
-            "because the environment variable 'ONEFLOW_DISABLE_VIEW' is set to true, so the view mechanism is disabled, and we will set bucket_size = 1"
-        )
-        bucket_size = 1
-    world_size = flow.env.get_world_size()
-    with flow.no_grad():
-        for x in module.parameters():
-            requires_grad = x.requires_grad
-            flow._C.broadcast(x, inplace=True)
-            # TODO: fix the bug that x's requires_grad is discarded
-            # after flow._C.broadcast
-            x.requires_grad_(requires_grad)
-
+def _register_python_reducer(module, bucket_size, world_size):
     all_grad_size = sum([x.numel() for x in module.parameters()])
     if all_grad_size > 0:
         device = list(module.parameters())[0].device
@@ -127,10 +110,6 @@ def DistributedDataParallel(
             flow.zeros(bucket_elems, dtype=flow.float32, device=device)
         )
 
-    ddp_state_for_reversed_params = OrderedDict(
-        reversed([(x, [False, False]) for x in module.parameters() if x.requires_grad])
-    )
-    module._ddp_state_for_reversed_params = ddp_state_for_reversed_params
     # The gradient shoule be averaged by all the nodes, so besides allreduce,
     # a division by world_size is required.
     # Use x * (1 / world_size) instead of x / world_size for two reasons:
@@ -149,10 +128,57 @@ def DistributedDataParallel(
             param._register_post_grad_accumulation_hook(inplace_mul_and_return_none)
             param._register_post_grad_accumulation_hook(allreduce_fn(module, param))
 
+
+def DistributedDataParallel(
+    module: "flow.nn.Module",
+    *,
+    broadcast_buffers: bool = True,
+    bucket_size: int = 10,
+    use_native_reducer: bool = True,
+    bucket_cap_mb: float = 25,
+):
+    r"""Averages the gradients of ``module`` over all ranks after each backward pass.
+
+    With ``use_native_reducer`` the gradients accumulate into flat buckets of at most
+    ``bucket_cap_mb`` MiB owned by a C++ reducer, which allreduces each bucket as soon as all
+    its gradients are ready and supports parameters of different dtypes. Otherwise Python hooks
+    allreduce buckets of ``bucket_size`` float32 parameters.
+    """
+    if parse_boolean_from_env("ONEFLOW_DISABLE_VIEW", False):
+        warnings.warn(
+            "because the environment variable 'ONEFLOW_DISABLE_VIEW' is set to true, so the view mechanism is disabled, and we will set bucket_size = 1"
+        )
+        bucket_size = 1
+        use_native_reducer = False
+    if not use_native_reducer:
+        assert all(x.dtype == flow.float32 for x in module.parameters())
+    world_size = flow.env.get_world_size()
+    with flow.no_grad():
+        for x in module.parameters():
+            requires_grad = x.requires_grad
+            flow._C.broadcast(x, inplace=True)
+            # TODO: fix the bug that x's requires_grad is discarded
+            # after flow._C.broadcast
+            x.requires_grad_(requires_grad)
+
+    ddp_state_for_reversed_params = OrderedDict(
+        reversed([(x, [False, False]) for x in module.parameters() if x.requires_grad])
+    )
+    module._ddp_state_for_reversed_params = ddp_state_for_reversed_params
+    if use_native_reducer:
+        reversed_param_list = list(ddp_state_for_reversed_params.keys())
+        module._ddp_reducer = flow._oneflow_internal.autograd.DDPReducer(
+            reversed_param_list, int(bucket_cap_mb * 1024 * 1024)
+        )
+    else:
+        _register_python_reducer(module, bucket_size, world_size)
+
     def post_forward_hook(module, input, output):
         ddp_state_for_reversed_params = module._ddp_state_for_reversed_params
         for state in ddp_state_for_reversed_params.values():
             state[0], state[1] = False, False
+        if use_native_reducer:
+            module._ddp_reducer.prepare_for_backward()
         if isinstance(output, (tuple, list)):
             if isinstance(output[0], dict):
                 # For List[Dict[Tensor]] return type.
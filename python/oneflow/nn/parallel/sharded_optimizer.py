@@ -0,0 +1,278 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import time
+from typing import Callable, Dict, Iterator, List, Type, Union
+
+import oneflow as flow
+from oneflow.nn.optimizer.optimizer import Optimizer
+from oneflow.nn.parameter import Parameter
+
+
+def _reduce_scatter(flat_tensor, placement):
+    return (
+        flat_tensor.to_global(placement=placement, sbp=flow.sbp.partial_sum)
+        .to_global(placement=placement, sbp=flow.sbp.split(0))
+        .to_local()
+    )
+
+
+def _all_gather(shard, placement):
+    return (
+        shard.to_global(placement=placement, sbp=flow.sbp.split(0))
+        .to_global(placement=placement, sbp=flow.sbp.broadcast)
+        .to_local()
+    )
+
+
+class _Bucket(object):
+    def __init__(self, params: List[Parameter], world_size: int, rank: int):
+        self.params = params
+        self.numel = sum(p.numel() for p in params)
+        self.shard_numel = (self.numel + world_size - 1) // world_size
+        self.padding = self.shard_numel * world_size - self.numel
+        flat = self.flatten([p.detach() for p in params])
+        begin = rank * self.shard_numel
+        self.shard = Parameter(
+            flow._C.slice_view_1d_contiguous(
+                flat, begin, begin + self.shard_numel
+            ).clone()
+        )
+
+    def flatten(self, tensors):
+        flat_list = [t.reshape(-1) for t in tensors]
+        if self.padding > 0:
+            flat_list.append(
+                flow.zeros(
+                    self.padding, dtype=tensors[0].dtype, device=tensors[0].device
+                )
+            )
+        return flow.cat(flat_list)
+
+    def unflatten_to_params(self, flat):
+        offset = 0
+        for param in self.params:
+            numel = param.numel()
+            param.copy_(
+                flow._C.slice_view_1d_contiguous(flat, offset, offset + numel).view(
+                    param.shape
+                )
+            )
+            offset += numel
+
+
+class ShardedOptimizer(Optimizer):
+    r"""Shards the states of an optimizer across all ranks for eager data parallel training.
+
+    Every rank keeps the full parameters but only ``1 / world_size`` of the optimizer
+    states. The parameters of each param group are packed into flat buckets of about
+    ``bucket_size_mb``. Each step reduce-scatters every flat gradient bucket, updates the
+    local shard of the bucket with one call of ``optimizer_class``, and all-gathers the
+    updated shards back into the parameters. Eager ops run asynchronously, so the
+    all-gathers of the step are in flight while the next forward is being dispatched.
+
+    The module must not be wrapped by :func:`oneflow.nn.parallel.DistributedDataParallel`,
+    gradients are averaged by the reduce-scatter instead. :meth:`stats` reports the optimizer
+    state memory saved on this rank and the average step time.
+
+    Args:
+        params (iterable): iterable of parameters to optimize or dicts defining
+            parameter groups
+        optimizer_class (type): the optimizer which updates the local shards, such as
+            :class:`oneflow.optim.Adam`
+        bucket_size_mb (float, optional): the size of a flat gradient bucket in MiB
+            (default: 25)
+        **defaults: the options of ``optimizer_class``
+
+    For example:
+
+    .. code-block:: python
+
+        >>> import oneflow as flow
+        >>> model = flow.nn.Linear(4, 4)  # doctest: +SKIP
+        >>> optimizer = flow.nn.parallel.ShardedOptimizer(
+        ...     model.parameters(), flow.optim.Adam, lr=1e-3
+        ... )  # doctest: +SKIP
+        >>> model(flow.randn(2, 4)).sum().backward()  # doctest: +SKIP
+        >>> optimizer.step()  # doctest: +SKIP
+        >>> optimizer.zero_grad()  # doctest: +SKIP
+
+    """
+
+    def __init__(
+        self,
+        params: Union[Iterator[Parameter], List[Dict]],
+        optimizer_class: Type[Optimizer],
+        bucket_size_mb: float = 25,
+        **defaults,
+    ):
+        super().__init__(params, defaults)
+        self._world_size = flow.env.get_world_size()
+        rank = flow.env.get_rank()
+        bucket_bytes = bucket_size_mb * 1024 * 1024
+        self._buckets = []
+        self._group_buckets = []
+        inner_param_groups = []
+        with flow.no_grad():
+            for param_group in self.param_groups:
+                params = [p for p in param_group.parameters if p.requires_grad]
+                assert all(p.is_local for p in params), "parameters must be local"
+                for p in params:
+                    assert p.is_leaf, "parameters must be leaf tensor"
+                    if p.device.type != params[0].device.type:
+                        raise ValueError(
+                            f"ShardedOptimizer needs all parameters on one device type, but "
+                            f"got {p.device.type} and {params[0].device.type}"
+                        )
+                    # the inplace broadcast drops requires_grad of the parameter
+                    flow._C.broadcast(p, inplace=True)
+                    p.requires_grad_(True)
+                # a bucket is flattened into one tensor, so parameters of another dtype start
+                # a new bucket
+                buckets = []
+                begin, size = 0, 0
+                for i, p in enumerate(params):
+                    size += p.numel() * p.dtype.bytes
+                    if (
+                        size >= bucket_bytes
+                        or i + 1 == len(params)
+                        or params[i + 1].dtype != p.dtype
+                    ):
+                        buckets.append(
+                            _Bucket(params[begin : i + 1], self._world_size, rank)
+                        )
+                        begin, size = i + 1, 0
+                self._buckets.extend(buckets)
+                self._group_buckets.append(buckets)
+                inner_param_groups.append(
+                    dict(param_group.options, params=[b.shard for b in buckets])
+                )
+        self._placement = None
+        if len(self._buckets) > 0:
+            device_type = self._buckets[0].shard.device.type
+            self._placement = flow.env.all_device_placement(device_type)
+        self._optimizer = optimizer_class(inner_param_groups, **defaults)
+        self._last_step_begin = None
+        self._step_time_sum = 0.0
+        self._step_time_num = 0
+
+    def step(self, closure: Callable = None):
+        """Performs a single optimization step.
+
+        Args:
+            closure (callable, optional): A closure that reevaluates the model
+                and returns the loss.
+        """
+        now = time.perf_counter()
+        if self._last_step_begin is not None:
+            self._step_time_sum += now - self._last_step_begin
+            self._step_time_num += 1
+        self._last_step_begin = now
+        with flow.no_grad():
+            loss = None
+            if closure is not None:
+                loss = closure()
+
+            # learning rate schedulers update the outer param groups
+            for param_group, inner_param_group in zip(
+                self.param_groups, self._optimizer.param_groups
+            ):
+                for key, value in param_group.options.items():
+                    inner_param_group[key] = value
+
+            scale = 1.0 / self._world_size
+            for bucket, has_grad in zip(self._buckets, self._buckets_with_grad()):
+                if not has_grad:
+                    bucket.shard.grad = None
+                    continue
+                grads = [
+                    flow.zeros_like(p) if p.grad is None else p.grad
+                    for p in bucket.params
+                ]
+                shard_grad = _reduce_scatter(bucket.flatten(grads), self._placement)
+                bucket.shard.grad = shard_grad * scale
+            self._optimizer.step()
+            for bucket in self._buckets:
+                if bucket.shard.grad is None:
+                    continue
+                bucket.unflatten_to_params(_all_gather(bucket.shard, self._placement))
+                bucket.shard.grad = None
+
+            self._state["step"] += 1
+            return loss
+
+    def _buckets_with_grad(self) -> List[bool]:
+        # a bucket is reduced when any rank has a gradient for it, so all ranks launch the
+        # same collectives
+        if len(self._buckets) == 0:
+            return []
+        local_flags = [
+            any(p.grad is not None for p in bucket.params) for bucket in self._buckets
+        ]
+        # every rank launches the reduction of the flags, also the ones not reading it, so that
+        # the collectives of all ranks stay in the same order
+        num_ranks_with_grad = (
+            flow.tensor(
+                local_flags, dtype=flow.int32, device=self._buckets[0].shard.device
+            )
+            .to_global(placement=self._placement, sbp=flow.sbp.partial_sum)
+            .to_global(placement=self._placement, sbp=flow.sbp.broadcast)
+            .to_local()
+        )
+        if all(local_flags):
+            # every bucket has a gradient here, so no need to wait for the other ranks
+            return local_flags
+        return [n > 0 for n in num_ranks_with_grad.tolist()]
+
+    def state_dict(self):
+        """Returns the states of the local shards, which must be loaded on the same rank."""
+        return self._optimizer.state_dict()
+
+    def load_state_dict(self, state_dict) -> None:
+        self._optimizer.load_state_dict(state_dict)
+
+    def stats(self) -> Dict[str, float]:
+        """Returns the optimizer state memory of this rank and the average step time.
+
+        ``local_state_bytes`` counts the master weight shards and the optimizer states of
+        this rank, ``unsharded_state_bytes`` the states ``optimizer_class`` would keep for the
+        full parameters without sharding, and ``avg_step_time_ms`` the average time between
+        two calls of :meth:`step`.
+        """
+        local_state_bytes = 0
+        unsharded_state_bytes = 0
+        for bucket in self._buckets:
+            local_state_bytes += bucket.shard.numel() * bucket.shard.dtype.bytes
+            state = self._optimizer._state.get(bucket.shard, {})
+            for value in state.values():
+                if not isinstance(value, flow.Tensor):
+                    continue
+                local_state_bytes += value.numel() * value.dtype.bytes
+                if value.numel() == bucket.shard_numel:
+                    # a state of every element, the unsharded one holds no padding
+                    unsharded_state_bytes += bucket.numel * value.dtype.bytes
+                else:
+                    # a state of the whole parameter, kept once per parameter
+                    unsharded_state_bytes += (
+                        len(bucket.params) * value.numel() * value.dtype.bytes
+                    )
+        return {
+            "local_state_bytes": local_state_bytes,
+            "unsharded_state_bytes": unsharded_state_bytes,
+            "saved_state_bytes": unsharded_state_bytes - local_state_bytes,
+            "avg_step_time_ms": self._step_time_sum * 1000 / self._step_time_num
+            if self._step_time_num > 0
+            else 0.0,
+        }
@@ -14,6 +14,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 """
 
+import json
 import oneflow._oneflow_internal
 from oneflow.profiler.profiler import profile, record_function, ProfilerActivity
 
@@ -25,6 +26,11 @@ __all__ = [
     "profile",
     "record_function",
     "ProfilerActivity",
+    "enable_op_trace",
+    "disable_op_trace",
+    "op_trace_stats",
+    "export_op_trace_chrome_trace",
+    "reset_op_trace",
 ]
 
 
@@ -42,3 +48,28 @@ def profiler_start():
 
 def profiler_stop():
     oneflow._oneflow_internal.profiler.ProfilerStop()
+
+
+def enable_op_trace():
+    oneflow._oneflow_internal.profiler.EnableOpTrace(True)
+
+
+def disable_op_trace():
+    oneflow._oneflow_internal.profiler.EnableOpTrace(False)
+
+
+def op_trace_stats():
+    """Returns the latency stats of every traced op type and vm instruction type as a list of
+    dicts with keys name, count, total_ns, max_ns, p50_ns, p90_ns and p99_ns."""
+    return json.loads(oneflow._oneflow_internal.profiler.DumpOpTraceStatsJson())
+
+
+def export_op_trace_chrome_trace(path):
+    """Writes the most recent traced launches of every thread to `path` in the chrome trace
+    event format, which can be opened by chrome://tracing or perfetto."""
+    with open(path, "w") as f:
+        f.write(oneflow._oneflow_internal.profiler.DumpOpTraceChromeTrace())
+
+
+def reset_op_trace():
+    oneflow._oneflow_internal.profiler.ResetOpTrace()
@@ -18,14 +18,14 @@ import re
 import os
 import unittest
 
-import numpy as np
-
 import oneflow
 import oneflow as flow
 import oneflow.framework.graph_build_util as graph_build_util
 import oneflow.framework.scope_util as scope_util
 import oneflow.unittest
 
+from train_graph_test_util import check_train_graph_matches_plain_graph
+
 
 @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
 @flow.unittest.skip_unless_1n1d()
@@ -118,5 +118,20 @@ class TestGraphActivationCheckpoint(flow.unittest.TestCase):
                 test_case.assertTrue(find_ctrl)
 
 
+@flow.unittest.skip_unless_1n1d()
+class TestGraphAutoActivationCheckpoint(flow.unittest.TestCase):
+    def test_auto_activation_checkpoint(test_case):
+        # The activations take about 2MB, so some of them must be recomputed
+        graph = check_train_graph_matches_plain_graph(
+            test_case, lambda g: g.config.enable_auto_activation_checkpointing(1)
+        )
+
+        fake_op_num = 0
+        for op in graph._full_graph_proto.net.op:
+            if op.name.startswith("OneFlow-System-Checkpointing-Fake-Fw-Op"):
+                fake_op_num += 1
+        test_case.assertGreater(fake_op_num, 0)
+
+
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,193 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import shutil
+import tempfile
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class LinearGraph(flow.nn.Graph):
+    def __init__(self, linear):
+        super().__init__()
+        self.linear = linear
+
+    def build(self, x):
+        return self.linear(x)
+
+
+def _test_graph_async_checkpoint(test_case, device):
+    linear = flow.nn.Linear(4, 6).to(device)
+    x = flow.randn(2, 4, device=device)
+    graph = LinearGraph(linear)
+    expected_out = graph(x).numpy()
+    expected_weight = linear.weight.numpy()
+
+    with tempfile.TemporaryDirectory() as checkpoint_dir:
+        graph.save_checkpoint_async(checkpoint_dir)
+        flow.nn.Graph.wait_checkpoint_saved()
+        test_case.assertTrue(os.path.exists(os.path.join(checkpoint_dir, "manifest")))
+
+        flow.nn.init.zeros_(linear.weight)
+        flow.nn.init.zeros_(linear.bias)
+        graph.load_checkpoint(checkpoint_dir)
+        test_case.assertTrue(np.array_equal(linear.weight.numpy(), expected_weight))
+        test_case.assertTrue(np.array_equal(graph(x).numpy(), expected_out))
+
+        # saving over the checkpoint replaces it and removes the shards of the old one
+        flow.nn.init.ones_(linear.weight)
+        graph.save_checkpoint_async(checkpoint_dir)
+        flow.nn.Graph.wait_checkpoint_saved()
+        flow.nn.init.zeros_(linear.weight)
+        graph.load_checkpoint(checkpoint_dir)
+        test_case.assertTrue(np.array_equal(linear.weight.numpy(), np.ones((6, 4))))
+        shard_files = [
+            filename
+            for _, _, filenames in os.walk(checkpoint_dir)
+            for filename in filenames
+            if filename.startswith("shard_") and not filename.endswith(".crc32c")
+        ]
+        test_case.assertEqual(len(shard_files), 2)
+
+        # a shard which does not match its checksums is not loaded
+        shard_path = [
+            os.path.join(root, filename)
+            for root, _, filenames in os.walk(checkpoint_dir)
+            for filename in filenames
+            if filename.startswith("shard_") and not filename.endswith(".crc32c")
+        ][0]
+        with open(shard_path, "r+b") as f:
+            first_byte = f.read(1)
+            f.seek(0)
+            f.write(bytes([first_byte[0] ^ 1]))
+        with test_case.assertRaises(Exception):
+            graph.load_checkpoint(checkpoint_dir)
+
+
+def _test_graph_async_checkpoint_write_failure(test_case):
+    linear = flow.nn.Linear(4, 6)
+    graph = LinearGraph(linear)
+    graph(flow.randn(2, 4))
+    expected_weight = linear.weight.numpy()
+
+    with tempfile.TemporaryDirectory() as checkpoint_dir:
+        graph.save_checkpoint_async(checkpoint_dir)
+        flow.nn.Graph.wait_checkpoint_saved()
+        # the shards of the next save can not be created
+        variable_dirs = [
+            os.path.join(checkpoint_dir, name)
+            for name in os.listdir(checkpoint_dir)
+            if os.path.isdir(os.path.join(checkpoint_dir, name))
+        ]
+        for variable_dir in variable_dirs:
+            os.chmod(variable_dir, 0o555)
+        try:
+            flow.nn.init.ones_(linear.weight)
+            graph.save_checkpoint_async(checkpoint_dir)
+            with test_case.assertRaises(Exception):
+                flow.nn.Graph.wait_checkpoint_saved()
+            # the error is raised once
+            flow.nn.Graph.wait_checkpoint_saved()
+        finally:
+            for variable_dir in variable_dirs:
+                os.chmod(variable_dir, 0o755)
+
+        # the previous checkpoint is kept
+        graph.load_checkpoint(checkpoint_dir)
+        test_case.assertTrue(np.array_equal(linear.weight.numpy(), expected_weight))
+
+
+def _make_global_graph(placement, sbp, init_weight=None):
+    linear = flow.nn.Linear(4, 6, bias=False)
+    if init_weight is not None:
+        with flow.no_grad():
+            linear.weight.copy_(flow.tensor(init_weight))
+    linear.to_global(placement=placement, sbp=flow.sbp.broadcast)
+    linear.weight = flow.nn.Parameter(
+        linear.weight.to_global(placement=placement, sbp=sbp)
+    )
+    graph = LinearGraph(linear)
+    x = flow.ones(2, 4).to_global(placement=placement, sbp=flow.sbp.broadcast)
+    graph(x)
+    return graph, linear
+
+
+def _test_graph_async_checkpoint_reshard(
+    test_case, device, save_ranks, save_sbp, load_ranks, load_sbp
+):
+    weight = np.arange(24).reshape(6, 4).astype(np.float32)
+    checkpoint_dir = os.path.join(
+        tempfile.gettempdir(), "test_graph_async_checkpoint_reshard"
+    )
+
+    save_placement = flow.placement(device, ranks=save_ranks)
+    graph, _ = _make_global_graph(save_placement, save_sbp, weight)
+    graph.save_checkpoint_async(checkpoint_dir)
+    flow.nn.Graph.wait_checkpoint_saved()
+
+    load_placement = flow.placement(device, ranks=load_ranks)
+    graph, linear = _make_global_graph(load_placement, load_sbp)
+    graph.load_checkpoint(checkpoint_dir)
+    loaded_weight = linear.weight.to_global(
+        placement=load_placement, sbp=flow.sbp.broadcast
+    )
+    if flow.env.get_rank() in load_ranks:
+        test_case.assertTrue(np.array_equal(loaded_weight.to_local().numpy(), weight))
+
+    flow.comm.barrier()
+    if flow.env.get_rank() == 0:
+        shutil.rmtree(checkpoint_dir)
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestGraphAsyncCheckpoint(oneflow.unittest.TestCase):
+    def test_graph_async_checkpoint_cpu(test_case):
+        _test_graph_async_checkpoint(test_case, "cpu")
+
+    @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
+    def test_graph_async_checkpoint_gpu(test_case):
+        _test_graph_async_checkpoint(test_case, "cuda")
+
+    @unittest.skipIf(os.geteuid() == 0, "root can write to read-only directories")
+    def test_graph_async_checkpoint_write_failure(test_case):
+        _test_graph_async_checkpoint_write_failure(test_case)
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestGraphAsyncCheckpointReshard(oneflow.unittest.TestCase):
+    def test_graph_async_checkpoint_reshard_cpu(test_case):
+        # saved with the rows split across the ranks, loaded with the columns split
+        _test_graph_async_checkpoint_reshard(
+            test_case, "cpu", [0, 1], flow.sbp.split(0), [0, 1], flow.sbp.split(1)
+        )
+
+    def test_graph_async_checkpoint_fewer_ranks_cpu(test_case):
+        _test_graph_async_checkpoint_reshard(
+            test_case, "cpu", [0, 1], flow.sbp.split(0), [0], flow.sbp.broadcast
+        )
+
+    def test_graph_async_checkpoint_more_ranks_cpu(test_case):
+        _test_graph_async_checkpoint_reshard(
+            test_case, "cpu", [0], flow.sbp.broadcast, [0, 1], flow.sbp.split(0)
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,141 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import unittest
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class MLP(flow.nn.Module):
+    def __init__(self):
+        super().__init__()
+        self.fc1 = flow.nn.Linear(64, 128)
+        self.fc2 = flow.nn.Linear(128, 32)
+
+    def forward(self, x):
+        return self.fc2(flow.relu(self.fc1(x))).sum(dim=1)
+
+
+def _matmul_nd_sbps(graph):
+    # nd_sbp of the inputs and outputs of each matmul, keyed by the weight it multiplies with
+    job = graph._full_graph_proto
+    nd_sbp_sigs = job.job_parallel_view_conf.op_name2nd_sbp_signature_conf
+    matmul_nd_sbps = {}
+    for op in job.net.op:
+        if not op.HasField("user_conf") or op.user_conf.op_type_name != "matmul":
+            continue
+        weight_lbn = op.user_conf.input["b"].s[0]
+        weight_name = "fc1" if "fc1.weight" in weight_lbn else "fc2"
+        bn2nd_sbp = nd_sbp_sigs[op.name].bn_in_op2nd_sbp
+        matmul_nd_sbps[weight_name] = {
+            bn: nd_sbp.sbp_parallel[0] for bn, nd_sbp in bn2nd_sbp.items()
+        }
+    return matmul_nd_sbps
+
+
+def _test_auto_parallel(
+    test_case, placement, weight_sbp, input_sbp, memory_cost_ratio, check_nd_sbps
+):
+    flow.manual_seed(0)
+    model = MLP().to_global(placement=placement, sbp=weight_sbp)
+    x = flow.randn(16, 64, placement=placement, sbp=input_sbp)
+
+    class AutoParallelGraph(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+            self.model = model
+            self.config.enable_auto_parallel(True)
+            self.config.set_auto_parallel_memory_cost_ratio(memory_cost_ratio)
+
+        def build(self, x):
+            return self.model(x)
+
+    graph = AutoParallelGraph()
+    lazy_out = graph(x)
+    eager_out = model(x)
+    test_case.assertTrue(
+        np.allclose(
+            lazy_out.to_global(sbp=flow.sbp.broadcast).numpy(),
+            eager_out.to_global(sbp=flow.sbp.broadcast).numpy(),
+            rtol=1e-4,
+            atol=1e-4,
+        )
+    )
+    matmul_nd_sbps = _matmul_nd_sbps(graph)
+    test_case.assertEqual(set(matmul_nd_sbps.keys()), {"fc1", "fc2"})
+    check_nd_sbps(matmul_nd_sbps)
+
+
+def _is_split(sbp, axis):
+    return sbp.HasField("split_parallel") and sbp.split_parallel.axis == axis
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestGraphAutoParallel(oneflow.unittest.TestCase):
+    def test_data_parallel_input_cpu(test_case):
+        # splitting the batch needs no boxing of the broadcast weights
+        def check_nd_sbps(matmul_nd_sbps):
+            for nd_sbps in matmul_nd_sbps.values():
+                test_case.assertTrue(_is_split(nd_sbps["a_0"], 0))
+                test_case.assertTrue(nd_sbps["b_0"].HasField("broadcast_parallel"))
+                test_case.assertTrue(_is_split(nd_sbps["out_0"], 0))
+
+        placement = flow.placement("cpu", ranks=[0, 1])
+        _test_auto_parallel(
+            test_case,
+            placement,
+            flow.sbp.broadcast,
+            flow.sbp.split(0),
+            0.0,
+            check_nd_sbps,
+        )
+
+    def test_split_weight_cpu(test_case):
+        # gathering the split weight of fc1 costs more than splitting its output
+        def check_nd_sbps(matmul_nd_sbps):
+            test_case.assertTrue(_is_split(matmul_nd_sbps["fc1"]["b_0"], 0))
+            test_case.assertTrue(_is_split(matmul_nd_sbps["fc1"]["out_0"], 1))
+
+        placement = flow.placement("cpu", ranks=[0, 1])
+        _test_auto_parallel(
+            test_case,
+            placement,
+            flow.sbp.split(0),
+            flow.sbp.broadcast,
+            0.0,
+            check_nd_sbps,
+        )
+
+    def test_memory_cost_cpu(test_case):
+        # slicing broadcast data is free, so holding full outputs on every rank is never cheapest
+        def check_nd_sbps(matmul_nd_sbps):
+            for nd_sbps in matmul_nd_sbps.values():
+                test_case.assertFalse(nd_sbps["out_0"].HasField("broadcast_parallel"))
+
+        placement = flow.placement("cpu", ranks=[0, 1])
+        _test_auto_parallel(
+            test_case,
+            placement,
+            flow.sbp.broadcast,
+            flow.sbp.broadcast,
+            1.0,
+            check_nd_sbps,
+        )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,107 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import time
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+from oneflow.test_utils import launch_util
+
+_ENV_NAME = "ONEFLOW_LAZY_DISTRIBUTED_PLAN_COMPILE"
+
+
+class _MLP(flow.nn.Module):
+    def __init__(self, placement, depth, width):
+        super().__init__()
+        rng = np.random.RandomState(0)
+        self.weights = flow.nn.ParameterList()
+        for _ in range(depth):
+            weight = flow.tensor(rng.randn(width, width).astype(np.float32) / width)
+            self.weights.append(
+                flow.nn.Parameter(
+                    weight.to_global(placement=placement, sbp=flow.sbp.broadcast)
+                )
+            )
+
+    def forward(self, x):
+        for weight in self.weights:
+            x = flow.relu(flow.matmul(x, weight)) + x
+        return x
+
+
+class _MLPGraph(flow.nn.Graph):
+    def __init__(self, model):
+        super().__init__()
+        self.model = model
+
+    def build(self, x):
+        return self.model(x)
+
+
+def _compile_and_run(depth=8, width=16):
+    ranks = list(range(flow.env.get_world_size()))
+    placement = flow.placement("cpu", ranks=ranks)
+    x = flow.tensor(np.random.RandomState(1).randn(4 * len(ranks), width)).to(
+        flow.float32
+    )
+    x = x.to_global(placement=placement, sbp=flow.sbp.broadcast).to_global(
+        sbp=flow.sbp.split(0)
+    )
+    graph = _MLPGraph(_MLP(placement, depth, width))
+    start = time.perf_counter()
+    out = graph(x)
+    compile_time = time.perf_counter() - start
+    return out.to_global(sbp=flow.sbp.broadcast).to_local().numpy(), compile_time
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestDistributedPlanCompile(oneflow.unittest.TestCase):
+    def test_same_result_as_master_compile(test_case):
+        # Distributed compile first, ranks skipping a compilation fall behind in id generation
+        os.environ[_ENV_NAME] = "1"
+        distributed_out, _ = _compile_and_run()
+        os.environ[_ENV_NAME] = "0"
+        master_out, _ = _compile_and_run()
+        test_case.assertTrue(np.allclose(distributed_out, master_out, 1e-5, 1e-5))
+
+
+def _launch_benchmark(num_ranks, distributed):
+    output = launch_util.launch_local_ranks(
+        __file__, num_ranks, {_ENV_NAME: "1" if distributed else "0"}
+    )
+    return launch_util.parse_result(output, "graph_compile_time")
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestDistributedPlanCompileStartup(oneflow.unittest.TestCase):
+    def test_compile_time_gain(test_case):
+        # Simulates a multi rank job with local cpu processes. Each rank only builds its own part
+        # of the data parallel plan instead of the master building all of it.
+        num_ranks = int(os.getenv("ONEFLOW_TEST_PLAN_COMPILE_BENCHMARK_RANKS", "4"))
+        master_compile_time = _launch_benchmark(num_ranks, distributed=False)
+        distributed_compile_time = _launch_benchmark(num_ranks, distributed=True)
+        test_case.assertLess(distributed_compile_time, master_compile_time)
+
+
+def _benchmark_worker():
+    _, compile_time = _compile_and_run(depth=64, width=64)
+    if flow.env.get_rank() == 0:
+        launch_util.print_result("graph_compile_time", compile_time)
+
+
+if __name__ == "__main__":
+    launch_util.main(_benchmark_worker)
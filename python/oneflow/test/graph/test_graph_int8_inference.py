@@ -0,0 +1,177 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import time
+import unittest
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+
+
+class FakeQuantLinear(flow.nn.Module):
+    def __init__(self, in_features, out_features, per_channel):
+        super().__init__()
+        self.linear = flow.nn.Linear(in_features, out_features)
+        self.weight_observer = flow.nn.MinMaxObserver(
+            per_layer_quantization=not per_channel
+        )
+        self.input_observer = flow.nn.MinMaxObserver()
+        self.fake_quant = flow.nn.FakeQuantization()
+
+    def forward(self, x, quantize=True):
+        weight = self.linear.weight
+        if quantize:
+            weight = self.fake_quant(weight, *self.weight_observer(weight))
+            x = self.fake_quant(x, *self.input_observer(x))
+        return flow._C.matmul(x, weight, transpose_b=True) + self.linear.bias
+
+
+class FakeQuantConv2d(flow.nn.Module):
+    def __init__(self, in_channels, out_channels, per_channel):
+        super().__init__()
+        self.conv = flow.nn.Conv2d(in_channels, out_channels, 3, padding=1)
+        self.weight_observer = flow.nn.MinMaxObserver(
+            per_layer_quantization=not per_channel
+        )
+        self.input_observer = flow.nn.MinMaxObserver()
+        self.fake_quant = flow.nn.FakeQuantization()
+
+    def forward(self, x, quantize=True):
+        weight = self.conv.weight
+        if quantize:
+            weight = self.fake_quant(weight, *self.weight_observer(weight))
+            x = self.fake_quant(x, *self.input_observer(x))
+        return flow._C.conv2d(x, weight, self.conv.bias, padding=[1, 1])
+
+
+class Model(flow.nn.Module):
+    def __init__(self, per_channel):
+        super().__init__()
+        self.conv = FakeQuantConv2d(16, 32, per_channel)
+        self.fc1 = FakeQuantLinear(32 * 8 * 8, 512, per_channel)
+        self.fc2 = FakeQuantLinear(512, 10, per_channel)
+
+    def forward(self, x, quantize=True):
+        x = flow.relu(self.conv(x, quantize))
+        x = flow.relu(self.fc1(x.flatten(1), quantize))
+        return self.fc2(x, quantize)
+
+
+class InferenceGraph(flow.nn.Graph):
+    def __init__(self, model, quantize, int8):
+        super().__init__()
+        self.model = model
+        self.quantize = quantize
+        self.config.enable_int8_inference(int8)
+
+    def build(self, x):
+        return self.model(x, self.quantize)
+
+
+def _cpu_has_avx512_vnni():
+    try:
+        with open("/proc/cpuinfo") as f:
+            flags = f.read()
+    except OSError:
+        return False
+    return "avx512_vnni" in flags and "avx512bw" in flags
+
+
+def _time_graph(graph, x, num_iters=20, num_repeats=3):
+    graph(x).numpy()
+    best = float("inf")
+    for _ in range(num_repeats):
+        start = time.perf_counter()
+        for _ in range(num_iters):
+            graph(x).numpy()
+        best = min(best, (time.perf_counter() - start) / num_iters)
+    return best
+
+
+def _test_int8_inference(test_case, per_channel):
+    model = Model(per_channel)
+    model.eval()
+    x = flow.tensor(np.random.uniform(-1, 1, (32, 16, 8, 8)).astype(np.float32))
+    float_weights = {k: v.numpy() for k, v in model.state_dict().items()}
+    fake_quant_out = model(x).numpy()
+    fp32_out = model(x, quantize=False).numpy()
+
+    int8_graph = InferenceGraph(model, quantize=True, int8=True)
+    int8_out = int8_graph(x).numpy()
+    op_types = [
+        op.user_conf.op_type_name
+        for op in int8_graph._full_graph_proto.net.op
+        if op.HasField("user_conf")
+    ]
+    test_case.assertEqual(op_types.count("quantized_conv2d"), 1)
+    test_case.assertEqual(op_types.count("quantized_matmul"), 2)
+    test_case.assertNotIn("fake_quantization", op_types)
+    # The weight observers are folded into the int8 kernels, the input ones stay.
+    test_case.assertEqual(op_types.count("min_max_observer"), 3)
+
+    # The int8 kernels compute exactly what fake quantization simulates, up to the rounding
+    # of the float accumulation.
+    test_case.assertTrue(np.allclose(int8_out, fake_quant_out, rtol=1e-4, atol=1e-4))
+    # And stay close to the unquantized model.
+    relative_error = np.linalg.norm(int8_out - fp32_out) / np.linalg.norm(fp32_out)
+    test_case.assertLess(relative_error, 0.05)
+
+    # The pages of the float weights are released after quantizing, not their content.
+    for k, v in model.state_dict().items():
+        test_case.assertTrue(np.array_equal(v.numpy(), float_weights[k]))
+
+
+class LargeFakeQuantMlp(flow.nn.Module):
+    def __init__(self):
+        super().__init__()
+        self.fc1 = FakeQuantLinear(2048, 4096, per_channel=True)
+        self.fc2 = FakeQuantLinear(4096, 2048, per_channel=True)
+
+    def forward(self, x, quantize=True):
+        return self.fc2(flow.relu(self.fc1(x, quantize)), quantize)
+
+
+def _test_int8_inference_speedup(test_case):
+    model = LargeFakeQuantMlp()
+    model.eval()
+    x = flow.tensor(np.random.uniform(-1, 1, (64, 2048)).astype(np.float32))
+    fp32_time = _time_graph(InferenceGraph(model, quantize=False, int8=False), x)
+    int8_time = _time_graph(InferenceGraph(model, quantize=True, int8=True), x)
+    # Of the same order as the fp32 gemm with avx2 only, the gain comes from vnni.
+    test_case.assertLess(
+        int8_time,
+        fp32_time,
+        f"fp32: {fp32_time * 1e3:.3f}ms int8: {int8_time * 1e3:.3f}ms",
+    )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestGraphInt8Inference(oneflow.unittest.TestCase):
+    def test_int8_inference_per_layer(test_case):
+        _test_int8_inference(test_case, per_channel=False)
+
+    def test_int8_inference_per_channel(test_case):
+        _test_int8_inference(test_case, per_channel=True)
+
+    @unittest.skipUnless(
+        _cpu_has_avx512_vnni(), "int8 gemm is only faster with avx512 vnni"
+    )
+    def test_int8_inference_speedup(test_case):
+        _test_int8_inference_speedup(test_case)
+
+
+if __name__ == "__main__":
+    unittest.main()
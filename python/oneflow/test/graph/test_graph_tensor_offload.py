@@ -0,0 +1,124 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import tempfile
+import unittest
+
+import oneflow as flow
+import oneflow.unittest
+
+from train_graph_test_util import (
+    check_train_graph_matches_plain_graph,
+    make_train_graph,
+)
+
+
+def _offload_config(tier, directory=""):
+    def configure(graph):
+        graph.config.enable_tensor_offload(tier, directory, min_bytes=64 * 1024)
+
+    return configure
+
+
+def _check_offload_ops(test_case, graph):
+    # Every offloaded tensor goes through tensor_offload -> tensor_prefetch -> tensor_reload under
+    # one key, the prefetch and the reload wait for the ops picked by the pass and the backward
+    # consumers read the reloaded tensor.
+    ops = {op.name: op for op in graph._full_graph_proto.net.op}
+
+    def op_type(op):
+        return op.user_conf.op_type_name if op.HasField("user_conf") else ""
+
+    def producer(op, arg):
+        return ops[op.user_conf.input[arg].s[0].split("/")[0]]
+
+    def key(op):
+        return op.user_conf.attr["key"].at_string
+
+    consumed_lbns = set(
+        lbn
+        for op in ops.values()
+        if op.HasField("user_conf")
+        for arg in op.user_conf.input.values()
+        for lbn in arg.s
+    )
+    reloads = [op for op in ops.values() if op_type(op) == "tensor_reload"]
+    test_case.assertGreater(len(reloads), 0)
+    for reload in reloads:
+        prefetch = producer(reload, "token")
+        test_case.assertEqual(op_type(prefetch), "tensor_prefetch")
+        offload = producer(prefetch, "in")
+        test_case.assertEqual(op_type(offload), "tensor_offload")
+        test_case.assertEqual(key(reload), key(prefetch))
+        test_case.assertEqual(key(reload), key(offload))
+        test_case.assertEqual(len(reload.ctrl_in_op_name), 1)
+        test_case.assertLessEqual(len(prefetch.ctrl_in_op_name), 1)
+        test_case.assertIn(reload.name + "/out_0", consumed_lbns)
+    test_case.assertEqual(
+        len([op for op in ops.values() if op_type(op) == "tensor_offload"]),
+        len(reloads),
+    )
+
+
+def _device_memory_used_by_first_step(tier=None):
+    model = flow.nn.Sequential(
+        *[m for _ in range(4) for m in (flow.nn.Linear(2048, 2048), flow.nn.ReLU())],
+        flow.nn.Linear(2048, 1),
+    ).to("cuda")
+    graph = make_train_graph(model, None if tier is None else _offload_config(tier))
+    x = flow.randn(8192, 2048, device="cuda")
+    y = flow.randn(8192, device="cuda")
+    flow.cuda.synchronize()
+    used_before = flow._oneflow_internal.GetCUDAMemoryUsed()
+    graph(x, y).numpy()
+    used_after = flow._oneflow_internal.GetCUDAMemoryUsed()
+    return used_after - used_before
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestGraphTensorOffload(flow.unittest.TestCase):
+    def test_offload_to_host(test_case):
+        graph = check_train_graph_matches_plain_graph(
+            test_case, _offload_config("host")
+        )
+        _check_offload_ops(test_case, graph)
+
+    def test_offload_to_disk(test_case):
+        with tempfile.TemporaryDirectory() as directory:
+
+            def check_no_files_left():
+                # the files of a step are all read back and removed by its backward pass,
+                # the next step writes new ones
+                test_case.assertEqual(os.listdir(directory), [])
+
+            graph = check_train_graph_matches_plain_graph(
+                test_case,
+                _offload_config("disk", directory),
+                after_step=check_no_files_left,
+            )
+            _check_offload_ops(test_case, graph)
+
+    @unittest.skipIf(os.getenv("ONEFLOW_TEST_CPU_ONLY"), "only test cpu cases")
+    def test_offload_reduces_device_memory(test_case):
+        # the activations of the forward pass are kept on the host between forward and backward,
+        # so the memory planned for them on the device shrinks
+        baseline = _device_memory_used_by_first_step()
+        offloaded = _device_memory_used_by_first_step("host")
+        test_case.assertLess(offloaded, baseline)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,72 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import numpy as np
+
+import oneflow as flow
+
+
+def make_mlp():
+    return flow.nn.Sequential(
+        flow.nn.Linear(64, 256),
+        flow.nn.ReLU(),
+        flow.nn.Linear(256, 256),
+        flow.nn.ReLU(),
+        flow.nn.Linear(256, 1),
+    )
+
+
+def make_train_graph(model, configure=None):
+    # configure(graph) sets the graph config under test, None trains the plain graph
+    optimizer = flow.optim.SGD(model.parameters(), lr=1e-3)
+
+    class TrainGraph(flow.nn.Graph):
+        def __init__(self):
+            super().__init__()
+            self.model = model
+            self.loss_fn = flow.nn.MSELoss()
+            self.add_optimizer(optimizer)
+            if configure is not None:
+                configure(self)
+
+        def build(self, x, y):
+            loss = self.loss_fn(self.model(x).flatten(), y)
+            loss.backward()
+            return loss
+
+    return TrainGraph()
+
+
+def check_train_graph_matches_plain_graph(
+    test_case, configure, num_steps=3, after_step=None
+):
+    # Trains the mlp with and without configure, the losses of every step must match
+    model = make_mlp()
+    ref_model = make_mlp()
+    ref_model.load_state_dict(model.state_dict())
+    graph = make_train_graph(model, configure)
+    ref_graph = make_train_graph(ref_model)
+
+    x = flow.randn(512, 64)
+    y = flow.randn(512)
+    for _ in range(num_steps):
+        test_case.assertTrue(
+            np.allclose(
+                graph(x, y).numpy(), ref_graph(x, y).numpy(), rtol=1e-4, atol=1e-5
+            )
+        )
+        if after_step is not None:
+            after_step()
+    return graph
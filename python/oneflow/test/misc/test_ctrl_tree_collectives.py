@@ -0,0 +1,88 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import time
+
+import oneflow as flow
+import oneflow.unittest
+from oneflow.test_utils import launch_util
+
+_FAN_OUT_ENV_NAME = "ONEFLOW_CTRL_TREE_FAN_OUT"
+_WORKER_ENV_NAME = "ONEFLOW_TEST_CTRL_WORKER"
+
+
+def _check_tree_collectives_worker():
+    # The barrier and the key are reused, so the ctrl servers must reset both after each round
+    rank = flow.env.get_rank()
+    for i in range(8):
+        flow._oneflow_internal.CtrlBarrier("test_reused_barrier_name")
+        value = flow._oneflow_internal.CtrlBroadcastKV(
+            "test_reused_broadcast_key", "rank_{}_round_{}".format(rank, i)
+        )
+        assert value == "rank_0_round_{}".format(i), value
+    launch_util.print_result("rank_{}_done".format(rank), 1)
+
+
+def _barrier_latency_worker(repeat=100):
+    flow._oneflow_internal.CtrlBarrier("benchmark_warmup")
+    start = time.perf_counter()
+    for _ in range(repeat):
+        flow._oneflow_internal.CtrlBarrier("benchmark")
+    barrier_time = (time.perf_counter() - start) / repeat
+    if flow.env.get_rank() == 0:
+        launch_util.print_result("barrier_time", barrier_time)
+
+
+_WORKERS = {
+    "check_tree_collectives": _check_tree_collectives_worker,
+    "barrier_latency": _barrier_latency_worker,
+}
+
+
+def _launch(worker_name, num_ranks, fan_out):
+    return launch_util.launch_local_ranks(
+        __file__,
+        num_ranks,
+        {_FAN_OUT_ENV_NAME: str(fan_out), _WORKER_ENV_NAME: worker_name},
+    )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestCtrlTreeCollectives(flow.unittest.TestCase):
+    def test_reused_barrier_and_broadcast_on_tree(test_case):
+        # With a fan-out of 1 the ranks form a chain, so each collective goes through the tree
+        # over several levels.
+        num_ranks = 4
+        output = _launch("check_tree_collectives", num_ranks, fan_out=1)
+        for rank in range(num_ranks):
+            test_case.assertEqual(
+                launch_util.parse_result(output, "rank_{}_done".format(rank)), 1
+            )
+
+    def test_tree_barrier_latency(test_case):
+        # Simulates a multi rank job with local processes talking over the grpc ctrl plane
+        num_ranks = int(os.getenv("ONEFLOW_TEST_CTRL_BENCHMARK_RANKS", "16"))
+        flat_time = launch_util.parse_result(
+            _launch("barrier_latency", num_ranks, fan_out=0), "barrier_time"
+        )
+        tree_time = launch_util.parse_result(
+            _launch("barrier_latency", num_ranks, fan_out=4), "barrier_time"
+        )
+        test_case.assertLessEqual(tree_time, flat_time)
+
+
+if __name__ == "__main__":
+    launch_util.main(lambda: _WORKERS[os.environ[_WORKER_ENV_NAME]]())
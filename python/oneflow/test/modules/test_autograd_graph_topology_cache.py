@@ -0,0 +1,105 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import os
+import unittest
+from collections import OrderedDict
+
+import numpy as np
+import oneflow as flow
+import oneflow.unittest
+from oneflow import autograd
+
+from oneflow.test_utils.test_util import GenArgList
+
+
+class _TopologyCache:
+    def __init__(self, enabled):
+        self.enabled = enabled
+
+    def __enter__(self):
+        self.prev = os.environ.get("ONEFLOW_AUTOGRAD_CACHE_GRAPH_TOPOLOGY")
+        os.environ["ONEFLOW_AUTOGRAD_CACHE_GRAPH_TOPOLOGY"] = (
+            "1" if self.enabled else "0"
+        )
+
+    def __exit__(self, *args):
+        if self.prev is None:
+            del os.environ["ONEFLOW_AUTOGRAD_CACHE_GRAPH_TOPOLOGY"]
+        else:
+            os.environ["ONEFLOW_AUTOGRAD_CACHE_GRAPH_TOPOLOGY"] = self.prev
+
+
+class _DropSecondGrad(autograd.Function):
+    @staticmethod
+    def forward(ctx, x, y):
+        return x + y
+
+    @staticmethod
+    def backward(ctx, z_grad):
+        return z_grad, None
+
+
+def _train_steps(np_weights, np_x, device, cache_enabled):
+    weights = [flow.tensor(w, device=device, requires_grad=True) for w in np_weights]
+    x = flow.tensor(np_x, device=device)
+    grads = []
+    with _TopologyCache(cache_enabled):
+        for step in range(6):
+            for w in weights:
+                w.grad = None
+            h = x
+            # The topology alternates between two shapes to exercise cache hits and misses
+            for w in weights if step % 2 == 0 else weights[:2]:
+                h = flow.relu(flow.matmul(h, w)) + h
+            # No grad flows into the second input, so the nodes behind it are not ready to run
+            out = _DropSecondGrad.apply(h, flow.matmul(x, weights[-1]).sin())
+            out.sum().backward()
+            grads.append(
+                [w.grad.numpy() if w.grad is not None else None for w in weights]
+            )
+    return grads
+
+
+def _test_graph_topology_cache(test_case, device):
+    np_weights = [np.random.randn(8, 8).astype(np.float32) for _ in range(4)]
+    np_x = np.random.randn(4, 8).astype(np.float32)
+    expected = _train_steps(np_weights, np_x, device, cache_enabled=False)
+    actual = _train_steps(np_weights, np_x, device, cache_enabled=True)
+    for expected_step, actual_step in zip(expected, actual):
+        for expected_grad, actual_grad in zip(expected_step, actual_step):
+            if expected_grad is None:
+                test_case.assertIsNone(actual_grad)
+            else:
+                test_case.assertTrue(
+                    np.allclose(expected_grad, actual_grad, 1e-5, 1e-5)
+                )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestAutogradGraphTopologyCache(flow.unittest.TestCase):
+    def test_graph_topology_cache(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["test_fun"] = [_test_graph_topology_cache]
+        arg_dict["device"] = (
+            ["cpu"] if os.getenv("ONEFLOW_TEST_CPU_ONLY") else ["cpu", "cuda"]
+        )
+        for arg in GenArgList(arg_dict):
+            arg[0](test_case, *arg[1:])
+
+
+if __name__ == "__main__":
+    unittest.main()
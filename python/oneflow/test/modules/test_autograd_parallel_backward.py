@@ -0,0 +1,160 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import os
+import time
+import unittest
+from collections import OrderedDict
+
+import numpy as np
+import oneflow as flow
+import oneflow.unittest
+from oneflow import autograd
+
+from oneflow.test_utils.test_util import GenArgList
+
+
+class _AutogradThreads:
+    def __init__(self, num_threads):
+        self.num_threads = num_threads
+
+    def __enter__(self):
+        self.prev = os.environ.get("ONEFLOW_AUTOGRAD_NUM_THREADS")
+        os.environ["ONEFLOW_AUTOGRAD_NUM_THREADS"] = str(self.num_threads)
+
+    def __exit__(self, *args):
+        if self.prev is None:
+            del os.environ["ONEFLOW_AUTOGRAD_NUM_THREADS"]
+        else:
+            os.environ["ONEFLOW_AUTOGRAD_NUM_THREADS"] = self.prev
+
+
+class _WideBranchyModel(flow.nn.Module):
+    def __init__(self, width, depth, features):
+        super().__init__()
+        self.branches = flow.nn.ModuleList(
+            [
+                flow.nn.Sequential(
+                    *[
+                        flow.nn.Sequential(
+                            flow.nn.Linear(features, features), flow.nn.ReLU()
+                        )
+                        for _ in range(depth)
+                    ]
+                )
+                for _ in range(width)
+            ]
+        )
+
+    def forward(self, x):
+        outs = [branch(x) for branch in self.branches]
+        # Mix neighbouring branches so the backward graph is not a set of chains
+        mixed = [outs[i] * outs[(i + 1) % len(outs)] for i in range(len(outs))]
+        return flow.stack(mixed).sum()
+
+
+def _run_backward(model, x, num_threads):
+    model.zero_grad()
+    with _AutogradThreads(num_threads):
+        model(x).backward()
+    return [p.grad.numpy() for p in model.parameters()]
+
+
+def _test_parallel_backward_grads(test_case, device, num_threads):
+    flow.manual_seed(0)
+    model = _WideBranchyModel(width=16, depth=4, features=8).to(device)
+    x = flow.randn(4, 8, device=device)
+    serial_grads = _run_backward(model, x, 1)
+    parallel_grads = _run_backward(model, x, num_threads)
+    for serial_grad, parallel_grad in zip(serial_grads, parallel_grads):
+        test_case.assertTrue(np.allclose(serial_grad, parallel_grad, 1e-5, 1e-5))
+
+
+def _test_parallel_grad_with_hooks(test_case, device, num_threads):
+    class MyMul(autograd.Function):
+        @staticmethod
+        def forward(ctx, x, y):
+            ctx.save_for_backward(x, y)
+            return x * y
+
+        @staticmethod
+        def backward(ctx, z_grad):
+            x, y = ctx.saved_tensors
+            return z_grad * y, z_grad * x
+
+    np_x = np.random.randn(4, 5).astype(np.float32)
+    np_y = np.random.randn(4, 5).astype(np.float32)
+    x = flow.tensor(np_x, device=device, requires_grad=True)
+    y = flow.tensor(np_y, device=device, requires_grad=True)
+    hook_calls = []
+
+    def hook(grad):
+        hook_calls.append(1)
+        return grad * 2
+
+    x.register_hook(hook)
+    with _AutogradThreads(num_threads):
+        z = MyMul.apply(x, y) + MyMul.apply(x.sin(), y.cos())
+        (x_grad, y_grad) = flow.autograd.grad(z.sum(), [x, y])
+    test_case.assertEqual(len(hook_calls), 1)
+    test_case.assertTrue(
+        np.allclose(
+            x_grad.numpy(), 2 * (np_y + np.cos(np_x) * np.cos(np_y)), 1e-4, 1e-4
+        )
+    )
+    test_case.assertTrue(
+        np.allclose(y_grad.numpy(), np_x - np.sin(np_x) * np.sin(np_y), 1e-4, 1e-4)
+    )
+
+
+@flow.unittest.skip_unless_1n1d()
+class TestAutogradParallelBackward(flow.unittest.TestCase):
+    def test_parallel_backward(test_case):
+        arg_dict = OrderedDict()
+        arg_dict["test_fun"] = [
+            _test_parallel_backward_grads,
+            _test_parallel_grad_with_hooks,
+        ]
+        arg_dict["device"] = (
+            ["cpu"] if os.getenv("ONEFLOW_TEST_CPU_ONLY") else ["cpu", "cuda"]
+        )
+        arg_dict["num_threads"] = [2, 4]
+        for arg in GenArgList(arg_dict):
+            arg[0](test_case, *arg[1:])
+
+    def test_parallel_backward_benchmark(test_case):
+        device = "cpu" if os.getenv("ONEFLOW_TEST_CPU_ONLY") else "cuda"
+        model = _WideBranchyModel(width=64, depth=8, features=16).to(device)
+        x = flow.randn(8, 16, device=device)
+        for num_threads in [1, 2, 4]:
+            _run_backward(model, x, num_threads)
+            flow.comm.barrier()
+            start = time.perf_counter()
+            for _ in range(10):
+                model.zero_grad()
+                with _AutogradThreads(num_threads):
+                    model(x).backward()
+            flow.comm.barrier()
+            elapsed_ms = (time.perf_counter() - start) * 1000 / 10
+            print(
+                "autograd threads: {}, forward + backward: {:.3f} ms".format(
+                    num_threads, elapsed_ms
+                )
+            )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -13,6 +13,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 """
+import time
 import unittest
 import oneflow as flow
 from oneflow.nn.parallel import DistributedDataParallel as ddp
@@ -304,6 +305,94 @@ class TestDDP(flow.unittest.TestCase):
         for dev_type in test_device:
             test_case._test_broadcast_buffer(dev_type)
 
+    def _test_ddp_reducers_and_buckets(test_case, dev_type, **ddp_kwargs):
+        class Mul(flow.nn.Module):
+            def __init__(self):
+                super().__init__()
+                for i in range(10):
+                    self.register_parameter(
+                        f"w{i}", flow.nn.Parameter(flow.Tensor([i % 2 + 1, i % 2 + 1]))
+                    )
+
+            def forward(self, x):
+                for i in range(10):
+                    x = x * getattr(self, f"w{i}")
+                return x
+
+        rank = flow.env.get_rank()
+        x = flow.Tensor([rank + 1, rank + 1]).to(dev_type)
+        m = ddp(Mul().to(dev_type), **ddp_kwargs)
+        for _ in range(2):
+            m(x).sum().backward()
+            for i in range(10):
+                test_case.assertTrue(
+                    np_allclose_with_shape(
+                        getattr(m, f"w{i}").grad.numpy(),
+                        np.array([48, 48]) if i % 2 == 0 else np.array([24, 24]),
+                    )
+                )
+            for p in m.parameters():
+                p.grad = None
+
+    def test_ddp_reducers_and_buckets(test_case):
+        for dev_type in test_device:
+            # one parameter per bucket in the native reducer
+            test_case._test_ddp_reducers_and_buckets(dev_type, bucket_cap_mb=1e-6)
+            test_case._test_ddp_reducers_and_buckets(
+                dev_type, use_native_reducer=False, bucket_size=3
+            )
+
+    def _test_ddp_mixed_dtype(test_case, dev_type):
+        class MixedLinear(flow.nn.Module):
+            def __init__(self):
+                super().__init__()
+                self.w = flow.nn.Parameter(flow.ones(2, dtype=flow.float32))
+                self.v = flow.nn.Parameter(flow.ones(2, dtype=flow.float64))
+
+            def forward(self, x):
+                return (x * self.w).sum() + (x.to(flow.float64) * self.v).sum()
+
+        rank = flow.env.get_rank()
+        x = flow.Tensor([rank + 1, rank + 1]).to(dev_type)
+        m = ddp(MixedLinear().to(dev_type))
+        m(x).backward()
+        test_case.assertEqual(m.v.grad.dtype, flow.float64)
+        test_case.assertTrue(
+            np_allclose_with_shape(m.w.grad.numpy(), np.array([1.5, 1.5]))
+        )
+        test_case.assertTrue(
+            np_allclose_with_shape(m.v.grad.numpy(), np.array([1.5, 1.5]))
+        )
+
+    def test_ddp_mixed_dtype(test_case):
+        for dev_type in test_device:
+            test_case._test_ddp_mixed_dtype(dev_type)
+
+    def test_ddp_reducer_benchmark(test_case):
+        # Many small parameters make the per parameter bookkeeping of the reducer dominate
+        def step_time(dev_type, use_native_reducer):
+            model = flow.nn.Sequential(*[flow.nn.Linear(8, 8) for _ in range(200)]).to(
+                dev_type
+            )
+            model = ddp(model, use_native_reducer=use_native_reducer)
+            x = flow.randn(4, 8, device=dev_type)
+            for i in range(12):
+                if i == 2:
+                    flow.comm.barrier()
+                    begin = time.perf_counter()
+                model(x).sum().backward()
+            flow.comm.barrier()
+            return (time.perf_counter() - begin) / 10
+
+        for dev_type in test_device:
+            python_time = step_time(dev_type, False)
+            native_time = step_time(dev_type, True)
+            if flow.env.get_rank() == 0:
+                print(
+                    f"DDP backward step on {dev_type}: python reducer "
+                    f"{python_time * 1000:.2f}ms, native reducer {native_time * 1000:.2f}ms"
+                )
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,159 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+import os
+import unittest
+
+import numpy as np
+
+import oneflow as flow
+import oneflow.unittest
+from oneflow.nn.parallel import DistributedDataParallel as ddp
+
+
+test_device = ["cpu"] if os.getenv("ONEFLOW_TEST_CPU_ONLY") else ["cpu", "cuda"]
+
+
+def _make_model(dev_type):
+    return flow.nn.Sequential(
+        flow.nn.Linear(8, 16), flow.nn.ReLU(), flow.nn.Linear(16, 3)
+    ).to(dev_type)
+
+
+def _test_sharded_optimizer(test_case, dev_type, optimizer_class, bucket_size_mb):
+    model = _make_model(dev_type)
+    ref_model = _make_model(dev_type)
+    ref_model.load_state_dict(model.state_dict())
+    ref_model = ddp(ref_model)
+    optimizer = flow.nn.parallel.ShardedOptimizer(
+        model.parameters(), optimizer_class, bucket_size_mb=bucket_size_mb, lr=0.1
+    )
+    ref_optimizer = optimizer_class(ref_model.parameters(), lr=0.1)
+
+    rank = flow.env.get_rank()
+    for i in range(3):
+        x = flow.ones(4, 8, device=dev_type) * (rank + i + 1)
+        for m, opt in ((model, optimizer), (ref_model, ref_optimizer)):
+            m(x).sum().backward()
+            opt.step()
+            opt.zero_grad()
+    for p, ref_p in zip(model.parameters(), ref_model.parameters()):
+        test_case.assertTrue(
+            np.allclose(p.numpy(), ref_p.numpy(), rtol=1e-4, atol=1e-5)
+        )
+
+    stats = optimizer.stats()
+    test_case.assertGreater(stats["local_state_bytes"], 0)
+    test_case.assertEqual(
+        stats["unsharded_state_bytes"],
+        _state_bytes(ref_optimizer, ref_model.parameters()),
+    )
+    test_case.assertGreater(stats["avg_step_time_ms"], 0)
+
+
+def _state_bytes(optimizer, params):
+    return sum(
+        value.numel() * value.dtype.bytes
+        for p in params
+        for value in optimizer._state.get(p, {}).values()
+        if isinstance(value, flow.Tensor)
+    )
+
+
+class _PartlyUsedModel(flow.nn.Module):
+    def __init__(self):
+        super().__init__()
+        self.fc1 = flow.nn.Linear(8, 16)
+        self.fc2 = flow.nn.Linear(16, 3)
+        self.unused = flow.nn.Linear(3, 3)
+
+    def forward(self, x, use_fc2):
+        x = self.fc1(x)
+        return self.fc2(x) if use_fc2 else x
+
+
+def _test_sharded_optimizer_missing_grads(test_case, dev_type):
+    # fc2 only gets gradients on rank 0 and unused on no rank
+    model = _PartlyUsedModel().to(dev_type)
+    ref_model = _PartlyUsedModel().to(dev_type)
+    ref_model.load_state_dict(model.state_dict())
+    # every parameter gets its own bucket
+    optimizer = flow.nn.parallel.ShardedOptimizer(
+        model.parameters(), flow.optim.Adam, bucket_size_mb=1e-6, lr=0.1
+    )
+    ref_optimizer = flow.optim.Adam(ref_model.parameters(), lr=0.1)
+    unused_weight = model.unused.weight.numpy()
+
+    rank = flow.env.get_rank()
+    world_size = flow.env.get_world_size()
+    placement = flow.env.all_device_placement(dev_type)
+    for i in range(3):
+        x = flow.ones(4, 8, device=dev_type) * (rank + i + 1)
+        model(x, rank == 0).sum().backward()
+        optimizer.step()
+        optimizer.zero_grad()
+        # the gradients averaged over the ranks, a missing gradient counts as zero
+        ref_model(x, rank == 0).sum().backward()
+        with flow.no_grad():
+            for p in ref_model.parameters():
+                if p is ref_model.unused.weight or p is ref_model.unused.bias:
+                    continue
+                grad = flow.zeros_like(p) if p.grad is None else p.grad
+                p.grad = (
+                    grad.to_global(placement=placement, sbp=flow.sbp.partial_sum)
+                    .to_global(placement=placement, sbp=flow.sbp.broadcast)
+                    .to_local()
+                    / world_size
+                )
+        ref_optimizer.step()
+        ref_optimizer.zero_grad()
+    for p, ref_p in zip(model.parameters(), ref_model.parameters()):
+        test_case.assertTrue(
+            np.allclose(p.numpy(), ref_p.numpy(), rtol=1e-4, atol=1e-5)
+        )
+    test_case.assertTrue(np.array_equal(model.unused.weight.numpy(), unused_weight))
+
+
+@flow.unittest.skip_unless_1n2d()
+class TestShardedOptimizer(flow.unittest.TestCase):
+    def test_sharded_sgd(test_case):
+        for dev_type in test_device:
+            _test_sharded_optimizer(test_case, dev_type, flow.optim.SGD, 25)
+
+    def test_sharded_adam_multiple_buckets(test_case):
+        for dev_type in test_device:
+            # every parameter gets its own bucket
+            _test_sharded_optimizer(test_case, dev_type, flow.optim.Adam, 1e-6)
+
+    def test_sharded_adam_missing_grads(test_case):
+        for dev_type in test_device:
+            _test_sharded_optimizer_missing_grads(test_case, dev_type)
+
+    def test_mixed_dtype_parameters_use_separate_buckets(test_case):
+        for dev_type in test_device:
+            model = flow.nn.Sequential(
+                flow.nn.Linear(8, 16), flow.nn.Linear(16, 3).to(flow.float64)
+            ).to(dev_type)
+            optimizer = flow.nn.parallel.ShardedOptimizer(
+                model.parameters(), flow.optim.SGD, lr=0.1
+            )
+            test_case.assertEqual(
+                [b.shard.dtype for b in optimizer._buckets],
+                [flow.float32, flow.float64],
+            )
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,72 @@
+"""
+Copyright 2020 The OneFlow Authors. All rights reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+"""
+
+import os
+import re
+import socket
+import subprocess
+import sys
+import unittest
+
+_WORKER_ENV_NAME = "ONEFLOW_TEST_LAUNCHED_WORKER"
+
+
+def free_port():
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+def launch_local_ranks(script, num_ranks, env=None):
+    """Runs script on num_ranks local processes with oneflow.distributed.launch, and returns
+    their output. The processes run the worker passed to main() of script instead of its tests.
+    """
+    launch_env = dict(os.environ)
+    launch_env.update(env or {})
+    launch_env[_WORKER_ENV_NAME] = "1"
+    launch_env.pop("ONEFLOW_TEST_DEVICE_NUM", None)
+    cmd = [
+        sys.executable,
+        "-m",
+        "oneflow.distributed.launch",
+        "--nproc_per_node",
+        str(num_ranks),
+        "--master_port",
+        str(free_port()),
+        os.path.abspath(script),
+    ]
+    return subprocess.check_output(
+        cmd, env=launch_env, stderr=subprocess.STDOUT
+    ).decode()
+
+
+def print_result(name, value):
+    print("{}: {:.6f}".format(name, value), flush=True)
+
+
+def parse_result(output, name):
+    """Reads a value written by print_result from the output of launch_local_ranks."""
+    return float(re.search(r"{}: ([0-9.]+)".format(name), output).group(1))
+
+
+def main(worker):
+    """Entry of a test script that runs worker when started by launch_local_ranks and its tests
+    otherwise.
+    """
+    if os.getenv(_WORKER_ENV_NAME):
+        worker()
+    else:
+        unittest.main()
@@ -131,6 +131,7 @@ void OpSchemaEmitter<Target>::run(raw_ostream& os) {
     emitTrait(def, "no_grad", "NoGrad", &op);
     emitTrait(def, "support_non_contiguous", "SupportNonContiguous", &op);
     emitTrait(def, "cpu_only", "CpuOnly", &op);
+    emitTrait(def, "random", "Random", &op);
     emitBit(def, "has_nd_sbp_infer_fn", &op);
     emitBit(def, "has_get_sbp_fn", &op);
     emitBit(def, "has_logical_tensor_desc_infer_fn", &op);